@@ -1,4 +1,5 @@
 #include "libpscnv.h"
+#include "libpscnv_trace.h"
 #include <string.h>
 #include <stdint.h>
 #include "drm.h"
@@ -185,9 +186,90 @@ int pscnv_fifo_init_ib(int fd, uint32_t cid, uint32_t pb_handle, uint32_t flags,
 
 int pscnv_obj_eng_new(int fd, uint32_t cid, uint32_t handle, uint32_t oclass, uint32_t flags) {
 	struct drm_pscnv_obj_eng_new req;
+	int ret;
 	req.cid = cid;
 	req.handle = handle;
 	req.oclass = oclass;
 	req.flags = flags;
-	return drmCommandWriteRead(fd, DRM_PSCNV_OBJ_ENG_NEW, &req, sizeof(req));
+	ret = drmCommandWriteRead(fd, DRM_PSCNV_OBJ_ENG_NEW, &req, sizeof(req));
+	if (!ret && pscnv_trace_fp) {
+		struct pscnv_trace_obj to;
+		to.cid = cid;
+		to.handle = handle;
+		to.oclass = oclass;
+		to.flags = flags;
+		pscnv_trace_record(PSCNV_TRACE_OBJ, &to, sizeof to, 0, 0);
+	}
+	return ret;
+}
+
+int pscnv_obj_free(int fd, uint32_t cid, uint32_t handle) {
+	struct drm_pscnv_obj_free req;
+	req.cid = cid;
+	req.handle = handle;
+	return drmCommandWriteRead(fd, DRM_PSCNV_OBJ_FREE, &req, sizeof(req));
+}
+
+int pscnv_chan_sched(int fd, uint32_t cid, uint32_t priority, uint32_t timeslice) {
+	struct drm_pscnv_chan_sched req;
+	req.cid = cid;
+	req.priority = priority;
+	req.timeslice = timeslice;
+	req._pad = 0;
+	return drmCommandWriteRead(fd, DRM_PSCNV_CHAN_SCHED, &req, sizeof(req));
+}
+
+int pscnv_fence_info(int fd, uint32_t cid, uint64_t *addr, uint32_t *value) {
+	int ret;
+	struct drm_pscnv_fence_info req;
+	req.cid = cid;
+	ret = drmCommandWriteRead(fd, DRM_PSCNV_FENCE_INFO, &req, sizeof(req));
+	if (ret)
+		return ret;
+	if (addr)
+		*addr = req.addr;
+	if (value)
+		*value = req.value;
+	return 0;
+}
+
+int pscnv_fence_wait(int fd, uint32_t cid, uint32_t seq, uint64_t timeout_ns) {
+	struct drm_pscnv_fence_wait req;
+	req.cid = cid;
+	req.seq = seq;
+	req.timeout_ns = timeout_ns;
+	return drmCommandWriteRead(fd, DRM_PSCNV_FENCE_WAIT, &req, sizeof(req));
+}
+
+int pscnv_fence_fd(int fd, uint32_t cid, uint32_t seq, int *fence_fd) {
+	int ret;
+	struct drm_pscnv_fence_fd req;
+	req.cid = cid;
+	req.seq = seq;
+	req._pad = 0;
+	ret = drmCommandWriteRead(fd, DRM_PSCNV_FENCE_FD, &req, sizeof(req));
+	if (ret)
+		return ret;
+	*fence_fd = req.fd;
+	return 0;
+}
+
+int pscnv_perfmon(int fd, const uint8_t signals[8][4], uint32_t period_us, uint32_t ring_order, uint32_t *handle, uint64_t *map_handle) {
+	int ret;
+	struct drm_pscnv_perfmon req;
+	memset(&req, 0, sizeof req);
+	if (signals)
+		memcpy(req.signals, signals, sizeof req.signals);
+	else
+		period_us = 0;
+	req.period_us = period_us;
+	req.ring_order = ring_order;
+	ret = drmCommandWriteRead(fd, DRM_PSCNV_PERFMON, &req, sizeof(req));
+	if (ret)
+		return ret;
+	if (handle)
+		*handle = req.handle;
+	if (map_handle)
+		*map_handle = req.map_handle;
+	return 0;
 }
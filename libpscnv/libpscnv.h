@@ -19,6 +19,11 @@
 #define PSCNV_GEM_SYSRAM_NOSNOOP	0x0000000c
 #define PSCNV_GEM_GART			PSCNV_GEM_SYSRAM_SNOOP	/* compat */
 
+#define PSCNV_CHAN_PRIO_LOW		0
+#define PSCNV_CHAN_PRIO_NORMAL		1
+#define PSCNV_CHAN_PRIO_HIGH		2
+#define PSCNV_CHAN_PRIO_REALTIME	3
+
 int pscnv_getparam(int fd, uint64_t param, uint64_t *value);
 int pscnv_gem_new(int fd, uint32_t cookie, uint32_t flags, uint32_t tile_flags, uint64_t size, uint32_t *user, uint32_t *handle, uint64_t *map_handle);
 int pscnv_gem_info(int fd, uint32_t handle, uint32_t *cookie, uint32_t *flags, uint32_t *tile_flags, uint64_t *size, uint64_t *map_handle, uint32_t *user);
@@ -36,5 +41,13 @@ int pscnv_fifo_init(int fd, uint32_t cid, uint32_t pb_handle, uint32_t flags, ui
 int pscnv_fifo_init_ib(int fd, uint32_t cid, uint32_t pb_handle, uint32_t flags, uint32_t slimask, uint64_t ib_start, uint32_t ib_order);
 int pscnv_obj_eng_new(int fd, uint32_t cid, uint32_t handle, uint32_t oclass, uint32_t flags);
 #define pscnv_obj_gr_new pscnv_obj_eng_new
+int pscnv_obj_free(int fd, uint32_t cid, uint32_t handle);
+int pscnv_chan_sched(int fd, uint32_t cid, uint32_t priority, uint32_t timeslice);
+int pscnv_fence_info(int fd, uint32_t cid, uint64_t *addr, uint32_t *value);
+int pscnv_fence_wait(int fd, uint32_t cid, uint32_t seq, uint64_t timeout_ns);
+int pscnv_fence_fd(int fd, uint32_t cid, uint32_t seq, int *fence_fd);
+/* signals NULL or period_us 0 stops sampling; the ring is laid out as
+ * drm_pscnv_perf_ring in pscnv_drm.h */
+int pscnv_perfmon(int fd, const uint8_t signals[8][4], uint32_t period_us, uint32_t ring_order, uint32_t *handle, uint64_t *map_handle);
 
 #endif
@@ -0,0 +1,160 @@
+#include "libpscnv_bocache.h"
+#include "libpscnv.h"
+#include <stdlib.h>
+#include <time.h>
+
+static uint64_t pscnv_bo_cache_time_us(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* 4 buckets of 4 KiB steps up to 16 KiB, then 4 per power of two */
+static uint64_t pscnv_bo_cache_bucket_size(int i) {
+	uint64_t base;
+	if (i < 4)
+		return (uint64_t)(i + 1) << 12;
+	base = 0x4000ull << (i / 4 - 1);
+	return base + (i % 4 + 1) * (base / 4);
+}
+
+static int pscnv_bo_cache_bucket(uint64_t size) {
+	int o = 0;
+	if (!size)
+		return -1;
+	if (size <= 0x4000)
+		return (size - 1) >> 12;
+	while ((0x8000ull << o) < size)
+		o++;
+	if (4 * (o + 1) >= PSCNV_BO_CACHE_BUCKETS)
+		return -1;
+	return 4 * (o + 1) + (size - (0x4000ull << o) - 1) / (0x1000ull << o);
+}
+
+static void pscnv_bo_cache_unlink(struct pscnv_bo_cache *cache, int i, struct pscnv_ib_bo *bo) {
+	if (bo->cache_prev)
+		bo->cache_prev->cache_next = bo->cache_next;
+	else
+		cache->head[i] = bo->cache_next;
+	if (bo->cache_next)
+		bo->cache_next->cache_prev = bo->cache_prev;
+	else
+		cache->tail[i] = bo->cache_prev;
+	bo->cache_next = bo->cache_prev = 0;
+	cache->bytes -= bo->size;
+}
+
+/* Releases BOs older than max_age_us, then the oldest ones until the
+ * cache fits in max_bytes. cache->lock held. */
+static void pscnv_bo_cache_evict(struct pscnv_bo_cache *cache, uint64_t now, uint64_t max_age_us) {
+	struct pscnv_ib_bo *bo;
+	int i, oldest;
+	for (i = 0; i < PSCNV_BO_CACHE_BUCKETS; i++)
+		while ((bo = cache->tail[i]) && now - bo->cache_time > max_age_us) {
+			pscnv_bo_cache_unlink(cache, i, bo);
+			pscnv_ib_bo_free(bo);
+		}
+	while (cache->bytes > cache->max_bytes) {
+		oldest = -1;
+		for (i = 0; i < PSCNV_BO_CACHE_BUCKETS; i++)
+			if (cache->tail[i] && (oldest == -1 || cache->tail[i]->cache_time < cache->tail[oldest]->cache_time))
+				oldest = i;
+		bo = cache->tail[oldest];
+		pscnv_bo_cache_unlink(cache, oldest, bo);
+		pscnv_ib_bo_free(bo);
+	}
+	cache->last_trim = now;
+}
+
+/* Age trimming only needs a scan every so often. */
+static void pscnv_bo_cache_age(struct pscnv_bo_cache *cache, uint64_t now) {
+	if (now - cache->last_trim >= cache->max_age_us / 4)
+		pscnv_bo_cache_evict(cache, now, cache->max_age_us);
+}
+
+int pscnv_bo_cache_new(int fd, int vid, struct pscnv_bo_cache **res) {
+	struct pscnv_bo_cache *cache = calloc(1, sizeof *cache);
+	if (!cache)
+		return 1;
+	pthread_mutex_init(&cache->lock, 0);
+	cache->fd = fd;
+	cache->vid = vid;
+	cache->max_bytes = 64 << 20;
+	cache->max_age_us = 1000000;
+	cache->last_trim = pscnv_bo_cache_time_us();
+	*res = cache;
+	return 0;
+}
+
+void pscnv_bo_cache_destroy(struct pscnv_bo_cache *cache) {
+	pscnv_bo_cache_trim(cache, 0);
+	pthread_mutex_destroy(&cache->lock);
+	free(cache);
+}
+
+void pscnv_bo_cache_set_limits(struct pscnv_bo_cache *cache, uint64_t max_bytes, uint64_t max_age_us) {
+	pthread_mutex_lock(&cache->lock);
+	cache->max_bytes = max_bytes;
+	cache->max_age_us = max_age_us;
+	pscnv_bo_cache_evict(cache, pscnv_bo_cache_time_us(), max_age_us);
+	pthread_mutex_unlock(&cache->lock);
+}
+
+/* Releases everything that has been cached for longer than max_age_us,
+ * 0 empties the cache. */
+void pscnv_bo_cache_trim(struct pscnv_bo_cache *cache, uint64_t max_age_us) {
+	uint64_t now = pscnv_bo_cache_time_us();
+	pthread_mutex_lock(&cache->lock);
+	pscnv_bo_cache_evict(cache, now + !max_age_us, max_age_us);
+	pthread_mutex_unlock(&cache->lock);
+}
+
+int pscnv_bo_cache_alloc(struct pscnv_bo_cache *cache, uint32_t cookie, uint32_t flags, uint32_t tile_flags, uint64_t size, uint32_t *user, struct pscnv_ib_bo **res) {
+	int i = pscnv_bo_cache_bucket(size);
+	struct pscnv_ib_bo *bo;
+	if (i < 0 || user)
+		return pscnv_ib_bo_alloc(cache->fd, cache->vid, cookie, flags, tile_flags, size, user, res);
+	pthread_mutex_lock(&cache->lock);
+	pscnv_bo_cache_age(cache, pscnv_bo_cache_time_us());
+	for (bo = cache->head[i]; bo; bo = bo->cache_next)
+		if (bo->flags == flags && bo->tile_flags == tile_flags)
+			break;
+	if (bo) {
+		pscnv_bo_cache_unlink(cache, i, bo);
+		cache->hits++;
+		/* GEM_NEW and VSPACE_MAP now, VSPACE_UNMAP and GEM_CLOSE back
+		 * when it was freed */
+		cache->ioctls_saved += cache->vid ? 4 : 2;
+		pthread_mutex_unlock(&cache->lock);
+		*res = bo;
+		return 0;
+	}
+	cache->misses++;
+	pthread_mutex_unlock(&cache->lock);
+	return pscnv_ib_bo_alloc(cache->fd, cache->vid, cookie, flags, tile_flags, pscnv_bo_cache_bucket_size(i), 0, res);
+}
+
+void pscnv_bo_cache_free(struct pscnv_bo_cache *cache, struct pscnv_ib_bo *bo) {
+	int i = pscnv_bo_cache_bucket(bo->size);
+	uint64_t now = pscnv_bo_cache_time_us();
+	if (i < 0 || bo->size != pscnv_bo_cache_bucket_size(i) || bo->size > cache->max_bytes ||
+	    bo->fd != cache->fd || bo->vid != cache->vid) {
+		pscnv_ib_bo_free(bo);
+		return;
+	}
+	pthread_mutex_lock(&cache->lock);
+	bo->cache_time = now;
+	bo->cache_prev = 0;
+	bo->cache_next = cache->head[i];
+	if (cache->head[i])
+		cache->head[i]->cache_prev = bo;
+	else
+		cache->tail[i] = bo;
+	cache->head[i] = bo;
+	cache->bytes += bo->size;
+	if (cache->bytes > cache->max_bytes)
+		pscnv_bo_cache_evict(cache, now, cache->max_age_us);
+	else
+		pscnv_bo_cache_age(cache, now);
+	pthread_mutex_unlock(&cache->lock);
+}
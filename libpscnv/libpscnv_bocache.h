@@ -0,0 +1,48 @@
+#ifndef LIBPSCNV_BOCACHE_H
+#define LIBPSCNV_BOCACHE_H
+#include <stdint.h>
+#include <pthread.h>
+#include "libpscnv_ib.h"
+
+/*
+ * Cache of freed BOs. pscnv_bo_cache_free keeps the BO with its vspace
+ * and CPU mappings instead of tearing it down, and pscnv_bo_cache_alloc
+ * hands it out again for a later request with the same flags and tile
+ * flags that falls in the same size bucket. Buckets go up in powers of
+ * two with 4 steps each (4, 8, 12, 16, 20, 24, 28, 32, 40, 48 KiB...), up
+ * to 64 MiB; BOs are allocated at the bucket size, so bigger ones and ones
+ * with user data bypass the cache.
+ *
+ * BOs that have sat in the cache for longer than max_age_us are released
+ * on the next alloc or free, as are the oldest ones whenever the cache
+ * grows beyond max_bytes. A reused BO keeps its old contents and cookie.
+ * Like pscnv_ib_bo_free, freeing into the cache doesn't wait for the GPU.
+ */
+
+#define PSCNV_BO_CACHE_BUCKETS	52
+
+struct pscnv_bo_cache {
+	int fd;
+	int vid;
+	pthread_mutex_t lock;
+	/* newest first */
+	struct pscnv_ib_bo *head[PSCNV_BO_CACHE_BUCKETS];
+	struct pscnv_ib_bo *tail[PSCNV_BO_CACHE_BUCKETS];
+	uint64_t bytes;
+	uint64_t max_bytes;
+	uint64_t max_age_us;
+	uint64_t last_trim;
+	/* statistics */
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t ioctls_saved;
+};
+
+int pscnv_bo_cache_new(int fd, int vid, struct pscnv_bo_cache **res);
+void pscnv_bo_cache_destroy(struct pscnv_bo_cache *cache);
+void pscnv_bo_cache_set_limits(struct pscnv_bo_cache *cache, uint64_t max_bytes, uint64_t max_age_us);
+int pscnv_bo_cache_alloc(struct pscnv_bo_cache *cache, uint32_t cookie, uint32_t flags, uint32_t tile_flags, uint64_t size, uint32_t *user, struct pscnv_ib_bo **res);
+void pscnv_bo_cache_free(struct pscnv_bo_cache *cache, struct pscnv_ib_bo *bo);
+void pscnv_bo_cache_trim(struct pscnv_bo_cache *cache, uint64_t max_age_us);
+
+#endif
@@ -0,0 +1,142 @@
+#include "libpscnv_compute.h"
+#include <stdlib.h>
+
+#define PSCNV_COMPUTE_BATCH	16
+
+/* NV50 compute */
+#define NV50_COMPUTE_BLOCKDIM_XY	0x3ac
+#define NV50_COMPUTE_BLOCKDIM_Z		0x3b0
+#define NV50_COMPUTE_BLOCKDIM_LATCH	0x2f8
+#define NV50_COMPUTE_USER_PARAM_COUNT	0x374
+#define NV50_COMPUTE_USER_PARAM		0x600
+
+static int pscnv_compute_nv50(struct pscnv_compute *cp) {
+	return cp->oclass == 0x50c0 || cp->oclass == 0x85c0;
+}
+
+static int pscnv_compute_is_dirty(struct pscnv_compute *cp, uint32_t mthd) {
+	return cp->dirty[mthd / 4 / 64] >> (mthd / 4 % 64) & 1;
+}
+
+int pscnv_compute_new(struct pscnv_ib_chan *ch, int subc, uint32_t oclass, uint32_t handle, struct pscnv_compute **res) {
+	struct pscnv_compute *cp = calloc(1, sizeof *cp);
+	if (!cp)
+		return 1;
+	cp->ch = ch;
+	cp->subc = subc;
+	cp->oclass = oclass;
+	cp->max_batch = PSCNV_COMPUTE_BATCH;
+	BEGIN_RING50(ch, subc, 0, 1);
+	OUT_RINGu(ch, handle);
+	*res = cp;
+	return 0;
+}
+
+/* Submits anything still queued, doesn't wait for it. */
+void pscnv_compute_free(struct pscnv_compute *cp) {
+	pscnv_compute_flush(cp);
+	free(cp);
+}
+
+void pscnv_compute_set_batch(struct pscnv_compute *cp, uint32_t max_batch) {
+	cp->max_batch = max_batch ? max_batch : 1;
+}
+
+/* Methods past the shadow go out right away, and so do the triggers
+ * below PSCNV_COMPUTE_STATE: semaphores, NOP, notify and wait for idle
+ * aren't state, writing the same value twice does something twice. */
+void pscnv_compute_set(struct pscnv_compute *cp, uint32_t mthd, uint32_t value) {
+	uint32_t i = mthd / 4;
+	uint64_t bit = 1ull << (i % 64);
+	if (mthd < PSCNV_COMPUTE_STATE || i >= PSCNV_COMPUTE_MTHDS) {
+		BEGIN_RING50(cp->ch, cp->subc, mthd, 1);
+		OUT_RINGu(cp->ch, value);
+		cp->words += 2;
+		return;
+	}
+	cp->state[i] = value;
+	if ((cp->known[i / 64] & bit) && cp->hw[i] == value) {
+		if (!(cp->dirty[i / 64] & bit))
+			cp->skipped++;
+		cp->dirty[i / 64] &= ~bit;
+	} else {
+		cp->dirty[i / 64] |= bit;
+	}
+}
+
+/* Addresses, high word first. */
+void pscnv_compute_set64(struct pscnv_compute *cp, uint32_t mthd, uint64_t value) {
+	pscnv_compute_set(cp, mthd, value >> 32);
+	pscnv_compute_set(cp, mthd + 4, value);
+}
+
+void pscnv_compute_setv(struct pscnv_compute *cp, uint32_t mthd, const uint32_t *values, uint32_t n) {
+	uint32_t i;
+	for (i = 0; i < n; i++)
+		pscnv_compute_set(cp, mthd + 4 * i, values[i]);
+}
+
+/* Kernel parameters. They're ordinary state here, so unchanged ones
+ * aren't sent again, and a run of changed ones goes under one header. */
+int pscnv_compute_params(struct pscnv_compute *cp, const uint32_t *params, uint32_t n) {
+	if (!pscnv_compute_nv50(cp) || n > PSCNV_COMPUTE_MAXPARAMS)
+		return 1;
+	pscnv_compute_set(cp, NV50_COMPUTE_USER_PARAM_COUNT, n << 8);
+	pscnv_compute_setv(cp, NV50_COMPUTE_USER_PARAM, params, n);
+	return 0;
+}
+
+/* Sends dirty methods, consecutive ones as one incrementing run. */
+static void pscnv_compute_emit(struct pscnv_compute *cp) {
+	struct pscnv_ib_chan *ch = cp->ch;
+	uint32_t w, start, end;
+	for (w = 0; w < PSCNV_COMPUTE_MTHDS / 64; w++) {
+		while (cp->dirty[w]) {
+			start = w * 64 + __builtin_ctzll(cp->dirty[w]);
+			end = start;
+			while (end < PSCNV_COMPUTE_MTHDS && (cp->dirty[end / 64] >> (end % 64) & 1)) {
+				cp->dirty[end / 64] &= ~(1ull << (end % 64));
+				cp->known[end / 64] |= 1ull << (end % 64);
+				cp->hw[end] = cp->state[end];
+				end++;
+			}
+			BEGIN_RING50(ch, cp->subc, start * 4, end - start);
+			OUT_RINGp(ch, &cp->state[start], end - start);
+			cp->words += end - start + 1;
+		}
+	}
+}
+
+void pscnv_compute_launch(struct pscnv_compute *cp) {
+	struct pscnv_ib_chan *ch = cp->ch;
+	int latch = pscnv_compute_nv50(cp) &&
+		(pscnv_compute_is_dirty(cp, NV50_COMPUTE_BLOCKDIM_XY) ||
+		 pscnv_compute_is_dirty(cp, NV50_COMPUTE_BLOCKDIM_Z));
+	pscnv_compute_emit(cp);
+	if (latch) {
+		BEGIN_RING50(ch, cp->subc, NV50_COMPUTE_BLOCKDIM_LATCH, 1);
+		OUT_RINGu(ch, 1);
+		cp->words += 2;
+	}
+	BEGIN_RING50(ch, cp->subc, PSCNV_COMPUTE_LAUNCH, 1);
+	OUT_RINGu(ch, 0);
+	cp->words += 2;
+	cp->launches++;
+	if (++cp->batched >= cp->max_batch)
+		pscnv_compute_flush(cp);
+}
+
+void pscnv_compute_flush(struct pscnv_compute *cp) {
+	if (cp->batched)
+		cp->flushes++;
+	cp->batched = 0;
+	FIRE_RING(cp->ch);
+}
+
+void pscnv_compute_invalidate(struct pscnv_compute *cp) {
+	uint32_t w;
+	for (w = 0; w < PSCNV_COMPUTE_MTHDS / 64; w++) {
+		cp->dirty[w] |= cp->known[w];
+		cp->known[w] = 0;
+	}
+}
@@ -0,0 +1,51 @@
+#ifndef LIBPSCNV_COMPUTE_H
+#define LIBPSCNV_COMPUTE_H
+#include "libpscnv_ib.h"
+
+/*
+ * Compute dispatch with shadowed state. Methods are set on the host with
+ * pscnv_compute_set and friends; pscnv_compute_launch then emits only
+ * those whose value differs from what was last sent to the GPU,
+ * consecutive ones under a single header, followed by the launch.
+ * Launches are queued, one IB entry and doorbell per max_batch of them
+ * or per pscnv_compute_flush.
+ *
+ * Anything else written to the object's subchannel behind the
+ * dispatcher's back needs pscnv_compute_invalidate, after which
+ * everything set is sent again.
+ */
+
+#define PSCNV_COMPUTE_STATE	0x140	/* methods 0x140 - 0x7fc are shadowed */
+#define PSCNV_COMPUTE_MTHDS	0x200
+#define PSCNV_COMPUTE_LAUNCH	0x368
+#define PSCNV_COMPUTE_MAXPARAMS	64
+
+struct pscnv_compute {
+	struct pscnv_ib_chan *ch;
+	int subc;
+	uint32_t oclass;
+	uint32_t max_batch;
+	uint32_t batched;
+	uint32_t state[PSCNV_COMPUTE_MTHDS];	/* what launches use */
+	uint32_t hw[PSCNV_COMPUTE_MTHDS];	/* what the GPU has */
+	uint64_t known[PSCNV_COMPUTE_MTHDS / 64];	/* hw is valid */
+	uint64_t dirty[PSCNV_COMPUTE_MTHDS / 64];
+	/* statistics */
+	uint64_t launches;
+	uint64_t flushes;
+	uint64_t words;		/* state dwords emitted, headers included */
+	uint64_t skipped;	/* sets that matched the GPU's value */
+};
+
+int pscnv_compute_new(struct pscnv_ib_chan *ch, int subc, uint32_t oclass, uint32_t handle, struct pscnv_compute **res);
+void pscnv_compute_free(struct pscnv_compute *cp);
+void pscnv_compute_set_batch(struct pscnv_compute *cp, uint32_t max_batch);
+void pscnv_compute_set(struct pscnv_compute *cp, uint32_t mthd, uint32_t value);
+void pscnv_compute_set64(struct pscnv_compute *cp, uint32_t mthd, uint64_t value);
+void pscnv_compute_setv(struct pscnv_compute *cp, uint32_t mthd, const uint32_t *values, uint32_t n);
+int pscnv_compute_params(struct pscnv_compute *cp, const uint32_t *params, uint32_t n);
+void pscnv_compute_launch(struct pscnv_compute *cp);
+void pscnv_compute_flush(struct pscnv_compute *cp);
+void pscnv_compute_invalidate(struct pscnv_compute *cp);
+
+#endif
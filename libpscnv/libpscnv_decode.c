@@ -0,0 +1,268 @@
+#include "libpscnv_decode.h"
+#include <stdlib.h>
+#include <string.h>
+
+void pscnv_decode_init(struct pscnv_decode *d, uint32_t chipset) {
+	memset(d, 0, sizeof *d);
+	d->chipset = chipset;
+}
+
+static void pscnv_decode_write(struct pscnv_decode *d, int subc, uint32_t mthd, uint32_t data, int flags) {
+	if (!mthd) {
+		d->subc_obj[subc] = data;
+		d->subc_class[subc] = d->chipset < 0xc0 && d->lookup ? d->lookup(d->lookup_priv, data) : data;
+	}
+	if (d->method)
+		d->method(d->priv, subc, mthd < 0x100 ? 0 : d->subc_obj[subc],
+				mthd < 0x100 ? 0 : d->subc_class[subc], mthd, data, flags);
+}
+
+/* Returns 1 if it hit something that isn't a method header, the rest of
+ * the words passed are skipped then. A header's data may run on into the
+ * next call, so a stream can be fed in pieces of any size. */
+int pscnv_decode(struct pscnv_decode *d, const uint32_t *w, uint32_t n) {
+	uint32_t i = 0, hdr, type, subc;
+	int nvc0 = d->chipset >= 0xc0;
+	while (i < n) {
+		if (d->left) {
+			int flags = d->done ? 0 : PSCNV_DECODE_FIRST;
+			uint32_t m = d->mthd;
+			if (d->type == 0 || d->type == 1)
+				m += 4 * d->done;
+			else if (d->type == 5)
+				m += d->done ? 4 : 0;
+			else
+				flags |= PSCNV_DECODE_NI;
+			d->done++;
+			d->left--;
+			d->nwords++;
+			pscnv_decode_write(d, d->subc, m, w[i++], flags);
+			continue;
+		}
+		hdr = w[i++];
+		type = hdr >> 29;
+		subc = hdr >> 13 & 7;
+		d->nwords++;
+		if (!nvc0 && ((hdr & 3) == 1 || (hdr & 3) == 2 || type == 1 || hdr == 0x20000)) {
+			/* jump, call or return: where they lead isn't in what
+			 * was passed. The words after a call are what runs
+			 * once it returns, after the others they are not. */
+			d->njumps++;
+			if ((hdr & 3) == 2)
+				continue;
+			return 0;
+		}
+		d->nheaders++;
+		if ((type == 0 || type == 2) && !(hdr & 3)) {
+			d->mthd = hdr & 0x1ffc;
+			d->left = hdr >> 18 & 0x7ff;
+		} else if (nvc0 && (type == 1 || type == 3 || type == 5)) {
+			d->mthd = (hdr & 0xfff) << 2;
+			d->left = hdr >> 16 & 0x1fff;
+		} else if (nvc0 && type == 4) {
+			pscnv_decode_write(d, subc, (hdr & 0xfff) << 2, hdr >> 16 & 0x1fff, PSCNV_DECODE_FIRST | PSCNV_DECODE_IMM);
+			continue;
+		} else {
+			d->nbad++;
+			return 1;
+		}
+		d->type = type;
+		d->subc = subc;
+		d->done = 0;
+	}
+	return 0;
+}
+
+/* What a method does besides setting state. Only the usual compute,
+ * 3D, 2D and copy classes are known, anything else is all state. */
+int pscnv_pb_method_kind(uint32_t oclass, uint32_t mthd) {
+	/* PFIFO, and NOP/notify/wait for idle and friends */
+	if (mthd < 0x140)
+		return PSCNV_PB_TRIGGER;
+	switch (oclass) {
+	case 0x50c0:
+	case 0x85c0:
+	case 0x90c0:
+		if (mthd == 0x368)
+			return PSCNV_PB_LAUNCH;
+		break;
+	case 0x5097:
+	case 0x8297:
+	case 0x8397:
+	case 0x8597:
+	case 0x8697:
+		if (mthd == 0x15e0 || mthd == 0x1d88)
+			return PSCNV_PB_LAUNCH;
+		if (mthd == 0x15dc)
+			return PSCNV_PB_TRIGGER;
+		break;
+	case 0x9097:
+	case 0x9197:
+	case 0x9297:
+		if (mthd == 0x1614 || mthd == 0x19d0)
+			return PSCNV_PB_LAUNCH;
+		if (mthd == 0x1618)
+			return PSCNV_PB_TRIGGER;
+		break;
+	case 0x502d:
+	case 0x902d:
+		if (mthd == 0x8dc)
+			return PSCNV_PB_LAUNCH;
+		break;
+	case 0x5039:
+		if (mthd == 0x328)
+			return PSCNV_PB_LAUNCH;
+		break;
+	case 0x9039:
+	case 0x90b5:
+		if (mthd == 0x300)
+			return PSCNV_PB_LAUNCH;
+		break;
+	}
+	return 0;
+}
+
+static uint32_t pscnv_pb_hash(uint64_t key, uint32_t size) {
+	return (uint32_t)((key * 0x9e3779b97f4a7c15ull) >> 32) & (size - 1);
+}
+
+static int pscnv_pb_grow(struct pscnv_pb_stats *st) {
+	struct pscnv_pb_method *old = st->tab, *tab;
+	uint32_t size = st->tab_size ? st->tab_size * 2 : 1024, i, h;
+	tab = calloc(size, sizeof *tab);
+	if (!tab)
+		return 1;
+	for (i = 0; i < st->tab_size; i++) {
+		if (!old[i].key)
+			continue;
+		h = pscnv_pb_hash(old[i].key, size);
+		while (tab[h].key)
+			h = (h + 1) & (size - 1);
+		tab[h] = old[i];
+	}
+	free(old);
+	st->tab = tab;
+	st->tab_size = size;
+	return 0;
+}
+
+static struct pscnv_pb_method *pscnv_pb_lookup(struct pscnv_pb_stats *st, uint32_t obj, uint32_t oclass, uint32_t mthd) {
+	/* mthd is never 0 here, so neither is the key */
+	uint64_t key = (uint64_t)obj << 32 | mthd;
+	uint32_t h;
+	if (st->tab_used * 2 >= st->tab_size && pscnv_pb_grow(st))
+		return 0;
+	h = pscnv_pb_hash(key, st->tab_size);
+	while (st->tab[h].key && st->tab[h].key != key)
+		h = (h + 1) & (st->tab_size - 1);
+	if (!st->tab[h].key) {
+		st->tab[h].key = key;
+		st->tab[h].oclass = oclass;
+		st->tab[h].kind = pscnv_pb_method_kind(oclass, mthd);
+		st->tab_used++;
+	}
+	return &st->tab[h];
+}
+
+static void pscnv_pb_method(void *priv, int subc, uint32_t obj, uint32_t oclass, uint32_t mthd, uint32_t data, int flags) {
+	struct pscnv_pb_stats *st = priv;
+	struct pscnv_pb_method *m;
+	st->writes++;
+	/* binds and PFIFO methods don't go in the table */
+	if (mthd < 0x100)
+		return;
+	m = pscnv_pb_lookup(st, obj, oclass, mthd);
+	if (!m) {
+		st->failed = 1;
+		return;
+	}
+	m->writes++;
+	m->subc = subc;
+	if ((flags & (PSCNV_DECODE_NI | PSCNV_DECODE_FIRST)) == PSCNV_DECODE_NI)
+		m->kind |= PSCNV_PB_STREAM;
+	if (m->kind & PSCNV_PB_LAUNCH) {
+		st->launches++;
+		st->launch_state += st->cur_state;
+		st->launch_redundant += st->cur_redundant;
+		if (st->cur_state > st->launch_state_max)
+			st->launch_state_max = st->cur_state;
+		st->cur_state = st->cur_redundant = 0;
+		st->launch_words = st->dec.nwords;
+		return;
+	}
+	if (m->kind)
+		return;
+	st->cur_state++;
+	if (m->valid && m->value == data) {
+		m->redundant++;
+		st->redundant++;
+		st->cur_redundant++;
+	}
+	m->value = data;
+	m->valid = 1;
+}
+
+int pscnv_pb_stats_init(struct pscnv_pb_stats *st, uint32_t chipset) {
+	memset(st, 0, sizeof *st);
+	pscnv_decode_init(&st->dec, chipset);
+	st->dec.method = pscnv_pb_method;
+	st->dec.priv = st;
+	return pscnv_pb_grow(st);
+}
+
+void pscnv_pb_stats_fini(struct pscnv_pb_stats *st) {
+	free(st->tab);
+	st->tab = 0;
+	st->tab_size = st->tab_used = 0;
+}
+
+int pscnv_pb_stats_feed(struct pscnv_pb_stats *st, const uint32_t *w, uint32_t n) {
+	return pscnv_decode(&st->dec, w, n) || st->failed;
+}
+
+static int pscnv_pb_cmp(const void *a, const void *b) {
+	const struct pscnv_pb_method *x = a, *y = b;
+	if (x->redundant != y->redundant)
+		return x->redundant < y->redundant ? 1 : -1;
+	if (x->writes != y->writes)
+		return x->writes < y->writes ? 1 : -1;
+	return x->key < y->key ? -1 : x->key > y->key;
+}
+
+/* Summary, then the top methods by redundant writes. */
+void pscnv_pb_stats_print(struct pscnv_pb_stats *st, FILE *fp, int top) {
+	struct pscnv_pb_method *sorted;
+	uint32_t i, n = 0;
+	static const char *kinds[] = { "state", "trigger", "launch", "launch", "stream", "stream", "stream", "stream" };
+	fprintf(fp, "%llu dwords, %llu headers, %llu method writes, %llu redundant (%.1f%%)\n",
+		(unsigned long long)st->dec.nwords, (unsigned long long)st->dec.nheaders,
+		(unsigned long long)st->writes, (unsigned long long)st->redundant,
+		st->writes ? 100.0 * st->redundant / st->writes : 0.0);
+	if (st->dec.nbad)
+		fprintf(fp, "%llu streams cut short by bad headers\n", (unsigned long long)st->dec.nbad);
+	if (st->dec.njumps)
+		fprintf(fp, "%llu jumps, calls and returns not followed\n", (unsigned long long)st->dec.njumps);
+	if (st->launches)
+		fprintf(fp, "%llu launches: %.1f dwords each, %.1f state writes each (max %llu), %.1f of them redundant\n",
+			(unsigned long long)st->launches,
+			(double)st->launch_words / st->launches,
+			(double)st->launch_state / st->launches,
+			(unsigned long long)st->launch_state_max,
+			(double)st->launch_redundant / st->launches);
+	if (!top)
+		return;
+	sorted = malloc(st->tab_used * sizeof *sorted + 1);
+	if (!sorted)
+		return;
+	for (i = 0; i < st->tab_size; i++)
+		if (st->tab[i].key)
+			sorted[n++] = st->tab[i];
+	qsort(sorted, n, sizeof *sorted, pscnv_pb_cmp);
+	fprintf(fp, "%-10s %-6s %-4s %-6s %-8s %12s %12s\n", "object", "class", "subc", "method", "kind", "writes", "redundant");
+	for (i = 0; i < n && i < (uint32_t)top; i++)
+		fprintf(fp, "%08x   %04x   %u    %04x   %-8s %12llu %12llu\n",
+			(uint32_t)(sorted[i].key >> 32), sorted[i].oclass, sorted[i].subc, (uint32_t)sorted[i].key,
+			kinds[sorted[i].kind & 7], (unsigned long long)sorted[i].writes,
+			(unsigned long long)sorted[i].redundant);
+	free(sorted);
+}
@@ -0,0 +1,98 @@
+#ifndef LIBPSCNV_DECODE_H
+#define LIBPSCNV_DECODE_H
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Host-side method stream decoding. pscnv_decode walks pushbuffer words
+ * and calls method() for every method write, with the class bound on
+ * its subchannel. NV50 streams use the two header formats BEGIN_RING50
+ * and BEGIN_RING50_NI emit; NVC0 ones can also have immediate and
+ * increment-once headers.
+ *
+ * Binding writes method 0 of a subchannel: with the class number on
+ * NVC0, with an object handle on NV50, which lookup() turns into a class
+ * if set. Methods below 0x100 are PFIFO's and reported with class 0.
+ *
+ * The decoder doesn't see memory, so NV50 jumps, calls and returns are
+ * only counted: decoding stops at a jump or return, and carries on after
+ * a call as if it had returned. What they lead to can be fed separately.
+ */
+
+#define PSCNV_DECODE_FIRST	1	/* first write after its header */
+#define PSCNV_DECODE_NI		2	/* non-incrementing header */
+#define PSCNV_DECODE_IMM	4	/* immediate, no data word */
+
+struct pscnv_decode {
+	uint32_t chipset;
+	uint32_t subc_obj[8];	/* what was written to method 0 */
+	uint32_t subc_class[8];
+	uint32_t (*lookup)(void *lookup_priv, uint32_t handle);
+	void *lookup_priv;
+	void (*method)(void *priv, int subc, uint32_t obj, uint32_t oclass, uint32_t mthd, uint32_t data, int flags);
+	void *priv;
+	/* the header whose data is being decoded, may span calls */
+	uint32_t mthd;
+	uint32_t left;		/* data words still to come */
+	uint32_t done;
+	uint32_t type;
+	int subc;
+	uint64_t nheaders;
+	uint64_t nwords;
+	uint64_t nbad;		/* streams given up on at a bad header */
+	uint64_t njumps;	/* NV50 jumps, calls and returns */
+};
+
+void pscnv_decode_init(struct pscnv_decode *d, uint32_t chipset);
+int pscnv_decode(struct pscnv_decode *d, const uint32_t *w, uint32_t n);
+
+/*
+ * Redundancy and launch statistics on top of the decoder. Every method
+ * of every bound object is shadowed; a state write of the value it
+ * already holds counts as redundant. Launches, draws, copies and PFIFO
+ * methods aren't state and are never redundant, neither are data ports
+ * (methods written through a non-incrementing header more than once).
+ *
+ * Launch state is what gets written between two launches, counted in
+ * methods; dwords per launch include headers.
+ */
+
+#define PSCNV_PB_TRIGGER	1
+#define PSCNV_PB_LAUNCH		2
+#define PSCNV_PB_STREAM		4
+
+struct pscnv_pb_method {
+	uint64_t key;		/* obj << 32 | mthd, 0 if free */
+	uint32_t oclass;
+	uint32_t subc;		/* subchannel of the last write */
+	uint32_t value;
+	uint32_t valid;
+	uint32_t kind;
+	uint64_t writes;
+	uint64_t redundant;
+};
+
+struct pscnv_pb_stats {
+	struct pscnv_decode dec;
+	struct pscnv_pb_method *tab;
+	uint32_t tab_size;
+	uint32_t tab_used;
+	uint64_t writes;
+	uint64_t redundant;
+	uint64_t launches;
+	uint64_t launch_state;		/* state writes before each launch, summed */
+	uint64_t launch_redundant;
+	uint64_t launch_state_max;
+	uint64_t cur_state;
+	uint64_t cur_redundant;
+	uint64_t launch_words;		/* dwords up to the last launch */
+	int failed;
+};
+
+int pscnv_pb_method_kind(uint32_t oclass, uint32_t mthd);
+int pscnv_pb_stats_init(struct pscnv_pb_stats *st, uint32_t chipset);
+void pscnv_pb_stats_fini(struct pscnv_pb_stats *st);
+int pscnv_pb_stats_feed(struct pscnv_pb_stats *st, const uint32_t *w, uint32_t n);
+void pscnv_pb_stats_print(struct pscnv_pb_stats *st, FILE *fp, int top);
+
+#endif
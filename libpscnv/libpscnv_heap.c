@@ -0,0 +1,296 @@
+#include "libpscnv_heap.h"
+#include "libpscnv.h"
+#include <stdlib.h>
+
+struct pscnv_heap_tcache {
+	struct pscnv_heap *heap;
+	struct {
+		uint32_t n;
+		struct pscnv_heap_block blk[PSCNV_HEAP_TCACHE];
+	} cls[PSCNV_HEAP_CLASSES];
+};
+
+static int pscnv_heap_class(uint32_t size) {
+	int cls = 0;
+	if (!size || size > 1u << PSCNV_HEAP_MAX_SHIFT)
+		return -1;
+	while (size > 1u << (PSCNV_HEAP_MIN_SHIFT + cls))
+		cls++;
+	return cls;
+}
+
+static void pscnv_heap_list_del(struct pscnv_heap_slab **head, struct pscnv_heap_slab *slab) {
+	if (slab->prev)
+		slab->prev->next = slab->next;
+	else
+		*head = slab->next;
+	if (slab->next)
+		slab->next->prev = slab->prev;
+	slab->next = slab->prev = 0;
+}
+
+static void pscnv_heap_list_add(struct pscnv_heap_slab **head, struct pscnv_heap_slab *slab) {
+	slab->prev = 0;
+	slab->next = *head;
+	if (*head)
+		(*head)->prev = slab;
+	*head = slab;
+}
+
+static struct pscnv_heap_slab *pscnv_heap_lookup(struct pscnv_heap *heap, uint64_t gpu) {
+	uint32_t lo = 0, hi = heap->nslabs;
+	while (lo < hi) {
+		uint32_t mid = (lo + hi) / 2;
+		struct pscnv_heap_slab *slab = heap->slabs[mid];
+		if (gpu < slab->bo->vm_base)
+			hi = mid;
+		else if (gpu >= slab->bo->vm_base + slab->bo->size)
+			lo = mid + 1;
+		else
+			return slab;
+	}
+	return 0;
+}
+
+/* Sets a slab up for a size class. It has to be empty. */
+static void pscnv_heap_slab_format(struct pscnv_heap_slab *slab, int cls) {
+	uint32_t i;
+	slab->cls = cls;
+	slab->nblocks = 1 << (PSCNV_HEAP_SLAB_SHIFT - PSCNV_HEAP_MIN_SHIFT - cls);
+	slab->nfree = slab->nblocks;
+	slab->hint = 0;
+	for (i = 0; i < (slab->nblocks + 31) / 32; i++)
+		slab->bitmap[i] = slab->nblocks - i * 32 >= 32 ? 0xffffffff : (1u << (slab->nblocks - i * 32)) - 1;
+}
+
+/* Takes an idle slab, or gets a new one from the kernel. heap->lock held. */
+static struct pscnv_heap_slab *pscnv_heap_slab_get(struct pscnv_heap *heap, int cls) {
+	struct pscnv_heap_slab *slab = heap->empty;
+	uint32_t i;
+	if (slab) {
+		pscnv_heap_list_del(&heap->empty, slab);
+		heap->nempty--;
+	} else {
+		if (heap->nslabs == heap->maxslabs) {
+			uint32_t max = heap->maxslabs ? heap->maxslabs * 2 : 16;
+			struct pscnv_heap_slab **ns = realloc(heap->slabs, max * sizeof *ns);
+			if (!ns)
+				return 0;
+			heap->slabs = ns;
+			heap->maxslabs = max;
+		}
+		slab = calloc(1, sizeof *slab);
+		if (!slab)
+			return 0;
+		if (pscnv_ib_bo_alloc(heap->fd, heap->vid, 0xf1f04ea9, heap->flags, 0, 1 << PSCNV_HEAP_SLAB_SHIFT, 0, &slab->bo)) {
+			free(slab);
+			return 0;
+		}
+		for (i = heap->nslabs; i && heap->slabs[i-1]->bo->vm_base > slab->bo->vm_base; i--)
+			heap->slabs[i] = heap->slabs[i-1];
+		heap->slabs[i] = slab;
+		heap->nslabs++;
+		heap->slab_allocs++;
+	}
+	pscnv_heap_slab_format(slab, cls);
+	pscnv_heap_list_add(&heap->partial[cls], slab);
+	return slab;
+}
+
+static void pscnv_heap_slab_release(struct pscnv_heap *heap, struct pscnv_heap_slab *slab) {
+	uint32_t i;
+	for (i = 0; heap->slabs[i] != slab; i++);
+	for (; i + 1 < heap->nslabs; i++)
+		heap->slabs[i] = heap->slabs[i+1];
+	heap->nslabs--;
+	pscnv_ib_bo_free(slab->bo);
+	free(slab);
+	heap->slab_frees++;
+}
+
+/* Moves up to n free blocks of a class into blk. heap->lock held. */
+static uint32_t pscnv_heap_take(struct pscnv_heap *heap, int cls, struct pscnv_heap_block *blk, uint32_t n) {
+	uint32_t got = 0, bsize = 1 << (PSCNV_HEAP_MIN_SHIFT + cls);
+	while (got < n) {
+		struct pscnv_heap_slab *slab = heap->partial[cls];
+		uint32_t w, bit, idx;
+		if (!slab && !(slab = pscnv_heap_slab_get(heap, cls)))
+			break;
+		for (w = slab->hint; !slab->bitmap[w]; w++);
+		while (got < n && slab->bitmap[w]) {
+			bit = __builtin_ctz(slab->bitmap[w]);
+			slab->bitmap[w] &= ~(1u << bit);
+			idx = w * 32 + bit;
+			blk[got].gpu = slab->bo->vm_base + (uint64_t)idx * bsize;
+			blk[got].map = slab->bo->map ? (char *)slab->bo->map + idx * bsize : 0;
+			blk[got].size = bsize;
+			got++;
+			slab->nfree--;
+		}
+		slab->hint = w;
+		if (!slab->nfree)
+			pscnv_heap_list_del(&heap->partial[cls], slab);
+	}
+	return got;
+}
+
+/* Returns n blocks of a class. heap->lock held. */
+static void pscnv_heap_put(struct pscnv_heap *heap, int cls, const struct pscnv_heap_block *blk, uint32_t n) {
+	uint32_t i, idx;
+	for (i = 0; i < n; i++) {
+		struct pscnv_heap_slab *slab = pscnv_heap_lookup(heap, blk[i].gpu);
+		if (!slab || slab->cls != cls)
+			continue;
+		idx = (blk[i].gpu - slab->bo->vm_base) >> (PSCNV_HEAP_MIN_SHIFT + cls);
+		if (slab->bitmap[idx / 32] & 1u << idx % 32)
+			continue;
+		slab->bitmap[idx / 32] |= 1u << idx % 32;
+		if (idx / 32 < slab->hint)
+			slab->hint = idx / 32;
+		if (!slab->nfree++)
+			pscnv_heap_list_add(&heap->partial[cls], slab);
+		if (slab->nfree == slab->nblocks) {
+			pscnv_heap_list_del(&heap->partial[cls], slab);
+			if (heap->nempty < heap->max_idle) {
+				pscnv_heap_list_add(&heap->empty, slab);
+				heap->nempty++;
+			} else {
+				pscnv_heap_slab_release(heap, slab);
+			}
+		}
+	}
+}
+
+static void pscnv_heap_tcache_drain(struct pscnv_heap_tcache *tc) {
+	int c;
+	pthread_mutex_lock(&tc->heap->lock);
+	for (c = 0; c < PSCNV_HEAP_CLASSES; c++) {
+		pscnv_heap_put(tc->heap, c, tc->cls[c].blk, tc->cls[c].n);
+		tc->cls[c].n = 0;
+	}
+	pthread_mutex_unlock(&tc->heap->lock);
+}
+
+/* thread exit */
+static void pscnv_heap_tcache_destroy(void *arg) {
+	struct pscnv_heap_tcache *tc = arg;
+	pscnv_heap_tcache_drain(tc);
+	free(tc);
+}
+
+static struct pscnv_heap_tcache *pscnv_heap_tcache(struct pscnv_heap *heap) {
+	struct pscnv_heap_tcache *tc = pthread_getspecific(heap->key);
+	if (tc)
+		return tc;
+	tc = calloc(1, sizeof *tc);
+	if (!tc)
+		return 0;
+	tc->heap = heap;
+	if (pthread_setspecific(heap->key, tc)) {
+		free(tc);
+		return 0;
+	}
+	return tc;
+}
+
+int pscnv_heap_new(int fd, int vid, uint32_t flags, struct pscnv_heap **res) {
+	struct pscnv_heap *heap = calloc(1, sizeof *heap);
+	if (!heap)
+		return 1;
+	if (pthread_key_create(&heap->key, pscnv_heap_tcache_destroy)) {
+		free(heap);
+		return 1;
+	}
+	pthread_mutex_init(&heap->lock, 0);
+	heap->fd = fd;
+	heap->vid = vid;
+	heap->flags = flags;
+	heap->max_idle = 1;
+	*res = heap;
+	return 0;
+}
+
+/* Other threads that used the heap must have exited or called
+ * pscnv_heap_flush by now. */
+void pscnv_heap_destroy(struct pscnv_heap *heap) {
+	struct pscnv_heap_tcache *tc = pthread_getspecific(heap->key);
+	uint32_t i;
+	free(tc);
+	pthread_key_delete(heap->key);
+	for (i = 0; i < heap->nslabs; i++) {
+		pscnv_ib_bo_free(heap->slabs[i]->bo);
+		free(heap->slabs[i]);
+	}
+	free(heap->slabs);
+	pthread_mutex_destroy(&heap->lock);
+	free(heap);
+}
+
+int pscnv_heap_alloc(struct pscnv_heap *heap, uint32_t size, struct pscnv_heap_block *res) {
+	int cls = pscnv_heap_class(size);
+	struct pscnv_heap_tcache *tc;
+	uint32_t n;
+	if (cls < 0)
+		return 1;
+	tc = pscnv_heap_tcache(heap);
+	if (!tc) {
+		pthread_mutex_lock(&heap->lock);
+		n = pscnv_heap_take(heap, cls, res, 1);
+		pthread_mutex_unlock(&heap->lock);
+		return !n;
+	}
+	if (!tc->cls[cls].n) {
+		pthread_mutex_lock(&heap->lock);
+		tc->cls[cls].n = pscnv_heap_take(heap, cls, tc->cls[cls].blk, PSCNV_HEAP_TCACHE / 2);
+		pthread_mutex_unlock(&heap->lock);
+		if (!tc->cls[cls].n)
+			return 1;
+	}
+	*res = tc->cls[cls].blk[--tc->cls[cls].n];
+	return 0;
+}
+
+void pscnv_heap_free(struct pscnv_heap *heap, const struct pscnv_heap_block *blk) {
+	int cls = pscnv_heap_class(blk->size);
+	struct pscnv_heap_tcache *tc;
+	uint32_t half = PSCNV_HEAP_TCACHE / 2;
+	if (cls < 0)
+		return;
+	tc = pscnv_heap_tcache(heap);
+	if (!tc) {
+		pthread_mutex_lock(&heap->lock);
+		pscnv_heap_put(heap, cls, blk, 1);
+		pthread_mutex_unlock(&heap->lock);
+		return;
+	}
+	if (tc->cls[cls].n == PSCNV_HEAP_TCACHE) {
+		/* give back the older half */
+		pthread_mutex_lock(&heap->lock);
+		pscnv_heap_put(heap, cls, tc->cls[cls].blk, half);
+		pthread_mutex_unlock(&heap->lock);
+		memmove(tc->cls[cls].blk, tc->cls[cls].blk + half, (PSCNV_HEAP_TCACHE - half) * sizeof *blk);
+		tc->cls[cls].n -= half;
+	}
+	tc->cls[cls].blk[tc->cls[cls].n++] = *blk;
+}
+
+/* Returns the calling thread's cached blocks to the heap. */
+void pscnv_heap_flush(struct pscnv_heap *heap) {
+	struct pscnv_heap_tcache *tc = pthread_getspecific(heap->key);
+	if (tc)
+		pscnv_heap_tcache_drain(tc);
+}
+
+/* Returns all idle slabs to the kernel, after flushing the calling
+ * thread's cache. */
+void pscnv_heap_trim(struct pscnv_heap *heap) {
+	pscnv_heap_flush(heap);
+	pthread_mutex_lock(&heap->lock);
+	while (heap->empty) {
+		struct pscnv_heap_slab *slab = heap->empty;
+		pscnv_heap_list_del(&heap->empty, slab);
+		pscnv_heap_slab_release(heap, slab);
+	}
+	heap->nempty = 0;
+	pthread_mutex_unlock(&heap->lock);
+}
@@ -0,0 +1,76 @@
+#ifndef LIBPSCNV_HEAP_H
+#define LIBPSCNV_HEAP_H
+#include <stdint.h>
+#include <pthread.h>
+#include "libpscnv_ib.h"
+
+/*
+ * Small buffer heap. Allocations of up to 64 KiB are carved out of 1 MiB
+ * slabs, each a single BO mapped into the vspace and (if MAPPABLE) into
+ * the process for as long as it lives, so an allocation costs no ioctls
+ * once its slab exists. Sizes are rounded up to a power of two, at least
+ * 64 bytes, and every slab serves a single size class. Blocks are
+ * aligned to their size, or to 4 KiB if that's less.
+ *
+ * Each thread keeps a small cache of free blocks per size class and only
+ * takes the heap lock to refill or drain it in batches. Slabs that have
+ * no blocks in use anymore are kept for reuse by any size class, up to
+ * max_idle of them; the rest go back to the kernel. pscnv_heap_trim
+ * returns all of them.
+ *
+ * Freeing a block doesn't wait for the GPU, same as pscnv_ib_bo_free.
+ */
+
+#define PSCNV_HEAP_MIN_SHIFT	6
+#define PSCNV_HEAP_MAX_SHIFT	16
+#define PSCNV_HEAP_CLASSES	(PSCNV_HEAP_MAX_SHIFT - PSCNV_HEAP_MIN_SHIFT + 1)
+#define PSCNV_HEAP_SLAB_SHIFT	20
+#define PSCNV_HEAP_TCACHE	32
+
+struct pscnv_heap_block {
+	uint64_t gpu;
+	void *map;
+	uint32_t size;
+};
+
+struct pscnv_heap_slab {
+	struct pscnv_ib_bo *bo;
+	/* on its class's partial list, or the empty list */
+	struct pscnv_heap_slab *next;
+	struct pscnv_heap_slab *prev;
+	int cls;
+	uint32_t nblocks;
+	uint32_t nfree;
+	uint32_t hint;
+	/* set bits are free blocks */
+	uint32_t bitmap[1 << (PSCNV_HEAP_SLAB_SHIFT - PSCNV_HEAP_MIN_SHIFT - 5)];
+};
+
+struct pscnv_heap {
+	int fd;
+	int vid;
+	uint32_t flags;
+	uint32_t max_idle;
+	pthread_mutex_t lock;
+	pthread_key_t key;
+	/* slabs with free blocks, per class */
+	struct pscnv_heap_slab *partial[PSCNV_HEAP_CLASSES];
+	struct pscnv_heap_slab *empty;
+	uint32_t nempty;
+	/* all slabs, sorted by GPU address */
+	struct pscnv_heap_slab **slabs;
+	uint32_t nslabs;
+	uint32_t maxslabs;
+	/* statistics */
+	uint64_t slab_allocs;
+	uint64_t slab_frees;
+};
+
+int pscnv_heap_new(int fd, int vid, uint32_t flags, struct pscnv_heap **res);
+void pscnv_heap_destroy(struct pscnv_heap *heap);
+int pscnv_heap_alloc(struct pscnv_heap *heap, uint32_t size, struct pscnv_heap_block *res);
+void pscnv_heap_free(struct pscnv_heap *heap, const struct pscnv_heap_block *blk);
+void pscnv_heap_flush(struct pscnv_heap *heap);
+void pscnv_heap_trim(struct pscnv_heap *heap);
+
+#endif
@@ -1,14 +1,71 @@
 #include "libpscnv_ib.h"
 #include "libpscnv.h"
+#include "libpscnv_trace.h"
+#include <errno.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <sched.h>
 #include <sys/mman.h>
+#include <time.h>
+
+#define PSCNV_IB_TRACK_SIZE	0x1000
+
+static uint64_t pscnv_ib_time_us(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Same problem as GET tracking below: without semaphore releases by
+ * address, NV50 channels get no fences, and fence_addr stays 0. */
+static int pscnv_ib_fence_init(struct pscnv_ib_chan *ch) {
+	uint64_t chipset;
+	ch->fence_addr = 0;
+	ch->fence_seq = 0;
+	if (pscnv_getparam(ch->fd, PSCNV_GETPARAM_CHIPSET_ID, &chipset) || chipset == 0x50)
+		return 0;
+	return pscnv_fence_info(ch->fd, ch->cid, &ch->fence_addr, &ch->fence_seq);
+}
+
+/* NV50 can only release semaphores through a DMA object, so it keeps
+ * reading GET from MMIO. Tracking is an optimisation, so failures here
+ * just leave it off. */
+static void pscnv_ib_track_init(struct pscnv_ib_chan *ch) {
+	uint64_t chipset;
+	ch->track = 0;
+	ch->track_map = 0;
+	ch->track_ring = 0;
+	ch->track_seq = ch->track_seen = ch->track_idle = 0;
+	if (pscnv_getparam(ch->fd, PSCNV_GETPARAM_CHIPSET_ID, &chipset) || chipset == 0x50)
+		return;
+	ch->track_ring = calloc(ch->ib_mask + 1, sizeof *ch->track_ring);
+	if (!ch->track_ring)
+		return;
+	if (pscnv_ib_bo_alloc(ch->fd, ch->vid, 0xf1f07ac, PSCNV_GEM_SYSRAM_SNOOP | PSCNV_GEM_MAPPABLE, 0, PSCNV_IB_TRACK_SIZE, 0, &ch->track)) {
+		free(ch->track_ring);
+		ch->track_ring = 0;
+		return;
+	}
+	ch->track_map = ch->track->map;
+	ch->track_map[0] = 0;
+	ch->track_addr = ch->track->vm_base;
+}
+
+static void pscnv_ib_track_fini(struct pscnv_ib_chan *ch) {
+	if (ch->track)
+		pscnv_ib_bo_free(ch->track);
+	free(ch->track_ring);
+	ch->track = 0;
+	ch->track_map = 0;
+	ch->track_ring = 0;
+}
 
 int pscnv_ib_chan_new(int fd, int vid, struct pscnv_ib_chan **res, uint32_t pb_dma, uint32_t pb_order, uint32_t ib_order) {
 	int ret;
 	struct pscnv_ib_chan *rr;
 	uint64_t map_handle;
-	*res = malloc(sizeof **res);
+	pscnv_trace_env();
+	*res = calloc(1, sizeof **res);
 	if (!*res)
 		return 1;
 	rr = *res;
@@ -38,6 +95,10 @@ int pscnv_ib_chan_new(int fd, int vid, struct pscnv_ib_chan **res, uint32_t pb_d
 	rr->ib_map = rr->ib->map;
 	rr->ib_mask = (1 << rr->ib_order) - 1;
 	rr->ib_put = rr->ib_get = 0;
+	rr->ib_kicked = 0;
+	rr->batch_bytes = 0;
+	rr->nkicks = rr->nentries = 0;
+	pscnv_ib_set_batch(rr, 32, 256 << 10, 50);
 	rr->pb_order = pb_order;
 	if (!pb_order)
 		rr->pb_order = 20;
@@ -51,12 +112,35 @@ int pscnv_ib_chan_new(int fd, int vid, struct pscnv_ib_chan **res, uint32_t pb_d
 	rr->pb_pos = 0;
 	rr->pb_put = 0;
 	rr->pb_get = 0;
+	rr->pb_end = 0;
+	rr->nstalls = rr->stall_us = rr->nmmio_gets = 0;
+	pscnv_ib_track_init(rr);
 	ret = pscnv_fifo_init_ib(fd, rr->cid, rr->pb_dma, 0, 1, rr->ib->vm_base, rr->ib_order);
 	if (ret)
 		goto out_fifo;
+	ret = pscnv_ib_fence_init(rr);
+	if (ret)
+		goto out_fifo;
+	if (pscnv_trace_fp) {
+		struct pscnv_trace_chan tc;
+		uint64_t chipset = 0;
+		memset(&tc, 0, sizeof tc);
+		pscnv_getparam(fd, PSCNV_GETPARAM_CHIPSET_ID, &chipset);
+		tc.chipset = chipset;
+		tc.cid = rr->cid;
+		tc.vid = rr->vid;
+		tc.pb_dma = rr->pb_dma;
+		tc.pb_order = rr->pb_order;
+		tc.ib_order = rr->ib_order;
+		tc.pb_base = rr->pb_base;
+		tc.ib_base = rr->ib->vm_base;
+		tc.track_base = rr->track_map ? rr->track_addr : 0;
+		pscnv_trace_record(PSCNV_TRACE_CHAN, &tc, sizeof tc, 0, 0);
+	}
 	return 0;
 
 out_fifo:
+	pscnv_ib_track_fini(rr);
 	pscnv_ib_bo_free(rr->pb);
 out_pb:
 	pscnv_ib_bo_free(rr->ib);
@@ -73,6 +157,17 @@ out_vs:
 	return 1;
 }
 
+/* The vspace is left alone, even if chan_new made it. */
+void pscnv_ib_chan_free(struct pscnv_ib_chan *ch) {
+	free(ch->mp_ready);
+	pscnv_ib_track_fini(ch);
+	pscnv_ib_bo_free(ch->pb);
+	pscnv_ib_bo_free(ch->ib);
+	munmap((void*)ch->chmap, 0x2000);
+	pscnv_chan_free(ch->fd, ch->cid);
+	free(ch);
+}
+
 int pscnv_ib_bo_alloc(int fd, int vid, uint32_t cookie, uint32_t flags, uint32_t tile_flags, uint64_t size, uint32_t *user, struct pscnv_ib_bo **res) {
 	int ret;
 	struct pscnv_ib_bo *rr;
@@ -84,6 +179,8 @@ int pscnv_ib_bo_alloc(int fd, int vid, uint32_t cookie, uint32_t flags, uint32_t
 	rr->fd = fd;
 	rr->vid = vid;
 	rr->size = size;
+	rr->flags = flags;
+	rr->tile_flags = tile_flags;
 	ret = pscnv_gem_new(fd, cookie, flags, tile_flags, size, user, &rr->handle, &map_handle);
 	if (ret)
 		goto out_new;
@@ -98,6 +195,19 @@ int pscnv_ib_bo_alloc(int fd, int vid, uint32_t cookie, uint32_t flags, uint32_t
 			goto out_map;
 	} else
 		rr->map = 0;
+	pscnv_trace_env();
+	if (pscnv_trace_fp) {
+		struct pscnv_trace_bo tb;
+		memset(&tb, 0, sizeof tb);
+		tb.vid = vid;
+		tb.handle = rr->handle;
+		tb.cookie = cookie;
+		tb.flags = flags;
+		tb.tile_flags = tile_flags;
+		tb.size = size;
+		tb.vm_base = vid ? rr->vm_base : 0;
+		pscnv_trace_record(PSCNV_TRACE_BO_NEW, &tb, sizeof tb, 0, 0);
+	}
 	return 0;
 
 out_map:
@@ -111,6 +221,15 @@ out_new:
 }
 
 int pscnv_ib_bo_free(struct pscnv_ib_bo *bo) {
+	if (pscnv_trace_fp) {
+		struct pscnv_trace_bo tb;
+		memset(&tb, 0, sizeof tb);
+		tb.vid = bo->vid;
+		tb.handle = bo->handle;
+		tb.size = bo->size;
+		tb.vm_base = bo->vid ? bo->vm_base : 0;
+		pscnv_trace_record(PSCNV_TRACE_BO_FREE, &tb, sizeof tb, 0, 0);
+	}
 	if (bo->map)
 		munmap(bo->map, bo->size);
 	if (bo->vid)
@@ -120,28 +239,359 @@ int pscnv_ib_bo_free(struct pscnv_ib_bo *bo) {
 	return 0;
 }
 
+/* Appends the tracking release to the data about to be submitted, in
+ * the room RING_SPACE left for it. */
+void pscnv_ib_track_emit(struct pscnv_ib_chan *ch) {
+	uint32_t seq = ++ch->track_seq;
+	BEGIN_RING50u(ch, 0, 0x10, 4);
+	OUT_RINGu(ch, ch->track_addr >> 32);
+	OUT_RINGu(ch, ch->track_addr);
+	OUT_RINGu(ch, seq);
+	OUT_RINGu(ch, 2);	/* WRITE_LONG */
+	ch->track_ring[seq & ch->ib_mask].pb_get = ch->pb_pos;
+	ch->track_ring[seq & ch->ib_mask].ib_get = (ch->ib_put + 1) & ch->ib_mask;
+}
+
+/* Refreshes pb_get and ib_get. With tracking that's a cached read of the
+ * last released sequence; MMIO is only read when there's no tracking, or
+ * when the sequence hasn't moved for a while, in case the GPU is busy
+ * with entries that don't end in a release. */
 int pscnv_ib_update_get(struct pscnv_ib_chan *ch) {
-	uint32_t lo = ch->chmap[0x58/4];
-	uint32_t hi = ch->chmap[0x5c/4];
+	uint32_t lo, hi;
+	if (ch->track_map) {
+		uint32_t seq = ch->track_map[0];
+		if (seq != ch->track_seen && (int32_t)(seq - ch->track_seen) > 0) {
+			ch->pb_get = ch->track_ring[seq & ch->ib_mask].pb_get;
+			ch->ib_get = ch->track_ring[seq & ch->ib_mask].ib_get;
+			ch->track_seen = seq;
+			ch->track_idle = 0;
+			return 0;
+		}
+		/* a segment's pushbuffer GET can't be told from MMIO */
+		if (ch->mp || ++ch->track_idle < 256)
+			return 0;
+		ch->track_idle = 0;
+	}
+	ch->nmmio_gets++;
+	lo = ch->chmap[0x58/4];
+	hi = ch->chmap[0x5c/4];
 	if (hi & 0x80000000) {
 		uint64_t mg = ((uint64_t)hi << 32 | lo) & 0xffffffffffull;
 		ch->pb_get = mg - ch->pb_base;
 	} else {
 		ch->pb_get = 0;
 	}
+	ch->ib_get = ch->chmap[0x88/4];
+	return 0;
+}
+
+/*
+ * Slow path of RING_SPACE. GET only ever moves towards pb_pos, so a stale
+ * value is always on the safe side. pb_pos is never allowed to catch up
+ * with GET from behind, since pb_pos == GET means an empty ring.
+ */
+void pscnv_ib_reserve(struct pscnv_ib_chan *ch, uint32_t n) {
+	uint32_t bytes = (n + PSCNV_IB_TRACK_DWORDS) * 4;
+	uint32_t old;
+	uint64_t start = 0;
+	if (bytes > ch->pb_size / 2) {
+		fprintf(stderr, "pscnv_ib_reserve: %u dwords don't fit in half of a %u byte pushbuffer\n", n, ch->pb_size);
+		abort();
+	}
+	if (ch->pb_pos + bytes > ch->pb_size) {
+		/* restart at the beginning once GET has come around to
+		 * this lap and left the start of the ring, or the ring is
+		 * empty. Before that, GET > pb_pos means it's still
+		 * reading the previous lap, beginning included. */
+		FIRE_RING(ch);
+		pscnv_ib_update_get(ch);
+		while (ch->pb_get > ch->pb_pos ||
+		       (ch->pb_get != ch->pb_pos && ch->pb_get <= bytes)) {
+			if (!start)
+				start = pscnv_ib_time_us();
+			old = ch->pb_get;
+			pscnv_ib_update_get(ch);
+			if (old == ch->pb_get)
+				sched_yield();
+		}
+		ch->pb_pos = ch->pb_put = 0;
+	}
+	while (ch->pb_pos < ch->pb_get && ch->pb_pos + bytes >= ch->pb_get) {
+		if (!start)
+			start = pscnv_ib_time_us();
+		old = ch->pb_get;
+		FIRE_RING(ch);
+		pscnv_ib_update_get(ch);
+		if (old == ch->pb_get)
+			sched_yield();
+	}
+	if (start) {
+		ch->nstalls++;
+		ch->stall_us += pscnv_ib_time_us() - start;
+	}
+	if (ch->pb_pos < ch->pb_get)
+		ch->pb_end = ch->pb_get - 4;
+	else
+		ch->pb_end = ch->pb_size;
+}
+
+void pscnv_ib_set_batch(struct pscnv_ib_chan *ch, uint32_t max_entries, uint32_t max_bytes, uint32_t max_us) {
+	/* the ring can't hold more than this anyway */
+	if (!max_entries || max_entries > ch->ib_mask)
+		max_entries = ch->ib_mask;
+	ch->batch_max_entries = max_entries;
+	ch->batch_max_bytes = max_bytes;
+	ch->batch_max_us = max_us;
+}
+
+/* Writes IB PUT, if anything was queued since the last time. That's an
+ * uncached MMIO write which makes PFIFO go fetch, so it's only done here. */
+void pscnv_ib_kick(struct pscnv_ib_chan *ch) {
+	if (ch->ib_kicked == ch->ib_put)
+		return;
+	ch->chmap[0x8c/4] = ch->ib_put;
+	ch->ib_kicked = ch->ib_put;
+	ch->batch_bytes = 0;
+	ch->nkicks++;
 }
 
+/* Raises mp_get to what IB GET says now. GET is read before the commit
+ * count, so it can't be ahead of it, and at most ib_mask entries are ever
+ * outstanding, so the masked distance between them is unambiguous. */
+static void pscnv_ib_mp_update_get(struct pscnv_ib_chan *ch) {
+	uint32_t hw = ch->chmap[0x88/4];
+	uint64_t commit = __atomic_load_n(&ch->mp_commit, __ATOMIC_ACQUIRE);
+	uint64_t get = commit - ((uint32_t)(commit - hw) & ch->ib_mask);
+	uint64_t old = __atomic_load_n(&ch->mp_get, __ATOMIC_RELAXED);
+	while (get > old && !__atomic_compare_exchange_n(&ch->mp_get, &old, get, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/*
+ * Moves mp_commit and IB PUT over every slot that's been filled in since,
+ * up to the first one that hasn't. Only one thread does that at a time,
+ * the kicker; whoever finds the job taken just leaves, and the kicker
+ * looks again after letting go, so no filled slot is left behind. That
+ * keeps doorbell writes in order without anybody waiting for anybody.
+ */
+static void pscnv_ib_mp_kick(struct pscnv_ib_chan *seg) {
+	struct pscnv_ib_chan *ch = seg->mp;
+	uint64_t commit, put;
+	do {
+		if (__atomic_exchange_n(&ch->mp_kicking, 1, __ATOMIC_SEQ_CST))
+			return;
+		commit = put = __atomic_load_n(&ch->mp_commit, __ATOMIC_RELAXED);
+		while (__atomic_load_n(&ch->mp_ready[put & ch->ib_mask], __ATOMIC_ACQUIRE) == put + 1)
+			put++;
+		if (put != commit) {
+			ch->chmap[0x8c/4] = put & ch->ib_mask;
+			__atomic_store_n(&ch->mp_commit, put, __ATOMIC_RELEASE);
+			seg->nkicks++;
+		}
+		__atomic_store_n(&ch->mp_kicking, 0, __ATOMIC_SEQ_CST);
+	} while (__atomic_load_n(&ch->mp_ready[put & ch->ib_mask], __ATOMIC_SEQ_CST) == put + 1);
+}
+
+/*
+ * Submission from a segment. A slot is claimed with a CAS on mp_reserve,
+ * once the ring has room for it, filled in and marked ready, in any order
+ * with the other producers. pscnv_ib_mp_kick then publishes it along with
+ * the ones before it, and IB PUT never passes a slot that isn't ready.
+ */
+static int pscnv_ib_mp_push(struct pscnv_ib_chan *seg, uint64_t w) {
+	struct pscnv_ib_chan *ch = seg->mp;
+	uint64_t slot = __atomic_load_n(&ch->mp_reserve, __ATOMIC_RELAXED);
+	uint64_t start = 0;
+	for (;;) {
+		if (slot - __atomic_load_n(&ch->mp_get, __ATOMIC_ACQUIRE) >= ch->ib_mask) {
+			if (!start)
+				start = pscnv_ib_time_us();
+			pscnv_ib_mp_update_get(ch);
+			sched_yield();
+			slot = __atomic_load_n(&ch->mp_reserve, __ATOMIC_RELAXED);
+			continue;
+		}
+		if (__atomic_compare_exchange_n(&ch->mp_reserve, &slot, slot + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+			break;
+	}
+	if (start) {
+		seg->nstalls++;
+		seg->stall_us += pscnv_ib_time_us() - start;
+	}
+	ch->ib_map[(slot & ch->ib_mask) * 2] = w;
+	ch->ib_map[(slot & ch->ib_mask) * 2 + 1] = w >> 32;
+	/* slot + 1, so that what's left from the last lap doesn't count */
+	__atomic_store_n(&ch->mp_ready[slot & ch->ib_mask], slot + 1, __ATOMIC_SEQ_CST);
+	pscnv_ib_mp_kick(seg);
+	seg->nentries++;
+	return 0;
+}
+
+static void pscnv_ib_trace_push(struct pscnv_ib_chan *ch, uint64_t base, uint32_t len, int flags) {
+	struct pscnv_trace_ib ti;
+	const void *data = 0;
+	ti.cid = ch->cid;
+	ti.flags = flags;
+	ti.base = base;
+	ti.len = len;
+	if (base >= ch->pb_base && base + len <= ch->pb_base + ch->pb_size)
+		data = (const char *)ch->pb_map + (base - ch->pb_base);
+	ti.nodata = !data;
+	pscnv_trace_record(PSCNV_TRACE_IB, &ti, sizeof ti, data, data ? len : 0);
+}
+
+/* Queues an IB entry. The doorbell is rung once a batch limit is hit,
+ * otherwise it's up to the next FIRE_RING or pscnv_ib_kick. The time
+ * limit is only checked here, there's no timer behind it. */
 int pscnv_ib_push(struct pscnv_ib_chan *ch, uint64_t base, uint32_t len, int flags) {
 	uint64_t w = base | (uint64_t)len << 40 | (uint64_t)flags << 40;
+	uint32_t queued;
+	uint64_t start = 0;
+	if (pscnv_trace_fp)
+		pscnv_ib_trace_push(ch, base, len, flags);
+	if (ch->mp)
+		return pscnv_ib_mp_push(ch, w);
 	while (((ch->ib_put + 1) & ch->ib_mask) == ch->ib_get) {
 		uint32_t old = ch->ib_get;
-		ch->ib_get = ch->chmap[0x88/4];
+		if (!start)
+			start = pscnv_ib_time_us();
+		/* GPU can't catch up with entries it hasn't been told about */
+		pscnv_ib_kick(ch);
+		pscnv_ib_update_get(ch);
 		if (old == ch->ib_get)
 			sched_yield();
 	}
+	if (start) {
+		ch->nstalls++;
+		ch->stall_us += pscnv_ib_time_us() - start;
+	}
 	ch->ib_map[ch->ib_put * 2] = w;
 	ch->ib_map[ch->ib_put * 2 + 1] = w >> 32;
+	if (ch->ib_put == ch->ib_kicked && ch->batch_max_us)
+		ch->batch_start = pscnv_ib_time_us();
 	ch->ib_put++;
 	ch->ib_put &= ch->ib_mask;
-	ch->chmap[0x8c/4] = ch->ib_put;
+	ch->batch_bytes += len;
+	ch->nentries++;
+	queued = (ch->ib_put - ch->ib_kicked) & ch->ib_mask;
+	if (queued >= ch->batch_max_entries ||
+	    (ch->batch_max_bytes && ch->batch_bytes >= ch->batch_max_bytes) ||
+	    (ch->batch_max_us && pscnv_ib_time_us() - ch->batch_start >= ch->batch_max_us))
+		pscnv_ib_kick(ch);
+	return 0;
+}
+
+/* Releases the next fence sequence once everything before it is done,
+ * then raises a nonstall interrupt to wake up waiters. Returns the
+ * sequence to wait for, or 0 without emitting anything on channels
+ * without fences (NV50). */
+uint32_t pscnv_ib_fence_emit(struct pscnv_ib_chan *ch) {
+	uint32_t seq;
+	if (!ch->fence_addr)
+		return 0;
+	seq = ++ch->fence_seq;
+	RING_SPACE(ch, 7);
+	BEGIN_RING50u(ch, 0, 0x10, 4);
+	OUT_RINGu(ch, ch->fence_addr >> 32);
+	OUT_RINGu(ch, ch->fence_addr);
+	OUT_RINGu(ch, seq);
+	OUT_RINGu(ch, 2);	/* WRITE_LONG */
+	BEGIN_RING50u(ch, 0, 0x20, 1);
+	OUT_RINGu(ch, 0);	/* nonstall interrupt */
+	FIRE_RING(ch);
+	return seq;
+}
+
+int pscnv_ib_fence_wait(struct pscnv_ib_chan *ch, uint32_t seq, uint64_t timeout_ns) {
+	if (!ch->fence_addr)
+		return -ENODEV;
+	return pscnv_fence_wait(ch->fd, ch->cid, seq, timeout_ns);
+}
+
+/*
+ * Switches a channel to multi-producer submission: instead of writing to
+ * the channel, each thread gets its own segment of the pushbuffer from
+ * pscnv_ib_seg_new and uses it with the usual RING_SPACE/BEGIN_RING50/
+ * FIRE_RING, without any locking. Every FIRE_RING or QUEUE_RING on a
+ * segment queues one IB entry right away, in order with that thread's
+ * earlier ones, and it reaches the GPU as soon as all entries queued
+ * before it by other threads are written too. Each segment tracks its own GET through a slot of the
+ * channel's track BO, so this needs GET tracking to be available.
+ *
+ * Waits for the channel to go idle first. After this, the channel itself
+ * must not be written to anymore.
+ */
+int pscnv_ib_mp_init(struct pscnv_ib_chan *ch) {
+	if (!ch->track_map)
+		return 1;
+	if (!ch->mp_ready) {
+		ch->mp_ready = calloc(ch->ib_mask + 1, sizeof *ch->mp_ready);
+		if (!ch->mp_ready)
+			return 1;
+	}
+	FIRE_RING(ch);
+	while (ch->chmap[0x88/4] != ch->ib_put || ch->track_map[0] != ch->track_seq)
+		sched_yield();
+	ch->mp_reserve = ch->mp_commit = ch->mp_get = ch->ib_put;
+	ch->mp_kicking = 0;
+	ch->mp_carved = 0;
+	/* track slot 0 stays the channel's */
+	ch->mp_nsegs = 1;
+	return 0;
+}
+
+/* Carves a segment of size bytes, a power of two of at least 4 KiB, out
+ * of the channel's pushbuffer. Can be called from any thread. Segment
+ * memory only goes back with the channel. */
+int pscnv_ib_seg_new(struct pscnv_ib_chan *ch, uint32_t size, struct pscnv_ib_chan **res) {
+	struct pscnv_ib_chan *seg;
+	uint32_t off, idx;
+	if (size < 0x1000 || (size & (size - 1)))
+		return 1;
+	seg = calloc(1, sizeof *seg);
+	if (!seg)
+		return 1;
+	seg->track_ring = calloc(ch->ib_mask + 1, sizeof *seg->track_ring);
+	if (!seg->track_ring)
+		goto fail;
+	/* pushbuffer space first: once the track slots are gone, a segment
+	 * that didn't get one has nothing to lose anymore */
+	off = __atomic_load_n(&ch->mp_carved, __ATOMIC_RELAXED);
+	do {
+		off = (off + size - 1) & ~(size - 1);
+		if (off + size > ch->pb_size)
+			goto fail;
+	} while (!__atomic_compare_exchange_n(&ch->mp_carved, &off, off + size, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+	idx = __atomic_load_n(&ch->mp_nsegs, __ATOMIC_RELAXED);
+	do {
+		if (idx >= PSCNV_IB_TRACK_SIZE / 16)
+			goto fail;
+	} while (!__atomic_compare_exchange_n(&ch->mp_nsegs, &idx, idx + 1, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+	seg->mp = ch;
+	seg->fd = ch->fd;
+	seg->vid = ch->vid;
+	seg->cid = ch->cid;
+	seg->chmap = ch->chmap;
+	seg->pb_dma = ch->pb_dma;
+	seg->ib_order = ch->ib_order;
+	seg->ib_mask = ch->ib_mask;
+	seg->pb_map = ch->pb_map + off / 4;
+	seg->pb_base = ch->pb_base + off;
+	seg->pb_size = size;
+	seg->pb_mask = size - 1;
+	seg->track_map = ch->track_map + idx * 4;
+	seg->track_map[0] = 0;
+	seg->track_addr = ch->track_addr + idx * 16;
+	*res = seg;
+	return 0;
+
+fail:
+	free(seg->track_ring);
+	free(seg);
+	return 1;
+}
+
+void pscnv_ib_seg_free(struct pscnv_ib_chan *seg) {
+	FIRE_RING(seg);
+	free(seg->track_ring);
+	free(seg);
 }
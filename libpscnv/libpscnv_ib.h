@@ -2,6 +2,7 @@
 #define LIBPSCNV_IB_H
 #include <stdint.h>
 #include <sched.h>
+#include <string.h>
 
 struct pscnv_ib_bo {
 	int fd;
@@ -10,6 +11,12 @@ struct pscnv_ib_bo {
 	void *map;
 	uint32_t size;
 	uint64_t vm_base;
+	uint32_t flags;
+	uint32_t tile_flags;
+	/* while sitting in a pscnv_bo_cache */
+	struct pscnv_ib_bo *cache_next;
+	struct pscnv_ib_bo *cache_prev;
+	uint64_t cache_time;
 };
 
 struct pscnv_ib_chan {
@@ -26,6 +33,21 @@ struct pscnv_ib_chan {
 	uint32_t ib_mask;
 	uint32_t ib_put;
 	uint32_t ib_get;
+	/* last PUT written to the doorbell, and queued entries after it */
+	uint32_t ib_kicked;
+	uint32_t batch_bytes;
+	uint64_t batch_start;
+	/* kick once this many entries, bytes or microseconds are queued,
+	 * 0 disables the limit. See pscnv_ib_set_batch. */
+	uint32_t batch_max_entries;
+	uint32_t batch_max_bytes;
+	uint32_t batch_max_us;
+	/* statistics */
+	uint64_t nkicks;
+	uint64_t nentries;
+	uint64_t nstalls;	/* waits for pushbuffer or IB space */
+	uint64_t stall_us;	/* total time spent in them */
+	uint64_t nmmio_gets;	/* GET reads that went to the channel's MMIO */
 
 	struct pscnv_ib_bo *pb;
 	uint32_t *pb_map;
@@ -36,43 +58,132 @@ struct pscnv_ib_chan {
 	uint32_t pb_pos;
 	uint32_t pb_put;
 	uint32_t pb_get;
+	/* pb_pos may advance up to here without checking GET again */
+	uint32_t pb_end;
 
+	/* GET tracking: every submission ends with a semaphore release of
+	 * a sequence number into track_map, and track_ring remembers
+	 * where pb and IB GET will be once that sequence shows up there.
+	 * Without a track BO, GET is read from MMIO. */
+	struct pscnv_ib_bo *track;
+	volatile uint32_t *track_map;
+	uint64_t track_addr;
+	uint32_t track_seq;
+	uint32_t track_seen;
+	uint32_t track_idle;
+	struct pscnv_ib_track {
+		uint32_t pb_get;
+		uint32_t ib_get;
+	} *track_ring;
+
+	uint64_t fence_addr;
+	uint32_t fence_seq;
+
+	/* Multi-producer submission, see pscnv_ib_mp_init. On the channel:
+	 * IB slots handed out to producers, slots published to the ring
+	 * (in order), a lower bound on IB GET, all counting up from
+	 * ib_put, and how much of the pushbuffer is carved into segments.
+	 * On a segment, mp points to its channel. */
+	struct pscnv_ib_chan *mp;
+	uint64_t mp_reserve;
+	uint64_t mp_commit;
+	uint64_t mp_get;
+	/* slot + 1 once a slot is filled in, and whether a thread is
+	 * publishing them, see pscnv_ib_mp_kick */
+	uint64_t *mp_ready;
+	int mp_kicking;
+	uint32_t mp_carved;
+	uint32_t mp_nsegs;
 };
 
 int pscnv_ib_chan_new(int fd, int vid, struct pscnv_ib_chan **res, uint32_t pb_dma, uint32_t pb_order, uint32_t ib_order);
+void pscnv_ib_chan_free(struct pscnv_ib_chan *ch);
 int pscnv_ib_bo_alloc(int fd, int vid, uint32_t cookie, uint32_t flags, uint32_t tile_flags, uint64_t size, uint32_t *user, struct pscnv_ib_bo **res);
 int pscnv_ib_bo_free(struct pscnv_ib_bo *bo);
 int pscnv_ib_push(struct pscnv_ib_chan *ch, uint64_t base, uint32_t len, int flags);
+void pscnv_ib_kick(struct pscnv_ib_chan *ch);
+void pscnv_ib_set_batch(struct pscnv_ib_chan *ch, uint32_t max_entries, uint32_t max_bytes, uint32_t max_us);
 int pscnv_ib_update_get(struct pscnv_ib_chan *ch);
+void pscnv_ib_track_emit(struct pscnv_ib_chan *ch);
+uint32_t pscnv_ib_fence_emit(struct pscnv_ib_chan *ch);
+int pscnv_ib_fence_wait(struct pscnv_ib_chan *ch, uint32_t seq, uint64_t timeout_ns);
+int pscnv_ib_mp_init(struct pscnv_ib_chan *ch);
+int pscnv_ib_seg_new(struct pscnv_ib_chan *ch, uint32_t size, struct pscnv_ib_chan **res);
+void pscnv_ib_seg_free(struct pscnv_ib_chan *seg);
+
+#define PSCNV_IB_TRACK_DWORDS	5
+
+void pscnv_ib_reserve(struct pscnv_ib_chan *ch, uint32_t n);
+
+/*
+ * Pushbuffer writing. RING_SPACE reserves n dwords, contiguous and before
+ * the end of the ring, which can then be written with the unchecked
+ * OUT_RINGu/OUT_RINGp/BEGIN_RING50u. Since nothing straddles the end,
+ * FIRE_RING always has a single range to submit. A single reservation
+ * can't be more than half the ring, asking for more aborts. Every
+ * reservation also leaves room
+ * for the GET tracking release that QUEUE_RING appends.
+ *
+ * BEGIN_RING50 and BEGIN_RING50_NI reserve their data along with the
+ * header, and OUT_RING reserves its own dword, so code that only uses
+ * these stays correct without explicit reservations.
+ *
+ * QUEUE_RING turns what was written since the last submission into an IB
+ * entry but leaves ringing the doorbell (IB PUT) to the batch limits,
+ * while FIRE_RING also rings it right away.
+ */
 
-static inline int FIRE_RING(struct pscnv_ib_chan *ch) {
+static inline void RING_SPACE(struct pscnv_ib_chan *ch, uint32_t n) {
+	if (ch->pb_pos + (n + PSCNV_IB_TRACK_DWORDS) * 4 > ch->pb_end)
+		pscnv_ib_reserve(ch, n);
+}
+
+static inline void QUEUE_RING(struct pscnv_ib_chan *ch) {
 	if (ch->pb_pos != ch->pb_put) {
-		if (ch->pb_pos > ch->pb_put) {
-			pscnv_ib_push(ch, ch->pb_base + ch->pb_put, ch->pb_pos - ch->pb_put, 0);
-		} else {
-			pscnv_ib_push(ch, ch->pb_base + ch->pb_put, ch->pb_size - ch->pb_put, 0);
-			if (ch->pb_pos)
-			       	pscnv_ib_push(ch, ch->pb_base, ch->pb_pos, 0);
-		}
+		if (ch->track_map)
+			pscnv_ib_track_emit(ch);
+		pscnv_ib_push(ch, ch->pb_base + ch->pb_put, ch->pb_pos - ch->pb_put, 0);
 		ch->pb_put = ch->pb_pos;
 	}
 }
 
-static inline int OUT_RING(struct pscnv_ib_chan *ch, uint32_t word) {
-	while (((ch->pb_pos + 4) & ch->pb_mask) == ch->pb_get) {
-		uint32_t old = ch->pb_get;
-		FIRE_RING(ch);
-		pscnv_ib_update_get(ch);
-		if (old == ch->pb_get)
-			sched_yield();
-	}
+static inline void FIRE_RING(struct pscnv_ib_chan *ch) {
+	QUEUE_RING(ch);
+	pscnv_ib_kick(ch);
+}
+
+static inline void OUT_RINGu(struct pscnv_ib_chan *ch, uint32_t word) {
 	ch->pb_map[ch->pb_pos/4] = word;
 	ch->pb_pos += 4;
-	ch->pb_pos &= ch->pb_mask;
 }
 
-static inline int BEGIN_RING50(struct pscnv_ib_chan *ch, int subc, int mthd, int len) {
-	OUT_RING(ch, mthd | subc << 13 | len << 18);
+static inline void OUT_RINGp(struct pscnv_ib_chan *ch, const void *data, uint32_t n) {
+	memcpy(&ch->pb_map[ch->pb_pos/4], data, n * 4);
+	ch->pb_pos += n * 4;
+}
+
+static inline void OUT_RING(struct pscnv_ib_chan *ch, uint32_t word) {
+	RING_SPACE(ch, 1);
+	OUT_RINGu(ch, word);
+}
+
+static inline void BEGIN_RING50u(struct pscnv_ib_chan *ch, int subc, int mthd, int len) {
+	OUT_RINGu(ch, mthd | subc << 13 | len << 18);
+}
+
+/* method mthd gets all len words */
+static inline void BEGIN_RING50_NIu(struct pscnv_ib_chan *ch, int subc, int mthd, int len) {
+	OUT_RINGu(ch, 0x40000000 | mthd | subc << 13 | len << 18);
+}
+
+static inline void BEGIN_RING50(struct pscnv_ib_chan *ch, int subc, int mthd, int len) {
+	RING_SPACE(ch, len + 1);
+	BEGIN_RING50u(ch, subc, mthd, len);
+}
+
+static inline void BEGIN_RING50_NI(struct pscnv_ib_chan *ch, int subc, int mthd, int len) {
+	RING_SPACE(ch, len + 1);
+	BEGIN_RING50_NIu(ch, subc, mthd, len);
 }
 
 #endif
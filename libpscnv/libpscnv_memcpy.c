@@ -0,0 +1,204 @@
+#include "libpscnv_memcpy.h"
+#include "libpscnv.h"
+#include <stdlib.h>
+
+#define PSCNV_COPY_DMA		0xc0b7
+#define PSCNV_COPY_MAXLINES	2047
+#define PSCNV_COPY_TIMEOUT	10000000000ull	/* 10s for a chunk is a hung engine */
+
+/* Copies lines of line bytes each, pitch == line. */
+static void pscnv_copy_lines(struct pscnv_copy *cp, uint64_t dst, uint64_t src, uint32_t line, uint32_t lines) {
+	struct pscnv_ib_chan *ch = cp->ch;
+	switch (cp->oclass) {
+	case 0x90b5:
+		BEGIN_RING50(ch, PSCNV_COPY_SUBC, 0x400, 8);
+		OUT_RINGu(ch, src >> 32);
+		OUT_RINGu(ch, src);
+		OUT_RINGu(ch, dst >> 32);
+		OUT_RINGu(ch, dst);
+		OUT_RINGu(ch, line);
+		OUT_RINGu(ch, line);
+		OUT_RINGu(ch, line);
+		OUT_RINGu(ch, lines);
+		BEGIN_RING50(ch, PSCNV_COPY_SUBC, 0x300, 1);
+		OUT_RINGu(ch, 0x110);
+		break;
+	default:
+		BEGIN_RING50(ch, PSCNV_COPY_SUBC, 0x238, 2);
+		OUT_RINGu(ch, dst >> 32);
+		OUT_RINGu(ch, dst);
+		BEGIN_RING50(ch, PSCNV_COPY_SUBC, 0x30c, 6);
+		OUT_RINGu(ch, src >> 32);
+		OUT_RINGu(ch, src);
+		OUT_RINGu(ch, line);
+		OUT_RINGu(ch, line);
+		OUT_RINGu(ch, line);
+		OUT_RINGu(ch, lines);
+		BEGIN_RING50(ch, PSCNV_COPY_SUBC, 0x300, 1);
+		OUT_RINGu(ch, 0x100110);
+		break;
+	}
+}
+
+/* Whole pages as 4 KiB lines, then the rest as one line. */
+static void pscnv_copy_emit(struct pscnv_copy *cp, uint64_t dst, uint64_t src, uint64_t size) {
+	uint32_t line, lines;
+	while (size) {
+		if (size >= 0x1000) {
+			line = 0x1000;
+			lines = size >> 12;
+			if (lines > PSCNV_COPY_MAXLINES)
+				lines = PSCNV_COPY_MAXLINES;
+		} else {
+			line = size;
+			lines = 1;
+		}
+		pscnv_copy_lines(cp, dst, src, line, lines);
+		dst += (uint64_t)line * lines;
+		src += (uint64_t)line * lines;
+		size -= (uint64_t)line * lines;
+	}
+}
+
+/* Takes the next staging buffer, once nothing uses it anymore. Returns
+ * its index, or the error waiting for it failed with. */
+static int pscnv_copy_stage(struct pscnv_copy *cp) {
+	int i = cp->next, ret;
+	if (cp->stage_busy[i]) {
+		ret = pscnv_ib_fence_wait(cp->ch, cp->stage_seq[i], PSCNV_COPY_TIMEOUT);
+		if (ret)
+			return ret;
+	}
+	cp->next = (i + 1) % PSCNV_COPY_STAGES;
+	cp->stage_busy[i] = 0;
+	return i;
+}
+
+static void pscnv_copy_fence(struct pscnv_copy *cp, uint32_t *seq) {
+	cp->last_seq = pscnv_ib_fence_emit(cp->ch);
+	if (seq)
+		*seq = cp->last_seq;
+}
+
+int pscnv_copy_new(int fd, int vid, uint32_t stage_size, struct pscnv_copy **res) {
+	struct pscnv_copy *cp;
+	struct pscnv_ib_chan *ch;
+	uint64_t chipset;
+	int i;
+	if (pscnv_getparam(fd, PSCNV_GETPARAM_CHIPSET_ID, &chipset))
+		return 1;
+	/* no fences, nothing would say when a stage is done */
+	if (chipset < 0xc0)
+		return 1;
+	cp = calloc(1, sizeof *cp);
+	if (!cp)
+		return 1;
+	cp->stage_size = stage_size ? stage_size : 1 << 20;
+	if (pscnv_ib_chan_new(fd, vid, &cp->ch, PSCNV_COPY_DMA, 0, 0))
+		goto fail_chan;
+	ch = cp->ch;
+	for (i = 0; i < PSCNV_COPY_STAGES; i++)
+		if (pscnv_ib_bo_alloc(fd, ch->vid, 0xc0b7 + i, PSCNV_GEM_SYSRAM_SNOOP | PSCNV_GEM_MAPPABLE, 0, cp->stage_size, 0, &cp->stage[i]))
+			goto fail_stage;
+
+	/* PCOPY contexts come with the channel, and classes are bound by
+	 * number. */
+	cp->oclass = (chipset & 0xf0) == 0xc0 ? 0x90b5 : 0x9039;
+	BEGIN_RING50(ch, PSCNV_COPY_SUBC, 0, 1);
+	OUT_RINGu(ch, cp->oclass);
+	FIRE_RING(ch);
+	*res = cp;
+	return 0;
+
+fail_stage:
+	for (i = 0; i < PSCNV_COPY_STAGES; i++)
+		if (cp->stage[i])
+			pscnv_ib_bo_free(cp->stage[i]);
+	pscnv_ib_chan_free(cp->ch);
+fail_chan:
+	free(cp);
+	return 1;
+}
+
+void pscnv_copy_free(struct pscnv_copy *cp) {
+	int i;
+	pscnv_copy_wait(cp, pscnv_ib_fence_emit(cp->ch), PSCNV_COPY_TIMEOUT);
+	for (i = 0; i < PSCNV_COPY_STAGES; i++)
+		pscnv_ib_bo_free(cp->stage[i]);
+	pscnv_ib_chan_free(cp->ch);
+	free(cp);
+}
+
+int pscnv_copy_wait(struct pscnv_copy *cp, uint32_t seq, uint64_t timeout_ns) {
+	return pscnv_ib_fence_wait(cp->ch, seq, timeout_ns);
+}
+
+int pscnv_memcpy_dtod_async(struct pscnv_copy *cp, uint64_t dst, uint64_t src, uint64_t size, uint32_t *seq) {
+	pscnv_copy_emit(cp, dst, src, size);
+	pscnv_copy_fence(cp, seq);
+	return 0;
+}
+
+int pscnv_memcpy_htod_async(struct pscnv_copy *cp, uint64_t dst, const void *src, uint64_t size, uint32_t *seq) {
+	uint64_t len;
+	int i;
+	if (!size) {
+		pscnv_copy_fence(cp, seq);
+		return 0;
+	}
+	while (size) {
+		len = size < cp->stage_size ? size : cp->stage_size;
+		i = pscnv_copy_stage(cp);
+		if (i < 0)
+			return i;
+		memcpy(cp->stage[i]->map, src, len);
+		pscnv_copy_emit(cp, dst, cp->stage[i]->vm_base, len);
+		pscnv_copy_fence(cp, &cp->stage_seq[i]);
+		cp->stage_busy[i] = 1;
+		src = (const char *)src + len;
+		dst += len;
+		size -= len;
+	}
+	if (seq)
+		*seq = cp->last_seq;
+	return 0;
+}
+
+/* Each chunk is copied out while the engine works on the next one. */
+int pscnv_memcpy_dtoh_async(struct pscnv_copy *cp, void *dst, uint64_t src, uint64_t size, uint32_t *seq) {
+	int prev = -1, i, ret;
+	uint64_t len, prev_len = 0;
+	char *prev_dst = 0;
+	if (!size) {
+		pscnv_copy_fence(cp, seq);
+		return 0;
+	}
+	while (size) {
+		len = size < cp->stage_size ? size : cp->stage_size;
+		i = pscnv_copy_stage(cp);
+		if (i < 0)
+			return i;
+		pscnv_copy_emit(cp, cp->stage[i]->vm_base, src, len);
+		pscnv_copy_fence(cp, &cp->stage_seq[i]);
+		cp->stage_busy[i] = 1;
+		if (prev != -1) {
+			ret = pscnv_ib_fence_wait(cp->ch, cp->stage_seq[prev], PSCNV_COPY_TIMEOUT);
+			if (ret)
+				return ret;
+			memcpy(prev_dst, cp->stage[prev]->map, prev_len);
+		}
+		prev = i;
+		prev_dst = dst;
+		prev_len = len;
+		dst = (char *)dst + len;
+		src += len;
+		size -= len;
+	}
+	ret = pscnv_ib_fence_wait(cp->ch, cp->stage_seq[prev], PSCNV_COPY_TIMEOUT);
+	if (ret)
+		return ret;
+	memcpy(prev_dst, cp->stage[prev]->map, prev_len);
+	if (seq)
+		*seq = cp->last_seq;
+	return 0;
+}
@@ -0,0 +1,47 @@
+#ifndef LIBPSCNV_MEMCPY_H
+#define LIBPSCNV_MEMCPY_H
+#include <stdint.h>
+#include "libpscnv_ib.h"
+
+/*
+ * Copies between host memory and GPU virtual addresses on a copy engine:
+ * PCOPY0 (0x90b5) on NVC0 cards, M2MF (0x9039) on later ones. Each
+ * pscnv_copy has its own channel in the given vspace, and two snooped
+ * sysram staging buffers that host memory goes through in chunks, so the
+ * CPU copies one chunk while the engine copies the other. NV50 channels
+ * have no fences to tell when a chunk is done, pscnv_copy_new fails
+ * there.
+ *
+ * The copies return 0 or a negative error from waiting for the engine,
+ * and store a fence sequence of the copy channel in seq if it isn't
+ * NULL, see pscnv_copy_wait.
+ *
+ * htod returns as soon as the last chunk is staged, src can be reused
+ * right away. dtod doesn't wait at all. dtoh has to wait for the engine
+ * before it can copy the last chunk out, so into pageable memory it only
+ * overlaps the chunks with each other; for a copy that doesn't block,
+ * use dtod into a mapped sysram BO.
+ */
+
+#define PSCNV_COPY_STAGES	2
+#define PSCNV_COPY_SUBC		2
+
+struct pscnv_copy {
+	struct pscnv_ib_chan *ch;
+	uint32_t oclass;
+	struct pscnv_ib_bo *stage[PSCNV_COPY_STAGES];
+	uint32_t stage_seq[PSCNV_COPY_STAGES];
+	int stage_busy[PSCNV_COPY_STAGES];
+	uint32_t stage_size;
+	int next;
+	uint32_t last_seq;
+};
+
+int pscnv_copy_new(int fd, int vid, uint32_t stage_size, struct pscnv_copy **res);
+void pscnv_copy_free(struct pscnv_copy *cp);
+int pscnv_copy_wait(struct pscnv_copy *cp, uint32_t seq, uint64_t timeout_ns);
+int pscnv_memcpy_htod_async(struct pscnv_copy *cp, uint64_t dst, const void *src, uint64_t size, uint32_t *seq);
+int pscnv_memcpy_dtoh_async(struct pscnv_copy *cp, void *dst, uint64_t src, uint64_t size, uint32_t *seq);
+int pscnv_memcpy_dtod_async(struct pscnv_copy *cp, uint64_t dst, uint64_t src, uint64_t size, uint32_t *seq);
+
+#endif
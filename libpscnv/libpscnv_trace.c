@@ -0,0 +1,80 @@
+#include "libpscnv_trace.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+FILE *pscnv_trace_fp;
+/* Held while pscnv_trace_fp is opened, written to or closed. Callers
+ * may peek at pscnv_trace_fp without it to skip building records. */
+static pthread_mutex_t pscnv_trace_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int pscnv_trace_start(const char *path) {
+	struct pscnv_trace_hdr hdr;
+	FILE *fp;
+	pthread_mutex_lock(&pscnv_trace_lock);
+	if (pscnv_trace_fp)
+		goto fail;
+	fp = fopen(path, "wb");
+	if (!fp)
+		goto fail;
+	memset(&hdr, 0, sizeof hdr);
+	memcpy(hdr.magic, PSCNV_TRACE_MAGIC, sizeof hdr.magic);
+	hdr.version = PSCNV_TRACE_VERSION;
+	if (fwrite(&hdr, sizeof hdr, 1, fp) != 1) {
+		fclose(fp);
+		goto fail;
+	}
+	__atomic_store_n(&pscnv_trace_fp, fp, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&pscnv_trace_lock);
+	return 0;
+fail:
+	pthread_mutex_unlock(&pscnv_trace_lock);
+	return 1;
+}
+
+void pscnv_trace_stop(void) {
+	FILE *fp;
+	pthread_mutex_lock(&pscnv_trace_lock);
+	fp = pscnv_trace_fp;
+	__atomic_store_n(&pscnv_trace_fp, 0, __ATOMIC_RELEASE);
+	if (fp)
+		fclose(fp);
+	pthread_mutex_unlock(&pscnv_trace_lock);
+}
+
+/* Called where channels and BOs get created, so that a trace asked for
+ * in the environment is open before anything is submitted. */
+void pscnv_trace_env(void) {
+	static int checked;
+	const char *path;
+	if (checked)
+		return;
+	checked = 1;
+	path = getenv("PSCNV_TRACE");
+	if (path && *path && !pscnv_trace_start(path))
+		atexit(pscnv_trace_stop);
+}
+
+/* Writes one record. The trace lock is held across it, so records from
+ * different threads don't interleave and the file can't be closed under
+ * it. */
+void pscnv_trace_record(int type, const void *rec, uint32_t size, const void *data, uint32_t len) {
+	struct pscnv_trace_rec hdr;
+	struct timespec ts;
+	FILE *fp;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	hdr.type = type;
+	hdr.pad = 0;
+	hdr.len = size + len;
+	hdr.time_us = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+	pthread_mutex_lock(&pscnv_trace_lock);
+	fp = pscnv_trace_fp;
+	if (fp) {
+		fwrite(&hdr, sizeof hdr, 1, fp);
+		fwrite(rec, size, 1, fp);
+		if (len)
+			fwrite(data, len, 1, fp);
+	}
+	pthread_mutex_unlock(&pscnv_trace_lock);
+}
@@ -0,0 +1,88 @@
+#ifndef LIBPSCNV_TRACE_H
+#define LIBPSCNV_TRACE_H
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Submission capture. While a trace is open, libpscnv appends a record
+ * for every IB channel and object created, every BO allocated or freed
+ * through pscnv_ib_bo_alloc/free, and every IB entry pushed, along with
+ * the pushbuffer data the entry points to. BO contents aren't recorded.
+ *
+ * Tracing starts with pscnv_trace_start, or on the first channel or BO
+ * if PSCNV_TRACE names a file in the environment.
+ *
+ * The file is a pscnv_trace_hdr followed by records, each a
+ * pscnv_trace_rec and len bytes of payload, all in host byte order.
+ * test/pb_replay decodes and replays them.
+ */
+
+#define PSCNV_TRACE_MAGIC	"PSCNVTRC"
+#define PSCNV_TRACE_VERSION	1
+
+#define PSCNV_TRACE_CHAN	1
+#define PSCNV_TRACE_BO_NEW	2
+#define PSCNV_TRACE_BO_FREE	3
+#define PSCNV_TRACE_OBJ		4
+#define PSCNV_TRACE_IB		5
+
+struct pscnv_trace_hdr {
+	char magic[8];
+	uint32_t version;
+	uint32_t pad;
+};
+
+struct pscnv_trace_rec {
+	uint16_t type;
+	uint16_t pad;
+	uint32_t len;
+	uint64_t time_us;
+};
+
+struct pscnv_trace_chan {
+	uint32_t cid;
+	uint32_t vid;
+	uint32_t pb_dma;
+	uint32_t pb_order;
+	uint32_t ib_order;
+	uint32_t chipset;
+	uint64_t pb_base;
+	uint64_t ib_base;
+	uint64_t track_base;	/* 0 if GET isn't tracked */
+};
+
+struct pscnv_trace_bo {
+	uint32_t vid;
+	uint32_t handle;
+	uint32_t cookie;
+	uint32_t flags;
+	uint32_t tile_flags;
+	uint32_t pad;
+	uint64_t size;
+	uint64_t vm_base;
+};
+
+struct pscnv_trace_obj {
+	uint32_t cid;
+	uint32_t handle;
+	uint32_t oclass;
+	uint32_t flags;
+};
+
+/* followed by len bytes of pushbuffer, or nothing if nodata is set */
+struct pscnv_trace_ib {
+	uint32_t cid;
+	uint32_t flags;
+	uint64_t base;
+	uint32_t len;
+	uint32_t nodata;
+};
+
+extern FILE *pscnv_trace_fp;
+
+int pscnv_trace_start(const char *path);
+void pscnv_trace_stop(void);
+void pscnv_trace_env(void);
+void pscnv_trace_record(int type, const void *rec, uint32_t size, const void *data, uint32_t len);
+
+#endif
@@ -58,6 +58,8 @@ typedef DRM_SPINTYPE spinlock_t;
 #define kzalloc(x, y) drm_calloc(x, 1, DRM_MEM_DRIVER)
 #define kcalloc(x, y, z) drm_calloc(x, y, DRM_MEM_DRIVER)
 #define kmalloc(x, y) drm_alloc(x, DRM_MEM_DRIVER)
+#define vzalloc(x) drm_calloc(x, 1, DRM_MEM_DRIVER)
+#define vfree(x) kfree(x)
 
 struct device_attribute {};
 struct notifier_block {};
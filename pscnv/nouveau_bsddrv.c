@@ -101,6 +101,12 @@ MODULE_PARM_DESC(reg_debug, "Register access debug bitmask:\n"
 int nouveau_reg_debug;
 module_param_named(reg_debug, nouveau_reg_debug, int, 0600);
 
+#ifdef PSCNV_MMIO_TRACE
+MODULE_PARM_DESC(mmio_trace, "Log2 of MMIO trace records to keep, 0 disables (default: 20)");
+int pscnv_mmio_trace_order = 20;
+module_param_named(mmio_trace, pscnv_mmio_trace_order, int, 0400);
+#endif
+
 MODULE_PARM_DESC(perflvl, "Performance level (default: boot)\n");
 static char nouveau_perflvl_array[32];
 char *nouveau_perflvl = nouveau_perflvl_array;
@@ -220,6 +226,12 @@ struct drm_ioctl_desc nouveau_ioctls[] = {
 	DRM_IOCTL_DEF(DRM_PSCNV_FIFO_INIT, pscnv_ioctl_fifo_init, DRM_UNLOCKED),
 	DRM_IOCTL_DEF(DRM_PSCNV_OBJ_ENG_NEW, pscnv_ioctl_obj_eng_new, DRM_UNLOCKED),
 	DRM_IOCTL_DEF(DRM_PSCNV_FIFO_INIT_IB, pscnv_ioctl_fifo_init_ib, DRM_UNLOCKED),
+	DRM_IOCTL_DEF(DRM_PSCNV_CHAN_SCHED, pscnv_ioctl_chan_sched, DRM_UNLOCKED),
+	DRM_IOCTL_DEF(DRM_PSCNV_FENCE_INFO, pscnv_ioctl_fence_info, DRM_UNLOCKED),
+	DRM_IOCTL_DEF(DRM_PSCNV_FENCE_WAIT, pscnv_ioctl_fence_wait, DRM_UNLOCKED),
+	DRM_IOCTL_DEF(DRM_PSCNV_FENCE_FD, pscnv_ioctl_fence_fd, DRM_UNLOCKED),
+	DRM_IOCTL_DEF(DRM_PSCNV_OBJ_FREE, pscnv_ioctl_obj_free, DRM_UNLOCKED),
+	DRM_IOCTL_DEF(DRM_PSCNV_PERFMON, pscnv_ioctl_perfmon, DRM_UNLOCKED | DRM_AUTH | DRM_ROOT_ONLY),
 };
 
 static int
@@ -32,6 +32,8 @@
 
 #include "nouveau_drv.h"
 #include "nouveau_reg.h"
+#include "pscnv_trap.h"
+#include "pscnv_mmio.h"
 
 #if 0
 static int
@@ -156,18 +158,404 @@ nouveau_debugfs_vbios_image(struct seq_file *m, void *data)
 	return 0;
 }
 
+static int
+nouveau_debugfs_traps(struct seq_file *m, void *data)
+{
+	struct drm_info_node *node = (struct drm_info_node *) m->private;
+	struct drm_nouveau_private *dev_priv = node->minor->dev->dev_private;
+	struct pscnv_trap_ring *ring = dev_priv->trap;
+
+	if (!ring)
+		return -ENODEV;
+	seq_printf(m, "queued : %llu\n", (unsigned long long)ring->queued);
+	seq_printf(m, "decoded: %llu\n", (unsigned long long)ring->decoded);
+	seq_printf(m, "dropped: %llu\n", (unsigned long long)ring->dropped);
+	seq_printf(m, "storm  : %u left\n", ring->storm);
+	return 0;
+}
+
+static const char *const nouveau_debugfs_irq_names[32] = {
+	[5] = "PCOPY0",
+	[6] = "PCOPY1",
+	[8] = "PFIFO",
+	[12] = "PGRAPH",
+	[14] = "PCRYPT",
+	[20] = "PTIMER",
+	[21] = "I2C",
+	[24] = "PCRTC",
+	[26] = "PDISPLAY",
+	[28] = "PBUS",
+	[31] = "SOFTWARE",
+};
+
+static int
+nouveau_debugfs_irq(struct seq_file *m, void *data)
+{
+	struct drm_info_node *node = (struct drm_info_node *) m->private;
+	struct drm_nouveau_private *dev_priv = node->minor->dev->dev_private;
+	struct nouveau_irq_stats *st = &dev_priv->irq_stats;
+	int i, j;
+
+	seq_printf(m, "interrupts: %llu, lock held avg %llu ns, max %u ns\n",
+		   (unsigned long long)st->irqs,
+		   (unsigned long long)(st->irqs ? st->lock_time / st->irqs : 0),
+		   st->lock_max);
+	seq_printf(m, "bit name     %10s %8s %8s  histogram, <256ns to >=4ms\n",
+		   "count", "avg ns", "max ns");
+	for (i = 0; i < 32; i++) {
+		if (!st->count[i])
+			continue;
+		seq_printf(m, "%3d %-8s %10llu %8llu %8u ", i,
+			   nouveau_debugfs_irq_names[i] ? nouveau_debugfs_irq_names[i] : "?",
+			   (unsigned long long)st->count[i],
+			   (unsigned long long)(st->time[i] / st->count[i]),
+			   st->max[i]);
+		for (j = 0; j < NOUVEAU_IRQ_HIST; j++)
+			seq_printf(m, " %u", st->hist[i][j]);
+		seq_printf(m, "\n");
+	}
+	return 0;
+}
+
+static void
+nouveau_debugfs_lat(struct seq_file *m, const char *name, uint64_t n,
+		    struct pscnv_lat *lat)
+{
+	int j;
+	seq_printf(m, "%-13s %10llu %10llu %8llu %10llu ", name,
+		   (unsigned long long)lat->count, (unsigned long long)n,
+		   (unsigned long long)(lat->count ? lat->time / lat->count : 0),
+		   (unsigned long long)lat->max);
+	for (j = 0; j < PSCNV_LAT_HIST; j++)
+		seq_printf(m, " %u", lat->hist[j]);
+	seq_printf(m, "\n");
+}
+
+static int
+nouveau_debugfs_ioctl(struct seq_file *m, void *data)
+{
+	struct drm_info_node *node = (struct drm_info_node *) m->private;
+	struct drm_nouveau_private *dev_priv = node->minor->dev->dev_private;
+	struct pscnv_ioctl_stats *st, *snap;
+	int i;
+
+	snap = kmalloc(sizeof *snap, GFP_KERNEL);
+	if (!snap)
+		return -ENOMEM;
+	st = &dev_priv->ioctl_stats;
+	spin_lock(&st->lock);
+	memcpy(snap, st, sizeof *snap);
+	spin_unlock(&st->lock);
+
+	seq_printf(m, "%-13s %10s %10s %8s %10s  histogram, <1us to >=4s\n",
+		   "ioctl", "count", "errors", "avg ns", "max ns");
+	for (i = 0; i < PSCNV_IOCTLS; i++)
+		if (snap->ioctl[i].count)
+			nouveau_debugfs_lat(m, pscnv_ioctl_names[i],
+					    snap->errors[i], &snap->ioctl[i]);
+	seq_printf(m, "\n%-13s %10s %10s %8s %10s  histogram of waits\n",
+		   "lock", "waits", "taken", "avg ns", "max ns");
+	nouveau_debugfs_lat(m, "vram_mutex", snap->lock_taken[PSCNV_LOCK_VRAM],
+			    &snap->lock_wait[PSCNV_LOCK_VRAM]);
+	nouveau_debugfs_lat(m, "vspace", snap->lock_taken[PSCNV_LOCK_VSPACE],
+			    &snap->lock_wait[PSCNV_LOCK_VSPACE]);
+	kfree(snap);
+	return 0;
+}
+
+/*
+ * Limits of the PLLs the VBIOS describes, one a line, in the form
+ * test/pll_sim reads to check the M/N/P search against them: PLL type,
+ * chip version, whether the pre-NV50 M limits apply, register, both VCOs'
+ * minfreq maxfreq min_inputfreq max_inputfreq min_m max_m min_n max_n,
+ * then max_log2p max_usable_log2p log2p_bias min_p max_p refclk.
+ */
+
+static int
+nouveau_debugfs_pll_lims(struct seq_file *m, void *data)
+{
+	static const u8 types[] = {
+		PLL_CORE, PLL_SHADER, PLL_UNK03, PLL_MEMORY, PLL_UNK05,
+		PLL_UNK40, PLL_UNK41, PLL_UNK42, PLL_VPLL0, PLL_VPLL1
+	};
+	struct drm_info_node *node = (struct drm_info_node *) m->private;
+	struct drm_device *dev = node->minor->dev;
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	struct pll_lims lim;
+	unsigned long flags;
+	unsigned long hits, misses;
+	int i;
+
+	spin_lock_irqsave(&dev_priv->pll_cache_lock, flags);
+	hits = dev_priv->pll_cache.hits;
+	misses = dev_priv->pll_cache.misses;
+	spin_unlock_irqrestore(&dev_priv->pll_cache_lock, flags);
+	seq_printf(m, "# M/N/P cache: %lu hits, %lu misses\n", hits, misses);
+
+	for (i = 0; i < ARRAY_SIZE(types); i++) {
+		memset(&lim, 0, sizeof lim);
+		if (get_pll_limits(dev, types[i], &lim))
+			continue;
+		seq_printf(m, "%02x %02x %d %06x", types[i],
+			   dev_priv->vbios.chip_version,
+			   dev_priv->card_type < NV_50, lim.reg);
+		seq_printf(m, " %d %d %d %d %d %d %d %d",
+			   lim.vco1.minfreq, lim.vco1.maxfreq,
+			   lim.vco1.min_inputfreq, lim.vco1.max_inputfreq,
+			   lim.vco1.min_m, lim.vco1.max_m,
+			   lim.vco1.min_n, lim.vco1.max_n);
+		seq_printf(m, " %d %d %d %d %d %d %d %d",
+			   lim.vco2.minfreq, lim.vco2.maxfreq,
+			   lim.vco2.min_inputfreq, lim.vco2.max_inputfreq,
+			   lim.vco2.min_m, lim.vco2.max_m,
+			   lim.vco2.min_n, lim.vco2.max_n);
+		seq_printf(m, " %d %d %d %d %d %d\n", lim.max_log2p,
+			   lim.max_usable_log2p, lim.log2p_bias,
+			   lim.min_p, lim.max_p, lim.refclk);
+	}
+	return 0;
+}
+
+#ifdef PSCNV_MMIO_PROFILE
+#define NOUVEAU_DEBUGFS_MMIO_TOP 32
+
+static int
+nouveau_debugfs_mmio(struct seq_file *m, void *data)
+{
+	static const char *const kinds[PSCNV_MMIO_KINDS] = {
+		"rd", "wr", "pramin", "window", "bar3", "poll"
+	};
+	struct pscnv_mmio_site *top[NOUVEAU_DEBUGFS_MMIO_TOP], *site;
+	unsigned long sub[PSCNV_MMIO_SUBSYS][PSCNV_MMIO_KINDS];
+	unsigned long total;
+	int ntop = 0, i, j;
+
+	memset(sub, 0, sizeof sub);
+	for (site = pscnv_mmio_first(); site; site = site->next) {
+		total = pscnv_mmio_total(site);
+		if (!total)
+			continue;
+		for (j = 0; j < PSCNV_MMIO_KINDS; j++)
+			sub[pscnv_mmio_subsys(site)][j] += site->count[j];
+		/* insertion into the top list, busiest first */
+		if (ntop == NOUVEAU_DEBUGFS_MMIO_TOP &&
+		    pscnv_mmio_total(top[ntop - 1]) >= total)
+			continue;
+		if (ntop < NOUVEAU_DEBUGFS_MMIO_TOP)
+			ntop++;
+		for (i = ntop - 1; i && pscnv_mmio_total(top[i - 1]) < total; i--)
+			top[i] = top[i - 1];
+		top[i] = site;
+	}
+
+	seq_printf(m, "%-8s", "");
+	for (j = 0; j < PSCNV_MMIO_KINDS; j++)
+		seq_printf(m, " %10s", kinds[j]);
+	seq_printf(m, "\n");
+	for (i = 0; i < PSCNV_MMIO_SUBSYS; i++) {
+		seq_printf(m, "%-8s", pscnv_mmio_subsys_names[i]);
+		for (j = 0; j < PSCNV_MMIO_KINDS; j++)
+			seq_printf(m, " %10lu", sub[i][j]);
+		seq_printf(m, "\n");
+	}
+	seq_printf(m, "\n");
+	for (i = 0; i < ntop; i++) {
+		for (j = 0; j < PSCNV_MMIO_KINDS; j++)
+			seq_printf(m, "%10lu ", top[i]->count[j]);
+		seq_printf(m, "%s:%d %s\n", top[i]->file, top[i]->line,
+			   top[i]->func);
+	}
+	return 0;
+}
+#endif
+
 static struct drm_info_list nouveau_debugfs_list[] = {
 	{ "chipset", nouveau_debugfs_chipset_info, 0, NULL },
 	{ "memory", nouveau_debugfs_memory_info, 0, NULL },
 	{ "vbios.rom", nouveau_debugfs_vbios_image, 0, NULL },
+	{ "traps", nouveau_debugfs_traps, 0, NULL },
+	{ "irq", nouveau_debugfs_irq, 0, NULL },
+	{ "ioctl", nouveau_debugfs_ioctl, 0, NULL },
+	{ "pll_lims", nouveau_debugfs_pll_lims, 0, NULL },
+#ifdef PSCNV_MMIO_PROFILE
+	{ "mmio", nouveau_debugfs_mmio, 0, NULL },
+#endif
 };
 #define NOUVEAU_DEBUGFS_ENTRIES ARRAY_SIZE(nouveau_debugfs_list)
 
+static int
+nouveau_debugfs_file_open(struct inode *inode, struct file *file)
+{
+	file->private_data = inode->i_private;
+	return 0;
+}
+
+/*
+ * Writing a number to trap_storm raises that many synthetic traps back
+ * to back, "irq" then has the interrupt timing over the storm.
+ */
+
+static ssize_t
+nouveau_debugfs_trap_storm_write(struct file *file, const char __user *ubuf,
+				 size_t len, loff_t *ppos)
+{
+	struct drm_device *dev = file->private_data;
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	char buf[16];
+	long count;
+
+	if (!dev_priv || !dev_priv->trap)
+		return -ENODEV;
+	if (len >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, len))
+		return -EFAULT;
+	buf[len] = 0;
+	if (kstrtol(buf, 10, &count) || count < 0)
+		return -EINVAL;
+	pscnv_trap_storm_start(dev, count);
+	return len;
+}
+
+static const struct file_operations nouveau_debugfs_trap_storm_fops = {
+	.owner = THIS_MODULE,
+	.open = nouveau_debugfs_file_open,
+	.write = nouveau_debugfs_trap_storm_write,
+};
+
+/* not a seq_file, only listed so drm_debugfs_remove_files finds it */
+static struct drm_info_list nouveau_debugfs_trap_storm_ent = {
+	"trap_storm", NULL, 0, NULL
+};
+
+#ifdef PSCNV_MMIO_PROFILE
+/* Writing anything to mmio_reset zeroes the "mmio" counters. */
+static ssize_t
+nouveau_debugfs_mmio_reset_write(struct file *file, const char __user *ubuf,
+				 size_t len, loff_t *ppos)
+{
+	pscnv_mmio_reset();
+	return len;
+}
+
+static const struct file_operations nouveau_debugfs_mmio_reset_fops = {
+	.owner = THIS_MODULE,
+	.open = nouveau_debugfs_file_open,
+	.write = nouveau_debugfs_mmio_reset_write,
+};
+
+static struct drm_info_list nouveau_debugfs_mmio_reset_ent = {
+	"mmio_reset", NULL, 0, NULL
+};
+#endif
+
+#ifdef PSCNV_MMIO_TRACE
+/*
+ * mmio_trace reads back as a drm_pscnv_mmio_trace_head and the records
+ * it counts, for test/mmio_replay. The trace may grow while it's read,
+ * records past the header's count are to be ignored. Writing anything
+ * empties the trace and starts recording again.
+ */
+static ssize_t
+nouveau_debugfs_mmio_trace_read(struct file *file, char __user *ubuf,
+				size_t len, loff_t *ppos)
+{
+	struct drm_device *dev = file->private_data;
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	struct pscnv_mmio_trace *t = dev_priv ? dev_priv->mmio_trace : NULL;
+	struct drm_pscnv_mmio_trace_head head;
+	loff_t pos = *ppos, end;
+	size_t done = 0, n;
+
+	if (!t)
+		return -ENODEV;
+	pscnv_mmio_trace_head(t, dev_priv->chipset, &head);
+	end = sizeof head + (loff_t)head.count * sizeof *t->rec;
+	if (pos < sizeof head) {
+		n = min_t(size_t, len, sizeof head - pos);
+		if (copy_to_user(ubuf, (char *)&head + pos, n))
+			return -EFAULT;
+		done += n;
+		pos += n;
+	}
+	if (done < len && pos < end) {
+		n = min_t(size_t, len - done, end - pos);
+		if (copy_to_user(ubuf + done, (char *)t->rec + (pos - sizeof head), n))
+			return -EFAULT;
+		done += n;
+		pos += n;
+	}
+	*ppos = pos;
+	return done;
+}
+
+static ssize_t
+nouveau_debugfs_mmio_trace_write(struct file *file, const char __user *ubuf,
+				 size_t len, loff_t *ppos)
+{
+	struct drm_device *dev = file->private_data;
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+
+	if (!dev_priv || !dev_priv->mmio_trace)
+		return -ENODEV;
+	pscnv_mmio_trace_reset(dev_priv->mmio_trace);
+	return len;
+}
+
+static const struct file_operations nouveau_debugfs_mmio_trace_fops = {
+	.owner = THIS_MODULE,
+	.open = nouveau_debugfs_file_open,
+	.read = nouveau_debugfs_mmio_trace_read,
+	.write = nouveau_debugfs_mmio_trace_write,
+};
+
+static struct drm_info_list nouveau_debugfs_mmio_trace_ent = {
+	"mmio_trace", NULL, 0, NULL
+};
+#endif
+
+/* Files that aren't seq_files, made by hand as drm_debugfs_create_files
+ * only does those. */
+static int
+nouveau_debugfs_file_create(struct drm_minor *minor, struct drm_info_list *ent,
+			    int mode, const struct file_operations *fops)
+{
+	struct drm_device *dev = minor->dev;
+	struct drm_info_node *node;
+
+	node = kmalloc(sizeof(*node), GFP_KERNEL);
+	if (!node)
+		return -ENOMEM;
+	node->dent = debugfs_create_file(ent->name, mode,
+					 minor->debugfs_root, dev, fops);
+	if (!node->dent) {
+		kfree(node);
+		return -ENOMEM;
+	}
+	node->minor = minor;
+	node->info_ent = ent;
+	mutex_lock(&dev->struct_mutex);
+	list_add(&node->list, &minor->debugfs_nodes.list);
+	mutex_unlock(&dev->struct_mutex);
+	return 0;
+}
+
 int
 nouveau_debugfs_init(struct drm_minor *minor)
 {
 	drm_debugfs_create_files(nouveau_debugfs_list, NOUVEAU_DEBUGFS_ENTRIES,
 				 minor->debugfs_root, minor);
+	nouveau_debugfs_file_create(minor, &nouveau_debugfs_trap_storm_ent,
+				    S_IWUSR, &nouveau_debugfs_trap_storm_fops);
+#ifdef PSCNV_MMIO_PROFILE
+	nouveau_debugfs_file_create(minor, &nouveau_debugfs_mmio_reset_ent,
+				    S_IWUSR, &nouveau_debugfs_mmio_reset_fops);
+#endif
+#ifdef PSCNV_MMIO_TRACE
+	nouveau_debugfs_file_create(minor, &nouveau_debugfs_mmio_trace_ent,
+				    S_IRUSR | S_IWUSR,
+				    &nouveau_debugfs_mmio_trace_fops);
+#endif
 	return 0;
 }
 
@@ -176,4 +564,11 @@ nouveau_debugfs_takedown(struct drm_minor *minor)
 {
 	drm_debugfs_remove_files(nouveau_debugfs_list, NOUVEAU_DEBUGFS_ENTRIES,
 				 minor);
+	drm_debugfs_remove_files(&nouveau_debugfs_trap_storm_ent, 1, minor);
+#ifdef PSCNV_MMIO_PROFILE
+	drm_debugfs_remove_files(&nouveau_debugfs_mmio_reset_ent, 1, minor);
+#endif
+#ifdef PSCNV_MMIO_TRACE
+	drm_debugfs_remove_files(&nouveau_debugfs_mmio_trace_ent, 1, minor);
+#endif
 }
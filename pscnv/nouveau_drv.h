@@ -51,10 +51,58 @@
 #include "pscnv_mem.h"
 #include "pscnv_ramht.h"
 #include "pscnv_engine.h"
+#include "pscnv_mmio.h"
 struct nouveau_grctx;
 
 typedef void (*nouveau_irqhandler_t) (struct drm_device *dev, int irq);
 
+/*
+ * Interrupt accounting, per PMC_INTR_0 bit. Times are PTIMER ns; bucket
+ * b of a histogram counts handler runs of 2^(b+7) up to 2^(b+8) ns, the
+ * first and last buckets take everything below and above. Only updated
+ * under context_switch_lock.
+ */
+#define NOUVEAU_IRQ_HIST 16
+struct nouveau_irq_stats {
+	uint64_t count[32];
+	uint64_t time[32];
+	uint32_t max[32];
+	uint32_t hist[32][NOUVEAU_IRQ_HIST];
+	/* whole nouveau_irq_handler runs with the lock held */
+	uint64_t irqs;
+	uint64_t lock_time;
+	uint32_t lock_max;
+};
+
+/*
+ * ioctl latency and lock waits, see pscnv_ioctl.c. Times are CPU clock
+ * ns; bucket b of a histogram counts 2^(b-1) up to 2^b us, bucket 0
+ * everything under 1us and the last everything from 2^22 us up.
+ */
+#define PSCNV_LAT_HIST 24
+struct pscnv_lat {
+	uint64_t count;
+	uint64_t time;
+	uint64_t max;
+	uint32_t hist[PSCNV_LAT_HIST];
+};
+
+enum pscnv_lock_class {
+	PSCNV_LOCK_VRAM,	/* vram_mutex */
+	PSCNV_LOCK_VSPACE,	/* pscnv_vspace lock */
+	PSCNV_LOCKS
+};
+
+#define PSCNV_IOCTLS (DRM_PSCNV_PERFMON + 1)
+struct pscnv_ioctl_stats {
+	spinlock_t lock;
+	struct pscnv_lat ioctl[PSCNV_IOCTLS];
+	uint64_t errors[PSCNV_IOCTLS];
+	/* waits only, taking a lock that's free isn't timed */
+	struct pscnv_lat lock_wait[PSCNV_LOCKS];
+	uint64_t lock_taken[PSCNV_LOCKS];	/* racy across vspaces, roughly right */
+};
+
 #define MAX_NUM_DCB_ENTRIES 16
 
 #define NOUVEAU_MAX_CHANNEL_NR 128
@@ -268,6 +316,8 @@ struct nouveau_pm_level {
 	u32 volt_min; /* microvolts */
 	u32 volt_max;
 	u8  fanspeed;
+
+	void *clocks_state;	/* kept by clocks_prepare, if any */
 };
 
 struct nouveau_pm_temp_sensor_constants {
@@ -297,19 +347,50 @@ enum nouveau_counter_signal {
 	PGRAPH_IDLE,
 	PGRAPH_INTR_PENDING,
 	CTXPROG_ACTIVE,
+	NOUVEAU_COUNTER_SIGNALS
 };
 
 struct nouveau_pm_counter {
+	struct drm_device *dev;
 	bool periodic_polling;
+	bool programmed;		/* the hardware counts what's below */
+	unsigned long last_readout;	/* jiffies */
+#ifdef __linux__
+	struct hrtimer readout_timer;
+#else
 	struct timer_list readout_timer;
+#endif
 	spinlock_t counter_lock;
 
-	/* the 8 sets * 4 counters */
-	enum nouveau_counter_signal signals[8][4];
+	/* the hardware signal of the 8 sets * 4 counters, the ones the
+	 * driver watches and the ones set up by the perfmon ioctl, which
+	 * get the slots the driver leaves free */
+	u8 signals[8][4];
+	u8 user_signals[8][4];
+	bool user;
+	bool polling_before_user;	/* restored when the ioctl stops */
+	u32 period_us;
+	/* samples go here while sampling, see drm_pscnv_perf_ring. The
+	 * ring is mapped by userspace, so its header is only ever written,
+	 * ring_size is what indexes it. */
+	struct pscnv_bo *ring;
+	u32 ring_head;
+	u32 ring_size;
 	struct {
 		u32 cycles;
 		u32 signals[4];
 	} sets[8];
+	/* NVC0: sets are PCOUNTER domains, 0 the hub and 1 on the GPCs
+	 * present; PGRAPH idle comes from PDAEMON's idle counters */
+	u8 domains;
+	bool pdaemon_idle;
+	u32 idle_cycles;
+	u32 idle_total;
+
+	/* the hardware side, called with counter_lock held: program
+	 * starts counting signals, read fills in sets and restarts */
+	void (*program)(struct drm_device *, u8 signals[8][4]);
+	void (*read)(struct drm_device *);
 
 	int  (*init)(struct drm_device *);
 	void (*takedown)(struct drm_device *);
@@ -323,6 +404,8 @@ struct nouveau_pm_counter {
 	void (*poll)(struct drm_device *);
 	void (*start)(struct drm_device *);
 	void (*stop)(struct drm_device *);
+	int  (*configure)(struct drm_device *, u8 signals[8][4],
+				u32 period_us, struct pscnv_bo *ring);
 	void (*on_update)(struct drm_device *);
 };
 
@@ -334,12 +417,14 @@ struct nouveau_pm_engine {
 	struct nouveau_pm_threshold_temp threshold_temp;
 	struct nouveau_pm_fan fan;
 	struct nouveau_pm_counter counter;
-	spinlock_t reclock_lock;
+	/* held across a whole reclock, which sleeps */
+	struct mutex reclock_lock;
 
 	struct nouveau_pm_profile *profile_ac;
 	struct nouveau_pm_profile *profile_dc;
 	struct nouveau_pm_profile *profile;
 	struct list_head profiles;
+	struct nouveau_pm_governor *governor;
 
 	struct nouveau_pm_level boot;
 	struct nouveau_pm_level *cur;
@@ -350,6 +435,14 @@ struct nouveau_pm_engine {
 	int  (*clocks_get)(struct drm_device *, struct nouveau_pm_level *);
 	void *(*clocks_pre)(struct drm_device *, struct nouveau_pm_level *);
 	int (*clocks_set)(struct drm_device *, void *);
+	/* optional: work out what clocks_pre can ahead of time, and forget
+	 * it again when the hardware state it relied on is gone */
+	int (*clocks_prepare)(struct drm_device *, struct nouveau_pm_level *);
+	void (*clocks_flush)(struct drm_device *);
+
+	/* time spent in clocks_pre and clocks_set, under reclock_lock */
+	struct pscnv_lat reclock_pre;
+	struct pscnv_lat reclock_set;
 
 	int (*voltage_get)(struct drm_device *);
 	int (*voltage_set_range)(struct drm_device *, int vol_min, int volt_max);
@@ -366,24 +459,6 @@ struct nouveau_engine {
 	struct nouveau_pm_engine      pm;
 };
 
-struct nouveau_pll_vals {
-	union {
-		struct {
-#ifdef __BIG_ENDIAN
-			uint8_t N1, M1, N2, M2;
-#else
-			uint8_t M1, N1, M2, N2;
-#endif
-		};
-		struct {
-			uint16_t NM1, NM2;
-		} __attribute__((packed));
-	};
-	int log2P;
-
-	int refclk;
-};
-
 enum nv04_fp_display_regs {
 	FP_DISPLAY_END,
 	FP_TOTAL,
@@ -505,7 +580,16 @@ struct drm_nouveau_private {
 #endif
 
 	spinlock_t context_switch_lock;
+#ifdef __linux__
+	/* woken on every nonstall interrupt, see pscnv_fence.c */
+	wait_queue_head_t fence_wq;
+#endif
 	nouveau_irqhandler_t irq_handler[32];
+	struct nouveau_irq_stats irq_stats;
+	struct pscnv_ioctl_stats ioctl_stats;
+	/* trap reports waiting to be decoded, see pscnv_trap.c */
+	struct pscnv_trap_ring *trap;
+	struct pscnv_mmio_trace *mmio_trace;	/* see pscnv_mmio.h */
 
 #if 0 /* relevant only for pre-NV50 */
 	/* RAMIN configuration, RAMFC, RAMHT and RAMRO offsets */
@@ -569,7 +653,8 @@ struct drm_nouveau_private {
 	struct pscnv_mm *vram_mm;
 	struct mutex vram_mutex;
 
-	/* for slow-path nv_wv32/nv_rv32 */
+	/* for slow-path nv_wv32/nv_rv32, irqsave since they're used under
+	 * context_switch_lock */
 
 	spinlock_t pramin_lock;
 	uint64_t pramin_start;
@@ -583,6 +668,9 @@ struct drm_nouveau_private {
 #endif
 
 	struct nvbios vbios;
+	/* M/N/P found by nouveau_calc_pll_mnp, see nouveau_pll.h */
+	struct nouveau_pll_cache pll_cache;
+	spinlock_t pll_cache_lock;
 
 	struct nv04_mode_state mode_reg;
 	struct nv04_mode_state saved_reg;
@@ -687,12 +775,20 @@ extern int  nouveau_load(struct drm_device *, unsigned long flags);
 extern int  nouveau_firstopen(struct drm_device *);
 extern void nouveau_lastclose(struct drm_device *);
 extern int  nouveau_unload(struct drm_device *);
-extern bool nouveau_wait_until(struct drm_device *, uint64_t timeout,
-			       uint32_t reg, uint32_t mask, uint32_t val);
-extern bool nouveau_wait_until_neq(struct drm_device *, uint64_t timeout,
-				   uint32_t reg, uint32_t mask, uint32_t val);
-extern bool nouveau_wait_cb(struct drm_device *, uint64_t timeout,
-			    bool (*cond)(void *), void *);
+extern bool _nouveau_wait_until(PSCNV_MMIO_SITE_PARAM struct drm_device *,
+				uint64_t timeout, uint32_t reg, uint32_t mask,
+				uint32_t val);
+extern bool _nouveau_wait_until_neq(PSCNV_MMIO_SITE_PARAM
+				    struct drm_device *, uint64_t timeout,
+				    uint32_t reg, uint32_t mask, uint32_t val);
+extern bool _nouveau_wait_cb(PSCNV_MMIO_SITE_PARAM struct drm_device *,
+			     uint64_t timeout, bool (*cond)(void *), void *);
+#define nouveau_wait_until(dev, timeout, reg, mask, val) \
+	_nouveau_wait_until(PSCNV_MMIO_SITE_ARG dev, timeout, reg, mask, val)
+#define nouveau_wait_until_neq(dev, timeout, reg, mask, val) \
+	_nouveau_wait_until_neq(PSCNV_MMIO_SITE_ARG dev, timeout, reg, mask, val)
+#define nouveau_wait_cb(dev, timeout, cond, data) \
+	_nouveau_wait_cb(PSCNV_MMIO_SITE_ARG dev, timeout, cond, data)
 //extern bool nouveau_wait_for_idle(struct drm_device *);
 extern int  nouveau_card_init(struct drm_device *);
 
@@ -1188,37 +1284,63 @@ int nv50_calc_pll(struct drm_device *, struct pll_lims *, int clk,
 int nva3_calc_pll(struct drm_device *, struct pll_lims *,
 		   int clk, int *N, int *fN, int *M, int *P);
 
-static inline u32 nv_rd32(struct drm_device *dev, unsigned reg)
+/*
+ * Register access. The site argument is for the MMIO profiler, see
+ * pscnv_mmio.h; the nv_* macros pass the caller's.
+ */
+static inline u32 _nv_rd32(struct pscnv_mmio_site *site,
+			   struct drm_device *dev, unsigned reg)
 {
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
-	return DRM_READ32(dev_priv->mmio, reg);
+	u32 val = DRM_READ32(dev_priv->mmio, reg);
+	pscnv_mmio_count(site, PSCNV_MMIO_RD);
+	pscnv_mmio_trace(dev_priv, RD32, reg, val);
+	return val;
 }
 
-static inline u32 nv_rd08(struct drm_device *dev, unsigned reg)
+static inline u32 _nv_rd08(struct pscnv_mmio_site *site,
+			   struct drm_device *dev, unsigned reg)
 {
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
-	return DRM_READ8(dev_priv->mmio, reg);
+	u32 val = DRM_READ8(dev_priv->mmio, reg);
+	pscnv_mmio_count(site, PSCNV_MMIO_RD);
+	pscnv_mmio_trace(dev_priv, RD08, reg, val);
+	return val;
 }
 
-static inline void nv_wr32(struct drm_device *dev, unsigned reg, u32 val)
+static inline void _nv_wr32(struct pscnv_mmio_site *site,
+			    struct drm_device *dev, unsigned reg, u32 val)
 {
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	pscnv_mmio_count(site, PSCNV_MMIO_WR);
+	pscnv_mmio_trace(dev_priv, WR32, reg, val);
 	DRM_WRITE32(dev_priv->mmio, reg, val);
 }
 
-static inline void nv_wr08(struct drm_device *dev, unsigned reg, u8 val)
+static inline void _nv_wr08(struct pscnv_mmio_site *site,
+			    struct drm_device *dev, unsigned reg, u8 val)
 {
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	pscnv_mmio_count(site, PSCNV_MMIO_WR);
+	pscnv_mmio_trace(dev_priv, WR08, reg, val);
 	DRM_WRITE8(dev_priv->mmio, reg, val);
 }
 
-static inline u32 nv_mask(struct drm_device *dev, u32 reg, u32 mask, u32 val)
+static inline u32 _nv_mask(struct pscnv_mmio_site *site,
+			   struct drm_device *dev, u32 reg, u32 mask, u32 val)
 {
-	u32 tmp = nv_rd32(dev, reg);
-	nv_wr32(dev, reg, (tmp & ~mask) | val);
+	u32 tmp = _nv_rd32(site, dev, reg);
+	_nv_wr32(site, dev, reg, (tmp & ~mask) | val);
 	return tmp;
 }
 
+#define nv_rd32(dev, reg) _nv_rd32(PSCNV_MMIO_SITE, dev, reg)
+#define nv_rd08(dev, reg) _nv_rd08(PSCNV_MMIO_SITE, dev, reg)
+#define nv_wr32(dev, reg, val) _nv_wr32(PSCNV_MMIO_SITE, dev, reg, val)
+#define nv_wr08(dev, reg, val) _nv_wr08(PSCNV_MMIO_SITE, dev, reg, val)
+#define nv_mask(dev, reg, mask, val) \
+	_nv_mask(PSCNV_MMIO_SITE, dev, reg, mask, val)
+
 #define nv_wait(dev, reg, mask, val) \
 	nouveau_wait_until(dev, 2000000000ULL, (reg), (mask), (val))
 
@@ -1227,6 +1349,34 @@ static inline u32 nv_mask(struct drm_device *dev, u32 reg, u32 mask, u32 val)
 #define nv_wait_cb(dev, func, data) \
 	nouveau_wait_cb(dev, 2000000000ULL, (func), (data))
 
+/* monotonic and comparable across CPUs, unlike PTIMER it's no MMIO */
+static inline uint64_t pscnv_clock_ns(void)
+{
+#ifdef __linux__
+	return ktime_to_ns(ktime_get());
+#else
+	struct timespec ts;
+	nanouptime(&ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+/* pscnv_ioctl.c */
+extern const char *const pscnv_ioctl_names[PSCNV_IOCTLS];
+extern void pscnv_lat_add(struct pscnv_lat *lat, uint64_t ns);
+extern void pscnv_lock_waited(struct drm_device *dev, int lock, uint64_t ns);
+
+/* mutex_lock, with the wait accounted to lock class cls */
+#define pscnv_mutex_lock(dev, mutex, cls) do {				\
+	struct drm_nouveau_private *__dev_priv = (dev)->dev_private;	\
+	if (!mutex_trylock(mutex)) {					\
+		uint64_t __start = pscnv_clock_ns();			\
+		mutex_lock(mutex);					\
+		pscnv_lock_waited(dev, cls, pscnv_clock_ns() - __start);	\
+	}								\
+	__dev_priv->ioctl_stats.lock_taken[cls]++;			\
+} while (0)
+
 /*
  * Logging
  * Argument d is (struct drm_device *).
@@ -1351,40 +1501,57 @@ nv_match_device(struct drm_device *dev, unsigned device,
 
 /* object access */
 
-static inline uint32_t nv_rv32(struct pscnv_bo *bo,
-				unsigned offset)
+static inline uint32_t _nv_rv32(struct pscnv_mmio_site *site,
+				struct pscnv_bo *bo, unsigned offset)
 {
 	struct drm_nouveau_private *dev_priv = bo->dev->dev_private;
+	unsigned long flags;
 	uint32_t res;
 	uint64_t addr = bo->start + offset;
-	if (bo->map3 && dev_priv->vm && dev_priv->vm_ok)
-		return le32_to_cpu(DRM_READ32(dev_priv->ramin, bo->map3->start - dev_priv->vm_ramin_base + offset));
-	spin_lock(&dev_priv->pramin_lock);
+	if (bo->map3 && dev_priv->vm && dev_priv->vm_ok) {
+		uint32_t bar3 = bo->map3->start - dev_priv->vm_ramin_base + offset;
+		res = le32_to_cpu(DRM_READ32(dev_priv->ramin, bar3));
+		pscnv_mmio_count(site, PSCNV_MMIO_BAR3);
+		pscnv_mmio_trace(dev_priv, BAR3_RD, bar3, res);
+		return res;
+	}
+	spin_lock_irqsave(&dev_priv->pramin_lock, flags);
 	if (addr >> 16 != dev_priv->pramin_start) {
 		dev_priv->pramin_start = addr >> 16;
-		nv_wr32(bo->dev, 0x1700, addr >> 16);
+		pscnv_mmio_count(site, PSCNV_MMIO_WINDOW);
+		_nv_wr32(site, bo->dev, 0x1700, addr >> 16);
 	}
-	res = nv_rd32(bo->dev, 0x700000 + (addr & 0xffff));
-	spin_unlock(&dev_priv->pramin_lock);
+	pscnv_mmio_count(site, PSCNV_MMIO_PRAMIN);
+	res = _nv_rd32(site, bo->dev, 0x700000 + (addr & 0xffff));
+	spin_unlock_irqrestore(&dev_priv->pramin_lock, flags);
 	return res;
 }
 
-static inline void nv_wv32(struct pscnv_bo *bo,
-				unsigned offset, uint32_t val)
+static inline void _nv_wv32(struct pscnv_mmio_site *site,
+			    struct pscnv_bo *bo, unsigned offset, uint32_t val)
 {
 	struct drm_nouveau_private *dev_priv = bo->dev->dev_private;
+	unsigned long flags;
 	uint64_t addr = bo->start + offset;
 	if (bo->map3 && dev_priv->vm && dev_priv->vm_ok) {
-		DRM_WRITE32(dev_priv->ramin, bo->map3->start - dev_priv->vm_ramin_base + offset, cpu_to_le32(val));
+		uint32_t bar3 = bo->map3->start - dev_priv->vm_ramin_base + offset;
+		pscnv_mmio_count(site, PSCNV_MMIO_BAR3);
+		pscnv_mmio_trace(dev_priv, BAR3_WR, bar3, val);
+		DRM_WRITE32(dev_priv->ramin, bar3, cpu_to_le32(val));
 		return;
 	}
-	spin_lock(&dev_priv->pramin_lock);
+	spin_lock_irqsave(&dev_priv->pramin_lock, flags);
 	if (addr >> 16 != dev_priv->pramin_start) {
 		dev_priv->pramin_start = addr >> 16;
-		nv_wr32(bo->dev, 0x1700, addr >> 16);
+		pscnv_mmio_count(site, PSCNV_MMIO_WINDOW);
+		_nv_wr32(site, bo->dev, 0x1700, addr >> 16);
 	}
-	nv_wr32(bo->dev, 0x700000 + (addr & 0xffff), val);
-	spin_unlock(&dev_priv->pramin_lock);
+	pscnv_mmio_count(site, PSCNV_MMIO_PRAMIN);
+	_nv_wr32(site, bo->dev, 0x700000 + (addr & 0xffff), val);
+	spin_unlock_irqrestore(&dev_priv->pramin_lock, flags);
 }
 
+#define nv_rv32(bo, offset) _nv_rv32(PSCNV_MMIO_SITE, bo, offset)
+#define nv_wv32(bo, offset, val) _nv_wv32(PSCNV_MMIO_SITE, bo, offset, val)
+
 #endif /* __NOUVEAU_DRV_H__ */
@@ -0,0 +1,216 @@
+/*
+ * Copyright 2011 - Nouveau Community
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "nouveau_drv.h"
+#include "nouveau_pm.h"
+#include "nouveau_governor.h"
+#include "pscnv_chan.h"
+
+/*
+ * The "auto" profile: picks a perflvl from how busy PGRAPH was over the
+ * last NOUVEAU_GOV_PERIOD ms, see nouveau_governor.h for how. Selected
+ * like any other profile, through performance_level or nouveau.perflvl,
+ * and only there on cards with more than one perflvl.
+ *
+ * While it's the current profile, a work item on dev_priv->wq samples the
+ * counters and calls nouveau_pm_trigger when the level should change.
+ * fini only tells it to stop, as it may be called from that work item
+ * itself when the power source changed.
+ */
+
+struct nouveau_pm_governor {
+	struct nouveau_pm_profile profile;
+	struct drm_device *dev;
+	struct delayed_work work;
+	bool running;
+	int level;		/* what select returns */
+	u32 busy;		/* last sample */
+	struct nouveau_gov gov;
+};
+
+static const struct nouveau_gov_params nouveau_gov_default = {
+	.up = NOUVEAU_GOV_UP,
+	.down = NOUVEAU_GOV_DOWN,
+	.residency_ms = NOUVEAU_GOV_RESIDENCY,
+	.defer_ms = NOUVEAU_GOV_DEFER,
+};
+
+static u32
+nouveau_pm_governor_ms(void)
+{
+	u64 ns = pscnv_clock_ns();
+	do_div(ns, 1000000);
+	return ns;
+}
+
+/* index of the current perflvl, -1 if it's boot */
+static int
+nouveau_pm_governor_cur(struct nouveau_pm_engine *pm)
+{
+	int i;
+	for (i = 0; i < pm->nr_perflvl; i++)
+		if (pm->cur == &pm->perflvl[i])
+			return i;
+	return -1;
+}
+
+static void
+nouveau_pm_governor_work(struct work_struct *work)
+{
+	struct nouveau_pm_governor *gov =
+		container_of(to_delayed_work(work), struct nouveau_pm_governor, work);
+	struct drm_device *dev = gov->dev;
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	struct nouveau_pm_engine *pm = &dev_priv->engine.pm;
+	u32 idle, total, now;
+	u64 tmp;
+
+	if (!gov->running)
+		return;
+
+	/* without a usable sample, stay where we are rather than taking
+	 * it for an idle card */
+	pm->counter.poll(dev);
+	if (pm->counter.signal_value(dev, PGRAPH_IDLE, &idle, &total) ||
+	    !total || idle > total)
+		goto out;
+	tmp = (u64)(total - idle) * 100;
+	do_div(tmp, total);
+	gov->busy = tmp;
+
+	now = nouveau_pm_governor_ms();
+	gov->level = nouveau_gov_sample(&gov->gov, now, gov->busy,
+					pscnv_chan_busy(dev));
+	if (gov->level != gov->gov.cur)
+		nouveau_pm_trigger(dev);
+	nouveau_gov_switched(&gov->gov, now, nouveau_pm_governor_cur(pm));
+	gov->level = gov->gov.cur;
+
+out:
+	if (gov->running)
+		queue_delayed_work(dev_priv->wq, &gov->work,
+				   msecs_to_jiffies(NOUVEAU_GOV_PERIOD));
+}
+
+static void
+nouveau_pm_governor_init(struct nouveau_pm_profile *profile)
+{
+	struct nouveau_pm_governor *gov =
+		container_of(profile, struct nouveau_pm_governor, profile);
+	struct drm_nouveau_private *dev_priv = gov->dev->dev_private;
+	struct nouveau_pm_engine *pm = &dev_priv->engine.pm;
+
+	gov->level = nouveau_pm_governor_cur(pm);
+	nouveau_gov_init(&gov->gov, &nouveau_gov_default, pm->nr_perflvl,
+			 gov->level, nouveau_pm_governor_ms());
+	gov->running = true;
+	queue_delayed_work(dev_priv->wq, &gov->work,
+			   msecs_to_jiffies(NOUVEAU_GOV_PERIOD));
+}
+
+static void
+nouveau_pm_governor_fini(struct nouveau_pm_profile *profile)
+{
+	struct nouveau_pm_governor *gov =
+		container_of(profile, struct nouveau_pm_governor, profile);
+
+	gov->running = false;
+}
+
+static struct nouveau_pm_level *
+nouveau_pm_governor_select(struct nouveau_pm_profile *profile)
+{
+	struct nouveau_pm_governor *gov =
+		container_of(profile, struct nouveau_pm_governor, profile);
+	struct drm_nouveau_private *dev_priv = gov->dev->dev_private;
+	struct nouveau_pm_engine *pm = &dev_priv->engine.pm;
+
+	if (gov->level < 0)
+		return pm->cur;
+	return &pm->perflvl[gov->level];
+}
+
+static void
+nouveau_pm_governor_destroy(struct nouveau_pm_profile *profile)
+{
+	struct nouveau_pm_governor *gov =
+		container_of(profile, struct nouveau_pm_governor, profile);
+	struct drm_nouveau_private *dev_priv = gov->dev->dev_private;
+
+	gov->running = false;
+	cancel_delayed_work(&gov->work);
+	flush_workqueue(dev_priv->wq);
+	dev_priv->engine.pm.governor = NULL;
+	kfree(gov);
+}
+
+static const struct nouveau_pm_profile_func nouveau_pm_governor_func = {
+	.destroy = nouveau_pm_governor_destroy,
+	.init = nouveau_pm_governor_init,
+	.fini = nouveau_pm_governor_fini,
+	.select = nouveau_pm_governor_select,
+};
+
+void
+nouveau_pm_governor_create(struct drm_device *dev)
+{
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	struct nouveau_pm_engine *pm = &dev_priv->engine.pm;
+	struct nouveau_pm_governor *gov;
+
+	if (pm->nr_perflvl < 2)
+		return;
+
+	gov = kzalloc(sizeof(*gov), GFP_KERNEL);
+	if (!gov)
+		return;
+	gov->dev = dev;
+	gov->level = -1;
+	INIT_DELAYED_WORK(&gov->work, nouveau_pm_governor_work);
+	strncpy(gov->profile.name, "auto", sizeof(gov->profile.name));
+	gov->profile.func = &nouveau_pm_governor_func;
+	list_add_tail(&gov->profile.head, &pm->profiles);
+	pm->governor = gov;
+}
+
+/* Reclocks done and time spent in each perflvl since "auto" was last
+ * selected. */
+int
+nouveau_pm_governor_info(struct drm_device *dev, char *buf, int len)
+{
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	struct nouveau_pm_engine *pm = &dev_priv->engine.pm;
+	struct nouveau_pm_governor *gov = pm->governor;
+	int i, pos;
+
+	if (!gov)
+		return snprintf(buf, len, "none\n");
+
+	pos = snprintf(buf, len, "%s, busy %u%%, %u reclocks\n",
+		       gov->running ? "running" : "stopped", gov->busy,
+		       gov->gov.reclocks);
+	for (i = 0; i < gov->gov.nr && pos < len; i++)
+		pos += snprintf(buf + pos, len - pos, "%c%d: %llu ms\n",
+				i == gov->gov.cur ? '*' : ' ', pm->perflvl[i].id,
+				(unsigned long long)gov->gov.time_ms[i]);
+	return pos < len ? pos : len - 1;
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2011 - Nouveau Community
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __NOUVEAU_GOVERNOR_H__
+#define __NOUVEAU_GOVERNOR_H__
+
+/* Decisions of the "auto" reclocking profile. These only do arithmetic,
+ * so that test/governor_sim can build them on the host. */
+
+#define NOUVEAU_GOV_LEVELS	8	/* NOUVEAU_PM_MAX_LEVEL */
+
+struct nouveau_gov_params {
+	uint32_t up;		/* busy % from which to go to the top level */
+	uint32_t down;		/* busy % under which to go one level down */
+	uint32_t residency_ms;	/* least time spent in a level */
+	uint32_t defer_ms;	/* longest a change waits for idle channels */
+};
+
+#define NOUVEAU_GOV_UP		80
+#define NOUVEAU_GOV_DOWN	30
+#define NOUVEAU_GOV_RESIDENCY	500
+#define NOUVEAU_GOV_DEFER	1000
+#define NOUVEAU_GOV_PERIOD	100	/* ms between samples */
+
+struct nouveau_gov {
+	struct nouveau_gov_params p;
+	int nr;			/* levels, slowest first */
+	int cur;		/* the one we're in, -1 if none of them */
+	uint32_t avg;		/* smoothed busy %, in 1/256ths */
+	uint32_t last_ms;	/* time of the last sample */
+	uint32_t since_ms;	/* when cur was entered */
+	uint32_t wait_ms;	/* when a change started waiting on channels */
+	int waiting;
+	uint32_t reclocks;
+	uint64_t time_ms[NOUVEAU_GOV_LEVELS];
+};
+
+static inline void
+nouveau_gov_init(struct nouveau_gov *g, const struct nouveau_gov_params *p,
+		 int nr, int cur, uint32_t now)
+{
+	int i;
+	g->p = *p;
+	g->nr = nr < NOUVEAU_GOV_LEVELS ? nr : NOUVEAU_GOV_LEVELS;
+	g->cur = cur < g->nr ? cur : -1;
+	g->avg = 0;
+	g->last_ms = g->since_ms = now;
+	g->waiting = 0;
+	g->reclocks = 0;
+	for (i = 0; i < NOUVEAU_GOV_LEVELS; i++)
+		g->time_ms[i] = 0;
+}
+
+/*
+ * Takes a busy % sampled at now, and whether any channel has work queued
+ * on it, and returns the level to go to, cur to stay.
+ *
+ * The load is averaged over the last few samples, 1/4 each, and has to
+ * reach up to go to the top level at once, or to fall under down to go
+ * a level down, so a load between the two never moves us. Either way,
+ * cur is kept for at least residency_ms. A change is held back while
+ * channels have work queued, but for no more than defer_ms, so busy
+ * channels can't pin a level forever. Out of any level, we start over
+ * from the top.
+ */
+static inline int
+nouveau_gov_sample(struct nouveau_gov *g, uint32_t now, uint32_t busy, int queued)
+{
+	int want = g->cur;
+	uint32_t pct;
+
+	if (g->cur >= 0)
+		g->time_ms[g->cur] += now - g->last_ms;
+	g->last_ms = now;
+
+	if (busy > 100)
+		busy = 100;
+	g->avg = (g->avg * 3 + busy * 256) / 4;
+	pct = (g->avg + 128) / 256;
+
+	if (g->cur < 0 || pct >= g->p.up)
+		want = g->nr - 1;
+	else if (pct < g->p.down && g->cur > 0)
+		want = g->cur - 1;
+
+	if (want == g->cur) {
+		g->waiting = 0;
+		return g->cur;
+	}
+	if (g->cur >= 0 && now - g->since_ms < g->p.residency_ms)
+		return g->cur;
+	if (queued) {
+		if (!g->waiting) {
+			g->waiting = 1;
+			g->wait_ms = now;
+		}
+		if (now - g->wait_ms < g->p.defer_ms)
+			return g->cur;
+	}
+	return want;
+}
+
+/* Tells the governor which level we're in after acting on a sample. It
+ * may not be the one asked for, if reclocking failed or something else
+ * picked the level. */
+static inline void
+nouveau_gov_switched(struct nouveau_gov *g, uint32_t now, int level)
+{
+	if (level == g->cur)
+		return;
+	g->cur = level;
+	g->since_ms = now;
+	g->waiting = 0;
+	g->reclocks++;
+}
+
+#endif /* __NOUVEAU_GOVERNOR_H__ */
@@ -40,6 +40,7 @@
 #include "nv50_display.h"
 #include "pscnv_engine.h"
 #include "pscnv_fifo.h"
+#include "pscnv_trap.h"
 
 void
 nouveau_irq_preinstall(struct drm_device *dev)
@@ -1261,6 +1262,23 @@ void nouveau_irq_unregister(struct drm_device *dev, int irq) {
 	spin_unlock_irqrestore(&dev_priv->context_switch_lock, flags);
 }
 
+/* Accounts the handler for bit that ran since then, returns the time now. */
+static uint32_t
+nouveau_irq_account(struct drm_device *dev, int bit, uint32_t then)
+{
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	struct nouveau_irq_stats *st = &dev_priv->irq_stats;
+	uint32_t now = nv_rd32(dev, NV04_PTIMER_TIME_0);
+	uint32_t ns = now - then;
+	int b = fls(ns >> 8);
+
+	st->time[bit] += ns;
+	if (ns > st->max[bit])
+		st->max[bit] = ns;
+	st->hist[bit][b < NOUVEAU_IRQ_HIST ? b : NOUVEAU_IRQ_HIST - 1]++;
+	return now;
+}
+
 irqreturn_t
 nouveau_irq_handler(DRM_IRQ_ARGS)
 {
@@ -1271,21 +1289,29 @@ nouveau_irq_handler(DRM_IRQ_ARGS)
 	uint32_t fbdev_flags = 0;
 #endif
 	unsigned long flags;
+	uint32_t start, now, held;
 	int i;
 
 	status = nv_rd32(dev, NV03_PMC_INTR_0);
 	if (!status)
 		return IRQ_NONE;
 	spin_lock_irqsave(&dev_priv->context_switch_lock, flags);
+	start = now = nv_rd32(dev, NV04_PTIMER_TIME_0);
+	for (i = 0; i < 32; i++)
+		if (status & 1 << i)
+			dev_priv->irq_stats.count[i]++;
 
 	if (status & 0x80000000) {
-		NV_ERROR(dev, "Got a SOFTWARE interrupt for no good reason.\n");
 		nv_wr32(dev, NV03_PMC_INTR_0, 0);
+		if (!pscnv_trap_storm(dev))
+			NV_ERROR(dev, "Got a SOFTWARE interrupt for no good reason.\n");
+		now = nouveau_irq_account(dev, 31, now);
 		status &= ~0x80000000;
 	}
 
 	if (status & 0x10000000) {
 		nouveau_pbus_irq_handler(dev);
+		now = nouveau_irq_account(dev, 28, now);
 		status &= ~0x10000000;
 	}
 
@@ -1293,6 +1319,7 @@ nouveau_irq_handler(DRM_IRQ_ARGS)
 		if (status & 1 << i) {
 			if (dev_priv->irq_handler[i]) {
 				dev_priv->irq_handler[i](dev, i);
+				now = nouveau_irq_account(dev, i, now);
 				status &= ~(1 << i);
 			}
 		}
@@ -1307,12 +1334,14 @@ nouveau_irq_handler(DRM_IRQ_ARGS)
 
 	if (status & NV_PMC_INTR_0_CRTCn_PENDING) {
 		nouveau_crtc_irq_handler(dev, (status>>24)&3);
+		now = nouveau_irq_account(dev, 24, now);
 		status &= ~NV_PMC_INTR_0_CRTCn_PENDING;
 	}
 
 	if (status & (NV_PMC_INTR_0_NV50_DISPLAY_PENDING |
 		      NV_PMC_INTR_0_NV50_I2C_PENDING)) {
 		nv50_display_irq_handler(dev);
+		now = nouveau_irq_account(dev, 26, now);
 		status &= ~(NV_PMC_INTR_0_NV50_DISPLAY_PENDING |
 			    NV_PMC_INTR_0_NV50_I2C_PENDING);
 	}
@@ -1325,6 +1354,11 @@ nouveau_irq_handler(DRM_IRQ_ARGS)
 		dev_priv->fbdev_info->flags = fbdev_flags;
 #endif
 
+	held = nv_rd32(dev, NV04_PTIMER_TIME_0) - start;
+	dev_priv->irq_stats.irqs++;
+	dev_priv->irq_stats.lock_time += held;
+	if (held > dev_priv->irq_stats.lock_max)
+		dev_priv->irq_stats.lock_max = held;
 	spin_unlock_irqrestore(&dev_priv->context_switch_lock, flags);
 
 	return IRQ_HANDLED;
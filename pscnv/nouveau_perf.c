@@ -400,6 +400,13 @@ nouveau_perf_init(struct drm_device *dev)
 		perflvl->profile.func = &nouveau_pm_static_profile_func;
 		list_add_tail(&perflvl->profile.head, &pm->profiles);
 
+		/* so that switching to it later has less to do */
+		if (pm->clocks_prepare) {
+			ret = pm->clocks_prepare(dev, perflvl);
+			if (ret)
+				NV_WARN(dev, "perflvl %d, prepare failed: %d\n",
+					i, ret);
+		}
 
 		pm->nr_perflvl++;
 	}
@@ -0,0 +1,479 @@
+/*
+ * Copyright 1993-2003 NVIDIA, Corporation
+ * Copyright 2007-2009 Stuart Bennett
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __NOUVEAU_PLL_H__
+#define __NOUVEAU_PLL_H__
+
+/* M/N/P search for the PLLs nouveau_calc_pll_mnp programs, with a cache
+ * of results. These only do arithmetic, so that test/pll_sim can build
+ * them on the host and check them against the exhaustive search they
+ * replace. */
+
+struct pll_lims {
+	uint32_t reg;
+
+	struct {
+		int minfreq;
+		int maxfreq;
+		int min_inputfreq;
+		int max_inputfreq;
+
+		uint8_t min_m;
+		uint8_t max_m;
+		uint8_t min_n;
+		uint8_t max_n;
+	} vco1, vco2;
+
+	uint8_t max_log2p;
+	/*
+	 * for most pre nv50 cards setting a log2P of 7 (the common max_log2p
+	 * value) is no different to 6 (at least for vplls) so allowing the MNP
+	 * calc to use 7 causes the generated clock to be out by a factor of 2.
+	 * however, max_log2p cannot be fixed-up during parsing as the
+	 * unmodified max_log2p value is still needed for setting mplls, hence
+	 * an additional max_usable_log2p member
+	 */
+	uint8_t max_usable_log2p;
+	uint8_t log2p_bias;
+
+	uint8_t min_p;
+	uint8_t max_p;
+
+	int refclk;
+};
+
+struct nouveau_pll_vals {
+	union {
+		struct {
+#ifdef __BIG_ENDIAN
+			uint8_t N1, M1, N2, M2;
+#else
+			uint8_t M1, N1, M2, N2;
+#endif
+		};
+		struct {
+			uint16_t NM1, NM2;
+		} __attribute__((packed));
+	};
+	int log2P;
+
+	int refclk;
+};
+
+/*
+ * The searches below give the same answers as the exhaustive ones that
+ * used to be in nouveau_calc.c, M, N and P being tried in the same order
+ * and the first best one kept. They only skip, working it out from the
+ * limits instead, the values of M and N that one would have stepped over
+ * without trying: those putting the reference past the input limits, N
+ * under its minimum, the first stage VCO under its range or, before NV60,
+ * N2/M2 out of 4..10.
+ */
+
+/* ceil(a * m / d) for a >= 0 and m, d > 0, without a * m overflowing,
+ * clamped to cap */
+static inline int
+nouveau_pll_muldiv_up(int a, int m, int d, int cap)
+{
+	int q = a / d, r = a % d;
+	if (q > cap / m)
+		return cap;
+	q = q * m + (r * m + d - 1) / d;
+	return q < cap ? q : cap;
+}
+
+/* first M for which in / M <= max */
+static inline int
+nouveau_pll_first_m(int in, int max, int minM)
+{
+	int M;
+	if (max >= in)
+		return minM;
+	M = in / (max + 1) + 1;
+	return M > minM ? M : minM;
+}
+
+/* first M for which in / M < min, beyond any M if there's none */
+static inline int
+nouveau_pll_stop_m(int in, int min)
+{
+	return min > 0 ? in / min + 1 : 0x100;
+}
+
+/* first M from M for which (clkP * M + in / 2) / in >= minN */
+static inline int
+nouveau_pll_first_m_for_n(int clkP, int in, int minN, int M)
+{
+	int need = minN * in - in / 2;
+	if (need <= 0)
+		return M;
+	if (clkP <= 0)
+		return 0x100;
+	need = (need + clkP - 1) / clkP;
+	return need > M ? need : M;
+}
+
+/* The M limit pre-NV50 cards put on single stage PLLs, by VBIOS chip
+ * version. */
+static inline int
+nouveau_pll_single_maxm(int cv, int clk, int maxM)
+{
+	/* this division verified for nv20, nv18, nv28 (Haiku), and nv34 */
+	/* possibly correlated with introduction of 27MHz crystal */
+	if (cv < 0x17 || cv == 0x1a || cv == 0x20) {
+		if (clk > 250000)
+			maxM = 6;
+		if (clk > 340000)
+			maxM = 2;
+	} else if (cv < 0x40) {
+		if (clk > 150000)
+			maxM = 6;
+		if (clk > 200000)
+			maxM = 4;
+		if (clk > 340000)
+			maxM = 2;
+	}
+	return maxM;
+}
+
+/* Single stage PLL, "clk" in kHz, returns the clock it gets. */
+static inline int
+nouveau_pll_single(const struct pll_lims *pll_lim, int clk, int maxM,
+		   struct nouveau_pll_vals *bestpv)
+{
+	int minvco = pll_lim->vco1.minfreq, maxvco = pll_lim->vco1.maxfreq;
+	int minM = pll_lim->vco1.min_m;
+	int minN = pll_lim->vco1.min_n, maxN = pll_lim->vco1.max_n;
+	int minP = pll_lim->max_p ? pll_lim->min_p : 0;
+	int maxP = pll_lim->max_p ? pll_lim->max_p : pll_lim->max_usable_log2p;
+	int crystal = pll_lim->refclk;
+	int loM = nouveau_pll_first_m(crystal, pll_lim->vco1.max_inputfreq, minM);
+	int stopM = nouveau_pll_stop_m(crystal, pll_lim->vco1.min_inputfreq);
+	int M, N, thisP, P;
+	int clkP, calcclk;
+	int delta, bestdelta = INT_MAX;
+	int bestclk = 0;
+
+	P = pll_lim->max_p ? maxP : (1 << maxP);
+	if ((clk * P) < minvco) {
+		minvco = clk * maxP;
+		maxvco = minvco * 2;
+	}
+
+	if (clk + clk/200 > maxvco)	/* +0.5% */
+		maxvco = clk + clk/200;
+
+	for (thisP = minP; thisP <= maxP; thisP++) {
+		P = pll_lim->max_p ? thisP : (1 << thisP);
+		clkP = clk * P;
+
+		if (clkP < minvco)
+			continue;
+		if (clkP > maxvco)
+			return bestclk;
+
+		/* going under the input minimum ends the whole search, even
+		 * if the M where that happens would have been skipped */
+		M = nouveau_pll_first_m_for_n(clkP, crystal, minN, loM);
+		if (M > maxM) {
+			if (minM <= maxM && stopM <= maxM)
+				return bestclk;
+			continue;
+		}
+
+		for (; M <= maxM; M++) {
+			if (M >= stopM)
+				return bestclk;
+
+			/* add crystal/2 to round better */
+			N = (clkP * M + crystal/2) / crystal;
+			if (N > maxN)
+				break;
+
+			/* more rounding additions */
+			calcclk = ((N * crystal + P/2) / P + M/2) / M;
+			delta = abs(calcclk - clk);
+			if (delta < bestdelta) {
+				bestdelta = delta;
+				bestclk = calcclk;
+				bestpv->N1 = N;
+				bestpv->M1 = M;
+				bestpv->log2P = thisP;
+				if (delta == 0)
+					return bestclk;
+			}
+		}
+	}
+
+	return bestclk;
+}
+
+/* Two stage PLL, "clk" in kHz, returns the clock it gets. cv is the VBIOS
+ * chip version. */
+static inline int
+nouveau_pll_double(const struct pll_lims *pll_lim, int clk, int cv,
+		   struct nouveau_pll_vals *bestpv)
+{
+	int minvco1 = pll_lim->vco1.minfreq, maxvco1 = pll_lim->vco1.maxfreq;
+	int minvco2 = pll_lim->vco2.minfreq, maxvco2 = pll_lim->vco2.maxfreq;
+	int minU2 = pll_lim->vco2.min_inputfreq;
+	int maxU2 = pll_lim->vco2.max_inputfreq;
+	int minM1 = pll_lim->vco1.min_m, maxM1 = pll_lim->vco1.max_m;
+	int minN1 = pll_lim->vco1.min_n, maxN1 = pll_lim->vco1.max_n;
+	int minM2 = pll_lim->vco2.min_m, maxM2 = pll_lim->vco2.max_m;
+	int minN2 = pll_lim->vco2.min_n, maxN2 = pll_lim->vco2.max_n;
+	int maxlog2P = pll_lim->max_usable_log2p;
+	int crystal = pll_lim->refclk;
+	int fixedgain2 = (minM2 == maxM2 && minN2 == maxN2);
+	int stopM1 = nouveau_pll_stop_m(crystal, pll_lim->vco1.min_inputfreq);
+	int M1, N1, M2, N2, log2P, hiM2;
+	int clkP, calcclk1, calcclk2, calcclkout;
+	int delta, bestdelta = INT_MAX;
+	int bestclk = 0;
+
+	int vco2 = (maxvco2 - maxvco2/200) / 2;
+	for (log2P = 0; clk && log2P < maxlog2P && clk <= (vco2 >> log2P); log2P++)
+		;
+	clkP = clk << log2P;
+
+	if (maxvco2 < clk + clk/200)	/* +0.5% */
+		maxvco2 = clk + clk/200;
+
+	if (maxM1 >= stopM1)
+		maxM1 = stopM1 - 1;
+	for (M1 = nouveau_pll_first_m(crystal, pll_lim->vco1.max_inputfreq, minM1);
+	     M1 <= maxM1; M1++) {
+		N1 = minN1;
+		if (minvco1 > 0)
+			N1 = nouveau_pll_muldiv_up(minvco1, M1, crystal, maxN1 + 1);
+		if (N1 < minN1)
+			N1 = minN1;
+
+		for (; N1 <= maxN1; N1++) {
+			calcclk1 = crystal * N1 / M1;
+			if (calcclk1 > maxvco1)
+				break;
+
+			hiM2 = nouveau_pll_stop_m(calcclk1, minU2) - 1;
+			if (hiM2 > maxM2)
+				hiM2 = maxM2;
+			M2 = nouveau_pll_first_m(calcclk1, maxU2, minM2);
+			M2 = nouveau_pll_first_m_for_n(clkP, calcclk1, minN2, M2);
+
+			/* N2/M2 within 4..10 wants calcclk1 within about
+			 * clkP/11..clkP/3.5: past the top, that's so for every
+			 * N1 from here on, under the bottom, for every M2 */
+			if (!fixedgain2 && cv < 0x60) {
+				if ((int64_t)calcclk1 * (8 * M2 - 1) > (int64_t)2 * clkP * M2)
+					break;
+				if ((int64_t)calcclk1 * (22 * hiM2 - 1) <= (int64_t)2 * clkP * hiM2 - 1)
+					continue;
+			}
+
+			for (; M2 <= hiM2; M2++) {
+				/* add calcclk1/2 to round better */
+				N2 = (clkP * M2 + calcclk1/2) / calcclk1;
+				if (N2 > maxN2)
+					break;
+
+				if (!fixedgain2) {
+					if (cv < 0x60)
+						if (N2/M2 < 4 || N2/M2 > 10)
+							continue;
+
+					calcclk2 = calcclk1 * N2 / M2;
+					if (calcclk2 < minvco2)
+						break;
+					if (calcclk2 > maxvco2)
+						continue;
+				} else
+					calcclk2 = calcclk1;
+
+				calcclkout = calcclk2 >> log2P;
+				delta = abs(calcclkout - clk);
+				if (delta < bestdelta) {
+					bestdelta = delta;
+					bestclk = calcclkout;
+					bestpv->N1 = N1;
+					bestpv->M1 = M1;
+					bestpv->N2 = N2;
+					bestpv->M2 = M2;
+					bestpv->log2P = log2P;
+					if (delta == 0)
+						return bestclk;
+				}
+			}
+		}
+	}
+
+	return bestclk;
+}
+
+/*
+ * Results by limits and clock. Reclocking and modesetting keep asking
+ * for the same few clocks from the same few PLLs, so this is a small
+ * direct mapped table. It doesn't lock, see nouveau_calc_pll_mnp for
+ * how the driver uses it.
+ */
+
+#define NOUVEAU_PLL_CACHE_BITS 6
+
+struct nouveau_pll_cache_entry {
+	struct pll_lims lim;
+	int clk;
+	int cv;
+	int clamp;
+	int valid;
+	int out;
+	struct nouveau_pll_vals pv;	/* log2P -1 if nothing was found */
+};
+
+struct nouveau_pll_cache {
+	struct nouveau_pll_cache_entry ent[1 << NOUVEAU_PLL_CACHE_BITS];
+	unsigned long hits, misses;
+};
+
+static inline int
+nouveau_pll_lims_eq(const struct pll_lims *a, const struct pll_lims *b)
+{
+	return a->vco1.minfreq == b->vco1.minfreq &&
+		a->vco1.maxfreq == b->vco1.maxfreq &&
+		a->vco1.min_inputfreq == b->vco1.min_inputfreq &&
+		a->vco1.max_inputfreq == b->vco1.max_inputfreq &&
+		a->vco1.min_m == b->vco1.min_m && a->vco1.max_m == b->vco1.max_m &&
+		a->vco1.min_n == b->vco1.min_n && a->vco1.max_n == b->vco1.max_n &&
+		a->vco2.minfreq == b->vco2.minfreq &&
+		a->vco2.maxfreq == b->vco2.maxfreq &&
+		a->vco2.min_inputfreq == b->vco2.min_inputfreq &&
+		a->vco2.max_inputfreq == b->vco2.max_inputfreq &&
+		a->vco2.min_m == b->vco2.min_m && a->vco2.max_m == b->vco2.max_m &&
+		a->vco2.min_n == b->vco2.min_n && a->vco2.max_n == b->vco2.max_n &&
+		a->max_usable_log2p == b->max_usable_log2p &&
+		a->min_p == b->min_p && a->max_p == b->max_p &&
+		a->refclk == b->refclk;
+}
+
+static inline struct nouveau_pll_cache_entry *
+nouveau_pll_cache_slot(struct nouveau_pll_cache *cache,
+		       const struct pll_lims *lim, int clk)
+{
+	uint32_t h = clk * 0x9e3779b1u;
+	h ^= (lim->vco1.maxfreq + lim->vco2.maxfreq + lim->refclk) * 0x85ebca6bu;
+	h ^= lim->vco1.max_m << 8 | lim->vco1.max_n;
+	return &cache->ent[(h >> 16) & ((1 << NOUVEAU_PLL_CACHE_BITS) - 1)];
+}
+
+/* Copies what a search found, the members of pv it would have set. */
+static inline void
+nouveau_pll_apply(const struct pll_lims *lim, struct nouveau_pll_vals *pv,
+		  const struct nouveau_pll_vals *res)
+{
+	if (res->log2P < 0)
+		return;
+	pv->N1 = res->N1;
+	pv->M1 = res->M1;
+	pv->log2P = res->log2P;
+	if (lim->vco2.maxfreq) {
+		pv->N2 = res->N2;
+		pv->M2 = res->M2;
+	}
+}
+
+/* Looks clk up, returns the clock got and sets pv like the search would
+ * if it's there, -1 if it isn't. */
+static inline int
+nouveau_pll_cache_get(struct nouveau_pll_cache *cache,
+		      const struct pll_lims *lim, int clk, int cv, int clamp,
+		      struct nouveau_pll_vals *pv)
+{
+	struct nouveau_pll_cache_entry *e = nouveau_pll_cache_slot(cache, lim, clk);
+
+	if (!e->valid || e->clk != clk || e->cv != cv || e->clamp != clamp ||
+	    !nouveau_pll_lims_eq(&e->lim, lim)) {
+		cache->misses++;
+		return -1;
+	}
+	cache->hits++;
+	nouveau_pll_apply(lim, pv, &e->pv);
+	return e->out;
+}
+
+/* Keeps what nouveau_pll_search returned. */
+static inline void
+nouveau_pll_cache_put(struct nouveau_pll_cache *cache,
+		      const struct pll_lims *lim, int clk, int cv, int clamp,
+		      int out, const struct nouveau_pll_vals *res)
+{
+	struct nouveau_pll_cache_entry *e = nouveau_pll_cache_slot(cache, lim, clk);
+
+	e->lim = *lim;
+	e->clk = clk;
+	e->cv = cv;
+	e->clamp = clamp;
+	e->out = out;
+	e->pv = *res;
+	e->valid = 1;
+}
+
+/*
+ * Finds M, N and P for clk, in kHz, into res, returns the clock got, 0 if
+ * there's none. cv is the VBIOS chip version, clamp whether the pre-NV50
+ * limits on M apply. res->log2P is left at -1 if nothing was found.
+ */
+static inline int
+nouveau_pll_search(const struct pll_lims *lim, int clk, int cv, int clamp,
+		   struct nouveau_pll_vals *res)
+{
+	int maxM;
+
+	memset(res, 0, sizeof(*res));
+	res->log2P = -1;
+	if (lim->vco2.maxfreq)
+		return nouveau_pll_double(lim, clk, cv, res);
+
+	maxM = lim->vco1.max_m;
+	if (clamp)
+		maxM = nouveau_pll_single_maxm(cv, clk, maxM);
+	return nouveau_pll_single(lim, clk, maxM, res);
+}
+
+/* nouveau_pll_search through the cache, setting only the members of pv
+ * it would have set. */
+static inline int
+nouveau_pll_calc(struct nouveau_pll_cache *cache, const struct pll_lims *lim,
+		 int clk, int cv, int clamp, struct nouveau_pll_vals *pv)
+{
+	struct nouveau_pll_vals res;
+	int out;
+
+	out = nouveau_pll_cache_get(cache, lim, clk, cv, clamp, pv);
+	if (out >= 0)
+		return out;
+
+	out = nouveau_pll_search(lim, clk, cv, clamp, &res);
+	nouveau_pll_cache_put(cache, lim, clk, cv, clamp, out, &res);
+	nouveau_pll_apply(lim, pv, &res);
+	return out;
+}
+
+#endif /* __NOUVEAU_PLL_H__ */
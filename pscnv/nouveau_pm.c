@@ -138,41 +138,50 @@ nouveau_pm_perflvl_set(struct drm_device *dev, struct nouveau_pm_level *perflvl)
 {
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
 	struct nouveau_pm_engine *pm = &dev_priv->engine.pm;
+	u64 time0, time1;
 	void *state;
 	int ret;
 
 	if (perflvl == pm->cur)
 		return 0;
 
-	spin_lock(&pm->reclock_lock);
+	mutex_lock(&pm->reclock_lock);
 
 	ret = nouveau_pm_perflvl_aux(dev, perflvl, pm->cur, perflvl);
-	if (ret)
+	if (ret) {
+		mutex_unlock(&pm->reclock_lock);
 		return ret;
+	}
 
+	time0 = pscnv_clock_ns();
 	state = pm->clocks_pre(dev, perflvl);
+	time1 = pscnv_clock_ns();
+	pscnv_lat_add(&pm->reclock_pre, time1 - time0);
 	if (IS_ERR(state)) {
 		ret = PTR_ERR(state);
 		goto error;
 	}
 	ret = pm->clocks_set(dev, state);
+	pscnv_lat_add(&pm->reclock_set, pscnv_clock_ns() - time1);
 	if (ret)
 		goto error;
 
 	ret = nouveau_pm_perflvl_aux(dev, perflvl, perflvl, pm->cur);
-	if (ret)
+	if (ret) {
+		mutex_unlock(&pm->reclock_lock);
 		return ret;
+	}
 
 	pm->cur = perflvl;
 
-	spin_unlock(&pm->reclock_lock);
+	mutex_unlock(&pm->reclock_lock);
 
 	return 0;
 
 error:
 	/* restore the fan speed and voltage before leaving */
 	nouveau_pm_perflvl_aux(dev, perflvl, perflvl, pm->cur);
-	spin_unlock(&pm->reclock_lock);
+	mutex_unlock(&pm->reclock_lock);
 	return ret;
 }
 
@@ -452,6 +461,49 @@ nouveau_pm_show_pgraph_usage(struct device *d, struct device_attribute *attr,
 static DEVICE_ATTR(pgraph_usage, S_IRUGO, nouveau_pm_show_pgraph_usage,
 		   NULL);
 
+static ssize_t
+nouveau_pm_show_governor(struct device *d, struct device_attribute *attr,
+			 char *buf)
+{
+	struct drm_device *dev = dev_get_drvdata(d);
+
+	return nouveau_pm_governor_info(dev, buf, PAGE_SIZE);
+}
+static DEVICE_ATTR(pm_governor, S_IRUGO, nouveau_pm_show_governor, NULL);
+
+static ssize_t
+nouveau_pm_show_reclock_latency(struct device *d, struct device_attribute *attr,
+				char *buf)
+{
+	struct drm_device *dev = dev_get_drvdata(d);
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	struct nouveau_pm_engine *pm = &dev_priv->engine.pm;
+	struct pscnv_lat lat[2];
+	u64 avg[2];
+	int i;
+
+	mutex_lock(&pm->reclock_lock);
+	lat[0] = pm->reclock_pre;
+	lat[1] = pm->reclock_set;
+	mutex_unlock(&pm->reclock_lock);
+
+	for (i = 0; i < 2; i++) {
+		avg[i] = lat[i].time;
+		if (lat[i].count)
+			do_div(avg[i], (u32)lat[i].count);
+	}
+	return sprintf(buf, "prepare: %llu times, avg %llu ns, max %llu ns\n"
+			    "program: %llu times, avg %llu ns, max %llu ns\n",
+		       (unsigned long long)lat[0].count,
+		       (unsigned long long)avg[0],
+		       (unsigned long long)lat[0].max,
+		       (unsigned long long)lat[1].count,
+		       (unsigned long long)avg[1],
+		       (unsigned long long)lat[1].max);
+}
+static DEVICE_ATTR(reclock_latency, S_IRUGO, nouveau_pm_show_reclock_latency,
+		   NULL);
+
 static ssize_t
 nouveau_pm_get_perfmon_continuous(struct device *d, struct device_attribute *attr,
 			      char *buf)
@@ -506,6 +558,14 @@ nouveau_sysfs_init(struct drm_device *dev)
 	if (ret)
 		return ret;
 
+	ret = device_create_file(d, &dev_attr_pm_governor);
+	if (ret)
+		return ret;
+
+	ret = device_create_file(d, &dev_attr_reclock_latency);
+	if (ret)
+		return ret;
+
 	ret = device_create_file(d, &dev_attr_perfmon_continuous);
 	if (ret)
 		return ret;
@@ -542,6 +602,8 @@ nouveau_sysfs_fini(struct drm_device *dev)
 
 	device_remove_file(d, &dev_attr_performance_level);
 	device_remove_file(d, &dev_attr_pgraph_usage);
+	device_remove_file(d, &dev_attr_pm_governor);
+	device_remove_file(d, &dev_attr_reclock_latency);
 	device_remove_file(d, &dev_attr_perfmon_continuous);
 	for (i = 0; i < pm->nr_perflvl; i++) {
 		struct nouveau_pm_level *pl = &pm->perflvl[i];
@@ -974,6 +1036,7 @@ nouveau_pm_init(struct drm_device *dev)
 	strncpy(pm->boot.profile.name, "boot", 4);
 	pm->boot.profile.func = &nouveau_pm_static_profile_func;
 
+	mutex_init(&pm->reclock_lock);
 	INIT_LIST_HEAD(&pm->profiles);
 	list_add(&pm->boot.profile.head, &pm->profiles);
 
@@ -984,6 +1047,7 @@ nouveau_pm_init(struct drm_device *dev)
 
 	/* add performance levels from vbios */
 	nouveau_perf_init(dev);
+	nouveau_pm_governor_create(dev);
 
 	/* display available performance levels */
 	NV_INFO(dev, "%d available performance level(s)\n", pm->nr_perflvl);
@@ -995,6 +1059,10 @@ nouveau_pm_init(struct drm_device *dev)
 	nouveau_pm_perflvl_info(&pm->boot, info, sizeof(info));
 	NV_INFO(dev, "c:%s", info);
 
+	/* before any profile gets to use them */
+	pm->counter.init(dev);
+	pm->counter.watch(dev, PGRAPH_IDLE);
+
 	/* switch performance levels now if requested */
 	if (nouveau_perflvl && nouveau_perflvl[0])
 		nouveau_pm_profile_set(dev, nouveau_perflvl);
@@ -1009,9 +1077,6 @@ nouveau_pm_init(struct drm_device *dev)
 	register_acpi_notifier(&pm->acpi_nb);
 #endif
 
-	pm->counter.init(dev);
-	pm->counter.watch(dev, PGRAPH_IDLE);
-
 	return 0;
 }
 
@@ -1029,6 +1094,8 @@ nouveau_pm_fini(struct drm_device *dev)
 
 	if (pm->cur != &pm->boot)
 		nouveau_pm_perflvl_set(dev, &pm->boot);
+	if (pm->clocks_flush)
+		pm->clocks_flush(dev);
 
 	pm->counter.takedown(dev);
 
@@ -1053,6 +1120,10 @@ nouveau_pm_resume(struct drm_device *dev)
 	if (!pm->cur || pm->cur == &pm->boot)
 		return;
 
+	/* whatever was worked out from the state we left is gone with it */
+	if (pm->clocks_flush)
+		pm->clocks_flush(dev);
+
 	perflvl = pm->cur;
 	pm->cur = &pm->boot;
 	nouveau_pm_perflvl_set(dev, perflvl);
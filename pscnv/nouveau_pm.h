@@ -51,6 +51,10 @@ void nouveau_pm_resume(struct drm_device *dev);
 extern const struct nouveau_pm_profile_func nouveau_pm_static_profile_func;
 void nouveau_pm_trigger(struct drm_device *dev);
 
+/* nouveau_governor.c */
+void nouveau_pm_governor_create(struct drm_device *);
+int  nouveau_pm_governor_info(struct drm_device *, char *buf, int len);
+
 /* nouveau_volt.c */
 void nouveau_volt_init(struct drm_device *);
 void nouveau_volt_fini(struct drm_device *);
@@ -99,6 +103,8 @@ int nva3_pm_clocks_set(struct drm_device *, void *);
 int nvc0_pm_clocks_get(struct drm_device *, struct nouveau_pm_level *);
 void *nvc0_pm_clocks_pre(struct drm_device *, struct nouveau_pm_level *);
 int nvc0_pm_clocks_set(struct drm_device *, void *);
+int nvc0_pm_clocks_prepare(struct drm_device *, struct nouveau_pm_level *);
+void nvc0_pm_clocks_flush(struct drm_device *);
 
 /* nouveau_temp.c */
 void nouveau_temp_init(struct drm_device *dev);
@@ -117,7 +123,22 @@ int nv40_counter_unwatch_signal(struct drm_device *dev,
 void nv40_counter_poll(struct drm_device *dev);
 void nv40_counter_start(struct drm_device *dev);
 void nv40_counter_stop(struct drm_device *dev);
+int nv40_counter_configure(struct drm_device *dev, u8 signals[8][4],
+			   u32 period_us, struct pscnv_bo *ring);
+void nv40_counter_program(struct drm_device *dev, u8 signals[8][4]);
+void nv40_counter_read(struct drm_device *dev);
 int nv40_counter_value(struct drm_device *,
 		       enum nouveau_counter_signal, u32 *, u32 *);
 
+/* nvc0_counter.c */
+int nvc0_counter_init(struct drm_device *dev);
+void nvc0_counter_program(struct drm_device *dev, u8 signals[8][4]);
+void nvc0_counter_read(struct drm_device *dev);
+int nvc0_counter_watch_signal(struct drm_device *dev,
+			enum nouveau_counter_signal);
+int nvc0_counter_unwatch_signal(struct drm_device *dev,
+			enum nouveau_counter_signal);
+int nvc0_counter_value(struct drm_device *,
+		       enum nouveau_counter_signal, u32 *, u32 *);
+
 #endif
@@ -43,6 +43,7 @@
 #include "pscnv_chan.h"
 #include "pscnv_fifo.h"
 #include "pscnv_ioctl.h"
+#include "pscnv_trap.h"
 
 static void nouveau_stub_takedown(struct drm_device *dev) {}
 static int nouveau_stub_init(struct drm_device *dev) { return 0; }
@@ -89,6 +90,9 @@ static int nouveau_init_engine_ptrs(struct drm_device *dev)
 		engine->pm.counter.start	= nv40_counter_start;
 		engine->pm.counter.stop		= nv40_counter_stop;
 		engine->pm.counter.signal_value	= nv40_counter_value;
+		engine->pm.counter.configure	= nv40_counter_configure;
+		engine->pm.counter.program	= nv40_counter_program;
+		engine->pm.counter.read		= nv40_counter_read;
 		switch (chip) {
 		case 0xa3:
 		case 0xa5:
@@ -107,6 +111,14 @@ static int nouveau_init_engine_ptrs(struct drm_device *dev)
 			engine->pm.clocks_get		= nvc0_pm_clocks_get;
 			engine->pm.clocks_pre		= nvc0_pm_clocks_pre;
 			engine->pm.clocks_set		= nvc0_pm_clocks_set;
+			engine->pm.clocks_prepare	= nvc0_pm_clocks_prepare;
+			engine->pm.clocks_flush		= nvc0_pm_clocks_flush;
+			engine->pm.counter.init		= nvc0_counter_init;
+			engine->pm.counter.watch	= nvc0_counter_watch_signal;
+			engine->pm.counter.unwatch	= nvc0_counter_unwatch_signal;
+			engine->pm.counter.signal_value	= nvc0_counter_value;
+			engine->pm.counter.program	= nvc0_counter_program;
+			engine->pm.counter.read		= nvc0_counter_read;
 			break;
 		default:
 			engine->pm.clocks_get	= nv50_pm_clocks_get;
@@ -243,6 +255,7 @@ nouveau_card_init(struct drm_device *dev)
 #endif /* __linux__ */
 
 	dev_priv->init_state = NOUVEAU_CARD_INIT_FAILED;
+	pscnv_mmio_mark(dev, BEGIN, CARD_INIT);
 
 	/* Initialise internal driver API hooks */
 	ret = nouveau_init_engine_ptrs(dev);
@@ -250,6 +263,12 @@ nouveau_card_init(struct drm_device *dev)
 		goto out;
 	engine = &dev_priv->engine;
 	spin_lock_init(&dev_priv->context_switch_lock);
+#ifdef __linux__
+	init_waitqueue_head(&dev_priv->fence_wq);
+#endif
+	ret = pscnv_trap_init(dev);
+	if (ret)
+		goto out;
 
 	/* Make the CRTCs and I2C buses accessible */
 	if (drm_core_check_feature(dev, DRIVER_MODESET)) {
@@ -330,24 +349,34 @@ nouveau_card_init(struct drm_device *dev)
 	switch (dev_priv->card_type) {
 		case NV_50:
 			/* PFIFO */
+			pscnv_mmio_mark(dev, BEGIN, FIFO_INIT);
 			ret = nv50_fifo_init(dev);
+			pscnv_mmio_mark(dev, END, FIFO_INIT);
 			if (!ret) {
 				/* PGRAPH */
+				pscnv_mmio_mark(dev, BEGIN, GRAPH_INIT);
 				nv50_graph_init(dev);
+				pscnv_mmio_mark(dev, END, GRAPH_INIT);
 			}
 			break;
 		case NV_D0:
 		case NV_C0:
 			/* PFIFO */
+			pscnv_mmio_mark(dev, BEGIN, FIFO_INIT);
 			ret = nvc0_fifo_init(dev);
+			pscnv_mmio_mark(dev, END, FIFO_INIT);
 			if (!ret) {
 				/* PGRAPH */
+				pscnv_mmio_mark(dev, BEGIN, GRAPH_INIT);
 				ret = nvc0_graph_init(dev);
+				pscnv_mmio_mark(dev, END, GRAPH_INIT);
 				if (!ret && dev_priv->card_type == NV_C0) {
+					pscnv_mmio_mark(dev, BEGIN, COPY_INIT);
 					/* PCOPY0 */
 					nvc0_copy_init(dev, 0);
 					/* PCOPY1 */
 					nvc0_copy_init(dev, 1);
+					pscnv_mmio_mark(dev, END, COPY_INIT);
 				}
 			}
 			break;
@@ -371,7 +400,9 @@ nouveau_card_init(struct drm_device *dev)
 	}
 
 	if (drm_core_check_feature(dev, DRIVER_MODESET)) {
+		pscnv_mmio_mark(dev, BEGIN, DISPLAY_INIT);
 		ret = nouveau_display_create(dev);
+		pscnv_mmio_mark(dev, END, DISPLAY_INIT);
 		if (ret)
 			goto out_fifo;
 	}
@@ -421,6 +452,7 @@ nouveau_card_init(struct drm_device *dev)
 		drm_kms_helper_poll_init(dev);
 	}
 
+	pscnv_mmio_mark(dev, END, CARD_INIT);
 	NV_INFO(dev, "Card initialized.\n");
 	return 0;
 
@@ -464,6 +496,7 @@ out_display_early:
 		engine->display.late_takedown(dev);
 	}
 out:
+	pscnv_trap_takedown(dev);
 #ifdef __linux__
 	vga_client_register(dev->pdev, NULL, NULL, NULL);
 #endif
@@ -482,6 +515,7 @@ static void nouveau_card_takedown(struct drm_device *dev)
 		nouveau_backlight_exit(dev);
 		drm_irq_uninstall(dev);
 		flush_workqueue(dev_priv->wq);
+		pscnv_trap_takedown(dev);
 		for (i = 0; i < PSCNV_ENGINES_NUM; i++)
 			if (dev_priv->engines[i]) {
 				dev_priv->engines[i]->takedown(dev_priv->engines[i]);
@@ -605,6 +639,8 @@ int nouveau_load(struct drm_device *dev, unsigned long flags)
 
 	dev_priv->flags = flags/* & NOUVEAU_FLAGS*/;
 	dev_priv->init_state = NOUVEAU_CARD_INIT_DOWN;
+	spin_lock_init(&dev_priv->ioctl_stats.lock);
+	spin_lock_init(&dev_priv->pll_cache_lock);
 
 	NV_DEBUG(dev, "vendor: 0x%X device: 0x%X\n",
 		 dev->pci_vendor, dev->pci_device);
@@ -613,6 +649,11 @@ int nouveau_load(struct drm_device *dev, unsigned long flags)
 	if (!dev_priv->wq)
 		return -EINVAL;
 
+#ifdef PSCNV_MMIO_TRACE
+	/* before the first register access */
+	dev_priv->mmio_trace = pscnv_mmio_trace_new(pscnv_mmio_trace_order);
+#endif
+
 	/* resource 0 is mmio regs */
 	/* resource 1 is linear FB */
 	/* resource 2 is RAMIN (mmio regs + 0x1000000) */
@@ -793,19 +834,24 @@ int nouveau_unload(struct drm_device *dev)
 	drm_rmmap(dev, dev_priv->mmio);
 	drm_rmmap(dev, dev_priv->ramin);
 
+#ifdef PSCNV_MMIO_TRACE
+	pscnv_mmio_trace_free(dev_priv->mmio_trace);
+#endif
 	kfree(dev_priv);
 	dev->dev_private = NULL;
 	return 0;
 }
 
 /* Wait until (value(reg) & mask) == val, up until timeout has hit */
-bool nouveau_wait_until(struct drm_device *dev, uint64_t timeout,
-			uint32_t reg, uint32_t mask, uint32_t val)
+bool _nouveau_wait_until(PSCNV_MMIO_SITE_PARAM struct drm_device *dev,
+			 uint64_t timeout, uint32_t reg, uint32_t mask,
+			 uint32_t val)
 {
 	uint64_t start = nv04_timer_read(dev);
 
 	do {
-		if ((nv_rd32(dev, reg) & mask) == val)
+		pscnv_mmio_count(PSCNV_MMIO_CALLER, PSCNV_MMIO_POLL);
+		if ((_nv_rd32(PSCNV_MMIO_CALLER, dev, reg) & mask) == val)
 			return true;
 	} while (nv04_timer_read(dev) - start < timeout);
 
@@ -813,26 +859,31 @@ bool nouveau_wait_until(struct drm_device *dev, uint64_t timeout,
 }
 
 /* Wait until (value(reg) & mask) != val, up until timeout has hit. */
-bool nouveau_wait_until_neq(struct drm_device *dev, uint64_t timeout,
-			    uint32_t reg, uint32_t mask, uint32_t val)
+bool _nouveau_wait_until_neq(PSCNV_MMIO_SITE_PARAM
+			     struct drm_device *dev, uint64_t timeout,
+			     uint32_t reg, uint32_t mask, uint32_t val)
 {
 	uint64_t start = nv04_timer_read(dev);
 
 	do {
-		if ((nv_rd32(dev, reg) & mask) != val)
+		pscnv_mmio_count(PSCNV_MMIO_CALLER, PSCNV_MMIO_POLL);
+		if ((_nv_rd32(PSCNV_MMIO_CALLER, dev, reg) & mask) != val)
 			return true;
 	} while (nv04_timer_read(dev) - start < timeout);
 
 	return false;
 }
 
+/* cond's own register reads are charged to cond, only the polls to the
+ * caller */
 bool
-nouveau_wait_cb(struct drm_device *dev, uint64_t timeout,
-		bool (*cond)(void *), void *data)
+_nouveau_wait_cb(PSCNV_MMIO_SITE_PARAM struct drm_device *dev,
+		 uint64_t timeout, bool (*cond)(void *), void *data)
 {
 	uint64_t start = nv04_timer_read(dev);
 
 	do {
+		pscnv_mmio_count(PSCNV_MMIO_CALLER, PSCNV_MMIO_POLL);
 		if (cond(data) == true)
 			return true;
 	} while (nv04_timer_read(dev) - start < timeout);
@@ -24,9 +24,78 @@
 
 #include "nouveau_drv.h"
 #include "nouveau_pm.h"
+#include "pscnv_drm.h"
+
+/*
+ * The named signals, all in set 1, per chipset. A chipset missing here
+ * only gets the signals userspace asks for by number.
+ */
+static const struct nv40_counter_chipset {
+	u8 chipsets[4];
+	u8 signal[NOUVEAU_COUNTER_SIGNALS];
+} nv40_counter_chipsets[] = {
+	{ { 0x50 }, {
+		[PGRAPH_IDLE] = 0xc8,
+		[PGRAPH_INTR_PENDING] = 0xca,
+		[CTXPROG_ACTIVE] = 0xd2 } },
+	{ { 0x84, 0x86, 0x98 }, {
+		[PGRAPH_IDLE] = 0xbd,
+		[PGRAPH_INTR_PENDING] = 0xbf,
+		[CTXPROG_ACTIVE] = 0xc7 } },
+	{ { 0xa0, 0xac }, {
+		[PGRAPH_IDLE] = 0xc9,
+		[PGRAPH_INTR_PENDING] = 0xcb,
+		[CTXPROG_ACTIVE] = 0x1c } },
+	{ { 0xa3, 0xa5, 0xa8 }, {
+		[PGRAPH_IDLE] = 0xcb,
+		[PGRAPH_INTR_PENDING] = 0xcd,
+		[CTXPROG_ACTIVE] = 0xd5 } },
+};
+
+#define NV40_COUNTER_SET 1
+
+/* a readout older than this may have wrapped the cycle counters */
+#define NV40_COUNTER_MAX_AGE HZ
+/* how long poll counts for when the last readout is too old */
+#define NV40_COUNTER_POLL_MS 10
 
 static void
-pcounter_counters_readout_periodic(unsigned long data);
+pcounter_counters_readout(struct drm_device *dev);
+
+#ifdef __linux__
+static enum hrtimer_restart
+pcounter_counters_readout_periodic(struct hrtimer *timer)
+{
+	struct nouveau_pm_counter *counter =
+		container_of(timer, struct nouveau_pm_counter, readout_timer);
+
+	pcounter_counters_readout(counter->dev);
+	if (!counter->periodic_polling)
+		return HRTIMER_NORESTART;
+	hrtimer_forward_now(timer, ns_to_ktime(counter->period_us * 1000ULL));
+	return HRTIMER_RESTART;
+}
+#else
+static unsigned long
+nv40_counter_period(struct nouveau_pm_counter *counter)
+{
+	unsigned long j = msecs_to_jiffies(counter->period_us / 1000);
+	return j ? j : 1;
+}
+
+static void
+pcounter_counters_readout_periodic(unsigned long data)
+{
+	struct drm_device *dev = (struct drm_device *)data;
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	struct nouveau_pm_counter *counter = &dev_priv->engine.pm.counter;
+
+	pcounter_counters_readout(dev);
+	if (counter->periodic_polling)
+		mod_timer(&counter->readout_timer,
+			  jiffies + nv40_counter_period(counter));
+}
+#endif
 
 int
 nv40_counter_init(struct drm_device *dev)
@@ -34,9 +103,18 @@ nv40_counter_init(struct drm_device *dev)
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
 	struct nouveau_pm_counter *counter = &dev_priv->engine.pm.counter;
 
+	counter->dev = dev;
+	counter->period_us = 100000;
+	spin_lock_init(&counter->counter_lock);
+
 	/* initialise the periodic timer */
+#ifdef __linux__
+	hrtimer_init(&counter->readout_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	counter->readout_timer.function = pcounter_counters_readout_periodic;
+#else
 	setup_timer(&counter->readout_timer,
 		    pcounter_counters_readout_periodic, (unsigned long)dev);
+#endif
 
 	return 0;
 }
@@ -46,152 +124,85 @@ nv40_counter_fini(struct drm_device *dev)
 {
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
 	struct nouveau_pm_counter *counter = &dev_priv->engine.pm.counter;
-	int set, sig;
 
+	nv40_counter_configure(dev, NULL, 0, NULL);
 	nv40_counter_stop(dev);
-
-	for (set = 0; set < 8; set++)
-		for (sig = 0; sig < 4; sig++)
-			counter->sets[set].signals[sig] = 0;
+	memset(counter->signals, 0, sizeof counter->signals);
 }
 
-static u8
+static int
 nv40_counter_signal(struct drm_device *dev, enum nouveau_counter_signal s,
 		    u8 *set, u8 *signal)
 {
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
-	u8 chipset = dev_priv->chipset;
-
-	if (set)
-		*set = 0;
-	if (signal)
-		*signal = 0;
-
-	switch (s) {
-		case NONE:
-		{
-			return 0;
+	int i, j;
+
+	*set = NV40_COUNTER_SET;
+	*signal = 0;
+	if (s == NONE)
+		return 0;
+	if (s >= NOUVEAU_COUNTER_SIGNALS)
+		return -ENOENT;
+
+	for (i = 0; i < ARRAY_SIZE(nv40_counter_chipsets); i++) {
+		const struct nv40_counter_chipset *c = &nv40_counter_chipsets[i];
+		for (j = 0; j < ARRAY_SIZE(c->chipsets) && c->chipsets[j]; j++) {
+			if (c->chipsets[j] != dev_priv->chipset)
+				continue;
+			*signal = c->signal[s];
+			return *signal ? 0 : -ENOENT;
 		}
-		case PGRAPH_IDLE:
-		{
-			if (set)
-				*set = 1;
-			if (!signal)
-				return 0;
-
-			switch (chipset)
-			{
-				case 0x50:
-					*signal = 0xc8;
-					break;
-				case 0x84:
-				case 0x86:
-				case 0x98:
-					*signal = 0xbd;
-					break;
-				case 0xa0:
-				case 0xac:
-					*signal = 0xc9;
-					break;
-				case 0xa3:
-				case 0xa5:
-				case 0xa8:
-					*signal = 0xcb;
-					break;
-				default:
-					return -ENOENT;
-			}
+	}
 
-			return 0;
-		}
-		case PGRAPH_INTR_PENDING:
-		{
-			if (set)
-				*set = 1;
-			if (!signal)
-				return 0;
-
-			switch (chipset)
-			{
-				case 0x50:
-					*signal = 0xca;
-					break;
-				case 0x84:
-				case 0x86:
-				case 0x98:
-					*signal = 0xbf;
-					break;
-				case 0xa0:
-				case 0xac:
-					*signal = 0xcb;
-					break;
-				case 0xa3:
-				case 0xa5:
-				case 0xa8:
-					*signal = 0xcd;
-					break;
-				default:
-					return -ENOENT;
-			}
+	return -ENOENT;
+}
 
-			return 0;
-		}
-		case CTXPROG_ACTIVE:
-		{
-			if (set)
-				*set = 1;
-			if (!signal)
-				return 0;
-
-			switch (chipset)
-			{
-				case 0x50:
-					*signal = 0xd2;
-					break;
-				case 0x84:
-				case 0x86:
-				case 0x98:
-					*signal = 0xc7;
-					break;
-				case 0xa0:
-				case 0xac:
-					*signal = 0x1c;
-					break;
-				case 0xa3:
-				case 0xa5:
-				case 0xa8:
-					*signal = 0xd5;
-					break;
-				default:
-					return -ENOENT;
-			}
+/* the signals being counted: the driver's, and the perfmon ioctl's in
+ * the slots the driver leaves free, counter_lock held */
+static void
+nv40_counter_signals(struct nouveau_pm_counter *counter, u8 signals[8][4])
+{
+	int set, i;
 
-			return 0;
+	for (set = 0; set < 8; set++) {
+		for (i = 0; i < 4; i++) {
+			signals[set][i] = counter->signals[set][i];
+			if (!signals[set][i] && counter->user)
+				signals[set][i] = counter->user_signals[set][i];
 		}
-	};
+	}
+}
 
-	return -ENOENT;
+/* whether the perfmon ioctl's signals leave the driver's in place,
+ * counter_lock held */
+static bool
+nv40_counter_fits(struct nouveau_pm_counter *counter, u8 signals[8][4])
+{
+	int set, i;
+
+	for (set = 0; set < 8; set++)
+		for (i = 0; i < 4; i++)
+			if (counter->signals[set][i] && signals[set][i] &&
+			    signals[set][i] != counter->signals[set][i])
+				return false;
+	return true;
 }
 
-static void
-nv40_counter_reprogram(struct drm_device *dev)
+/* NV40 layout, counter_lock held */
+void
+nv40_counter_program(struct drm_device *dev, u8 signals[8][4])
 {
-	struct drm_nouveau_private *dev_priv = dev->dev_private;
-	struct nouveau_pm_counter *counter = &dev_priv->engine.pm.counter;
-	unsigned long flags;
 	int set;
 
-	spin_lock_irqsave(&counter->counter_lock, flags);
-
 	for (set = 0; set < 8; set++) {
 		nv_wr32(dev, 0xa7c0 + set * 4, 0x1);
 		nv_wr32(dev, 0xa500 + set * 4, 0);
 		nv_wr32(dev, 0xa520 + set * 4, 0);
 
-		nv_wr32(dev, 0xa400 + set * 4, counter->signals[set][0]);
-		nv_wr32(dev, 0xa440 + set * 4, counter->signals[set][1]);
-		nv_wr32(dev, 0xa480 + set * 4, counter->signals[set][2]);
-		nv_wr32(dev, 0xa4c0 + set * 4, counter->signals[set][3]);
+		nv_wr32(dev, 0xa400 + set * 4, signals[set][0]);
+		nv_wr32(dev, 0xa440 + set * 4, signals[set][1]);
+		nv_wr32(dev, 0xa480 + set * 4, signals[set][2]);
+		nv_wr32(dev, 0xa4c0 + set * 4, signals[set][3]);
 
 		nv_wr32(dev, 0xa420 + set * 4, 0xaaaa);
 		nv_wr32(dev, 0xa460 + set * 4, 0xaaaa);
@@ -201,21 +212,15 @@ nv40_counter_reprogram(struct drm_device *dev)
 
 	/* reset the counters */
 	nv_mask(dev, 0x400084, 0x20, 0x20);
-
-	spin_unlock_irqrestore(&counter->counter_lock, flags);
 }
 
-static void
-pcounter_counters_readout(struct drm_device *dev)
+void
+nv40_counter_read(struct drm_device *dev)
 {
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
 	struct nouveau_pm_counter *counter = &dev_priv->engine.pm.counter;
-	unsigned long flags;
 	int s;
 
-	spin_lock_irqsave(&counter->counter_lock, flags);
-
-	/* readout */
 	nv_mask(dev, 0x400084, 0x0, 0x20);
 
 	for (s = 0; s < 8; s++) {
@@ -225,9 +230,72 @@ pcounter_counters_readout(struct drm_device *dev)
 		counter->sets[s].signals[2] = nv_rd32(dev, 0xa680 + s * 4);
 		counter->sets[s].signals[3] = nv_rd32(dev, 0xa740 + s * 4);
 	}
+}
 
-	if (counter->periodic_polling)
-		mod_timer(&counter->readout_timer, jiffies + (HZ / 10));
+static void
+nv40_counter_reprogram(struct drm_device *dev)
+{
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	struct nouveau_pm_counter *counter = &dev_priv->engine.pm.counter;
+	unsigned long flags;
+	u8 signals[8][4];
+
+	spin_lock_irqsave(&counter->counter_lock, flags);
+	nv40_counter_signals(counter, signals);
+	counter->program(dev, signals);
+	counter->programmed = true;
+	counter->last_readout = jiffies;
+	spin_unlock_irqrestore(&counter->counter_lock, flags);
+}
+
+static void *
+nv40_counter_ring_ptr(struct pscnv_bo *ring, uint64_t offset)
+{
+#ifdef __linux__
+	return (char *)page_address(ring->pages[offset >> PAGE_SHIFT]) +
+		(offset & (PAGE_SIZE - 1));
+#else
+	return (char *)ring->pages[offset >> PAGE_SHIFT] +
+		(offset & (PAGE_SIZE - 1));
+#endif
+}
+
+/* appends what was just read out to the ring, counter_lock held */
+static void
+nv40_counter_ring_put(struct nouveau_pm_counter *counter)
+{
+	struct drm_pscnv_perf_ring *head = nv40_counter_ring_ptr(counter->ring, 0);
+	struct drm_pscnv_perf_sample *sample;
+	u32 seq = counter->ring_head;
+	int s;
+
+	sample = nv40_counter_ring_ptr(counter->ring, PSCNV_PERF_RING_SAMPLES +
+			(uint64_t)(seq & (counter->ring_size - 1)) * sizeof *sample);
+	sample->time = pscnv_clock_ns();
+	sample->seq = seq;
+	for (s = 0; s < 8; s++) {
+		sample->cycles[s] = counter->sets[s].cycles;
+		memcpy(sample->count[s], counter->sets[s].signals,
+		       sizeof sample->count[s]);
+	}
+	wmb();
+	counter->ring_head = head->head = seq + 1;
+}
+
+static void
+pcounter_counters_readout(struct drm_device *dev)
+{
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	struct nouveau_pm_counter *counter = &dev_priv->engine.pm.counter;
+	unsigned long flags;
+
+	spin_lock_irqsave(&counter->counter_lock, flags);
+
+	counter->read(dev);
+	counter->last_readout = jiffies;
+
+	if (counter->periodic_polling && counter->ring)
+		nv40_counter_ring_put(counter);
 
 	spin_unlock_irqrestore(&counter->counter_lock, flags);
 
@@ -251,9 +319,12 @@ int nv40_counter_watch_signal(struct drm_device *dev,
 	spin_lock_irqsave(&counter->counter_lock, flags);
 
 	for (i = 0; i < 4; i++) {
-		if (counter->signals[set][i] == 0 ||
+		u8 user = counter->user ? counter->user_signals[set][i] : 0;
+		if ((counter->signals[set][i] == 0 &&
+		     (user == 0 || user == signal)) ||
 		    counter->signals[set][i] == signal) {
 			counter->signals[set][i] = signal;
+			counter->programmed = false;
 			spin_unlock_irqrestore(&counter->counter_lock, flags);
 			return 0;
 		}
@@ -282,6 +353,7 @@ int nv40_counter_unwatch_signal(struct drm_device *dev,
 	for (i = 0; i < 4; i++) {
 		if (counter->signals[set][i] == signal) {
 			counter->signals[set][i] = 0;
+			counter->programmed = false;
 			spin_unlock_irqrestore(&counter->counter_lock, flags);
 			return 0;
 		}
@@ -292,32 +364,46 @@ int nv40_counter_unwatch_signal(struct drm_device *dev,
 	return -ENOENT;
 }
 
+/*
+ * Reads out what was counted since the last readout, without waiting
+ * unless that was too long ago for the counters to be trusted, or they
+ * were never set up: then they're restarted and count for a short while.
+ */
 void
 nv40_counter_poll(struct drm_device *dev)
 {
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
 	struct nouveau_pm_counter *counter = &dev_priv->engine.pm.counter;
 	unsigned long flags;
-	bool exit = 0;
+	bool exit, stale;
 
 	/* do not poll if continuous polling is done */
 	spin_lock_irqsave(&counter->counter_lock, flags);
-	if (counter->periodic_polling)
-		exit = 1;
+	exit = counter->periodic_polling;
+	stale = !counter->programmed ||
+		jiffies - counter->last_readout > NV40_COUNTER_MAX_AGE;
 	spin_unlock_irqrestore(&counter->counter_lock, flags);
 	if (exit)
 		return;
 
-	nv40_counter_reprogram(dev);
-	msleep(100);
+	if (stale) {
+		nv40_counter_reprogram(dev);
+		msleep(NV40_COUNTER_POLL_MS);
+	}
 	pcounter_counters_readout(dev);
 }
 
 static void
-pcounter_counters_readout_periodic(unsigned long data)
+nv40_counter_timer_start(struct nouveau_pm_counter *counter)
 {
-	struct drm_device *dev = (struct drm_device *)data;
-	pcounter_counters_readout(dev);
+#ifdef __linux__
+	hrtimer_start(&counter->readout_timer,
+		      ns_to_ktime(counter->period_us * 1000ULL),
+		      HRTIMER_MODE_REL);
+#else
+	mod_timer(&counter->readout_timer,
+		  jiffies + nv40_counter_period(counter));
+#endif
 }
 
 void
@@ -329,13 +415,11 @@ nv40_counter_start(struct drm_device *dev)
 
 	nv40_counter_reprogram(dev);
 
-	/* does it need to be atomic? */
 	spin_lock_irqsave(&counter->counter_lock, flags);
-
 	counter->periodic_polling = 1;
-	mod_timer(&counter->readout_timer, jiffies + (HZ / 10));
-
 	spin_unlock_irqrestore(&counter->counter_lock, flags);
+
+	nv40_counter_timer_start(counter);
 }
 
 void
@@ -346,11 +430,83 @@ nv40_counter_stop(struct drm_device *dev)
 	unsigned long flags;
 
 	spin_lock_irqsave(&counter->counter_lock, flags);
-
 	counter->periodic_polling = 0;
+	spin_unlock_irqrestore(&counter->counter_lock, flags);
 
+	/* the readout takes counter_lock, so not under it */
+#ifdef __linux__
+	hrtimer_cancel(&counter->readout_timer);
+#else
 	del_timer_sync(&counter->readout_timer);
+#endif
+}
+
+/*
+ * Switches to the signals, period and ring of the perfmon ioctl, taking
+ * over the GEM reference to the ring; no signals goes back to what the
+ * driver watches, and to periodic polling if it was on before. Signals
+ * can't take the slots of the ones the driver watches, -EBUSY leaves
+ * everything as it was and the ring to the caller.
+ */
+int
+nv40_counter_configure(struct drm_device *dev, u8 signals[8][4],
+		       u32 period_us, struct pscnv_bo *ring)
+{
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	struct nouveau_pm_counter *counter = &dev_priv->engine.pm.counter;
+	struct drm_pscnv_perf_ring *head;
+	struct pscnv_bo *old;
+	unsigned long flags;
+	bool polling, user;
+
+	spin_lock_irqsave(&counter->counter_lock, flags);
+	polling = counter->periodic_polling;
+	user = counter->user;
+	spin_unlock_irqrestore(&counter->counter_lock, flags);
+
+	nv40_counter_stop(dev);
+
+	spin_lock_irqsave(&counter->counter_lock, flags);
+	if (signals && !nv40_counter_fits(counter, signals)) {
+		spin_unlock_irqrestore(&counter->counter_lock, flags);
+		if (polling)
+			nv40_counter_start(dev);
+		return -EBUSY;
+	}
+	if (!user)
+		counter->polling_before_user = polling;
+	old = counter->ring;
+	counter->ring = ring;
+	counter->ring_head = 0;
+	counter->ring_size = ring ? rounddown_pow_of_two((ring->size -
+		PSCNV_PERF_RING_SAMPLES) / sizeof(struct drm_pscnv_perf_sample)) : 0;
+	counter->user = signals != NULL;
+	if (signals)
+		memcpy(counter->user_signals, signals, sizeof counter->user_signals);
+	if (period_us)
+		counter->period_us = period_us < PSCNV_PERFMON_PERIOD_MIN ?
+			PSCNV_PERFMON_PERIOD_MIN : period_us;
+	counter->programmed = false;
 	spin_unlock_irqrestore(&counter->counter_lock, flags);
+
+	if (old)
+		drm_gem_object_unreference_unlocked(old->gem);
+
+	if (!signals) {
+		if (user ? counter->polling_before_user : polling)
+			nv40_counter_start(dev);
+		return 0;
+	}
+
+	if (ring) {
+		head = nv40_counter_ring_ptr(ring, 0);
+		head->head = 0;
+		head->size = counter->ring_size;
+		head->period_us = counter->period_us;
+	}
+	if (period_us)
+		nv40_counter_start(dev);
+	return 0;
 }
 
 int
@@ -361,9 +517,13 @@ nv40_counter_value(struct drm_device *dev, enum nouveau_counter_signal signal,
 	struct nouveau_pm_counter *counter = &dev_priv->engine.pm.counter;
 	unsigned long flags;
 	u8 set, sig, i;
+	int ret;
 
-	nv40_counter_signal(dev, signal, &set, &sig);
+	ret = nv40_counter_signal(dev, signal, &set, &sig);
+	if (ret)
+		return ret;
 
+	/* the driver's signals are always counted, in their own slots */
 	spin_lock_irqsave(&counter->counter_lock, flags);
 	for (i = 0; i < 4; i++) {
 		if (counter->signals[set][i] == sig) {
@@ -3,13 +3,13 @@
 #include "nv50_chan.h"
 #include "pscnv_chan.h"
 #include "nv50_vm.h"
+#include "pscnv_fifo.h"
 
 static int nv50_chan_new (struct pscnv_chan *ch) {
 	struct pscnv_vspace *vs = ch->vspace;
 	struct drm_nouveau_private *dev_priv = ch->dev->dev_private;
 	uint64_t size;
 	uint32_t chan_pd;
-	unsigned long flags;
 	int i;
 	/* determine size of underlying VO... for normal channels,
 	 * allocate 64kiB since they have to store the objects
@@ -26,10 +26,14 @@ static int nv50_chan_new (struct pscnv_chan *ch) {
 			0, (ch->cid == -1 ? 0xc5a2ba7 : 0xc5a2f1f0));
 	if (!ch->bo)
 		return -ENOMEM;
+	/* two bits per 16-byte unit: used, and start of an object */
+	ch->instmap = kzalloc(2 * NV50_IOBJ_MAP_WORDS(ch->bo->size) * 4, GFP_KERNEL);
+	if (!ch->instmap) {
+		pscnv_mem_free(ch->bo);
+		return -ENOMEM;
+	}
 
-	spin_lock_irqsave(&dev_priv->chan->ch_lock, flags);
-	ch->handle = ch->bo->start >> 12;
-	spin_unlock_irqrestore(&dev_priv->chan->ch_lock, flags);
+	pscnv_chan_set_handle(ch, ch->bo->start >> 12);
 
 	if (vs->vid != -1)
 		dev_priv->vm->map_kernel(ch->bo);
@@ -53,12 +57,12 @@ static int nv50_chan_new (struct pscnv_chan *ch) {
 	ch->instpos = chan_pd + NV50_VM_PDE_COUNT * 8;
 
 	if (ch->cid >= 0) {
-		int i;
-		ch->ramht.bo = ch->bo;
-		ch->ramht.bits = 9;
-		ch->ramht.offset = nv50_chan_iobj_new(ch, 8 << ch->ramht.bits);
-		for (i = 0; i < (8 << ch->ramht.bits); i += 8)
-			nv_wv32(ch->ramht.bo, ch->ramht.offset + i + 4, 0);
+		if (pscnv_ramht_init(&ch->ramht, ch->bo, nv50_chan_iobj_new(ch, 8 << 9), 9)) {
+			pscnv_chan_set_handle(ch, 0);
+			kfree(ch->instmap);
+			pscnv_mem_free(ch->bo);
+			return -ENOMEM;
+		}
 
 		if (dev_priv->chipset == 0x50) {
 			ch->ramfc = 0;
@@ -71,9 +75,9 @@ static int nv50_chan_new (struct pscnv_chan *ch) {
 			ch->cache = pscnv_mem_alloc(vs->dev, 0x1000, PSCNV_GEM_CONTIG,
 					0, 0xf1f0cace);
 			if (!ch->cache) {
-				spin_lock_irqsave(&dev_priv->chan->ch_lock, flags);
-				ch->handle = 0;
-				spin_unlock_irqrestore(&dev_priv->chan->ch_lock, flags);
+				pscnv_ramht_takedown(&ch->ramht);
+				pscnv_chan_set_handle(ch, 0);
+				kfree(ch->instmap);
 				pscnv_mem_free(ch->bo);
 				return -ENOMEM;
 			}
@@ -88,33 +92,119 @@ static int nv50_chan_new (struct pscnv_chan *ch) {
 	return 0;
 }
 
+/*
+ * Instance objects live in the channel's own VO after the page directory,
+ * in 16-byte units. instmap holds a used bitmap followed by a bitmap of
+ * object starts, which is all that's needed to find an object's size
+ * again when it's freed. Allocation is first fit: there are at most a few
+ * thousand units and the objects are tiny, so nothing smarter pays off.
+ */
+
+static inline int nv50_iobj_test(uint32_t *map, int i) {
+	return map[i >> 5] >> (i & 31) & 1;
+}
+
+static inline void nv50_iobj_set(uint32_t *map, int i, int val) {
+	if (val)
+		map[i >> 5] |= 1u << (i & 31);
+	else
+		map[i >> 5] &= ~(1u << (i & 31));
+}
+
 int
 nv50_chan_iobj_new(struct pscnv_chan *ch, uint32_t size) {
-	/* XXX: maybe do this "properly" one day?
-	 *
-	 * Why we don't implement _del for instance objects:
-	 *  - Usually, bounded const number of them is allocated
-	 *    for any given channel, and the used set doesn't change
-	 *    much during channel's lifetime
-	 *  - Since instance objects are stored inside the main
-	 *    VO of the channel, the storage will be freed on channel
-	 *    close anyway
-	 *  - We cannot easily tell what objects are currently in use
-	 *    by PGRAPH and maybe other execution engines -- the user
-	 *    could cheat us. Caching doesn't help either.
-	 */
-	int res;
-	size += 0xf;
-	size &= ~0xf;
-	spin_lock(&ch->instlock);
-	if (ch->instpos + size > ch->bo->size) {
-		spin_unlock(&ch->instlock);
+	int units = (size + 0xf) >> 4;
+	int total = ch->bo->size >> 4;
+	uint32_t *used = ch->instmap;
+	uint32_t *first = ch->instmap + NV50_IOBJ_MAP_WORDS(ch->bo->size);
+	unsigned long flags;
+	int start, i;
+	spin_lock_irqsave(&ch->instlock, flags);
+	for (start = ch->instpos >> 4; start + units <= total; start = i + 1) {
+		for (i = start; i < start + units; i++)
+			if (nv50_iobj_test(used, i))
+				break;
+		if (i == start + units)
+			break;
+	}
+	if (start + units > total) {
+		spin_unlock_irqrestore(&ch->instlock, flags);
 		return 0;
 	}
-	res = ch->instpos;
-	ch->instpos += size;
-	spin_unlock(&ch->instlock);
-	return res;
+	for (i = start; i < start + units; i++)
+		nv50_iobj_set(used, i, 1);
+	nv50_iobj_set(first, start, 1);
+	spin_unlock_irqrestore(&ch->instlock, flags);
+	return start << 4;
+}
+
+void
+nv50_chan_iobj_free(struct pscnv_chan *ch, uint32_t inst) {
+	int total = ch->bo->size >> 4;
+	uint32_t *used = ch->instmap;
+	uint32_t *first = ch->instmap + NV50_IOBJ_MAP_WORDS(ch->bo->size);
+	unsigned long flags;
+	int i = inst >> 4;
+	spin_lock_irqsave(&ch->instlock, flags);
+	if ((inst & 0xf) || i >= total || !nv50_iobj_test(first, i)) {
+		spin_unlock_irqrestore(&ch->instlock, flags);
+		NV_ERROR(ch->dev, "CHAN: freeing bogus instance object %x on channel %d\n", inst, ch->cid);
+		return;
+	}
+	nv50_iobj_set(first, i, 0);
+	do {
+		nv50_iobj_set(used, i, 0);
+		nv_wv32(ch->bo, i << 4, 0);
+		nv_wv32(ch->bo, (i << 4) + 4, 0);
+		nv_wv32(ch->bo, (i << 4) + 8, 0);
+		nv_wv32(ch->bo, (i << 4) + 0xc, 0);
+		i++;
+	} while (i < total && nv50_iobj_test(used, i) && !nv50_iobj_test(first, i));
+	spin_unlock_irqrestore(&ch->instlock, flags);
+}
+
+/*
+ * Drops an object created by OBJ_VDMA_NEW or an engine's chan_obj_new,
+ * once neither PFIFO nor any of the channel's engines can be using it.
+ * PFIFO's puller is stopped for the checks and the free, and the engines
+ * can't switch channels without context_switch_lock, so nothing can
+ * start on the channel's work in between. Work submitted after the
+ * free was asked for is the caller's business. So are subchannels
+ * still bound to the object: the memory is zeroed, so they fault until
+ * bound again, and it's only ever reused for this channel's objects.
+ */
+int
+nv50_chan_obj_free(struct pscnv_chan *ch, uint32_t handle) {
+	struct drm_device *dev = ch->dev;
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	unsigned long flags;
+	uint32_t inst, pull;
+	int i, ret = 0;
+	spin_lock_irqsave(&dev_priv->context_switch_lock, flags);
+	inst = (pscnv_ramht_find(&ch->ramht, handle) & 0xfffff) << 4;
+	if (!inst) {
+		spin_unlock_irqrestore(&dev_priv->context_switch_lock, flags);
+		return -ENOENT;
+	}
+	pull = nv_rd32(dev, 0x3250);
+	nv_wr32(dev, 0x3250, pull & ~1);
+	if (dev_priv->fifo->chan_obj_free)
+		ret = dev_priv->fifo->chan_obj_free(ch, inst);
+	for (i = 0; !ret && i < PSCNV_ENGINES_NUM; i++) {
+		struct pscnv_engine *eng = dev_priv->engines[i];
+		if (!ch->engdata[i] || !eng->chan_obj_free)
+			continue;
+		ret = eng->chan_obj_free(eng, ch, inst);
+	}
+	if (!ret)
+		ret = pscnv_ramht_remove(&ch->ramht, handle);
+	if (!ret) {
+		nv50_chan_iobj_free(ch, inst);
+		dev_priv->vm->bar_flush(dev);
+	}
+	nv_wr32(dev, 0x3250, pull);
+	spin_unlock_irqrestore(&dev_priv->context_switch_lock, flags);
+	return ret;
 }
 
 /* XXX: we'll possibly want to break down type and/or add mysterious flags5
@@ -140,11 +230,10 @@ nv50_chan_dmaobj_new(struct pscnv_chan *ch, uint32_t type, uint64_t start, uint6
 }
 
 static void nv50_chan_free(struct pscnv_chan *ch) {
-	struct drm_nouveau_private *dev_priv = ch->dev->dev_private;
-	unsigned long flags;
-	spin_lock_irqsave(&dev_priv->chan->ch_lock, flags);
-	ch->handle = 0;
-	spin_unlock_irqrestore(&dev_priv->chan->ch_lock, flags);
+	pscnv_chan_set_handle(ch, 0);
+	pscnv_ramht_takedown(&ch->ramht);
+	kfree(ch->instmap);
+	ch->instmap = NULL;
 	pscnv_mem_free(ch->bo);
 	ch->bo = NULL;
 	if (ch->cache)
@@ -13,7 +13,11 @@ struct nv50_chan_engine {
 	struct pscnv_chan_engine base;
 };
 
+#define NV50_IOBJ_MAP_WORDS(size) ((((size) >> 4) + 31) >> 5)
+
 extern int nv50_chan_iobj_new(struct pscnv_chan *, uint32_t size);
+extern void nv50_chan_iobj_free(struct pscnv_chan *, uint32_t inst);
+extern int nv50_chan_obj_free(struct pscnv_chan *, uint32_t handle);
 extern int nv50_chan_dmaobj_new(struct pscnv_chan *, uint32_t type, uint64_t start, uint64_t size);
 
 #endif /* __NV50_CHAN_H__ */
@@ -83,6 +83,7 @@ nv50_evo_channel_del(struct nouveau_channel **pchan)
 		pscnv_mem_free(chan->pushbuf);
 	if (chan->evo_obj)
 		pscnv_mem_free(chan->evo_obj);
+	pscnv_ramht_takedown(&chan->evo_ramht);
 
 	kfree(chan);
 }
@@ -128,7 +129,6 @@ nv50_evo_channel_new(struct drm_device *dev, struct nouveau_channel **pchan)
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
 	struct nouveau_channel *chan;
 	int ret;
-	int i;
 
 	chan = kzalloc(sizeof(struct nouveau_channel), GFP_KERNEL);
 	if (!chan)
@@ -147,13 +147,13 @@ nv50_evo_channel_new(struct drm_device *dev, struct nouveau_channel **pchan)
 		return -ENOMEM;
 	}
 	spin_lock_init(&chan->evo_ramht.lock);
-	chan->evo_ramht.bo = chan->evo_obj;
-	chan->evo_ramht.bits = 9;
-	chan->evo_ramht.offset = 0;
 	chan->evo_inst = 0x1000;
 	dev_priv->vm->map_kernel(chan->evo_obj);
-	for (i = 0; i < 0x1000; i += 4)
-		nv_wv32(chan->evo_obj, i, 0);
+	ret = pscnv_ramht_init(&chan->evo_ramht, chan->evo_obj, 0, 9);
+	if (ret) {
+		nv50_evo_channel_del(pchan);
+		return ret;
+	}
 
 	if (dev_priv->chipset >= 0xc0) {
 		ret = nv50_evo_dmaobj_new(chan, 0x3d, NvEvoFE, 0xfe, 0x19,
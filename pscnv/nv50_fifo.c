@@ -29,11 +29,17 @@
 #include "pscnv_chan.h"
 #include "pscnv_fifo.h"
 #include "nv50_vm.h"
+#include "pscnv_sched.h"
+#include "pscnv_fence.h"
 
 struct nv50_fifo_engine {
 	struct pscnv_fifo_engine base;
 	struct pscnv_bo *playlist[2];
 	int cur_playlist;
+	/* scratch for playlist_update, protected by context_switch_lock */
+	int pl_prio[128];
+	int pl_cur[128];
+	int pl_cids[0x1000 / 4];
 };
 
 #define nv50_fifo(x) container_of(x, struct nv50_fifo_engine, base)
@@ -43,6 +49,9 @@ static void nv50_fifo_irq_handler(struct drm_device *dev, int irq);
 static int nv50_fifo_chan_init_dma (struct pscnv_chan *ch, uint32_t pb_handle, uint32_t flags, uint32_t slimask, uint64_t pb_start);
 static int nv50_fifo_chan_init_ib (struct pscnv_chan *ch, uint32_t pb_handle, uint32_t flags, uint32_t slimask, uint64_t ib_start, uint32_t ib_order);
 static void nv50_fifo_chan_kill(struct pscnv_chan *ch);
+static int nv50_fifo_chan_sched(struct pscnv_chan *ch, int priority, uint32_t timeslice);
+static int nv50_fifo_chan_busy(struct pscnv_chan *ch);
+static int nv50_fifo_chan_obj_free(struct pscnv_chan *ch, uint32_t inst);
 
 int nv50_fifo_init(struct drm_device *dev) {
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
@@ -58,6 +67,9 @@ int nv50_fifo_init(struct drm_device *dev) {
 	res->base.chan_kill = nv50_fifo_chan_kill;
 	res->base.chan_init_dma = nv50_fifo_chan_init_dma;
 	res->base.chan_init_ib = nv50_fifo_chan_init_ib;
+	res->base.chan_sched = nv50_fifo_chan_sched;
+	res->base.chan_busy = nv50_fifo_chan_busy;
+	res->base.chan_obj_free = nv50_fifo_chan_obj_free;
 
 	res->playlist[0] = pscnv_mem_alloc(dev, 0x1000, PSCNV_GEM_CONTIG, 0, 0x91a71157);
 	res->playlist[1] = pscnv_mem_alloc(dev, 0x1000, PSCNV_GEM_CONTIG, 0, 0x91a71157);
@@ -106,6 +118,29 @@ int nv50_fifo_init(struct drm_device *dev) {
 	return 0;
 }
 
+/* GET hasn't caught up with PUT, for DMA or IB */
+static int nv50_fifo_chan_busy(struct pscnv_chan *ch) {
+	struct drm_device *dev = ch->dev;
+	uint32_t user = 0xc00000 + ch->cid * 0x2000;
+	return nv_rd32(dev, user + 0x40) != nv_rd32(dev, user + 0x44) ||
+		nv_rd32(dev, user + 0x88) != nv_rd32(dev, user + 0x8c);
+}
+
+/* Called by nv50_chan_obj_free with the puller stopped. RAMFC points at
+ * the pushbuffer's DMA object for as long as the channel lives, and any
+ * other object may still be named by methods PFIFO hasn't handed out. */
+static int nv50_fifo_chan_obj_free(struct pscnv_chan *ch, uint32_t inst) {
+	struct drm_device *dev = ch->dev;
+	if ((nv_rv32(ch->bo, ch->ramfc + 0x48) & 0xfffff) == inst >> 4)
+		return -EBUSY;
+	if (nv50_fifo_chan_busy(ch))
+		return -EBUSY;
+	if ((nv_rd32(dev, 0x3204) & 0x7f) == ch->cid &&
+	    nv_rd32(dev, 0x3210) != nv_rd32(dev, 0x3270))
+		return -EBUSY;
+	return 0;
+}
+
 static void nv50_fifo_takedown(struct drm_device *dev) {
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
 	int i;
@@ -125,15 +160,18 @@ static void nv50_fifo_takedown(struct drm_device *dev) {
 static void nv50_fifo_playlist_update (struct drm_device *dev) {
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
 	struct nv50_fifo_engine *fifo = nv50_fifo(dev_priv->fifo);
-	int i, pos;
+	int i, n, pos;
 	struct pscnv_bo *vo;
 	fifo->cur_playlist ^= 1;
 	vo = fifo->playlist[fifo->cur_playlist];
-	for (i = 0, pos = 0; i < 128; i++) {
-		if (nv_rd32(dev, 0x2600 + i * 4) & 0x80000000) {
-			nv_wv32(vo, pos, i);
-			pos += 4;
-		}
+	for (i = 0; i < 128; i++)
+		fifo->pl_prio[i] = (nv_rd32(dev, 0x2600 + i * 4) & 0x80000000) ? 0 : -1;
+	pscnv_chan_sched_prio(dev, fifo->pl_prio);
+	n = pscnv_sched_build_playlist(fifo->pl_prio, fifo->pl_cur, 128, fifo->pl_cids,
+			ARRAY_SIZE(fifo->pl_cids));
+	for (i = 0, pos = 0; i < n; i++) {
+		nv_wv32(vo, pos, fifo->pl_cids[i]);
+		pos += 4;
 	}
 	dev_priv->vm->bar_flush(dev);
 	/* XXX: is this correct? is this non-racy? */
@@ -174,6 +212,23 @@ static void nv50_fifo_chan_kill(struct pscnv_chan *ch) {
 	spin_unlock_irqrestore(&dev_priv->context_switch_lock, flags);
 }
 
+static int nv50_fifo_chan_sched(struct pscnv_chan *ch, int priority, uint32_t timeslice) {
+	struct drm_device *dev = ch->dev;
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	unsigned long flags;
+	/* XXX: no idea where NV50 keeps its timeslice, only priorities. */
+	if (timeslice)
+		return -EINVAL;
+	spin_lock_irqsave(&dev_priv->chan->ch_lock, flags);
+	ch->priority = priority;
+	spin_unlock_irqrestore(&dev_priv->chan->ch_lock, flags);
+	spin_lock_irqsave(&dev_priv->context_switch_lock, flags);
+	if (nv_rd32(dev, 0x2600 + ch->cid * 4) & 0x80000000)
+		nv50_fifo_playlist_update(dev);
+	spin_unlock_irqrestore(&dev_priv->context_switch_lock, flags);
+	return 0;
+}
+
 static int nv50_fifo_chan_init_dma (struct pscnv_chan *ch, uint32_t pb_handle, uint32_t flags, uint32_t slimask, uint64_t pb_start) {
 	struct drm_device *dev = ch->dev;
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
@@ -183,6 +238,7 @@ static int nv50_fifo_chan_init_dma (struct pscnv_chan *ch, uint32_t pb_handle, u
 	/* XXX: verify that we get a DMA object. */
 	pb_inst = pscnv_ramht_find(&ch->ramht, pb_handle);
 	if (!pb_inst || pb_inst & 0xffff0000) {
+		NV_ERROR(dev, "PFIFO: ch %d: pushbuffer object %x not found\n", ch->cid, pb_handle);
 		return -ENOENT;
 	}
 
@@ -251,6 +307,7 @@ static int nv50_fifo_chan_init_ib (struct pscnv_chan *ch, uint32_t pb_handle, ui
 	/* XXX: verify that we get a DMA object. */
 	pb_inst = pscnv_ramht_find(&ch->ramht, pb_handle);
 	if (!pb_inst || pb_inst & 0xffff0000) {
+		NV_ERROR(dev, "PFIFO: ch %d: pushbuffer object %x not found\n", ch->cid, pb_handle);
 		pscnv_chan_unref(ch);
 		return -ENOENT;
 	}
@@ -443,6 +500,12 @@ static void nv50_fifo_irq_handler(struct drm_device *dev, int irq) {
 		nv_wr32(dev, 0x2100, 0x00100000);
 		status &= ~0x00100000;
 	}
+	if (status & 0x40000000) {
+		/* nonstall interrupt, raised by method 0x20 for fences */
+		nv_wr32(dev, 0x2100, 0x40000000);
+		pscnv_fence_signal(dev);
+		status &= ~0x40000000;
+	}
 	if (status) {
 		NV_ERROR(dev, "Unknown PFIFO interrupt %08x\n", status);
 		nv_wr32(dev, 0x2100, status);
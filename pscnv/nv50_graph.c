@@ -31,6 +31,7 @@
 #include "pscnv_chan.h"
 #include "nv50_chan.h"
 #include "nv50_vm.h"
+#include "pscnv_trap.h"
 
 struct nv50_graph_engine {
 	struct pscnv_engine base;
@@ -146,6 +147,7 @@ int nv50_graph_chan_alloc(struct pscnv_engine *eng, struct pscnv_chan *ch);
 void nv50_graph_chan_free(struct pscnv_engine *eng, struct pscnv_chan *ch);
 void nv50_graph_chan_kill(struct pscnv_engine *eng, struct pscnv_chan *ch);
 int nv50_graph_chan_obj_new(struct pscnv_engine *eng, struct pscnv_chan *ch, uint32_t handle, uint32_t oclass, uint32_t flags);
+int nv50_graph_chan_obj_free(struct pscnv_engine *eng, struct pscnv_chan *ch, uint32_t inst);
 
 int nv50_graph_init(struct drm_device *dev) {
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
@@ -181,6 +183,7 @@ int nv50_graph_init(struct drm_device *dev) {
 	res->base.chan_kill = nv50_graph_chan_kill;
 	res->base.chan_free = nv50_graph_chan_free;
 	res->base.chan_obj_new = nv50_graph_chan_obj_new;
+	res->base.chan_obj_free = nv50_graph_chan_obj_free;
 
 	/* reset everything */
 	nv_wr32(dev, 0x200, 0xffffefff);
@@ -398,6 +401,7 @@ void nv50_graph_chan_free(struct pscnv_engine *eng, struct pscnv_chan *ch) {
 }
 
 int nv50_graph_chan_obj_new(struct pscnv_engine *eng, struct pscnv_chan *ch, uint32_t handle, uint32_t oclass, uint32_t flags) {
+	int ret;
 	uint32_t inst = nv50_chan_iobj_new(ch, 0x10);
 	if (!inst) {
 		return -ENOMEM;
@@ -406,7 +410,22 @@ int nv50_graph_chan_obj_new(struct pscnv_engine *eng, struct pscnv_chan *ch, uin
 	nv_wv32(ch->bo, inst + 4, 0);
 	nv_wv32(ch->bo, inst + 8, 0);
 	nv_wv32(ch->bo, inst + 0xc, 0);
-	return pscnv_ramht_insert (&ch->ramht, handle, 0x100000 | inst >> 4);
+	ret = pscnv_ramht_insert (&ch->ramht, handle, 0x100000 | inst >> 4);
+	if (ret)
+		nv50_chan_iobj_free(ch, inst);
+	return ret;
+}
+
+/* Objects are only looked up while PGRAPH runs methods of the channel.
+ * With PFIFO stopped nothing new arrives, so they're free to go once the
+ * channel is neither loaded with PGRAPH busy nor about to be loaded. */
+int nv50_graph_chan_obj_free(struct pscnv_engine *eng, struct pscnv_chan *ch, uint32_t inst) {
+	struct drm_device *dev = eng->dev;
+	uint32_t chan = 0x80000000 | ch->bo->start >> 12;
+	if ((nv_rd32(dev, 0x40032c) == chan && nv_rd32(dev, 0x400700)) ||
+	    nv_rd32(dev, 0x400330) == chan)
+		return -EBUSY;
+	return 0;
 }
 
 struct pscnv_enumval {
@@ -479,7 +498,7 @@ static struct pscnv_enumval *pscnv_enum_find (struct pscnv_enumval *list, int va
 		return 0;
 }
 
-static void nv50_graph_tex_trap(struct drm_device *dev, int cid, int tp) {
+static void nv50_graph_tex_trap(struct drm_device *dev, struct pscnv_trap *t, int cid, int tp) {
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
 	uint32_t staddr, status;
 	uint32_t e04, e08, e0c, e10;
@@ -488,140 +507,140 @@ static void nv50_graph_tex_trap(struct drm_device *dev, int cid, int tp) {
 		staddr = 0x408900 + tp * 0x1000;
 	else
 		staddr = 0x408600 + tp * 0x800;
-	status = nv_rd32(dev, staddr) & 0x7fffffff;
-	e04 = nv_rd32(dev, staddr + 4);
-	e08 = nv_rd32(dev, staddr + 8);
-	e0c = nv_rd32(dev, staddr + 0xc);
-	e10 = nv_rd32(dev, staddr + 0x10);
+	status = TRAP_RD(dev, t, staddr) & 0x7fffffff;
+	e04 = TRAP_RD(dev, t, staddr + 4);
+	e08 = TRAP_RD(dev, t, staddr + 8);
+	e0c = TRAP_RD(dev, t, staddr + 0xc);
+	e10 = TRAP_RD(dev, t, staddr + 0x10);
 	addr = (uint64_t)e08 << 8;
 	if (!(status & 1)) { // seems always set...
-		NV_ERROR(dev, "PGRAPH_TRAP_TEXTURE: ch %d TP %d status %08x [no 1!]\n", cid, tp, status);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_TEXTURE: ch %d TP %d status %08x [no 1!]\n", cid, tp, status);
 	}
 	status &= ~1;
 	if (status & 2) {
-		NV_ERROR(dev, "PGRAPH_TRAP_TEXTURE: ch %d TP %d FAULT at %llx\n", cid, tp, addr);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_TEXTURE: ch %d TP %d FAULT at %llx\n", cid, tp, addr);
 		status &= ~2;
 	}
 	if (status & 4) {
-		NV_ERROR(dev, "PGRAPH_TRAP_TEXTURE: ch %d TP %d STORAGE_TYPE_MISMATCH type %02x\n", cid, tp, e10 >> 5 & 0x7f);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_TEXTURE: ch %d TP %d STORAGE_TYPE_MISMATCH type %02x\n", cid, tp, e10 >> 5 & 0x7f);
 		status &= ~4;
 	}
 	if (status & 8) {
-		NV_ERROR(dev, "PGRAPH_TRAP_TEXTURE: ch %d TP %d LINEAR_MISMATCH type %02x\n", cid, tp, e10 >> 5 & 0x7f);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_TEXTURE: ch %d TP %d LINEAR_MISMATCH type %02x\n", cid, tp, e10 >> 5 & 0x7f);
 		status &= ~8;
 	}
 	if (status & 0x20) {
-		NV_ERROR(dev, "PGRAPH_TRAP_TEXTURE: ch %d TP %d WRONG_MEMTYPE type %02x\n", cid, tp, e10 >> 5 & 0x7f);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_TEXTURE: ch %d TP %d WRONG_MEMTYPE type %02x\n", cid, tp, e10 >> 5 & 0x7f);
 		status &= ~0x20;
 	}
 	if (status) {
-		NV_ERROR(dev, "PGRAPH_TRAP_TEXTURE: ch %d TP %d status %08x\n", cid, tp, status);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_TEXTURE: ch %d TP %d status %08x\n", cid, tp, status);
 	}
-	NV_ERROR(dev, "magic: %08x %08x %08x %08x\n", e04, e08, e0c, e10);
-	nv_wr32(dev, staddr, 0xc0000000);
+	TRAP_ERROR(dev, t, "magic: %08x %08x %08x %08x\n", e04, e08, e0c, e10);
+	TRAP_WR(dev, t, staddr, 0xc0000000);
 }
 
-static void nv50_graph_mp_trap(struct drm_device *dev, int cid, int tp, int mp) {
+static void nv50_graph_mp_trap(struct drm_device *dev, struct pscnv_trap *t, int cid, int tp, int mp) {
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
 	uint32_t mpaddr, mp10, status, pc, oplo, ophi;
 	if (dev_priv->chipset < 0xa0)
 		mpaddr = 0x408200 + tp * 0x1000 + mp * 0x80;
 	else
 		mpaddr = 0x408100 + tp * 0x800 + mp * 0x80;
-	mp10 = nv_rd32(dev, mpaddr + 0x10);
-	status = nv_rd32(dev, mpaddr + 0x14);
-	nv_rd32(dev, mpaddr + 0x20);
-	pc = nv_rd32(dev, mpaddr + 0x24);
-	oplo = nv_rd32(dev, mpaddr + 0x70);
-	ophi = nv_rd32(dev, mpaddr + 0x74);
+	mp10 = TRAP_RD(dev, t, mpaddr + 0x10);
+	status = TRAP_RD(dev, t, mpaddr + 0x14);
+	TRAP_RD(dev, t, mpaddr + 0x20);
+	pc = TRAP_RD(dev, t, mpaddr + 0x24);
+	oplo = TRAP_RD(dev, t, mpaddr + 0x70);
+	ophi = TRAP_RD(dev, t, mpaddr + 0x74);
 	if (!status)
 		return;
 	if (status & 1) {
-		NV_ERROR(dev, "PGRAPH_TRAP_MP: ch %d TP %d MP %d STACK_UNDERFLOW at %06x warp %d op %08x %08x\n", cid, tp, mp, pc & 0xffffff, pc >> 24, oplo, ophi);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_MP: ch %d TP %d MP %d STACK_UNDERFLOW at %06x warp %d op %08x %08x\n", cid, tp, mp, pc & 0xffffff, pc >> 24, oplo, ophi);
 		status &= ~1;
 	}
 	if (status & 2) {
-		NV_ERROR(dev, "PGRAPH_TRAP_MP: ch %d TP %d MP %d STACK_MISMATCH at %06x warp %d op %08x %08x\n", cid, tp, mp, pc & 0xffffff, pc >> 24, oplo, ophi);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_MP: ch %d TP %d MP %d STACK_MISMATCH at %06x warp %d op %08x %08x\n", cid, tp, mp, pc & 0xffffff, pc >> 24, oplo, ophi);
 		status &= ~2;
 	}
 	if (status & 4) {
-		NV_ERROR(dev, "PGRAPH_TRAP_MP: ch %d TP %d MP %d QUADON_ACTIVE at %06x warp %d op %08x %08x\n", cid, tp, mp, pc & 0xffffff, pc >> 24, oplo, ophi);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_MP: ch %d TP %d MP %d QUADON_ACTIVE at %06x warp %d op %08x %08x\n", cid, tp, mp, pc & 0xffffff, pc >> 24, oplo, ophi);
 		status &= ~4;
 	}
 	if (status & 8) {
-		NV_ERROR(dev, "PGRAPH_TRAP_MP: ch %d TP %d MP %d TIMEOUT at %06x warp %d op %08x %08x\n", cid, tp, mp, pc & 0xffffff, pc >> 24, oplo, ophi);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_MP: ch %d TP %d MP %d TIMEOUT at %06x warp %d op %08x %08x\n", cid, tp, mp, pc & 0xffffff, pc >> 24, oplo, ophi);
 		status &= ~8;
 	}
 	if (status & 0x10) {
-		NV_ERROR(dev, "PGRAPH_TRAP_MP: ch %d TP %d MP %d INVALID_OPCODE at %06x warp %d op %08x %08x\n", cid, tp, mp, pc & 0xffffff, pc >> 24, oplo, ophi);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_MP: ch %d TP %d MP %d INVALID_OPCODE at %06x warp %d op %08x %08x\n", cid, tp, mp, pc & 0xffffff, pc >> 24, oplo, ophi);
 		status &= ~0x10;
 	}
 	if (status & 0x40) {
-		NV_ERROR(dev, "PGRAPH_TRAP_MP: ch %d TP %d MP %d BREAKPOINT at %06x warp %d op %08x %08x\n", cid, tp, mp, pc & 0xffffff, pc >> 24, oplo, ophi);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_MP: ch %d TP %d MP %d BREAKPOINT at %06x warp %d op %08x %08x\n", cid, tp, mp, pc & 0xffffff, pc >> 24, oplo, ophi);
 		status &= ~0x40;
 	}
 	if (status) {
-		NV_ERROR(dev, "PGRAPH_TRAP_MP: ch %d TP %d MP %d status %08x at %06x warp %d op %08x %08x\n", cid, tp, mp, status, pc & 0xffffff, pc >> 24, oplo, ophi);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_MP: ch %d TP %d MP %d status %08x at %06x warp %d op %08x %08x\n", cid, tp, mp, status, pc & 0xffffff, pc >> 24, oplo, ophi);
 	}
-	nv_wr32(dev, mpaddr + 0x10, mp10);
-	nv_wr32(dev, mpaddr + 0x14, 0);
+	TRAP_WR(dev, t, mpaddr + 0x10, mp10);
+	TRAP_WR(dev, t, mpaddr + 0x14, 0);
 }
 
-static void nv50_graph_mpc_trap(struct drm_device *dev, int cid, int tp) {
+static void nv50_graph_mpc_trap(struct drm_device *dev, struct pscnv_trap *t, int cid, int tp) {
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
 	uint32_t staddr, status;
 	if (dev_priv->chipset < 0xa0)
 		staddr = 0x408314 + tp * 0x1000;
 	else
 		staddr = 0x40831c + tp * 0x800;
-	status = nv_rd32(dev, staddr) & 0x7fffffff;
+	status = TRAP_RD(dev, t, staddr) & 0x7fffffff;
 	if (status & 1) {
-		NV_ERROR(dev, "PGRAPH_TRAP_MPC: ch %d TP %d LOCAL_LIMIT_READ\n", cid, tp);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_MPC: ch %d TP %d LOCAL_LIMIT_READ\n", cid, tp);
 		status &= ~1;
 	}
 	if (status & 0x10) {
-		NV_ERROR(dev, "PGRAPH_TRAP_MPC: ch %d TP %d LOCAL_LIMIT_WRITE\n", cid, tp);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_MPC: ch %d TP %d LOCAL_LIMIT_WRITE\n", cid, tp);
 		status &= ~0x10;
 	}
 	if (status & 0x40) {
-		NV_ERROR(dev, "PGRAPH_TRAP_MPC: ch %d TP %d STACK_LIMIT\n", cid, tp);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_MPC: ch %d TP %d STACK_LIMIT\n", cid, tp);
 		status &= ~0x40;
 	}
 	if (status & 0x100) {
-		NV_ERROR(dev, "PGRAPH_TRAP_MPC: ch %d TP %d GLOBAL_LIMIT_READ\n", cid, tp);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_MPC: ch %d TP %d GLOBAL_LIMIT_READ\n", cid, tp);
 		status &= ~0x100;
 	}
 	if (status & 0x1000) {
-		NV_ERROR(dev, "PGRAPH_TRAP_MPC: ch %d TP %d GLOBAL_LIMIT_WRITE\n", cid, tp);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_MPC: ch %d TP %d GLOBAL_LIMIT_WRITE\n", cid, tp);
 		status &= ~0x1000;
 	}
 	if (status & 0x10000) {
-		nv50_graph_mp_trap(dev, cid, tp, 0);
+		nv50_graph_mp_trap(dev, t, cid, tp, 0);
 		status &= ~0x10000;
 	}
 	if (status & 0x20000) {
-		nv50_graph_mp_trap(dev, cid, tp, 1);
+		nv50_graph_mp_trap(dev, t, cid, tp, 1);
 		status &= ~0x20000;
 	}
 	if (status & 0x40000) {
-		NV_ERROR(dev, "PGRAPH_TRAP_MPC: ch %d TP %d GLOBAL_LIMIT_RED\n", cid, tp);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_MPC: ch %d TP %d GLOBAL_LIMIT_RED\n", cid, tp);
 		status &= ~0x40000;
 	}
 	if (status & 0x400000) {
-		NV_ERROR(dev, "PGRAPH_TRAP_MPC: ch %d TP %d GLOBAL_LIMIT_ATOM\n", cid, tp);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_MPC: ch %d TP %d GLOBAL_LIMIT_ATOM\n", cid, tp);
 		status &= ~0x400000;
 	}
 	if (status & 0x4000000) {
-		nv50_graph_mp_trap(dev, cid, tp, 2);
+		nv50_graph_mp_trap(dev, t, cid, tp, 2);
 		status &= ~0x4000000;
 	}
 	if (status) {
-		NV_ERROR(dev, "PGRAPH_TRAP_MPC: ch %d TP %d status %08x\n", cid, tp, status);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_MPC: ch %d TP %d status %08x\n", cid, tp, status);
 	}
-	nv_wr32(dev, staddr, 0xc0000000);
+	TRAP_WR(dev, t, staddr, 0xc0000000);
 }
 
-static void nv50_graph_tprop_trap(struct drm_device *dev, int cid, int tp) {
+static void nv50_graph_tprop_trap(struct drm_device *dev, struct pscnv_trap *t, int cid, int tp) {
 	static const char *const tprop_tnames[14] = {
 		"RT0",
 		"RT1",
@@ -647,207 +666,203 @@ static void nv50_graph_tprop_trap(struct drm_device *dev, int cid, int tp) {
 		staddr = 0x408e08 + tp * 0x1000;
 	else
 		staddr = 0x408708 + tp * 0x800;
-	status = nv_rd32(dev, staddr) & 0x7fffffff;
-	e0c = nv_rd32(dev, staddr + 4);
-	e10 = nv_rd32(dev, staddr + 8);
-	e14 = nv_rd32(dev, staddr + 0xc);
-	e18 = nv_rd32(dev, staddr + 0x10);
-	e1c = nv_rd32(dev, staddr + 0x14);
-	e20 = nv_rd32(dev, staddr + 0x18);
-	e24 = nv_rd32(dev, staddr + 0x1c);
+	status = TRAP_RD(dev, t, staddr) & 0x7fffffff;
+	e0c = TRAP_RD(dev, t, staddr + 4);
+	e10 = TRAP_RD(dev, t, staddr + 8);
+	e14 = TRAP_RD(dev, t, staddr + 0xc);
+	e18 = TRAP_RD(dev, t, staddr + 0x10);
+	e1c = TRAP_RD(dev, t, staddr + 0x14);
+	e20 = TRAP_RD(dev, t, staddr + 0x18);
+	e24 = TRAP_RD(dev, t, staddr + 0x1c);
 	surf = e24 >> 0x18 & 0xf;
 	addr = e10 | (uint64_t)e14 << 32;
 	if (surf > 13)
 		surf = 13;
 	if (status & 0x4) {
-		NV_ERROR(dev, "PGRAPH_TRAP_TPROP: ch %d TP %d surf %s SURF_WIDTH_OVERRUN\n", cid, tp, tprop_tnames[surf]);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_TPROP: ch %d TP %d surf %s SURF_WIDTH_OVERRUN\n", cid, tp, tprop_tnames[surf]);
 		status &= ~0x4;
 	}
 	if (status & 0x8) {
-		NV_ERROR(dev, "PGRAPH_TRAP_TPROP: ch %d TP %d surf %s SURF_HEIGHT_OVERRUN\n", cid, tp, tprop_tnames[surf]);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_TPROP: ch %d TP %d surf %s SURF_HEIGHT_OVERRUN\n", cid, tp, tprop_tnames[surf]);
 		status &= ~0x8;
 	}
 	if (status & 0x10) {
-		NV_ERROR(dev, "PGRAPH_TRAP_TPROP: ch %d TP %d surf %s DST2D_FAULT at %llx\n", cid, tp, tprop_tnames[surf], addr);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_TPROP: ch %d TP %d surf %s DST2D_FAULT at %llx\n", cid, tp, tprop_tnames[surf], addr);
 		status &= ~0x10;
 	}
 	if (status & 0x20) {
-		NV_ERROR(dev, "PGRAPH_TRAP_TPROP: ch %d TP %d surf %s ZETA_FAULT at %llx\n", cid, tp, tprop_tnames[surf], addr);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_TPROP: ch %d TP %d surf %s ZETA_FAULT at %llx\n", cid, tp, tprop_tnames[surf], addr);
 		status &= ~0x20;
 	}
 	if (status & 0x40) {
-		NV_ERROR(dev, "PGRAPH_TRAP_TPROP: ch %d TP %d surf %s RT_FAULT at %llx\n", cid, tp, tprop_tnames[surf], addr);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_TPROP: ch %d TP %d surf %s RT_FAULT at %llx\n", cid, tp, tprop_tnames[surf], addr);
 		status &= ~0x40;
 	}
 	if (status & 0x80) {
-		NV_ERROR(dev, "PGRAPH_TRAP_TPROP: ch %d TP %d surf %s CUDA_FAULT at %llx\n", cid, tp, tprop_tnames[surf], addr);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_TPROP: ch %d TP %d surf %s CUDA_FAULT at %llx\n", cid, tp, tprop_tnames[surf], addr);
 		status &= ~0x80;
 	}
 	if (status & 0x100) {
-		NV_ERROR(dev, "PGRAPH_TRAP_TPROP: ch %d TP %d surf %s DST2D_STORAGE_TYPE_MISMATCH type %02x\n", cid, tp, tprop_tnames[surf], e24 & 0x7f);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_TPROP: ch %d TP %d surf %s DST2D_STORAGE_TYPE_MISMATCH type %02x\n", cid, tp, tprop_tnames[surf], e24 & 0x7f);
 		status &= ~0x100;
 	}
 	if (status & 0x200) {
-		NV_ERROR(dev, "PGRAPH_TRAP_TPROP: ch %d TP %d surf %s ZETA_STORAGE_TYPE_MISMATCH type %02x\n", cid, tp, tprop_tnames[surf], e24 & 0x7f);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_TPROP: ch %d TP %d surf %s ZETA_STORAGE_TYPE_MISMATCH type %02x\n", cid, tp, tprop_tnames[surf], e24 & 0x7f);
 		status &= ~0x200;
 	}
 	if (status & 0x400) {
-		NV_ERROR(dev, "PGRAPH_TRAP_TPROP: ch %d TP %d surf %s RT_STORAGE_TYPE_MISMATCH type %02x\n", cid, tp, tprop_tnames[surf], e24 & 0x7f);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_TPROP: ch %d TP %d surf %s RT_STORAGE_TYPE_MISMATCH type %02x\n", cid, tp, tprop_tnames[surf], e24 & 0x7f);
 		status &= ~0x400;
 	}
 	if (status & 0x800) {
-		NV_ERROR(dev, "PGRAPH_TRAP_TPROP: ch %d TP %d surf %s DST2D_LINEAR_MISMATCH type %02x\n", cid, tp, tprop_tnames[surf], e24 & 0x7f);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_TPROP: ch %d TP %d surf %s DST2D_LINEAR_MISMATCH type %02x\n", cid, tp, tprop_tnames[surf], e24 & 0x7f);
 		status &= ~0x800;
 	}
 	if (status & 0x1000) {
-		NV_ERROR(dev, "PGRAPH_TRAP_TPROP: ch %d TP %d surf %s RT_LINEAR_MISMATCH type %02x\n", cid, tp, tprop_tnames[surf], e24 & 0x7f);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_TPROP: ch %d TP %d surf %s RT_LINEAR_MISMATCH type %02x\n", cid, tp, tprop_tnames[surf], e24 & 0x7f);
 		status &= ~0x1000;
 	}
 	if (status) {
-		NV_ERROR(dev, "PGRAPH_TRAP_TPROP: ch %d TP %d surf %s status %08x\n", cid, tp, tprop_tnames[surf], status);
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_TPROP: ch %d TP %d surf %s status %08x\n", cid, tp, tprop_tnames[surf], status);
 	}
-	NV_ERROR(dev, "magic: %08x %08x %08x %08x %08x %08x %08x\n",
+	TRAP_ERROR(dev, t, "magic: %08x %08x %08x %08x %08x %08x %08x\n",
 			e0c, e10, e14, e18, e1c, e20, e24);
-	nv_wr32(dev, staddr, 0xc0000000);
+	TRAP_WR(dev, t, staddr, 0xc0000000);
 }
 
-static void nv50_graph_trap_handler(struct drm_device *dev, int cid) {
+static void nv50_graph_trap_handler(struct drm_device *dev, struct pscnv_trap *t, int cid) {
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
-	uint32_t status = nv_rd32(dev, 0x400108);
+	uint32_t status = TRAP_RD(dev, t, 0x400108);
 	uint32_t ustatus;
-	uint32_t units = nv_rd32(dev, 0x1540);
+	uint32_t units = TRAP_RD(dev, t, 0x1540);
+	uint32_t regs[4];
 	int i;
 
 	if (status & 0x001) {
-		ustatus = nv_rd32(dev, 0x400804) & 0x7fffffff;
+		ustatus = TRAP_RD(dev, t, 0x400804) & 0x7fffffff;
 		if (ustatus & 0x00000001) {
-			nv_wr32(dev, 0x400500, 0);
-			if (nv_rd32(dev, 0x400808) & 0x80000000) {
-				uint32_t class = nv_rd32(dev, 0x400814);
-				uint32_t mthd = nv_rd32(dev, 0x400808) & 0x1ffc;
-				uint32_t subc = (nv_rd32(dev, 0x400808) >> 16) & 0x7;
-				uint32_t data = nv_rd32(dev, 0x40080c);
-				NV_ERROR(dev, "PGRAPH_TRAP_DISPATCH: ch %d sub %d [%04x] mthd %04x data %08x\n", cid, subc, class, mthd, data);
-				NV_INFO(dev, "PGRAPH_TRAP_DISPATCH: 400808: %08x\n", nv_rd32(dev, 0x400808));
-				NV_INFO(dev, "PGRAPH_TRAP_DISPATCH: 400848: %08x\n", nv_rd32(dev, 0x400848));
-				nv_wr32(dev, 0x400808, 0);
+			TRAP_WR(dev, t, 0x400500, 0);
+			uint32_t addr = TRAP_RD(dev, t, 0x400808);
+			if (addr & 0x80000000) {
+				uint32_t class = TRAP_RD(dev, t, 0x400814);
+				uint32_t mthd = addr & 0x1ffc;
+				uint32_t subc = (addr >> 16) & 0x7;
+				uint32_t data = TRAP_RD(dev, t, 0x40080c);
+				uint32_t r848 = TRAP_RD(dev, t, 0x400848);
+				TRAP_ERROR(dev, t, "PGRAPH_TRAP_DISPATCH: ch %d sub %d [%04x] mthd %04x data %08x\n", cid, subc, class, mthd, data);
+				TRAP_INFO(dev, t, "PGRAPH_TRAP_DISPATCH: 400808: %08x\n", addr);
+				TRAP_INFO(dev, t, "PGRAPH_TRAP_DISPATCH: 400848: %08x\n", r848);
+				TRAP_WR(dev, t, 0x400808, 0);
 			} else {
-				NV_ERROR(dev, "PGRAPH_TRAP_DISPATCH: No stuck command?\n");
+				TRAP_ERROR(dev, t, "PGRAPH_TRAP_DISPATCH: No stuck command?\n");
 			}
-			nv_wr32(dev, 0x4008e8, nv_rd32(dev, 0x4008e8) & 3);
-			nv_wr32(dev, 0x400848, 0);
+			TRAP_WR(dev, t, 0x4008e8, nv_rd32(dev, 0x4008e8) & 3);
+			TRAP_WR(dev, t, 0x400848, 0);
 		}
 		if (ustatus & 0x00000002) {
 			/* XXX: this one involves much more pain. */
-			NV_ERROR(dev, "PGRAPH_TRAP_QUERY: ch %d.\n", cid);
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_QUERY: ch %d.\n", cid);
 		}
 		if (ustatus & 0x00000004) {
-			NV_ERROR(dev, "PGRAPH_TRAP_GRCTX_MMIO: ch %d. This is a kernel bug.\n", cid);
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_GRCTX_MMIO: ch %d. This is a kernel bug.\n", cid);
 		}
 		if (ustatus & 0x00000008) {
-			NV_ERROR(dev, "PGRAPH_TRAP_GRCTX_XFER1: ch %d. This is a kernel bug.\n", cid);
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_GRCTX_XFER1: ch %d. This is a kernel bug.\n", cid);
 		}
 		if (ustatus & 0x00000010) {
-			NV_ERROR(dev, "PGRAPH_TRAP_GRCTX_XFER2: ch %d. This is a kernel bug.\n", cid);
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_GRCTX_XFER2: ch %d. This is a kernel bug.\n", cid);
 		}
 		ustatus &= ~0x0000001f;
 		if (ustatus)
-			NV_ERROR(dev, "PGRAPH_TRAP_DISPATCH: Unknown ustatus 0x%08x on ch %d\n", ustatus, cid);
-		nv_wr32(dev, 0x400804, 0xc0000000);
-		nv_wr32(dev, 0x400108, 0x001);
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_DISPATCH: Unknown ustatus 0x%08x on ch %d\n", ustatus, cid);
+		TRAP_WR(dev, t, 0x400804, 0xc0000000);
+		TRAP_WR(dev, t, 0x400108, 0x001);
 		status &= ~0x001;
 	}
 
 	if (status & 0x002) {
-		ustatus = nv_rd32(dev, 0x406800) & 0x7fffffff;
+		ustatus = TRAP_RD(dev, t, 0x406800) & 0x7fffffff;
+		if (ustatus & 7)
+			for (i = 0; i < 4; i++)
+				regs[i] = TRAP_RD(dev, t, 0x406804 + i * 4);
 		if (ustatus & 1)
-			NV_ERROR (dev, "PGRAPH_TRAP_M2MF_NOTIFY: ch %d %08x %08x %08x %08x\n",
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_M2MF_NOTIFY: ch %d %08x %08x %08x %08x\n",
 				cid,
-				nv_rd32(dev, 0x406804),
-				nv_rd32(dev, 0x406808),
-				nv_rd32(dev, 0x40680c),
-				nv_rd32(dev, 0x406810));
+				regs[0], regs[1], regs[2], regs[3]);
 		if (ustatus & 2)
-			NV_ERROR (dev, "PGRAPH_TRAP_M2MF_IN: ch %d %08x %08x %08x %08x\n",
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_M2MF_IN: ch %d %08x %08x %08x %08x\n",
 				cid,
-				nv_rd32(dev, 0x406804),
-				nv_rd32(dev, 0x406808),
-				nv_rd32(dev, 0x40680c),
-				nv_rd32(dev, 0x406810));
+				regs[0], regs[1], regs[2], regs[3]);
 		if (ustatus & 4)
-			NV_ERROR (dev, "PGRAPH_TRAP_M2MF_OUT: ch %d %08x %08x %08x %08x\n",
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_M2MF_OUT: ch %d %08x %08x %08x %08x\n",
 				cid,
-				nv_rd32(dev, 0x406804),
-				nv_rd32(dev, 0x406808),
-				nv_rd32(dev, 0x40680c),
-				nv_rd32(dev, 0x406810));
+				regs[0], regs[1], regs[2], regs[3]);
 		ustatus &= ~0x00000007;
 		if (ustatus)
-			NV_ERROR(dev, "PGRAPH_TRAP_M2MF: Unknown ustatus 0x%08x on ch %d\n", ustatus, cid);
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_M2MF: Unknown ustatus 0x%08x on ch %d\n", ustatus, cid);
 		/* No sane way found yet -- just reset the bugger. */
-		nv_wr32(dev, 0x400040, 2);
-		nv_wr32(dev, 0x400040, 0);
-		nv_wr32(dev, 0x406800, 0xc0000000);
-		nv_wr32(dev, 0x400108, 0x002);
+		TRAP_WR(dev, t, 0x400040, 2);
+		TRAP_WR(dev, t, 0x400040, 0);
+		TRAP_WR(dev, t, 0x406800, 0xc0000000);
+		TRAP_WR(dev, t, 0x400108, 0x002);
 		status &= ~0x002;
 	}
 
 	if (status & 0x004) {
-		ustatus = nv_rd32(dev, 0x400c04) & 0x7fffffff;
+		ustatus = TRAP_RD(dev, t, 0x400c04) & 0x7fffffff;
 		if (ustatus & 0x00000001) {
-			NV_ERROR (dev, "PGRAPH_TRAP_VFETCH: ch %d\n", cid);
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_VFETCH: ch %d\n", cid);
 		}
 		ustatus &= ~0x00000001;
 		if (ustatus)
-			NV_ERROR(dev, "PGRAPH_TRAP_VFETCH: Unknown ustatus 0x%08x on ch %d\n", ustatus, cid);
-		nv_wr32(dev, 0x400c04, 0xc0000000);
-		nv_wr32(dev, 0x400108, 0x004);
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_VFETCH: Unknown ustatus 0x%08x on ch %d\n", ustatus, cid);
+		TRAP_WR(dev, t, 0x400c04, 0xc0000000);
+		TRAP_WR(dev, t, 0x400108, 0x004);
 		status &= ~0x004;
 	}
 
 	if (status & 0x008) {
-		ustatus = nv_rd32(dev, 0x401800) & 0x7fffffff;
+		ustatus = TRAP_RD(dev, t, 0x401800) & 0x7fffffff;
 		if (ustatus & 0x00000001) {
-			NV_ERROR (dev, "PGRAPH_TRAP_STRMOUT: ch %d %08x %08x %08x %08x\n", cid,
-				nv_rd32(dev, 0x401804),
-				nv_rd32(dev, 0x401808),
-				nv_rd32(dev, 0x40180c),
-				nv_rd32(dev, 0x401810));
+			for (i = 0; i < 4; i++)
+				regs[i] = TRAP_RD(dev, t, 0x401804 + i * 4);
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_STRMOUT: ch %d %08x %08x %08x %08x\n", cid,
+				regs[0], regs[1], regs[2], regs[3]);
 		}
 		ustatus &= ~0x00000001;
 		if (ustatus)
-			NV_ERROR(dev, "PGRAPH_TRAP_STRMOUT: Unknown ustatus 0x%08x on ch %d\n", ustatus, cid);
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_STRMOUT: Unknown ustatus 0x%08x on ch %d\n", ustatus, cid);
 		/* No sane way found yet -- just reset the bugger. */
-		nv_wr32(dev, 0x400040, 0x80);
-		nv_wr32(dev, 0x400040, 0);
-		nv_wr32(dev, 0x401800, 0xc0000000);
-		nv_wr32(dev, 0x400108, 0x008);
+		TRAP_WR(dev, t, 0x400040, 0x80);
+		TRAP_WR(dev, t, 0x400040, 0);
+		TRAP_WR(dev, t, 0x401800, 0xc0000000);
+		TRAP_WR(dev, t, 0x400108, 0x008);
 		status &= ~0x008;
 	}
 
 	if (status & 0x010) {
-		ustatus = nv_rd32(dev, 0x405018) & 0x7fffffff;
+		ustatus = TRAP_RD(dev, t, 0x405018) & 0x7fffffff;
 		if (ustatus & 0x00000001) {
-			NV_ERROR (dev, "PGRAPH_TRAP_CCACHE: ch %d\n", cid);
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_CCACHE: ch %d\n", cid);
 		}
 		ustatus &= ~0x00000001;
 		if (ustatus)
-			NV_ERROR(dev, "PGRAPH_TRAP_CCACHE: Unknown ustatus 0x%08x on ch %d\n", ustatus, cid);
-		nv_wr32(dev, 0x405018, 0xc0000000);
-		nv_wr32(dev, 0x400108, 0x010);
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_CCACHE: Unknown ustatus 0x%08x on ch %d\n", ustatus, cid);
+		TRAP_WR(dev, t, 0x405018, 0xc0000000);
+		TRAP_WR(dev, t, 0x400108, 0x010);
 		status &= ~0x010;
 	}
 
 	if (status & 0x020) {
-		ustatus = nv_rd32(dev, 0x402000) & 0x7fffffff;
+		ustatus = TRAP_RD(dev, t, 0x402000) & 0x7fffffff;
 		if (ustatus & 0x00000001) {
-			NV_ERROR (dev, "PGRAPH_TRAP_CLIPID: ch %d\n", cid);
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_CLIPID: ch %d\n", cid);
 		}
 		ustatus &= ~0x00000001;
 		if (ustatus)
-			NV_ERROR(dev, "PGRAPH_TRAP_CLIPID: Unknown ustatus 0x%08x on ch %d\n", ustatus, cid);
-		nv_wr32(dev, 0x402000, 0xc0000000);
-		nv_wr32(dev, 0x400108, 0x020);
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_CLIPID: Unknown ustatus 0x%08x on ch %d\n", ustatus, cid);
+		TRAP_WR(dev, t, 0x402000, 0xc0000000);
+		TRAP_WR(dev, t, 0x400108, 0x020);
 		status &= ~0x020;
 	}
 
@@ -855,13 +870,13 @@ static void nv50_graph_trap_handler(struct drm_device *dev, int cid) {
 		for (i = 0; i < 16; i++)
 			if (units & 1 << i) {
 				if (dev_priv->chipset < 0xa0)
-					ustatus = nv_rd32(dev, 0x408900 + i * 0x1000);
+					ustatus = TRAP_RD(dev, t, 0x408900 + i * 0x1000);
 				else
-					ustatus = nv_rd32(dev, 0x408600 + i * 0x800);
+					ustatus = TRAP_RD(dev, t, 0x408600 + i * 0x800);
 				if (ustatus & 0x7fffffff)
-					nv50_graph_tex_trap(dev, cid, i);
+					nv50_graph_tex_trap(dev, t, cid, i);
 			}
-		nv_wr32(dev, 0x400108, 0x040);
+		TRAP_WR(dev, t, 0x400108, 0x040);
 		status &= ~0x040;
 	}
 
@@ -869,13 +884,13 @@ static void nv50_graph_trap_handler(struct drm_device *dev, int cid) {
 		for (i = 0; i < 16; i++)
 			if (units & 1 << i) {
 				if (dev_priv->chipset < 0xa0)
-					ustatus = nv_rd32(dev, 0x408314 + i * 0x1000);
+					ustatus = TRAP_RD(dev, t, 0x408314 + i * 0x1000);
 				else
-					ustatus = nv_rd32(dev, 0x40831c + i * 0x800);
+					ustatus = TRAP_RD(dev, t, 0x40831c + i * 0x800);
 				if (ustatus & 0x7fffffff)
-					nv50_graph_mpc_trap(dev, cid, i);
+					nv50_graph_mpc_trap(dev, t, cid, i);
 			}
-		nv_wr32(dev, 0x400108, 0x080);
+		TRAP_WR(dev, t, 0x400108, 0x080);
 		status &= ~0x080;
 	}
 
@@ -883,116 +898,122 @@ static void nv50_graph_trap_handler(struct drm_device *dev, int cid) {
 		for (i = 0; i < 16; i++)
 			if (units & 1 << i) {
 				if (dev_priv->chipset < 0xa0)
-					ustatus = nv_rd32(dev, 0x408e08 + i * 0x1000);
+					ustatus = TRAP_RD(dev, t, 0x408e08 + i * 0x1000);
 				else
-					ustatus = nv_rd32(dev, 0x408708 + i * 0x800);
+					ustatus = TRAP_RD(dev, t, 0x408708 + i * 0x800);
 				if (ustatus & 0x7fffffff)
-					nv50_graph_tprop_trap(dev, cid, i);
+					nv50_graph_tprop_trap(dev, t, cid, i);
 			}
-		nv_wr32(dev, 0x400108, 0x100);
+		TRAP_WR(dev, t, 0x400108, 0x100);
 		status &= ~0x100;
 	}
 
 	/* XXX: per-TP traps. */
 
 	if (status) {
-		NV_ERROR(dev, "Unknown PGRAPH trap %08x on ch %d\n", status, cid);
-		nv_wr32(dev, 0x400108, status);
+		TRAP_ERROR(dev, t, "Unknown PGRAPH trap %08x on ch %d\n", status, cid);
+		TRAP_WR(dev, t, 0x400108, status);
 	}
 }
 
-void nv50_graph_irq_handler(struct drm_device *dev, int irq) {
+static void nv50_graph_irq(struct drm_device *dev, struct pscnv_trap *t, uint32_t arg) {
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
 	uint32_t status;
 	uint32_t st, chandle, addr, data, datah, ecode, class, subc, mthd;
 	int cid;
-	status = nv_rd32(dev, 0x400100);
-	ecode = nv_rd32(dev, 0x400110);
-	st = nv_rd32(dev, 0x400700);
-	addr = nv_rd32(dev, 0x400704);
+	status = TRAP_RD(dev, t, 0x400100);
+	ecode = TRAP_RD(dev, t, 0x400110);
+	st = TRAP_RD(dev, t, 0x400700);
+	addr = TRAP_RD(dev, t, 0x400704);
 	mthd = addr & 0x1ffc;
 	subc = (addr >> 16) & 7;
-	data = nv_rd32(dev, 0x400708);
-	datah = nv_rd32(dev, 0x40070c);
-	chandle = nv_rd32(dev, 0x400784);
-	class = nv_rd32(dev, 0x400814) & 0xffff;
-	cid = pscnv_chan_handle_lookup(dev, chandle);
+	data = TRAP_RD(dev, t, 0x400708);
+	datah = TRAP_RD(dev, t, 0x40070c);
+	chandle = TRAP_RD(dev, t, 0x400784);
+	class = TRAP_RD(dev, t, 0x400814) & 0xffff;
+	cid = TRAP_VAL(t, pscnv_chan_handle_lookup(dev, chandle));
 	if (cid == 128) {
-		NV_ERROR(dev, "PGRAPH: UNKNOWN channel %x active!\n", chandle);
+		TRAP_ERROR(dev, t, "PGRAPH: UNKNOWN channel %x active!\n", chandle);
 	}
 
 	if (status & 0x00000001) {
-		NV_ERROR(dev, "PGRAPH_NOTIFY: ch %d\n", cid);
-		nv_wr32(dev, 0x400100, 0x00000001);
+		TRAP_ERROR(dev, t, "PGRAPH_NOTIFY: ch %d\n", cid);
+		TRAP_WR(dev, t, 0x400100, 0x00000001);
 		status &= ~0x00000001;
 	}
 	if (status & 0x00000002) {
-		NV_ERROR(dev, "PGRAPH_QUERY: ch %d\n", cid);
-		nv_wr32(dev, 0x400100, 0x00000002);
+		TRAP_ERROR(dev, t, "PGRAPH_QUERY: ch %d\n", cid);
+		TRAP_WR(dev, t, 0x400100, 0x00000002);
 		status &= ~0x00000002;
 	}
 	if (status & 0x00000004) {
-		NV_ERROR(dev, "PGRAPH_SYNC: ch %d\n", cid);
-		nv_wr32(dev, 0x400100, 0x00000004);
+		TRAP_ERROR(dev, t, "PGRAPH_SYNC: ch %d\n", cid);
+		TRAP_WR(dev, t, 0x400100, 0x00000004);
 		status &= ~0x00000004;
 	}
 	if (status & 0x00000010) {
-		NV_ERROR(dev, "PGRAPH_ILLEGAL_MTHD: ch %d sub %d [%04x] mthd %04x data %08x\n", cid, subc, class, mthd, data);
-		nv_wr32(dev, 0x400100, 0x00000010);
+		TRAP_ERROR(dev, t, "PGRAPH_ILLEGAL_MTHD: ch %d sub %d [%04x] mthd %04x data %08x\n", cid, subc, class, mthd, data);
+		TRAP_WR(dev, t, 0x400100, 0x00000010);
 		status &= ~0x00000010;
 	}
 	if (status & 0x00000020) {
-		NV_ERROR(dev, "PGRAPH_ILLEGAL_CLASS: ch %d sub %d [%04x] mthd %04x data %08x\n", cid, subc, class, mthd, data);
-		nv_wr32(dev, 0x400100, 0x00000020);
+		TRAP_ERROR(dev, t, "PGRAPH_ILLEGAL_CLASS: ch %d sub %d [%04x] mthd %04x data %08x\n", cid, subc, class, mthd, data);
+		TRAP_WR(dev, t, 0x400100, 0x00000020);
 		status &= ~0x00000020;
 	}
 	if (status & 0x00000040) {
-		NV_ERROR(dev, "PGRAPH_DOUBLE_NOTIFY: ch %d sub %d [%04x] mthd %04x data %08x\n", cid, subc, class, mthd, data);
-		nv_wr32(dev, 0x400100, 0x00000040);
+		TRAP_ERROR(dev, t, "PGRAPH_DOUBLE_NOTIFY: ch %d sub %d [%04x] mthd %04x data %08x\n", cid, subc, class, mthd, data);
+		TRAP_WR(dev, t, 0x400100, 0x00000040);
 		status &= ~0x00000040;
 	}
 	if (status & 0x00010000) {
-		NV_ERROR(dev, "PGRAPH_BUFFER_NOTIFY: ch %d\n", cid);
-		nv_wr32(dev, 0x400100, 0x00010000);
+		TRAP_ERROR(dev, t, "PGRAPH_BUFFER_NOTIFY: ch %d\n", cid);
+		TRAP_WR(dev, t, 0x400100, 0x00010000);
 		status &= ~0x00010000;
 	}
 	if (status & 0x00100000) {
 		struct pscnv_enumval *ev;
 		ev = pscnv_enum_find(dispatch_errors, ecode);
 		if (ev)
-			NV_ERROR(dev, "PGRAPH_DISPATCH_ERROR [%s]: ch %d sub %d [%04x] mthd %04x data %08x\n", ev->name, cid, subc, class, mthd, data);
+			TRAP_ERROR(dev, t, "PGRAPH_DISPATCH_ERROR [%s]: ch %d sub %d [%04x] mthd %04x data %08x\n", ev->name, cid, subc, class, mthd, data);
 		else {
 			uint32_t base = (dev_priv->chipset > 0xa0 && dev_priv->chipset < 0xaa ? 0x404800 : 0x405400);
 			int i;
-			NV_ERROR(dev, "PGRAPH_DISPATCH_ERROR [%x]: ch %d sub %d [%04x] mthd %04x data %08x\n", ecode, cid, subc, class, mthd, data);
-			for (i = 0; i < 0x400; i += 4)
-				NV_ERROR(dev, "DD %06x: %08x\n", base + i, nv_rd32(dev, base + i));
+			TRAP_ERROR(dev, t, "PGRAPH_DISPATCH_ERROR [%x]: ch %d sub %d [%04x] mthd %04x data %08x\n", ecode, cid, subc, class, mthd, data);
+			for (i = 0; i < 0x400; i += 4) {
+				uint32_t val = TRAP_RD(dev, t, base + i);
+				TRAP_ERROR(dev, t, "DD %06x: %08x\n", base + i, val);
+			}
 		}
-		nv_wr32(dev, 0x400100, 0x00100000);
+		TRAP_WR(dev, t, 0x400100, 0x00100000);
 		status &= ~0x00100000;
 	}
 
 	if (status & 0x00200000) {
-		nv50_graph_trap_handler(dev, cid);
-		nv_wr32(dev, 0x400100, 0x00200000);
+		nv50_graph_trap_handler(dev, t, cid);
+		TRAP_WR(dev, t, 0x400100, 0x00200000);
 		status &= ~0x00200000;
 	}
 
 	if (status & 0x01000000) {
-		addr = nv_rd32(dev, 0x400808);
+		addr = TRAP_RD(dev, t, 0x400808);
 		subc = addr >> 16 & 7;
 		mthd = addr & 0x1ffc;
-		data = nv_rd32(dev, 0x40080c);
-		NV_ERROR(dev, "PGRAPH_SINGLE_STEP: ch %d sub %d [%04x] mthd %04x data %08x\n", cid, subc, class, mthd, data);
-		nv_wr32(dev, 0x400100, 0x01000000);
+		data = TRAP_RD(dev, t, 0x40080c);
+		TRAP_ERROR(dev, t, "PGRAPH_SINGLE_STEP: ch %d sub %d [%04x] mthd %04x data %08x\n", cid, subc, class, mthd, data);
+		TRAP_WR(dev, t, 0x400100, 0x01000000);
 		status &= ~0x01000000;
 	}
 
 	if (status) {
-		NV_ERROR(dev, "Unknown PGRAPH interrupt %08x\n", status);
-		NV_ERROR(dev, "PGRAPH: ch %d sub %d [%04x] mthd %04x data %08x\n", cid, subc, class, mthd, data);
-		nv_wr32(dev, 0x400100, status);
+		TRAP_ERROR(dev, t, "Unknown PGRAPH interrupt %08x\n", status);
+		TRAP_ERROR(dev, t, "PGRAPH: ch %d sub %d [%04x] mthd %04x data %08x\n", cid, subc, class, mthd, data);
+		TRAP_WR(dev, t, 0x400100, status);
 	}
+}
+
+void nv50_graph_irq_handler(struct drm_device *dev, int irq) {
+	pscnv_trap_run(dev, nv50_graph_irq, 0);
 	nv50_vm_trap(dev);
 	nv_wr32(dev, 0x400500, 0x10001);
 }
@@ -4,6 +4,7 @@
 #include "pscnv_vm.h"
 #include "nv50_chan.h"
 #include "pscnv_chan.h"
+#include "pscnv_trap.h"
 
 static int nv50_vm_map_kernel(struct pscnv_bo *bo);
 static void nv50_vm_takedown(struct drm_device *dev);
@@ -492,11 +493,11 @@ static struct pscnv_enumval *pscnv_enum_find (struct pscnv_enumval *list, int va
 		return 0;
 }
 
-void nv50_vm_trap(struct drm_device *dev) {
+static void nv50_vm_trap_decode(struct drm_device *dev, struct pscnv_trap *t, uint32_t arg) {
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
 	uint32_t trap[6];
 	int i;
-	uint32_t idx = nv_rd32(dev, 0x100c90);
+	uint32_t idx = TRAP_RD(dev, t, 0x100c90);
 	uint32_t s0, s1, s2, s3;
 	char reason[50];
 	char unit1[50];
@@ -507,8 +508,8 @@ void nv50_vm_trap(struct drm_device *dev) {
 	if (idx & 0x80000000) {
 		idx &= 0xffffff;
 		for (i = 0; i < 6; i++) {
-			nv_wr32(dev, 0x100c90, idx | i << 24);
-			trap[i] = nv_rd32(dev, 0x100c94);
+			TRAP_WR(dev, t, 0x100c90, idx | i << 24);
+			trap[i] = TRAP_RD(dev, t, 0x100c94);
 		}
 		if (dev_priv->chipset < 0xa3 || (dev_priv->chipset >= 0xaa && dev_priv->chipset <= 0xac)) {
 			s0 = trap[0] & 0xf;
@@ -539,18 +540,23 @@ void nv50_vm_trap(struct drm_device *dev) {
 			snprintf(unit3, sizeof(unit3), "%s", ev->name);
 		else
 			snprintf(unit3, sizeof(unit3), "0x%x", s3);
-		chan = pscnv_chan_handle_lookup(dev, trap[2] << 16 | trap[1]);
+		chan = TRAP_VAL(t, pscnv_chan_handle_lookup(dev, trap[2] << 16 | trap[1]));
 		if (chan != 128) {
-			NV_INFO(dev, "VM: Trapped %s at %02x%04x%04x ch %d on %s/%s/%s, reason %s\n",
+			TRAP_INFO(dev, t, "VM: Trapped %s at %02x%04x%04x ch %d on %s/%s/%s, reason %s\n",
 				(trap[5]&0x100?"read":"write"),
 				trap[5]&0xff, trap[4]&0xffff,
 				trap[3]&0xffff, chan, unit1, unit2, unit3, reason);
 		} else {
-			NV_INFO(dev, "VM: Trapped %s at %02x%04x%04x UNKNOWN ch %08x on %s/%s/%s, reason %s\n",
+			TRAP_INFO(dev, t, "VM: Trapped %s at %02x%04x%04x UNKNOWN ch %08x on %s/%s/%s, reason %s\n",
 				(trap[5]&0x100?"read":"write"),
 				trap[5]&0xff, trap[4]&0xffff,
 				trap[3]&0xffff, trap[2] << 16 | trap[1], unit1, unit2, unit3, reason);
 		}
-		nv_wr32(dev, 0x100c90, idx | 0x80000000);
+		TRAP_WR(dev, t, 0x100c90, idx | 0x80000000);
 	}
 }
+
+/* Also called from other engines' handlers, PFIFO's and PCRYPT's. */
+void nv50_vm_trap(struct drm_device *dev) {
+	pscnv_trap_run(dev, nv50_vm_trap_decode, 0);
+}
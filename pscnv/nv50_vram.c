@@ -290,7 +290,7 @@ nv50_vram_alloc(struct pscnv_bo *bo)
 	}
 	if (!(bo->flags & PSCNV_GEM_CONTIG))
 		flags |= PSCNV_MM_FRAGOK;
-	mutex_lock(&dev_priv->vram_mutex);
+	pscnv_mutex_lock(dev, &dev_priv->vram_mutex, PSCNV_LOCK_VRAM);
 	ret = pscnv_mm_alloc(dev_priv->vram_mm, bo->size, flags, 0, dev_priv->vram_size, &bo->mmnode);
 	if (!ret) {
 		if (bo->flags & PSCNV_GEM_CONTIG)
@@ -56,6 +56,7 @@ int nv98_crypt_chan_alloc(struct pscnv_engine *eng, struct pscnv_chan *ch);
 void nv98_crypt_chan_free(struct pscnv_engine *eng, struct pscnv_chan *ch);
 void nv98_crypt_chan_kill(struct pscnv_engine *eng, struct pscnv_chan *ch);
 int nv98_crypt_chan_obj_new(struct pscnv_engine *eng, struct pscnv_chan *ch, uint32_t handle, uint32_t oclass, uint32_t flags);
+int nv98_crypt_chan_obj_free(struct pscnv_engine *eng, struct pscnv_chan *ch, uint32_t inst);
 
 int nv98_crypt_init(struct drm_device *dev) {
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
@@ -75,6 +76,7 @@ int nv98_crypt_init(struct drm_device *dev) {
 	res->base.chan_kill = nv98_crypt_chan_kill;
 	res->base.chan_free = nv98_crypt_chan_free;
 	res->base.chan_obj_new = nv98_crypt_chan_obj_new;
+	res->base.chan_obj_free = nv98_crypt_chan_obj_free;
 	spin_lock_init(&res->lock);
 
 	/* reset everything */
@@ -184,6 +186,7 @@ void nv98_crypt_chan_free(struct pscnv_engine *eng, struct pscnv_chan *ch) {
 }
 
 int nv98_crypt_chan_obj_new(struct pscnv_engine *eng, struct pscnv_chan *ch, uint32_t handle, uint32_t oclass, uint32_t flags) {
+	int ret;
 	uint32_t inst = nv50_chan_iobj_new(ch, 0x20);
 	if (!inst) {
 		return -ENOMEM;
@@ -196,7 +199,20 @@ int nv98_crypt_chan_obj_new(struct pscnv_engine *eng, struct pscnv_chan *ch, uin
 	nv_wv32(ch->bo, inst + 0x14, 0);
 	nv_wv32(ch->bo, inst + 0x18, 0);
 	nv_wv32(ch->bo, inst + 0x1c, 0);
-	return pscnv_ramht_insert (&ch->ramht, handle, 0x500000 | inst >> 4);
+	ret = pscnv_ramht_insert (&ch->ramht, handle, 0x500000 | inst >> 4);
+	if (ret)
+		nv50_chan_iobj_free(ch, inst);
+	return ret;
+}
+
+/* We don't know how to tell PCRYPT is idle, so objects stay in use for as
+ * long as the channel is loaded there or about to be. */
+int nv98_crypt_chan_obj_free(struct pscnv_engine *eng, struct pscnv_chan *ch, uint32_t inst) {
+	struct drm_device *dev = eng->dev;
+	uint32_t chan = 0x40000000 | ch->bo->start >> 12;
+	if (nv_rd32(dev, 0x87050) == chan || nv_rd32(dev, 0x87054) == chan)
+		return -EBUSY;
+	return 0;
 }
 
 void nv98_crypt_irq_handler(struct drm_device *dev, int irq) {
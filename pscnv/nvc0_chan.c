@@ -8,16 +8,13 @@ static int nvc0_chan_new (struct pscnv_chan *ch)
 {
 	struct pscnv_vspace *vs = ch->vspace;
 	struct drm_nouveau_private *dev_priv = ch->dev->dev_private;
-	unsigned long flags;
 
 	ch->bo = pscnv_mem_alloc(ch->dev, 0x1000, PSCNV_GEM_CONTIG,
 			0, (ch->cid < 0 ? 0xc5a2ba7 : 0xc5a2f1f0));
 	if (!ch->bo)
 		return -ENOMEM;
 
-	spin_lock_irqsave(&dev_priv->chan->ch_lock, flags);
-	ch->handle = ch->bo->start >> 12;
-	spin_unlock_irqrestore(&dev_priv->chan->ch_lock, flags);
+	pscnv_chan_set_handle(ch, ch->bo->start >> 12);
 
 	if (vs->vid != -3)
 		dev_priv->vm->map_kernel(ch->bo);
@@ -29,9 +26,6 @@ static int nvc0_chan_new (struct pscnv_chan *ch)
 
 	if (ch->cid >= 0) {
 		nv_wr32(ch->dev, 0x3000 + ch->cid * 8, (0x4 << 28) | ch->bo->start >> 12);
-		spin_lock_irqsave(&dev_priv->chan->ch_lock, flags);
-		ch->handle = ch->bo->start >> 12;
-		spin_unlock_irqrestore(&dev_priv->chan->ch_lock, flags);
 	}
 	dev_priv->vm->bar_flush(ch->dev);
 	return 0;
@@ -39,11 +33,7 @@ static int nvc0_chan_new (struct pscnv_chan *ch)
 
 static void nvc0_chan_free(struct pscnv_chan *ch)
 {
-	struct drm_nouveau_private *dev_priv = ch->dev->dev_private;
-	unsigned long flags;
-	spin_lock_irqsave(&dev_priv->chan->ch_lock, flags);
-	ch->handle = 0;
-	spin_unlock_irqrestore(&dev_priv->chan->ch_lock, flags);
+	pscnv_chan_set_handle(ch, 0);
 	pscnv_mem_free(ch->bo);
 	ch->bo = NULL;
 }
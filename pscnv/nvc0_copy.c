@@ -28,6 +28,7 @@
 #include "nvc0_copy.h"
 #include "nvc0_copy.fuc.h"
 #include "nvc0_vm.h"
+#include "pscnv_trap.h"
 
 struct nvc0_copy_chan {
 	struct pscnv_bo *bo;
@@ -49,6 +50,7 @@ nvc0_copy_chan_alloc(struct pscnv_engine *eng, struct pscnv_chan *ch)
 		ret = -ENOMEM;
 		goto fail_mem_alloc;
 	}
+	coch->bo->kernel_map = 1;
 
 	ret = dev_priv->vm->map_kernel(coch->bo);
 	if (ret) {
@@ -149,48 +151,48 @@ struct pscnv_copy_enum nvc0_copy_isr_error_name[] = {
 };
 
 static void
-nvc0_copy_isr(struct drm_device *dev, int engine)
+nvc0_copy_isr(struct drm_device *dev, struct pscnv_trap *t, uint32_t engine)
 {
 	uint64_t inst;
 	uint32_t disp, stat, chid, ssta, addr, mthd, subc, data;
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
 	struct nvc0_copy_engine *pcopy = NVC0_COPY(dev_priv->engines[engine]);
 #define PCOPY_ERROR(name)												\
-	NV_ERROR(dev, "%s: st %08x ch %d sub %d mthd %04x data %08x %08x/%08llx\n",\
+	TRAP_ERROR(dev, t, "%s: st %08x ch %d sub %d mthd %04x data %08x %08x/%08llx\n",\
 			 name, stat, chid, subc, mthd, data, ssta, inst);
 
-	disp = nv_rd32(dev, pcopy->fuc + 0x01c);
-	stat = nv_rd32(dev, pcopy->fuc + 0x008) & disp & ~(disp >> 16);
-	inst = (u64)(nv_rd32(dev, pcopy->fuc + 0x050) & 0x0fffffff) << 12;
+	disp = TRAP_RD(dev, t, pcopy->fuc + 0x01c);
+	stat = TRAP_RD(dev, t, pcopy->fuc + 0x008) & disp & ~(disp >> 16);
+	inst = (u64)(TRAP_RD(dev, t, pcopy->fuc + 0x050) & 0x0fffffff) << 12;
 	chid = -1;
-	ssta = nv_rd32(dev, pcopy->fuc + 0x040) & 0x0000ffff;
-	addr = nv_rd32(dev, pcopy->fuc + 0x040) >> 16;
+	ssta = TRAP_RD(dev, t, pcopy->fuc + 0x040) & 0x0000ffff;
+	addr = TRAP_RD(dev, t, pcopy->fuc + 0x040) >> 16;
 	mthd = (addr & 0x07ff) << 2;
 	subc = (addr & 0x3800) >> 11;
-	data = nv_rd32(dev, pcopy->fuc + 0x044);
+	data = TRAP_RD(dev, t, pcopy->fuc + 0x044);
 
 	if (stat & 0x00000040) {
 		PCOPY_ERROR("PCOPY_DISPATCH");
-		nv_wr32(dev, pcopy->fuc + 0x004, 0x00000040);
+		TRAP_WR(dev, t, pcopy->fuc + 0x004, 0x00000040);
 		stat &= ~0x00000040;
 	}
 
 	if (stat) {
-		NV_INFO(dev, "PCOPY: unhandled intr 0x%08x\n", stat);
-		nv_wr32(dev, pcopy->fuc + 0x004, stat);
+		TRAP_INFO(dev, t, "PCOPY: unhandled intr 0x%08x\n", stat);
+		TRAP_WR(dev, t, pcopy->fuc + 0x004, stat);
 	}
 }
 
 static void
 nvc0_copy_isr_0(struct drm_device *dev, int irq)
 {
-	nvc0_copy_isr(dev, PSCNV_ENGINE_COPY0);
+	pscnv_trap_run(dev, nvc0_copy_isr, PSCNV_ENGINE_COPY0);
 }
 
 static void
 nvc0_copy_isr_1(struct drm_device *dev, int irq)
 {
-	nvc0_copy_isr(dev, PSCNV_ENGINE_COPY1);
+	pscnv_trap_run(dev, nvc0_copy_isr, PSCNV_ENGINE_COPY1);
 }
 
 int
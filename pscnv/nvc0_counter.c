@@ -0,0 +1,196 @@
+/*
+ * Copyright 2011 - Nouveau Community
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "nouveau_drv.h"
+#include "nouveau_pm.h"
+
+/*
+ * NVC0 moved PCOUNTER into domains of 4 counters each: one on the hub
+ * at 0x1b0000, and one per GPC at 0x180000 + gpc * 0x1000. They're the
+ * sets of nv40_counter.c here, set 0 being the hub and set n GPC n - 1,
+ * so sampling, the ring and the perfmon ioctl work as they do there.
+ *
+ * No PCOUNTER signal for PGRAPH being idle is known on these, so
+ * PGRAPH_IDLE comes from a pair of PDAEMON idle counters instead, one
+ * counting the cycles PGRAPH is busy and one every cycle.
+ */
+
+#define NVC0_COUNTER_HUB		0x1b0000
+#define NVC0_COUNTER_GPC(gpc)		(0x180000 + (gpc) * 0x1000)
+#define NVC0_COUNTER_SIGNALS		0xe0
+
+#define NVC0_PDAEMON_CTR_MASK(i)	(0x10a504 + (i) * 0x10)
+#define NVC0_PDAEMON_CTR_COUNT(i)	(0x10a508 + (i) * 0x10)
+#define NVC0_PDAEMON_CTR_MODE(i)	(0x10a50c + (i) * 0x10)
+#define NVC0_PDAEMON_CTR_BUSY		0
+#define NVC0_PDAEMON_CTR_TOTAL		7
+#define NVC0_PDAEMON_MODE_IF_NOT_ALL	2
+#define NVC0_PDAEMON_MODE_ALWAYS	3
+#define NVC0_PDAEMON_SIG_GR		0x00200001
+
+static u32
+nvc0_counter_domain(int set)
+{
+	return set ? NVC0_COUNTER_GPC(set - 1) : NVC0_COUNTER_HUB;
+}
+
+int
+nvc0_counter_init(struct drm_device *dev)
+{
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	struct nouveau_pm_counter *counter = &dev_priv->engine.pm.counter;
+	u32 gpcs;
+
+	/* present GPCs, less the ones fused off */
+	gpcs = (1 << (nv_rd32(dev, 0x022430) & 0x1f)) - 1;
+	gpcs &= ~nv_rd32(dev, 0x022504);
+	counter->domains = 1 | (gpcs << 1);
+
+	/* reset PCOUNTER */
+	nv_mask(dev, 0x000200, 0x10000000, 0x00000000);
+	nv_mask(dev, 0x000200, 0x10000000, 0x10000000);
+
+	return nv40_counter_init(dev);
+}
+
+void
+nvc0_counter_program(struct drm_device *dev, u8 signals[8][4])
+{
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	struct nouveau_pm_counter *counter = &dev_priv->engine.pm.counter;
+	int set, i;
+	u32 dom;
+
+	for (set = 0; set < 8; set++) {
+		if (!(counter->domains & (1 << set)))
+			continue;
+		dom = nvc0_counter_domain(set);
+		nv_wr32(dev, dom + 0x09c, 0x00040002);
+		nv_wr32(dev, dom + 0x100, 0x00000000);
+		for (i = 0; i < 4; i++) {
+			/* one signal a counter, counted as is */
+			nv_wr32(dev, dom + 0x040 + i * 8, signals[set][i]);
+			nv_wr32(dev, dom + 0x044 + i * 8, 0xaaaa);
+		}
+		nv_wr32(dev, dom + 0x06c, NVC0_COUNTER_SIGNALS - 0x40 + 0x27);
+		nv_wr32(dev, dom + 0x0ec, 0x00000011);
+	}
+
+	if (counter->pdaemon_idle) {
+		nv_wr32(dev, NVC0_PDAEMON_CTR_MASK(NVC0_PDAEMON_CTR_BUSY),
+			NVC0_PDAEMON_SIG_GR);
+		nv_wr32(dev, NVC0_PDAEMON_CTR_MODE(NVC0_PDAEMON_CTR_BUSY),
+			NVC0_PDAEMON_MODE_IF_NOT_ALL);
+		nv_wr32(dev, NVC0_PDAEMON_CTR_MODE(NVC0_PDAEMON_CTR_TOTAL),
+			NVC0_PDAEMON_MODE_ALWAYS);
+		nv_wr32(dev, NVC0_PDAEMON_CTR_COUNT(NVC0_PDAEMON_CTR_BUSY), 0x80000000);
+		nv_wr32(dev, NVC0_PDAEMON_CTR_COUNT(NVC0_PDAEMON_CTR_TOTAL), 0x80000000);
+	}
+}
+
+void
+nvc0_counter_read(struct drm_device *dev)
+{
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	struct nouveau_pm_counter *counter = &dev_priv->engine.pm.counter;
+	u32 busy, dom;
+	int set;
+
+	for (set = 0; set < 8; set++) {
+		if (!(counter->domains & (1 << set)))
+			continue;
+		dom = nvc0_counter_domain(set);
+		/* latch what was counted and start over */
+		nv_wr32(dev, dom + 0x06c, NVC0_COUNTER_SIGNALS - 0x40 + 0x27);
+		nv_wr32(dev, dom + 0x0ec, 0x00000011);
+
+		counter->sets[set].cycles = nv_rd32(dev, dom + 0x070);
+		counter->sets[set].signals[0] = nv_rd32(dev, dom + 0x08c);
+		counter->sets[set].signals[1] = nv_rd32(dev, dom + 0x088);
+		counter->sets[set].signals[2] = nv_rd32(dev, dom + 0x080);
+		counter->sets[set].signals[3] = nv_rd32(dev, dom + 0x090);
+	}
+
+	if (counter->pdaemon_idle) {
+		busy = nv_rd32(dev, NVC0_PDAEMON_CTR_COUNT(NVC0_PDAEMON_CTR_BUSY));
+		counter->idle_total = nv_rd32(dev, NVC0_PDAEMON_CTR_COUNT(NVC0_PDAEMON_CTR_TOTAL));
+		counter->idle_cycles = counter->idle_total > busy ?
+			counter->idle_total - busy : 0;
+		nv_wr32(dev, NVC0_PDAEMON_CTR_COUNT(NVC0_PDAEMON_CTR_BUSY), 0x80000000);
+		nv_wr32(dev, NVC0_PDAEMON_CTR_COUNT(NVC0_PDAEMON_CTR_TOTAL), 0x80000000);
+	}
+}
+
+int
+nvc0_counter_watch_signal(struct drm_device *dev,
+			  enum nouveau_counter_signal signal)
+{
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	struct nouveau_pm_counter *counter = &dev_priv->engine.pm.counter;
+	unsigned long flags;
+
+	if (signal != PGRAPH_IDLE)
+		return -ENOENT;
+
+	spin_lock_irqsave(&counter->counter_lock, flags);
+	counter->pdaemon_idle = true;
+	counter->programmed = false;
+	spin_unlock_irqrestore(&counter->counter_lock, flags);
+	return 0;
+}
+
+int
+nvc0_counter_unwatch_signal(struct drm_device *dev,
+			    enum nouveau_counter_signal signal)
+{
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	struct nouveau_pm_counter *counter = &dev_priv->engine.pm.counter;
+	unsigned long flags;
+
+	if (signal != PGRAPH_IDLE)
+		return -ENOENT;
+
+	spin_lock_irqsave(&counter->counter_lock, flags);
+	counter->pdaemon_idle = false;
+	spin_unlock_irqrestore(&counter->counter_lock, flags);
+	return 0;
+}
+
+int
+nvc0_counter_value(struct drm_device *dev, enum nouveau_counter_signal signal,
+		   u32 *val, u32 *count)
+{
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	struct nouveau_pm_counter *counter = &dev_priv->engine.pm.counter;
+	unsigned long flags;
+	int ret = -ENOENT;
+
+	spin_lock_irqsave(&counter->counter_lock, flags);
+	if (signal == PGRAPH_IDLE && counter->pdaemon_idle) {
+		*val = counter->idle_cycles;
+		*count = counter->idle_total;
+		ret = 0;
+	}
+	spin_unlock_irqrestore(&counter->counter_lock, flags);
+
+	return ret;
+}
@@ -29,11 +29,18 @@
 #include "nouveau_reg.h"
 #include "pscnv_fifo.h"
 #include "pscnv_chan.h"
+#include "pscnv_sched.h"
+#include "pscnv_fence.h"
+#include "pscnv_trap.h"
 
 struct nvc0_fifo_engine {
 	struct pscnv_fifo_engine base;
 	struct pscnv_bo *playlist[2];
 	int cur_playlist;
+	/* scratch for playlist_update, protected by context_switch_lock */
+	int pl_prio[128];
+	int pl_cur[128];
+	int pl_cids[0x1000 / 8];
 	struct pscnv_bo *ctrl_bo;
 	struct drm_local_map *fifo_ctl;
 };
@@ -44,6 +51,8 @@ static void nvc0_fifo_takedown(struct drm_device *dev);
 static void nvc0_fifo_irq_handler(struct drm_device *dev, int irq);
 static int nvc0_fifo_chan_init_ib (struct pscnv_chan *ch, uint32_t pb_handle, uint32_t flags, uint32_t slimask, uint64_t ib_start, uint32_t ib_order);
 static void nvc0_fifo_chan_kill(struct pscnv_chan *ch);
+static int nvc0_fifo_chan_sched(struct pscnv_chan *ch, int priority, uint32_t timeslice);
+static int nvc0_fifo_chan_busy(struct pscnv_chan *ch);
 
 int nvc0_fifo_init(struct drm_device *dev)
 {
@@ -60,6 +69,8 @@ int nvc0_fifo_init(struct drm_device *dev)
 	res->base.takedown = nvc0_fifo_takedown;
 	res->base.chan_kill = nvc0_fifo_chan_kill;
 	res->base.chan_init_ib = nvc0_fifo_chan_init_ib;
+	res->base.chan_sched = nvc0_fifo_chan_sched;
+	res->base.chan_busy = nvc0_fifo_chan_busy;
 
 	res->ctrl_bo = pscnv_mem_alloc(dev, 128 * 0x1000,
 					     PSCNV_GEM_CONTIG, 0, 0xf1f03e95);
@@ -151,6 +162,7 @@ int nvc0_fifo_init(struct drm_device *dev)
 
 	nv_wr32(dev, 0x002a00, 0xffffffff); /* clears PFIFO.INTR bit 30 */
 	nv_wr32(dev, 0x002100, 0xffffffff);
+	nv_wr32(dev, 0x2628, 0x00000001); /* nonstall INTR_EN for PFIFO's own engine */
 	nv_wr32(dev, 0x2140, 0xbfffffff); /* PFIFO_INTR_EN */
 
 	return 0;
@@ -175,16 +187,19 @@ static void nvc0_fifo_playlist_update(struct drm_device *dev)
 {
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
 	struct nvc0_fifo_engine *fifo = nvc0_fifo(dev_priv->fifo);
-	int i, pos;
+	int i, n, pos;
 	struct pscnv_bo *vo;
 	fifo->cur_playlist ^= 1;
 	vo = fifo->playlist[fifo->cur_playlist];
-	for (i = 0, pos = 0; i < 128; i++) {
-		if (nv_rd32(dev, 0x3004 + i * 8) & 1) {
-			nv_wv32(vo, pos, i);
-			nv_wv32(vo, pos + 4, 0x4);
-			pos += 8;
-		}
+	for (i = 0; i < 128; i++)
+		fifo->pl_prio[i] = (nv_rd32(dev, 0x3004 + i * 8) & 1) ? 0 : -1;
+	pscnv_chan_sched_prio(dev, fifo->pl_prio);
+	n = pscnv_sched_build_playlist(fifo->pl_prio, fifo->pl_cur, 128, fifo->pl_cids,
+			ARRAY_SIZE(fifo->pl_cids));
+	for (i = 0, pos = 0; i < n; i++) {
+		nv_wv32(vo, pos, fifo->pl_cids[i]);
+		nv_wv32(vo, pos + 4, 0x4);
+		pos += 8;
 	}
 	dev_priv->vm->bar_flush(dev);
 
@@ -222,8 +237,47 @@ static void nvc0_fifo_chan_kill(struct pscnv_chan *ch)
 	spin_unlock_irqrestore(&dev_priv->context_switch_lock, flags);
 }
 
+static int nvc0_fifo_chan_sched(struct pscnv_chan *ch, int priority, uint32_t timeslice)
+{
+	struct drm_device *dev = ch->dev;
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	unsigned long flags;
+
+	spin_lock_irqsave(&dev_priv->chan->ch_lock, flags);
+	ch->priority = priority;
+	ch->timeslice = timeslice;
+	spin_unlock_irqrestore(&dev_priv->chan->ch_lock, flags);
+
+	spin_lock_irqsave(&dev_priv->context_switch_lock, flags);
+	/* not on PFIFO yet, chan_init_ib will pick the values up. */
+	if (!(nv_rd32(dev, 0x3004 + ch->cid * 8) & 1)) {
+		spin_unlock_irqrestore(&dev_priv->context_switch_lock, flags);
+		return 0;
+	}
+	nv_wv32(ch->bo, 0xf8, pscnv_sched_timeslice_nvc0(timeslice));
+	dev_priv->vm->bar_flush(dev);
+	/* kick it off PFIFO so that the new RAMFC gets loaded on the next
+	 * switch to it. */
+	nv_wr32(dev, 0x2634, ch->cid);
+	if (!nv_wait(dev, 0x2634, ~0, ch->cid))
+		NV_WARN(dev, "WARNING: 2634 = 0x%08x\n", nv_rd32(dev, 0x2634));
+	nvc0_fifo_playlist_update(dev);
+	spin_unlock_irqrestore(&dev_priv->context_switch_lock, flags);
+	return 0;
+}
+
 #define nvchan_wr32(chan, ofst, val)					\
 	DRM_WRITE32(fifo->fifo_ctl, ((chan)->cid * 0x1000 + ofst), val)
+#define nvchan_rd32(chan, ofst)						\
+	DRM_READ32(fifo->fifo_ctl, ((chan)->cid * 0x1000 + ofst))
+
+/* IB GET hasn't caught up with IB PUT */
+static int nvc0_fifo_chan_busy(struct pscnv_chan *ch)
+{
+	struct drm_nouveau_private *dev_priv = ch->dev->dev_private;
+	struct nvc0_fifo_engine *fifo = nvc0_fifo(dev_priv->fifo);
+	return nvchan_rd32(ch, 0x88) != nvchan_rd32(ch, 0x8c);
+}
 
 static int nvc0_fifo_chan_init_ib (struct pscnv_chan *ch, uint32_t pb_handle, uint32_t flags, uint32_t slimask, uint64_t ib_start, uint32_t ib_order) {
 	struct drm_device *dev = ch->dev;
@@ -267,7 +321,7 @@ static int nvc0_fifo_chan_init_ib (struct pscnv_chan *ch, uint32_t pb_handle, ui
 	nv_wv32(ch->bo, 0xac, 0x1f);
 	nv_wv32(ch->bo, 0x30, 0xfffff902);
 	/* nv_wv32(chan->vo, 0xb8, 0xf8000000); */ /* previously omitted */
-	nv_wv32(ch->bo, 0xf8, 0x10003080);
+	nv_wv32(ch->bo, 0xf8, pscnv_sched_timeslice_nvc0(ch->timeslice));
 	nv_wv32(ch->bo, 0xfc, 0x10000010);
 	dev_priv->vm->bar_flush(dev);
 
@@ -319,46 +373,73 @@ static const char *pgf_cause_str(uint32_t flags)
 	return "unknown cause";
 }
 
-static void nvc0_pfifo_page_fault(struct drm_device *dev, int unit)
+static void nvc0_pfifo_page_fault(struct drm_device *dev, struct pscnv_trap *t, int unit)
 {
 	uint64_t virt;
 	uint32_t chan, flags;
 
-	chan = nv_rd32(dev, 0x2800 + unit * 0x10) << 12;
-	virt = nv_rd32(dev, 0x2808 + unit * 0x10);
-	virt = (virt << 32) | nv_rd32(dev, 0x2804 + unit * 0x10);
-	flags = nv_rd32(dev, 0x280c + unit * 0x10);
+	chan = TRAP_RD(dev, t, 0x2800 + unit * 0x10) << 12;
+	virt = TRAP_RD(dev, t, 0x2808 + unit * 0x10);
+	virt = (virt << 32) | TRAP_RD(dev, t, 0x2804 + unit * 0x10);
+	flags = TRAP_RD(dev, t, 0x280c + unit * 0x10);
 
-	NV_INFO(dev, "%s PAGE FAULT at 0x%010llx (%c, %s)\n",
+	TRAP_INFO(dev, t, "%s PAGE FAULT at 0x%010llx (%c, %s)\n",
 		pgf_unit_str(unit), virt,
 		(flags & 0x80) ? 'w' : 'r', pgf_cause_str(flags));
 }
 
-static void nvc0_pfifo_subfifo_fault(struct drm_device *dev, int unit)
+static void nvc0_pfifo_subfifo_fault(struct drm_device *dev, struct pscnv_trap *t, int unit)
 {
-	int cid = nv_rd32(dev, 0x40120 + unit * 0x2000) & 0x7f;
-	int status = nv_rd32(dev, 0x40108 + unit * 0x2000);
-	uint32_t addr = nv_rd32(dev, 0x400c0 + unit * 0x2000);
-	uint32_t data = nv_rd32(dev, 0x400c4 + unit * 0x2000);
+	int cid = TRAP_RD(dev, t, 0x40120 + unit * 0x2000) & 0x7f;
+	int status = TRAP_RD(dev, t, 0x40108 + unit * 0x2000);
+	uint32_t addr = TRAP_RD(dev, t, 0x400c0 + unit * 0x2000);
+	uint32_t data = TRAP_RD(dev, t, 0x400c4 + unit * 0x2000);
 	int sub = addr >> 16 & 7;
 	int mthd = addr & 0x3ffc;
 	int mode = addr >> 21 & 7;
 
 	if (status & 0x200000) {
-		NV_INFO(dev, "PSUBFIFO %d ILLEGAL_MTHD: ch %d sub %d mthd %04x%s [mode %d] data %08x\n", unit, cid, sub, mthd, ((addr & 1)?" NI":""), mode, data);
-		nv_wr32(dev, 0x400c0 + unit * 0x2000, 0x80600008);
-		nv_wr32(dev, 0x40108 + unit * 0x2000, 0x200000);
+		TRAP_INFO(dev, t, "PSUBFIFO %d ILLEGAL_MTHD: ch %d sub %d mthd %04x%s [mode %d] data %08x\n", unit, cid, sub, mthd, ((addr & 1)?" NI":""), mode, data);
+		TRAP_WR(dev, t, 0x400c0 + unit * 0x2000, 0x80600008);
+		TRAP_WR(dev, t, 0x40108 + unit * 0x2000, 0x200000);
 		status &= ~0x200000;
 	}
 	if (status & 0x800000) {
-		NV_INFO(dev, "PSUBFIFO %d EMPTY_SUBCHANNEL: ch %d sub %d mthd %04x%s [mode %d] data %08x\n", unit, cid, sub, mthd, ((addr & 1)?" NI":""), mode, data);
-		nv_wr32(dev, 0x400c0 + unit * 0x2000, 0x80600008);
-		nv_wr32(dev, 0x40108 + unit * 0x2000, 0x800000);
+		TRAP_INFO(dev, t, "PSUBFIFO %d EMPTY_SUBCHANNEL: ch %d sub %d mthd %04x%s [mode %d] data %08x\n", unit, cid, sub, mthd, ((addr & 1)?" NI":""), mode, data);
+		TRAP_WR(dev, t, 0x400c0 + unit * 0x2000, 0x80600008);
+		TRAP_WR(dev, t, 0x40108 + unit * 0x2000, 0x800000);
 		status &= ~0x800000;
 	}
 	if (status) {
-		NV_INFO(dev, "unknown PSUBFIFO INTR: 0x%08x\n", status);
-		nv_wr32(dev, 0x4010c + unit * 0x2000, nv_rd32(dev, 0x4010c + unit * 0x2000) & ~status);
+		TRAP_INFO(dev, t, "unknown PSUBFIFO INTR: 0x%08x\n", status);
+		TRAP_WR(dev, t, 0x4010c + unit * 0x2000, nv_rd32(dev, 0x4010c + unit * 0x2000) & ~status);
+	}
+}
+
+/* The page fault and PSUBFIFO parts of the interrupt, status has which. */
+static void nvc0_fifo_trap(struct drm_device *dev, struct pscnv_trap *t, uint32_t status)
+{
+	if (status & 0x10000000) {
+		uint32_t bits = TRAP_RD(dev, t, 0x259c);
+		uint32_t units = bits;
+
+		while (units) {
+			int i = ffs(units) - 1;
+			units &= ~(1 << i);
+			nvc0_pfifo_page_fault(dev, t, i);
+		}
+		TRAP_WR(dev, t, 0x259c, bits); /* ack */
+	}
+
+	if (status & 0x20000000) {
+		uint32_t bits = TRAP_RD(dev, t, 0x25a0);
+		uint32_t units = bits;
+		while (units) {
+			int i = ffs(units) - 1;
+			units &= ~(1 << i);
+			nvc0_pfifo_subfifo_fault(dev, t, i);
+		}
+		TRAP_WR(dev, t, 0x25a0, bits); /* ack */
 	}
 }
 
@@ -374,29 +455,22 @@ static void nvc0_fifo_irq_handler(struct drm_device *dev, int irq)
 		status &= ~1;
 	}
 	
-	if (status & 0x10000000) {
-		uint32_t bits = nv_rd32(dev, 0x259c);
-		uint32_t units = bits;
-
-		while (units) {
-			int i = ffs(units) - 1;
-			units &= ~(1 << i);
-			nvc0_pfifo_page_fault(dev, i);
-		}
-		nv_wr32(dev, 0x259c, bits); /* ack */
-		status &= ~0x10000000;
+	if (status & 0x30000000) {
+		pscnv_trap_run(dev, nvc0_fifo_trap, status & 0x30000000);
+		status &= ~0x30000000;
 	}
 
-	if (status & 0x20000000) {
-		uint32_t bits = nv_rd32(dev, 0x25a0);
-		uint32_t units = bits;
+	if (status & 0x80000000) {
+		/* nonstall interrupt, aka UEVENT: per-engine status lives
+		 * in 0x25a8, bit 0 set by method 0x20 for fences. */
+		uint32_t units = nv_rd32(dev, 0x25a4);
 		while (units) {
 			int i = ffs(units) - 1;
 			units &= ~(1 << i);
-			nvc0_pfifo_subfifo_fault(dev, i);
+			nv_wr32(dev, 0x25a8 + i * 4, nv_rd32(dev, 0x25a8 + i * 4)); /* ack */
 		}
-		nv_wr32(dev, 0x25a0, bits); /* ack */
-		status &= ~0x20000000;
+		pscnv_fence_signal(dev);
+		status &= ~0x80000000;
 	}
 
 	if (status & 0x00000100) {
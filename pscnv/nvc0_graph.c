@@ -32,6 +32,7 @@
 #include "nvc0_vm.h"
 #include "nvc0_graph.h"
 #include "nvc0_pgraph.xml.h"
+#include "pscnv_trap.h"
 /*
  * If you want to use NVIDIA's firmware microcode, activate the macro:
  * #define USE_BLOB_UCODE 
@@ -562,6 +563,7 @@ nvc0_graph_init(struct drm_device *dev)
 						 NVC0_PGRAPH_CCACHE_HUB2GPC_ADDR);
 	if (!vo)
 		return -ENOMEM;
+	vo->kernel_map = 1;
 	ret = dev_priv->vm->map_kernel(vo);
 	if (ret)
 		return ret;
@@ -571,6 +573,7 @@ nvc0_graph_init(struct drm_device *dev)
 						 NVC0_PGRAPH_CCACHE_HUB2ESETUP_ADDR);
 	if (!vo)
 		return -ENOMEM;
+	vo->kernel_map = 1;
 	ret = dev_priv->vm->map_kernel(vo);
 	if (ret)
 		return ret;
@@ -580,6 +583,7 @@ nvc0_graph_init(struct drm_device *dev)
 						 GPC_BC(TP_BROADCAST_POLY_POLY2ESETUP));
 	if (!vo)
 		return -ENOMEM;
+	vo->kernel_map = 1;
 	ret = dev_priv->vm->map_kernel(vo);
 	if (ret)
 		return ret;
@@ -680,6 +684,7 @@ nvc0_graph_create_context_mmio_list(struct pscnv_vspace *vs,
 	vo = pscnv_mem_alloc(vs->dev, 0x1000, PSCNV_GEM_CONTIG, 0, 0x33101157);
 	if (!vo)
 		return -ENOMEM;
+	vo->kernel_map = 1;
 	nvc0_vs(vs)->mmio_bo = vo;
 
 	ret = dev_priv->vm->map_kernel(nvc0_vs(vs)->mmio_bo);
@@ -779,6 +784,7 @@ nvc0_graph_chan_alloc(struct pscnv_engine *eng, struct pscnv_chan *chan)
 								  0, 0x93ac0747);
 	if (!grch->grctx)
 		return -ENOMEM;
+	grch->grctx->kernel_map = 1;
 
 	ret = dev_priv->vm->map_kernel(grch->grctx);
 	if (ret)
@@ -922,106 +928,110 @@ pscnv_enum_find(const struct pscnv_enum *list, int val)
 }
 
 static void
-nvc0_graph_trap_handler(struct drm_device *dev, int cid)
+nvc0_graph_trap_handler(struct drm_device *dev, struct pscnv_trap *t, int cid)
 {
-	uint32_t status = nv_rd32(dev, NVC0_PGRAPH_TRAP);
-	uint32_t ustatus;
+	uint32_t status = TRAP_RD(dev, t, NVC0_PGRAPH_TRAP);
+	uint32_t ustatus, regs[7];
+	int i;
 
 	if (status & NVC0_PGRAPH_TRAP_DISPATCH) {
-		ustatus = nv_rd32(dev, NVC0_PGRAPH_DISPATCH_TRAP) & 0x7fffffff;
+		ustatus = TRAP_RD(dev, t, NVC0_PGRAPH_DISPATCH_TRAP) & 0x7fffffff;
 		if (ustatus & 0x00000001) {
-			NV_ERROR(dev, "PGRAPH_TRAP_DISPATCH: ch %d\n", cid);
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_DISPATCH: ch %d\n", cid);
 		}
 		if (ustatus & 0x00000002) {
-			NV_ERROR(dev, "PGRAPH_TRAP_QUERY: ch %d\n", cid);
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_QUERY: ch %d\n", cid);
 		}
 		ustatus &= ~0x00000003;
 		if (ustatus)
-			NV_ERROR(dev, "PGRAPH_TRAP_DISPATCH: unknown ustatus "
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_DISPATCH: unknown ustatus "
 				 "%08x on ch %d\n", ustatus, cid);
 
-		nv_wr32(dev, NVC0_PGRAPH_DISPATCH_TRAP, __TRAP_CLEAR_AND_ENABLE);
-		nv_wr32(dev, NVC0_PGRAPH_TRAP, NVC0_PGRAPH_TRAP_DISPATCH);
+		TRAP_WR(dev, t, NVC0_PGRAPH_DISPATCH_TRAP, __TRAP_CLEAR_AND_ENABLE);
+		TRAP_WR(dev, t, NVC0_PGRAPH_TRAP, NVC0_PGRAPH_TRAP_DISPATCH);
 		status &= ~NVC0_PGRAPH_TRAP_DISPATCH;
 	}
 
 	if (status & NVC0_PGRAPH_TRAP_M2MF) {
-		ustatus = nv_rd32(dev, NVC0_PGRAPH_M2MF_TRAP) & 0x7fffffff;
+		ustatus = TRAP_RD(dev, t, NVC0_PGRAPH_M2MF_TRAP) & 0x7fffffff;
+		if (ustatus & 7)
+			for (i = 0; i < 4; i++)
+				regs[i] = TRAP_RD(dev, t, NVC0_PGRAPH_M2MF_TRAP + 4 + i * 4);
 		if (ustatus & 1)
-			NV_ERROR(dev, "PGRAPH_TRAP_M2MF_NOTIFY: ch %d "
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_M2MF_NOTIFY: ch %d "
 				 "%08x %08x %08x %08x\n", cid,
-				 nv_rd32(dev, NVC0_PGRAPH_M2MF_TRAP + 0x04),
-				 nv_rd32(dev, NVC0_PGRAPH_M2MF_TRAP + 0x08),
-				 nv_rd32(dev, NVC0_PGRAPH_M2MF_TRAP + 0x0c),
-				 nv_rd32(dev, NVC0_PGRAPH_M2MF_TRAP + 0x10));
+				 regs[0], regs[1], regs[2], regs[3]);
 		if (ustatus & 2)
-			NV_ERROR(dev, "PGRAPH_TRAP_M2MF_IN: ch %d "
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_M2MF_IN: ch %d "
 				 "%08x %08x %08x %08x\n", cid,
-				 nv_rd32(dev, NVC0_PGRAPH_M2MF_TRAP + 0x04),
-				 nv_rd32(dev, NVC0_PGRAPH_M2MF_TRAP + 0x08),
-				 nv_rd32(dev, NVC0_PGRAPH_M2MF_TRAP + 0x0c),
-				 nv_rd32(dev, NVC0_PGRAPH_M2MF_TRAP + 0x10));
+				 regs[0], regs[1], regs[2], regs[3]);
 		if (ustatus & 4)
-			NV_ERROR(dev, "PGRAPH_TRAP_M2MF_OUT: ch %d "
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_M2MF_OUT: ch %d "
 				 "%08x %08x %08x %08x\n", cid,
-				 nv_rd32(dev, NVC0_PGRAPH_M2MF_TRAP + 0x04),
-				 nv_rd32(dev, NVC0_PGRAPH_M2MF_TRAP + 0x08),
-				 nv_rd32(dev, NVC0_PGRAPH_M2MF_TRAP + 0x0c),
-				 nv_rd32(dev, NVC0_PGRAPH_M2MF_TRAP + 0x10));
+				 regs[0], regs[1], regs[2], regs[3]);
 		ustatus &= ~0x00000007;
 		if (ustatus)
-			NV_ERROR(dev, "PGRAPH_TRAP_M2MF: unknown ustatus %08x "
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_M2MF: unknown ustatus %08x "
 				 "on ch %d\n", cid, ustatus);
-		nv_wr32(dev, NVC0_PGRAPH_M2MF_TRAP, __TRAP_CLEAR_AND_ENABLE);
-		nv_wr32(dev, NVC0_PGRAPH_TRAP, NVC0_PGRAPH_TRAP_M2MF);
+		TRAP_WR(dev, t, NVC0_PGRAPH_M2MF_TRAP, __TRAP_CLEAR_AND_ENABLE);
+		TRAP_WR(dev, t, NVC0_PGRAPH_TRAP, NVC0_PGRAPH_TRAP_M2MF);
 		status &= ~NVC0_PGRAPH_TRAP_M2MF;
 	}
 
 	if (status & NVC0_PGRAPH_TRAP_UNK4) {
-		ustatus = nv_rd32(dev, NVC0_PGRAPH_UNK5800_TRAP);
+		ustatus = TRAP_RD(dev, t, NVC0_PGRAPH_UNK5800_TRAP);
 		if (ustatus & (1 << 24))
-			NV_ERROR(dev, "PGRAPH_TRAP_SHADERS: VPA fail\n");
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_SHADERS: VPA fail\n");
 		if (ustatus & (1 << 25))
-			NV_ERROR(dev, "PGRAPH_TRAP_SHADERS: VPB fail\n");
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_SHADERS: VPB fail\n");
 		if (ustatus & (1 << 26))
-			NV_ERROR(dev, "PGRAPH_TRAP_SHADERS: TCP fail\n");
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_SHADERS: TCP fail\n");
 		if (ustatus & (1 << 27))
-			NV_ERROR(dev, "PGRAPH_TRAP_SHADERS: TEP fail\n");
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_SHADERS: TEP fail\n");
 		if (ustatus & (1 << 28))
-			NV_ERROR(dev, "PGRAPH_TRAP_SHADERS: GP fail\n");
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_SHADERS: GP fail\n");
 		if (ustatus & (1 << 29))
-			NV_ERROR(dev, "PGRAPH_TRAP_SHADERS: FP fail\n");
-		NV_ERROR(dev, "PGRAPH_TRAP_SHDERS: ustatus = %08x\n", ustatus);
-		nv_wr32(dev, NVC0_PGRAPH_UNK5800_TRAP, __TRAP_CLEAR_AND_ENABLE);
-		nv_wr32(dev, NVC0_PGRAPH_TRAP, NVC0_PGRAPH_TRAP_UNK4);
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_SHADERS: FP fail\n");
+		TRAP_ERROR(dev, t, "PGRAPH_TRAP_SHDERS: ustatus = %08x\n", ustatus);
+		TRAP_WR(dev, t, NVC0_PGRAPH_UNK5800_TRAP, __TRAP_CLEAR_AND_ENABLE);
+		TRAP_WR(dev, t, NVC0_PGRAPH_TRAP, NVC0_PGRAPH_TRAP_UNK4);
 		status &= ~NVC0_PGRAPH_TRAP_UNK4;
 	}
 
 	if (status & NVC0_PGRAPH_TRAP_MACRO) {
-		ustatus = nv_rd32(dev, NVC0_PGRAPH_MACRO_TRAP) & 0x7fffffff;
+		ustatus = TRAP_RD(dev, t, NVC0_PGRAPH_MACRO_TRAP) & 0x7fffffff;
+		if (ustatus & 0xf)
+			regs[0] = TRAP_RD(dev, t, 0x404424);
 		if (ustatus & NVC0_PGRAPH_MACRO_TRAP_TOO_FEW_PARAMS)
-			NV_ERROR(dev, "PGRAPH_TRAP_MACRO: TOO_FEW_PARAMS %08x\n",
-				 nv_rd32(dev, 0x404424));
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_MACRO: TOO_FEW_PARAMS %08x\n",
+				 regs[0]);
 		if (ustatus & NVC0_PGRAPH_MACRO_TRAP_TOO_MANY_PARAMS)
-			NV_ERROR(dev, "PGRAPH_TRAP_MACRO: TOO_MANY_PARAMS %08x\n",
-				 nv_rd32(dev, 0x404424));
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_MACRO: TOO_MANY_PARAMS %08x\n",
+				 regs[0]);
 		if (ustatus & NVC0_PGRAPH_MACRO_TRAP_ILLEGAL_OPCODE)
-			NV_ERROR(dev, "PGRAPH_TRAP_MACRO: ILLEGAL_OPCODE %08x\n",
-				 nv_rd32(dev, 0x404424));
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_MACRO: ILLEGAL_OPCODE %08x\n",
+				 regs[0]);
 		if (ustatus & NVC0_PGRAPH_MACRO_TRAP_DOUBLE_BRANCH)
-			NV_ERROR(dev, "PGRAPH_TRAP_MACRO: DOUBLE_BRANCH %08x\n",
-				 nv_rd32(dev, 0x404424));
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_MACRO: DOUBLE_BRANCH %08x\n",
+				 regs[0]);
 		ustatus &= ~0xf;
 		if (ustatus)
-			NV_ERROR(dev, "PGRAPH_TRAP_MACRO: unknown ustatus %08x\n", ustatus);
-		nv_wr32(dev, NVC0_PGRAPH_MACRO_TRAP, __TRAP_CLEAR_AND_ENABLE);
-		nv_wr32(dev, NVC0_PGRAPH_TRAP, NVC0_PGRAPH_TRAP_MACRO);
+			TRAP_ERROR(dev, t, "PGRAPH_TRAP_MACRO: unknown ustatus %08x\n", ustatus);
+		TRAP_WR(dev, t, NVC0_PGRAPH_MACRO_TRAP, __TRAP_CLEAR_AND_ENABLE);
+		TRAP_WR(dev, t, NVC0_PGRAPH_TRAP, NVC0_PGRAPH_TRAP_MACRO);
 		status &= ~NVC0_PGRAPH_TRAP_MACRO;
 	}
 
 	if (status) {
-		NV_ERROR(dev, "PGRAPH: unknown trap %08x on ch %d\n", status, cid);
-		NV_INFO(dev,
+		regs[0] = TRAP_RD(dev, t, NVC0_PGRAPH_DISPATCH_TRAP);
+		regs[1] = TRAP_RD(dev, t, NVC0_PGRAPH_M2MF_TRAP);
+		regs[2] = TRAP_RD(dev, t, NVC0_PGRAPH_CCACHE_TRAP);
+		regs[3] = TRAP_RD(dev, t, NVC0_PGRAPH_UNK6000_TRAP_UNK0);
+		regs[4] = TRAP_RD(dev, t, NVC0_PGRAPH_UNK6000_TRAP_UNK1);
+		regs[5] = TRAP_RD(dev, t, NVC0_PGRAPH_MACRO_TRAP);
+		regs[6] = TRAP_RD(dev, t, NVC0_PGRAPH_UNK5800_TRAP);
+		TRAP_ERROR(dev, t, "PGRAPH: unknown trap %08x on ch %d\n", status, cid);
+		TRAP_INFO(dev, t,
 				"DISPATCH_TRAP = %08x\n"
 				"M2MF_TRAP = %08x\n"
 				"CCACHE_TRAP = %08x\n"
@@ -1029,19 +1039,15 @@ nvc0_graph_trap_handler(struct drm_device *dev, int cid)
 				"UNK6000_TRAP_UNK1 = %08x\n"
 				"MACRO_TRAP = %08x\n"
 				"UNK5800_TRAP = %08x\n",
-				nv_rd32(dev, NVC0_PGRAPH_DISPATCH_TRAP),
-				nv_rd32(dev, NVC0_PGRAPH_M2MF_TRAP),
-				nv_rd32(dev, NVC0_PGRAPH_CCACHE_TRAP),
-				nv_rd32(dev, NVC0_PGRAPH_UNK6000_TRAP_UNK0),
-				nv_rd32(dev, NVC0_PGRAPH_UNK6000_TRAP_UNK1),
-				nv_rd32(dev, NVC0_PGRAPH_MACRO_TRAP),
-				nv_rd32(dev, NVC0_PGRAPH_UNK5800_TRAP));
-
-		nv_wr32(dev, NVC0_PGRAPH_TRAP, status);
+				regs[0], regs[1], regs[2], regs[3],
+				regs[4], regs[5], regs[6]);
+
+		TRAP_WR(dev, t, NVC0_PGRAPH_TRAP, status);
 	}
 }
 
-void nvc0_graph_irq_handler(struct drm_device *dev, int irq)
+static void
+nvc0_graph_irq(struct drm_device *dev, struct pscnv_trap *t, uint32_t arg)
 {
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
 	struct nvc0_graph_engine *graph;
@@ -1049,100 +1055,104 @@ void nvc0_graph_irq_handler(struct drm_device *dev, int irq)
 	uint32_t pgraph, addr, datal, datah, ecode, grcl, subc, mthd;
 	int cid;
 #define PGRAPH_ERROR(name)												\
-	NV_ERROR(dev, "%s: st %08x ch %d sub %d [%04x] mthd %04x data %08x%08x\n", \
+	TRAP_ERROR(dev, t, "%s: st %08x ch %d sub %d [%04x] mthd %04x data %08x%08x\n", \
 			 name, pgraph, cid, subc, grcl, mthd, datah, datal);
 
 	graph = NVC0_GRAPH(dev_priv->engines[PSCNV_ENGINE_GRAPH]);
 
-	status = nv_rd32(dev, NVC0_PGRAPH_INTR);
-	ecode = nv_rd32(dev, NVC0_PGRAPH_DATA_ERROR);
-	pgraph = nv_rd32(dev, NVC0_PGRAPH_STATUS);
-	addr = nv_rd32(dev, NVC0_PGRAPH_TRAPPED_ADDR);
+	status = TRAP_RD(dev, t, NVC0_PGRAPH_INTR);
+	ecode = TRAP_RD(dev, t, NVC0_PGRAPH_DATA_ERROR);
+	pgraph = TRAP_RD(dev, t, NVC0_PGRAPH_STATUS);
+	addr = TRAP_RD(dev, t, NVC0_PGRAPH_TRAPPED_ADDR);
 	mthd = addr & NVC0_PGRAPH_TRAPPED_ADDR_MTHD__MASK;
 	subc = (addr & NVC0_PGRAPH_TRAPPED_ADDR_SUBCH__MASK) >> 
 		NVC0_PGRAPH_TRAPPED_ADDR_SUBCH__SHIFT;
-	datal = nv_rd32(dev, NVC0_PGRAPH_TRAPPED_DATA_LOW);
-	datah = nv_rd32(dev, NVC0_PGRAPH_TRAPPED_DATA_HIGH);
-	grcl = nv_rd32(dev, NVC0_PGRAPH_DISPATCH_CTX_SWITCH) & 0xffff;
+	datal = TRAP_RD(dev, t, NVC0_PGRAPH_TRAPPED_DATA_LOW);
+	datah = TRAP_RD(dev, t, NVC0_PGRAPH_TRAPPED_DATA_HIGH);
+	grcl = TRAP_RD(dev, t, NVC0_PGRAPH_DISPATCH_CTX_SWITCH) & 0xffff;
 	cid = -1;
 
 	if (status & NVC0_PGRAPH_INTR_NOTIFY) {
 		PGRAPH_ERROR("PGRAPH_NOTIFY");
-		nv_wr32(dev, NVC0_PGRAPH_INTR, NVC0_PGRAPH_INTR_NOTIFY);
+		TRAP_WR(dev, t, NVC0_PGRAPH_INTR, NVC0_PGRAPH_INTR_NOTIFY);
 		status &= ~NVC0_PGRAPH_INTR_NOTIFY;
 	}
 	if (status & NVC0_PGRAPH_INTR_QUERY) {
 		PGRAPH_ERROR("PGRAPH_QUERY");
-		nv_wr32(dev, NVC0_PGRAPH_INTR, NVC0_PGRAPH_INTR_QUERY);
+		TRAP_WR(dev, t, NVC0_PGRAPH_INTR, NVC0_PGRAPH_INTR_QUERY);
 		status &= ~NVC0_PGRAPH_INTR_QUERY;
 	}
 	if (status & NVC0_PGRAPH_INTR_SYNC) {
 		PGRAPH_ERROR("PGRAPH_SYNC");
-		nv_wr32(dev, NVC0_PGRAPH_INTR, NVC0_PGRAPH_INTR_SYNC);
+		TRAP_WR(dev, t, NVC0_PGRAPH_INTR, NVC0_PGRAPH_INTR_SYNC);
 		status &= ~NVC0_PGRAPH_INTR_SYNC;
 	}
 	if (status & NVC0_PGRAPH_INTR_ILLEGAL_MTHD) {
 		PGRAPH_ERROR("PGRAPH_ILLEGAL_MTHD");
-		nv_wr32(dev, NVC0_PGRAPH_INTR, NVC0_PGRAPH_INTR_ILLEGAL_MTHD);
+		TRAP_WR(dev, t, NVC0_PGRAPH_INTR, NVC0_PGRAPH_INTR_ILLEGAL_MTHD);
 		status &= ~NVC0_PGRAPH_INTR_ILLEGAL_MTHD;
 	}
 	if (status & NVC0_PGRAPH_INTR_ILLEGAL_CLASS) {
 		PGRAPH_ERROR("PGRAPH_ILLEGAL_CLASS");
-		nv_wr32(dev, NVC0_PGRAPH_INTR, NVC0_PGRAPH_INTR_ILLEGAL_CLASS);
+		TRAP_WR(dev, t, NVC0_PGRAPH_INTR, NVC0_PGRAPH_INTR_ILLEGAL_CLASS);
 		status &= ~NVC0_PGRAPH_INTR_ILLEGAL_CLASS;
 	}
 	if (status & NVC0_PGRAPH_INTR_DOUBLE_NOTIFY) {
 		PGRAPH_ERROR("PGRAPH_DOUBLE_NOITFY");
-		nv_wr32(dev, NVC0_PGRAPH_INTR, NVC0_PGRAPH_INTR_DOUBLE_NOTIFY);
+		TRAP_WR(dev, t, NVC0_PGRAPH_INTR, NVC0_PGRAPH_INTR_DOUBLE_NOTIFY);
 		status &= ~NVC0_PGRAPH_INTR_DOUBLE_NOTIFY;
 	}
 	if (status & NVC0_PGRAPH_INTR_UNK7) {
 		PGRAPH_ERROR("PGRAPH_UNK7");
-		nv_wr32(dev, NVC0_PGRAPH_INTR, NVC0_PGRAPH_INTR_UNK7);
+		TRAP_WR(dev, t, NVC0_PGRAPH_INTR, NVC0_PGRAPH_INTR_UNK7);
 		status &= ~NVC0_PGRAPH_INTR_UNK7;
 	}
 	if (status & NVC0_PGRAPH_INTR_FIRMWARE_MTHD) {
 		PGRAPH_ERROR("PGRAPH_FIRMWARE_MTHD");
-		nv_wr32(dev, NVC0_PGRAPH_INTR, NVC0_PGRAPH_INTR_FIRMWARE_MTHD);
+		TRAP_WR(dev, t, NVC0_PGRAPH_INTR, NVC0_PGRAPH_INTR_FIRMWARE_MTHD);
 		status &= ~NVC0_PGRAPH_INTR_FIRMWARE_MTHD;
 	}
 	if (status & NVC0_PGRAPH_INTR_BUFFER_NOTIFY) {
 		PGRAPH_ERROR("PGRAPH_BUFFER_NOTIFY");
-		nv_wr32(dev, NVC0_PGRAPH_INTR, NVC0_PGRAPH_INTR_BUFFER_NOTIFY);
+		TRAP_WR(dev, t, NVC0_PGRAPH_INTR, NVC0_PGRAPH_INTR_BUFFER_NOTIFY);
 		status &= ~NVC0_PGRAPH_INTR_BUFFER_NOTIFY;
 	}
 	if (status & NVC0_PGRAPH_INTR_CTXCTL_UP) {
 		PGRAPH_ERROR("PGRAPH_CTXCTL_UP");
-		nv_wr32(dev, NVC0_PGRAPH_INTR, NVC0_PGRAPH_INTR_CTXCTL_UP);
+		TRAP_WR(dev, t, NVC0_PGRAPH_INTR, NVC0_PGRAPH_INTR_CTXCTL_UP);
 		status &= ~NVC0_PGRAPH_INTR_CTXCTL_UP;
 	}
 	if (status & NVC0_PGRAPH_INTR_DATA_ERROR) {
 		const struct pscnv_enum *ev;
 		ev = pscnv_enum_find(dispatch_errors, ecode);
 		if (ev) {
-			NV_ERROR(dev, "PGRAPH_DATA_ERROR [%s]", ev->name);
+			TRAP_ERROR(dev, t, "PGRAPH_DATA_ERROR [%s]", ev->name);
 			PGRAPH_ERROR("");
 		} else {
-			NV_ERROR(dev, "PGRAPH_DATA_ERROR [%x]", ecode);
+			TRAP_ERROR(dev, t, "PGRAPH_DATA_ERROR [%x]", ecode);
 		}
-		nv_wr32(dev, NVC0_PGRAPH_INTR, NVC0_PGRAPH_INTR_DATA_ERROR);
+		TRAP_WR(dev, t, NVC0_PGRAPH_INTR, NVC0_PGRAPH_INTR_DATA_ERROR);
 		status &= ~NVC0_PGRAPH_INTR_DATA_ERROR;
 	}
 	if (status & NVC0_PGRAPH_INTR_TRAP) {
-		nvc0_graph_trap_handler(dev, cid);
-		nv_wr32(dev, NVC0_PGRAPH_INTR, NVC0_PGRAPH_INTR_TRAP);
+		nvc0_graph_trap_handler(dev, t, cid);
+		TRAP_WR(dev, t, NVC0_PGRAPH_INTR, NVC0_PGRAPH_INTR_TRAP);
 		status &= ~NVC0_PGRAPH_INTR_TRAP;
 	}
 	if (status & NVC0_PGRAPH_INTR_SINGLE_STEP) {
 		PGRAPH_ERROR("PGRAPH_SINGLE_STEP");
-		nv_wr32(dev, NVC0_PGRAPH_INTR, NVC0_PGRAPH_INTR_SINGLE_STEP);
+		TRAP_WR(dev, t, NVC0_PGRAPH_INTR, NVC0_PGRAPH_INTR_SINGLE_STEP);
 		status &= ~NVC0_PGRAPH_INTR_SINGLE_STEP;
 	}
 	if (status) {
-		NV_ERROR(dev, "Unknown PGRAPH interrupt(s) %08x\n", status);
+		TRAP_ERROR(dev, t, "Unknown PGRAPH interrupt(s) %08x\n", status);
 		PGRAPH_ERROR("PGRAPH");
-		nv_wr32(dev, NVC0_PGRAPH_INTR, status);
+		TRAP_WR(dev, t, NVC0_PGRAPH_INTR, status);
 	}
+}
 
+void nvc0_graph_irq_handler(struct drm_device *dev, int irq)
+{
+	pscnv_trap_run(dev, nvc0_graph_irq, 0);
 	nv_wr32(dev, NVC0_PGRAPH_FIFO_CONTROL, (1 << 16) | 1);
 }
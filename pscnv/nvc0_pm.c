@@ -177,14 +177,31 @@ struct nvc0_pm_clock {
 	u32 coef;
 };
 
+/* A PDAEMON memory reclock script. */
+struct nvc0_pm_script {
+	u32 out[0x400];
+	u32 pos;
+};
+
+/*
+ * Everything needed to switch to a perflvl, kept in its clocks_state
+ * once worked out. The engine clocks only depend on the perflvl and the
+ * VBIOS, so they're done by nvc0_pm_clocks_prepare at nouveau_perf_init
+ * time. The memory clock is done on the first switch that needs it, as
+ * it may have to turn on the PLL it derives from, and the memory script
+ * reads back the state the memory controller is in, so there's one for
+ * each perflvl it's run from, built the first time we come from there.
+ * A switch then only has to upload a script and program the clocks.
+ */
 struct nvc0_pm_state {
 	struct drm_device *dev;
 	struct nouveau_pm_level *perflvl;
 	struct nvc0_pm_clock eng[16];
 	struct nvc0_pm_clock mem;
-	u32 mem_out[0x400];
-	u32 mem_pos;
 	u32 mem_10f808;
+	/* by the perflvl we come from, boot last */
+	struct nvc0_pm_script *script[NOUVEAU_PM_MAX_LEVEL + 1];
+	struct nvc0_pm_script *run;	/* what clocks_set has to run */
 };
 
 static u32
@@ -368,13 +385,13 @@ static void init_mem(struct drm_device *dev)
 	}
 }
 
-static int run_mem(struct drm_device *dev, struct nvc0_pm_state *state)
+static int run_mem(struct drm_device *dev, struct nvc0_pm_script *script)
 {
 	int i, ret;
 	/* Upload our script to D[0x800] onward */
 	nv_wr32(dev, 0x10a1c0, 0x01000800);
-	for (i = 0; i < state->mem_pos; ++i)
-		nv_wr32(dev, 0x10a1c4, state->mem_out[i]);
+	for (i = 0; i < script->pos; ++i)
+		nv_wr32(dev, 0x10a1c4, script->out[i]);
 
 	/* Clear area around stack pointer (used for debug mode mostly) */
 	nv_wr32(dev, 0x10a1c0, 0x010055c0);
@@ -406,14 +423,10 @@ static int run_mem(struct drm_device *dev, struct nvc0_pm_state *state)
 static int
 calc_mem(struct drm_device *dev, struct nvc0_pm_clock *info, u32 freq)
 {
-	struct drm_nouveau_private *dev_priv = dev->dev_private;
 	struct pll_lims pll;
 	int N, M, P, ret;
 	u32 ctrl;
 
-	if (dev_priv->engine.pm.cur == &dev_priv->engine.pm.boot)
-		init_mem(dev);
-
 	/* mclk pll input freq comes from another pll, make sure it's on */
 	ctrl = nv_rd32(dev, 0x132020);
 	if (!(ctrl & 0x00000001)) {
@@ -458,8 +471,8 @@ calc_mem(struct drm_device *dev, struct nvc0_pm_clock *info, u32 freq)
 	return -EINVAL;
 }
 
-void *
-nvc0_pm_clocks_pre(struct drm_device *dev, struct nouveau_pm_level *perflvl)
+static struct nvc0_pm_state *
+calc_state(struct drm_device *dev, struct nouveau_pm_level *perflvl)
 {
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
 	struct nvc0_pm_state *info;
@@ -489,19 +502,97 @@ nvc0_pm_clocks_pre(struct drm_device *dev, struct nouveau_pm_level *perflvl)
 		kfree(info);
 		return ERR_PTR(ret);
 	}
-	if (perflvl->memory && dev_priv->engine.pm.cur->memory != perflvl->memory && dev_priv->vram_type == NV_MEM_TYPE_GDDR5) {
-		ret = calc_mem(dev, &info->mem, perflvl->memory);
-		if (ret) {
-			kfree(info);
-			return ERR_PTR(ret);
-		}
-	}
 
 	info->perflvl = perflvl;
 	info->dev = dev;
 	return info;
 }
 
+int
+nvc0_pm_clocks_prepare(struct drm_device *dev, struct nouveau_pm_level *perflvl)
+{
+	struct nvc0_pm_state *info;
+
+	if (perflvl->clocks_state)
+		return 0;
+	info = calc_state(dev, perflvl);
+	if (IS_ERR(info))
+		return PTR_ERR(info);
+	perflvl->clocks_state = info;
+	return 0;
+}
+
+static void
+free_state(struct nvc0_pm_state *info)
+{
+	int i;
+
+	if (!info)
+		return;
+	for (i = 0; i <= NOUVEAU_PM_MAX_LEVEL; i++)
+		kfree(info->script[i]);
+	kfree(info);
+}
+
+void
+nvc0_pm_clocks_flush(struct drm_device *dev)
+{
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	struct nouveau_pm_engine *pm = &dev_priv->engine.pm;
+	int i;
+
+	for (i = 0; i < pm->nr_perflvl; i++) {
+		free_state(pm->perflvl[i].clocks_state);
+		pm->perflvl[i].clocks_state = NULL;
+	}
+	free_state(pm->boot.clocks_state);
+	pm->boot.clocks_state = NULL;
+}
+
+static void build_mem(struct drm_device *dev, struct nvc0_pm_state *info);
+
+void *
+nvc0_pm_clocks_pre(struct drm_device *dev, struct nouveau_pm_level *perflvl)
+{
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	struct nouveau_pm_engine *pm = &dev_priv->engine.pm;
+	struct nvc0_pm_state *info;
+	int ret, from;
+
+	ret = nvc0_pm_clocks_prepare(dev, perflvl);
+	if (ret)
+		return ERR_PTR(ret);
+	info = perflvl->clocks_state;
+	info->run = NULL;
+
+	if (perflvl->memory && pm->cur->memory != perflvl->memory && dev_priv->vram_type == NV_MEM_TYPE_GDDR5) {
+		if (pm->cur == &pm->boot)
+			init_mem(dev);
+		if (!info->mem.freq) {
+			ret = calc_mem(dev, &info->mem, perflvl->memory);
+			if (ret)
+				return ERR_PTR(ret);
+		}
+
+		/* scripts from boot go in the last slot */
+		for (from = 0; from < pm->nr_perflvl; from++)
+			if (pm->cur == &pm->perflvl[from])
+				break;
+		if (from == pm->nr_perflvl)
+			from = NOUVEAU_PM_MAX_LEVEL;
+		info->run = info->script[from];
+		if (!info->run) {
+			info->run = kzalloc(sizeof(*info->run), GFP_KERNEL);
+			if (!info->run)
+				return ERR_PTR(-ENOMEM);
+			build_mem(dev, info);
+			info->script[from] = info->run;
+		}
+	}
+
+	return info;
+}
+
 static void
 prog_clk(struct drm_device *dev, int clk, struct nvc0_pm_clock *info)
 {
@@ -542,10 +633,11 @@ prog_clk(struct drm_device *dev, int clk, struct nvc0_pm_clock *info)
 static void fuc_emit(struct nvc0_pm_state *info, enum fuc_ops func, u32 len_args, u32 args[], u32 saveret)
 {
 	u32 j;
-	info->mem_out[info->mem_pos++] = (8 + 4 * len_args) | (saveret << 31);
-	info->mem_out[info->mem_pos++] = nvc0_pdaemon_pointers[func];
+	struct nvc0_pm_script *script = info->run;
+	script->out[script->pos++] = (8 + 4 * len_args) | (saveret << 31);
+	script->out[script->pos++] = nvc0_pdaemon_pointers[func];
 	for (j = 0; j < len_args; ++j)
-		info->mem_out[info->mem_pos++] = args[j];
+		script->out[script->pos++] = args[j];
 
 	switch (func) {
 		case fuc_ops_mmwrs:
@@ -737,7 +829,7 @@ mclk_clock_set(struct nouveau_mem_exec_func *exec)
 //up: 10f824: 0x7e77 -> 0x7fd4 (setting 0x100, altering low bits
 //down: 10f824: 0x7fd4 -> 0x7e54 (old & 0x77) -> 7e77 (setting new bits)
 
-	nv_wr32(dev, 0x137360, 0x00000001);
+	/* 0x137360 is set by nvc0_pm_clocks_set, scripts are built ahead */
 	fuc_wr32(info, 0x10f090, 0x61);
 	fuc_wr32(info, 0x10f090, 0xc000007f);
 	fuc_sleep(info, 1000);
@@ -835,7 +927,7 @@ mclk_timing_set(struct nouveau_mem_exec_func *exec)
 }
 
 static void
-prog_mem(struct drm_device *dev, struct nvc0_pm_state *info)
+build_mem(struct drm_device *dev, struct nvc0_pm_state *info)
 {
 	struct nouveau_mem_exec_func exec = {
 		.dev = dev,
@@ -900,8 +992,17 @@ prog_mem(struct drm_device *dev, struct nvc0_pm_state *info)
 	}
 	fuc_wr32(info, 0x100b0c, nv_rd32(dev, 0x100b0c));
 	fuc_emit(info, fuc_ops_done, 0, 0, 0);
-	run_mem(dev, info);
+}
+
+static int
+prog_mem(struct drm_device *dev, struct nvc0_pm_state *info)
+{
+	int ret;
+
+	nv_wr32(dev, 0x137360, 0x00000001);
+	ret = run_mem(dev, info->run);
 	nv_mask(dev, 0x10f200, 0x800, 0x800);
+	return ret;
 }
 
 int
@@ -909,10 +1010,16 @@ nvc0_pm_clocks_set(struct drm_device *dev, void *data)
 {
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
 	struct nvc0_pm_state *info = data;
-	int i;
+	int i, ret;
 
-	if (info->mem.freq && dev_priv->vram_type == NV_MEM_TYPE_GDDR5)
-		prog_mem(dev, info);
+	if (info->run && dev_priv->vram_type == NV_MEM_TYPE_GDDR5) {
+		ret = prog_mem(dev, info);
+		if (ret) {
+			/* memory isn't where the scripts expect it anymore */
+			nvc0_pm_clocks_flush(dev);
+			return ret;
+		}
+	}
 
 	for (i = 0; i < 16; i++) {
 		if (!info->eng[i].freq)
@@ -920,6 +1027,5 @@ nvc0_pm_clocks_set(struct drm_device *dev, void *data)
 		prog_clk(dev, i, &info->eng[i]);
 	}
 
-	kfree(info);
 	return 0;
 }
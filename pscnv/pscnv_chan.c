@@ -32,6 +32,8 @@
 #include "pscnv_chan.h"
 #include "pscnv_fifo.h"
 #include "pscnv_ioctl.h"
+#include "pscnv_sched.h"
+#include "pscnv_fence.h"
 
 static int pscnv_chan_bind (struct pscnv_chan *ch, int fake) {
 	struct drm_nouveau_private *dev_priv = ch->dev->dev_private;
@@ -59,10 +61,44 @@ static int pscnv_chan_bind (struct pscnv_chan *ch, int fake) {
 	}
 }
 
+/* ch_lock must be held. */
+static void pscnv_chan_unhash (struct pscnv_chan *ch) {
+	struct drm_nouveau_private *dev_priv = ch->dev->dev_private;
+	struct pscnv_chan **pp;
+	if (!ch->handle || ch->handle == 0xffffffff)
+		return;
+	pp = &dev_priv->chan->handle_hash[pscnv_chan_handle_hash(ch->handle)];
+	while (*pp != ch) {
+		BUG_ON(!*pp);
+		pp = &(*pp)->handle_next;
+	}
+	*pp = ch->handle_next;
+	ch->handle_next = 0;
+}
+
+/* Sets the instance address used to find the channel from trap and fault
+ * reports. 0 and 0xffffffff mean none. */
+void pscnv_chan_set_handle (struct pscnv_chan *ch, uint32_t handle) {
+	struct drm_nouveau_private *dev_priv = ch->dev->dev_private;
+	unsigned long flags;
+	struct pscnv_chan **bucket;
+	spin_lock_irqsave(&dev_priv->chan->ch_lock, flags);
+	pscnv_chan_unhash(ch);
+	ch->handle = handle;
+	if (handle && handle != 0xffffffff) {
+		bucket = &dev_priv->chan->handle_hash[pscnv_chan_handle_hash(handle)];
+		ch->handle_next = *bucket;
+		*bucket = ch;
+	}
+	spin_unlock_irqrestore(&dev_priv->chan->ch_lock, flags);
+}
+
 static void pscnv_chan_unbind (struct pscnv_chan *ch) {
 	struct drm_nouveau_private *dev_priv = ch->dev->dev_private;
 	unsigned long flags;
 	spin_lock_irqsave(&dev_priv->chan->ch_lock, flags);
+	pscnv_chan_unhash(ch);
+	ch->handle = 0;
 	if (ch->cid < 0) {
 		BUG_ON(dev_priv->chan->fake_chans[-ch->cid] != ch);
 		dev_priv->chan->fake_chans[-ch->cid] = 0;
@@ -85,6 +121,7 @@ pscnv_chan_new (struct drm_device *dev, struct pscnv_vspace *vs, int fake) {
 	res->dev = dev;
 	res->vspace = vs;
 	res->handle = 0xffffffff;
+	res->priority = PSCNV_CHAN_PRIO_NORMAL;
 	if (vs)
 		pscnv_vspace_ref(vs);
 	spin_lock_init(&res->instlock);
@@ -125,6 +162,7 @@ void pscnv_chan_ref_free(struct kref *ref) {
 				eng->chan_free(eng, ch);
 			}
 	}
+	pscnv_fence_chan_free(ch);
 	dev_priv->chan->do_chan_free(ch);
 	pscnv_chan_unbind(ch);
 	if (ch->bo && ch->bo->gem)
@@ -209,30 +247,52 @@ int pscnv_chan_mmap(struct file *filp, struct vm_area_struct *vma)
 
 #endif
 
+/* Returns the cid of the channel with the given instance address, which
+ * is negative for fake channels, or 128 if there's none. Called from
+ * the IRQ handlers. */
 int pscnv_chan_handle_lookup(struct drm_device *dev, uint32_t handle) {
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
 	unsigned long flags;
 	struct pscnv_chan *res;
+	int cid = 128;
+	spin_lock_irqsave(&dev_priv->chan->ch_lock, flags);
+	for (res = dev_priv->chan->handle_hash[pscnv_chan_handle_hash(handle)]; res; res = res->handle_next)
+		if (res->handle == handle) {
+			cid = res->cid;
+			break;
+		}
+	spin_unlock_irqrestore(&dev_priv->chan->ch_lock, flags);
+	return cid;
+}
+
+/* Replaces the non-negative entries of prio[128] (channels enabled on
+ * PFIFO) with the priorities of these channels. */
+void pscnv_chan_sched_prio(struct drm_device *dev, int *prio) {
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	unsigned long flags;
+	struct pscnv_chan *ch;
 	int i;
 	spin_lock_irqsave(&dev_priv->chan->ch_lock, flags);
 	for (i = 0; i < 128; i++) {
-		res = dev_priv->chan->chans[i];
-		if (!res)
-			continue;
-		if (res->bo->start >> 12 != handle)
-			continue;
-		spin_unlock_irqrestore(&dev_priv->chan->ch_lock, flags);
-		return i;
-	}
-	for (i = 0; i < 4; i++) {
-		res = dev_priv->chan->fake_chans[i];
-		if (!res)
+		if (prio[i] < 0)
 			continue;
-		if (res->handle != handle)
-			continue;
-		spin_unlock_irqrestore(&dev_priv->chan->ch_lock, flags);
-		return -i;
+		ch = dev_priv->chan->chans[i];
+		prio[i] = ch ? ch->priority : PSCNV_CHAN_PRIO_NORMAL;
 	}
 	spin_unlock_irqrestore(&dev_priv->chan->ch_lock, flags);
-	return 128;
+}
+
+/* Whether any channel still has work queued for PFIFO to fetch. */
+int pscnv_chan_busy(struct drm_device *dev) {
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	unsigned long flags;
+	int i, res = 0;
+	if (!dev_priv->fifo || !dev_priv->fifo->chan_busy)
+		return 0;
+	spin_lock_irqsave(&dev_priv->chan->ch_lock, flags);
+	for (i = dev_priv->chan->ch_min; i <= dev_priv->chan->ch_max && !res; i++)
+		if (dev_priv->chan->chans[i])
+			res = dev_priv->fifo->chan_busy(dev_priv->chan->chans[i]);
+	spin_unlock_irqrestore(&dev_priv->chan->ch_lock, flags);
+	return res;
 }
@@ -37,27 +37,48 @@ extern uint64_t nvc0_fifo_ctrl_offs(struct drm_device *dev, int cid);
 struct pscnv_chan {
 	struct drm_device *dev;
 	int cid;
-	/* protected by ch_lock below, used for lookup */
+	/* protected by ch_lock below, used for lookup. Only change it
+	 * through pscnv_chan_set_handle, it's hashed. */
 	uint32_t handle;
+	struct pscnv_chan *handle_next;
 	struct pscnv_vspace *vspace;
 	struct list_head vspace_list;
 	struct pscnv_bo *bo;
-	spinlock_t instlock;
+	spinlock_t instlock;	/* irqsave, like context_switch_lock */
 	int instpos;
+	/* NV50 instance object allocator, see nv50_chan_iobj_new */
+	uint32_t *instmap;
 	struct pscnv_ramht ramht;
 	uint32_t ramfc;
 	struct pscnv_bo *cache;
 	struct drm_file *filp;
+	/* protected by ch_lock, read when building the playlist */
+	int priority;
+	uint32_t timeslice;
+	/* fence sequence word, see pscnv_fence.c */
+	struct pscnv_bo *fence_bo;
+	struct pscnv_mm_node *fence_map;
+	volatile uint32_t *fence_cpu;
 	struct kref ref;
 	void *engdata[PSCNV_ENGINES_NUM];
 };
 
+#define PSCNV_CHAN_HASH_BITS 8
+
+/* instance addresses are page numbers of 4kiB or 64kiB-aligned BOs, so
+ * mix the high bits down instead of just masking. */
+static inline uint32_t pscnv_chan_handle_hash(uint32_t handle) {
+	return (handle * 0x9e370001u) >> (32 - PSCNV_CHAN_HASH_BITS);
+}
+
 struct pscnv_chan_engine {
 	void (*takedown) (struct drm_device *dev);
 	int (*do_chan_new) (struct pscnv_chan *ch);
 	void (*do_chan_free) (struct pscnv_chan *ch);
 	struct pscnv_chan *fake_chans[4];
 	struct pscnv_chan *chans[128];
+	/* real and fake channels by handle, for the IRQ path */
+	struct pscnv_chan *handle_hash[1 << PSCNV_CHAN_HASH_BITS];
 	spinlock_t ch_lock;
 	int ch_min, ch_max;
 };
@@ -76,6 +97,9 @@ static inline void pscnv_chan_unref(struct pscnv_chan *ch) {
 
 extern int pscnv_chan_mmap(struct file *filp, struct vm_area_struct *vma);
 extern int pscnv_chan_handle_lookup(struct drm_device *dev, uint32_t handle);
+extern void pscnv_chan_set_handle(struct pscnv_chan *ch, uint32_t handle);
+extern void pscnv_chan_sched_prio(struct drm_device *dev, int *prio);
+extern int pscnv_chan_busy(struct drm_device *dev);
 
 int nv50_chan_init(struct drm_device *dev);
 int nvc0_chan_init(struct drm_device *dev);
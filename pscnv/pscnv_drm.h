@@ -145,6 +145,150 @@ struct drm_pscnv_obj_eng_new {
 	uint32_t flags;		/* < */
 };
 
+/*
+ * Frees an object on an NV50 channel. Fails with EBUSY while the channel
+ * has work left that may use it, and always for the pushbuffer's DMA
+ * object. Subchannels still bound to the object must be bound again.
+ */
+struct drm_pscnv_obj_free {
+	uint32_t cid;		/* < */
+	uint32_t handle;	/* < */
+};
+
+/*
+ * Priorities above NORMAL and timeslices above the default need the
+ * privilege to raise a process's priority (CAP_SYS_NICE on Linux), or
+ * the call fails with EPERM. Longer timeslices than
+ * PSCNV_CHAN_TIMESLICE_MAX are cut down to it.
+ */
+struct drm_pscnv_chan_sched {
+	uint32_t cid;		/* < */
+	/* one of PSCNV_CHAN_PRIO_*, see below */
+	uint32_t priority;	/* < */
+	/* in microseconds, 0 means driver default. NVC0+ only. */
+	uint32_t timeslice;	/* < */
+	uint32_t _pad;
+};
+#define PSCNV_CHAN_TIMESLICE_DEFAULT	1024
+#define PSCNV_CHAN_TIMESLICE_MAX	65536
+#define PSCNV_CHAN_PRIO_LOW		0
+#define PSCNV_CHAN_PRIO_NORMAL		1	/* default for new channels */
+#define PSCNV_CHAN_PRIO_HIGH		2
+#define PSCNV_CHAN_PRIO_REALTIME	3
+#define PSCNV_CHAN_PRIO_MAX		PSCNV_CHAN_PRIO_REALTIME
+
+/*
+ * Each channel has a 32-bit fence sequence word in sysram, mapped into
+ * its vspace. Userspace bumps it with a semaphore release followed by
+ * a nonstall interrupt, then waits on it with FENCE_WAIT or poll()s on
+ * a FENCE_FD. Sequence numbers compare modulo 2^32.
+ */
+struct drm_pscnv_fence_info {
+	uint32_t cid;		/* < */
+	uint32_t value;		/* > current sequence */
+	uint64_t addr;		/* > vspace address of the sequence word */
+};
+
+struct drm_pscnv_fence_wait {
+	uint32_t cid;		/* < */
+	uint32_t seq;		/* < */
+	uint64_t timeout_ns;	/* < 0 just checks */
+};
+
+struct drm_pscnv_fence_fd {
+	uint32_t cid;		/* < */
+	uint32_t seq;		/* < */
+	int32_t fd;		/* > becomes readable once seq is reached */
+	uint32_t _pad;
+};
+
+/*
+ * Performance counters, sampled into a ring the caller can mmap. There
+ * are 8 sets of 4 counters, each counting the cycles one hardware signal
+ * was active, and a cycle counter per set; signal 0 counts nothing. The
+ * counters are per card, so the last perfmon call wins, and only root
+ * may make it. The driver watches some signals itself: their counters
+ * keep counting them, asking for another signal there fails with EBUSY.
+ */
+struct drm_pscnv_perfmon {
+	uint8_t signals[8][4];	/* < signal for each set and counter */
+	uint32_t period_us;	/* < sampling period, 0 stops sampling */
+	uint32_t ring_order;	/* < the ring holds 2^ring_order samples */
+	uint32_t handle;	/* > GEM handle of the ring */
+	uint32_t _pad;
+	uint64_t map_handle;	/* > for mmapping it */
+};
+#define PSCNV_PERFMON_PERIOD_MIN	1000
+#define PSCNV_PERFMON_ORDER_MIN		4
+#define PSCNV_PERFMON_ORDER_MAX		16
+
+/*
+ * Layout of the ring: this header, then samples from offset
+ * PSCNV_PERF_RING_SAMPLES on. Sample seq is at index seq % size. The
+ * kernel fills in a sample before bumping head past it and never waits
+ * for the reader, so a sample copied out is good if head hadn't moved
+ * size past its seq by the time the copy was done.
+ */
+struct drm_pscnv_perf_ring {
+	uint32_t head;		/* samples written so far */
+	uint32_t size;		/* samples the ring holds */
+	uint32_t period_us;	/* sampling period in effect */
+	uint32_t _pad;
+};
+#define PSCNV_PERF_RING_SAMPLES		0x1000
+
+struct drm_pscnv_perf_sample {
+	uint64_t time;		/* CPU clock ns at readout */
+	uint32_t seq;
+	uint32_t _pad;
+	uint32_t cycles[8];	/* per set, since the previous sample */
+	uint32_t count[8][4];	/* cycles each signal was active */
+	uint32_t _pad2[20];	/* to 256 bytes */
+};
+
+/*
+ * Binary MMIO trace, what debugfs mmio_trace reads back on kernels built
+ * with PSCNV_MMIO_TRACE: a header, then count records in the order their
+ * slots were taken. Time is CPU clock nanoseconds. BEGIN and END records
+ * bracket an init sequence, the sequence number is in val.
+ */
+#define PSCNV_MMIO_TRACE_MAGIC		0x54494d4d	/* "MMIT" */
+#define PSCNV_MMIO_TRACE_VERSION	1
+
+#define PSCNV_MMIO_TRACE_RD32		0
+#define PSCNV_MMIO_TRACE_WR32		1
+#define PSCNV_MMIO_TRACE_RD08		2
+#define PSCNV_MMIO_TRACE_WR08		3
+#define PSCNV_MMIO_TRACE_BAR3_RD	4	/* addr is a BAR3 offset */
+#define PSCNV_MMIO_TRACE_BAR3_WR	5
+#define PSCNV_MMIO_TRACE_BEGIN		6
+#define PSCNV_MMIO_TRACE_END		7
+
+#define PSCNV_MMIO_SEQ_CARD_INIT	0
+#define PSCNV_MMIO_SEQ_FIFO_INIT	1
+#define PSCNV_MMIO_SEQ_GRAPH_INIT	2
+#define PSCNV_MMIO_SEQ_COPY_INIT	3
+#define PSCNV_MMIO_SEQ_DISPLAY_INIT	4
+#define PSCNV_MMIO_SEQS			5
+
+struct drm_pscnv_mmio_trace_head {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t chipset;
+	uint32_t rec_size;
+	uint64_t count;
+	uint64_t dropped;	/* accesses after the buffer filled up */
+};
+
+struct drm_pscnv_mmio_rec {
+	uint64_t time;
+	uint32_t addr;
+	uint32_t val;
+	uint16_t cpu;
+	uint8_t op;
+	uint8_t _pad[5];
+};
+
 #define DRM_PSCNV_GETPARAM           0x00	/* get some information from the card */
 #define DRM_PSCNV_GEM_NEW            0x20	/* create a new BO */
 #define DRM_PSCNV_GEM_INFO           0x21	/* get info about a BO */
@@ -159,6 +303,12 @@ struct drm_pscnv_obj_eng_new {
 #define DRM_PSCNV_FIFO_INIT          0x29	/* Initialises PFIFO processing on a channel */
 #define DRM_PSCNV_OBJ_ENG_NEW        0x2a	/* Create a new engine object on a channel */
 #define DRM_PSCNV_FIFO_INIT_IB       0x2b	/* Initialises IB PFIFO processing on a channel */
+#define DRM_PSCNV_CHAN_SCHED         0x2c	/* Sets channel priority and timeslice */
+#define DRM_PSCNV_FENCE_INFO         0x2d	/* Gets the fence word of a channel */
+#define DRM_PSCNV_FENCE_WAIT         0x2e	/* Waits for a fence sequence */
+#define DRM_PSCNV_FENCE_FD           0x2f	/* Makes a pollable fd for a fence sequence */
+#define DRM_PSCNV_OBJ_FREE           0x30	/* Frees an object on a channel */
+#define DRM_PSCNV_PERFMON            0x31	/* Sets up performance counter sampling */
 
 #define DRM_IOCTL_PSCNV_GETPARAM           DRM_IOWR(DRM_COMMAND_BASE + DRM_PSCNV_GETPARAM, struct drm_pscnv_getparam)
 #define DRM_IOCTL_PSCNV_GEM_NEW            DRM_IOWR(DRM_COMMAND_BASE + DRM_PSCNV_GEM_NEW, struct drm_pscnv_gem_info)
@@ -174,5 +324,11 @@ struct drm_pscnv_obj_eng_new {
 #define DRM_IOCTL_PSCNV_FIFO_INIT          DRM_IOW(DRM_COMMAND_BASE + DRM_PSCNV_FIFO_INIT, struct drm_pscnv_fifo_init)
 #define DRM_IOCTL_PSCNV_OBJ_ENG_NEW        DRM_IOW(DRM_COMMAND_BASE + DRM_PSCNV_OBJ_ENG_NEW, struct drm_pscnv_obj_eng_new)
 #define DRM_IOCTL_PSCNV_FIFO_INIT_IB       DRM_IOW(DRM_COMMAND_BASE + DRM_PSCNV_FIFO_INIT_IB, struct drm_pscnv_fifo_init_ib)
+#define DRM_IOCTL_PSCNV_CHAN_SCHED         DRM_IOW(DRM_COMMAND_BASE + DRM_PSCNV_CHAN_SCHED, struct drm_pscnv_chan_sched)
+#define DRM_IOCTL_PSCNV_FENCE_INFO         DRM_IOWR(DRM_COMMAND_BASE + DRM_PSCNV_FENCE_INFO, struct drm_pscnv_fence_info)
+#define DRM_IOCTL_PSCNV_FENCE_WAIT         DRM_IOW(DRM_COMMAND_BASE + DRM_PSCNV_FENCE_WAIT, struct drm_pscnv_fence_wait)
+#define DRM_IOCTL_PSCNV_FENCE_FD           DRM_IOWR(DRM_COMMAND_BASE + DRM_PSCNV_FENCE_FD, struct drm_pscnv_fence_fd)
+#define DRM_IOCTL_PSCNV_OBJ_FREE           DRM_IOW(DRM_COMMAND_BASE + DRM_PSCNV_OBJ_FREE, struct drm_pscnv_obj_free)
+#define DRM_IOCTL_PSCNV_PERFMON            DRM_IOWR(DRM_COMMAND_BASE + DRM_PSCNV_PERFMON, struct drm_pscnv_perfmon)
 
 #endif /* __PSCNV_DRM_H__ */
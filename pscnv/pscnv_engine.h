@@ -12,6 +12,10 @@ struct pscnv_engine {
 	int (*chan_alloc) (struct pscnv_engine *eng, struct pscnv_chan *ch);
 	void (*chan_free) (struct pscnv_engine *eng, struct pscnv_chan *ch);
 	int (*chan_obj_new) (struct pscnv_engine *eng, struct pscnv_chan *ch, uint32_t handle, uint32_t oclass, uint32_t flags);
+	/* optional, returns -EBUSY if the engine may still use the
+	 * instance object at inst. Called with context_switch_lock held
+	 * and PFIFO not handing out methods. */
+	int (*chan_obj_free) (struct pscnv_engine *eng, struct pscnv_chan *ch, uint32_t inst);
 	void (*chan_kill) (struct pscnv_engine *eng, struct pscnv_chan *ch);
 };
 
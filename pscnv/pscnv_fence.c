@@ -0,0 +1,215 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright 2010 PathScale Inc.  All rights reserved.
+ * Use is subject to license terms.
+ */
+
+#include "drm.h"
+#include "nouveau_drv.h"
+#include "pscnv_mem.h"
+#include "pscnv_vm.h"
+#include "pscnv_gem.h"
+#include "pscnv_chan.h"
+#include "pscnv_fence.h"
+#ifdef __linux__
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/file.h>
+#include <linux/anon_inodes.h>
+#endif
+
+/*
+ * Fences are a per-channel sequence word in a snooped sysram page, mapped
+ * into the channel's vspace. The channel releases a semaphore onto it and
+ * raises a nonstall interrupt, which wakes everybody sleeping on
+ * fence_wq; the interrupt doesn't tell us which channel it came from, so
+ * waiters just recheck their own word.
+ */
+
+int
+pscnv_fence_chan_init(struct pscnv_chan *ch)
+{
+	struct drm_device *dev = ch->dev;
+	struct drm_gem_object *obj;
+	struct pscnv_mm_node *node;
+	struct pscnv_bo *bo;
+	int ret;
+
+	obj = pscnv_gem_new(dev, PAGE_SIZE, PSCNV_GEM_SYSRAM_SNOOP, 0, 0xfe4ce, 0);
+	if (!obj) {
+		NV_ERROR(dev, "FENCE: Couldn't allocate fence page for channel %d\n", ch->cid);
+		return -ENOMEM;
+	}
+	bo = obj->driver_private;
+	bo->kernel_map = 1;
+
+	/* one reference for the mapping, one kept until the channel goes,
+	 * so the page stays even if the vspace goes first */
+	drm_gem_object_reference(obj);
+	ret = pscnv_vspace_map(ch->vspace, bo, 0x20000000, 1ull << 40, 1, &node);
+	if (ret) {
+		NV_ERROR(dev, "FENCE: Couldn't map fence page for channel %d\n", ch->cid);
+		drm_gem_object_unreference_unlocked(obj);
+		drm_gem_object_unreference_unlocked(obj);
+		return ret;
+	}
+	ch->fence_map = node;
+	ch->fence_bo = bo;
+#ifdef __linux__
+	ch->fence_cpu = page_address(bo->pages[0]);
+#else
+	ch->fence_cpu = (void *)bo->pages[0];
+#endif
+	*ch->fence_cpu = 0;
+	return 0;
+}
+
+void
+pscnv_fence_chan_free(struct pscnv_chan *ch)
+{
+	if (!ch->fence_map)
+		return;
+	pscnv_vspace_unmap_node(ch->fence_map);
+	drm_gem_object_unreference_unlocked(ch->fence_bo->gem);
+	ch->fence_map = 0;
+	ch->fence_bo = 0;
+	ch->fence_cpu = 0;
+}
+
+uint32_t
+pscnv_fence_read(struct pscnv_chan *ch)
+{
+	return *ch->fence_cpu;
+}
+
+void
+pscnv_fence_signal(struct drm_device *dev)
+{
+#ifdef __linux__
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	wake_up_all(&dev_priv->fence_wq);
+#endif
+}
+
+#ifdef __linux__
+
+int
+pscnv_fence_wait(struct pscnv_chan *ch, uint32_t seq, uint64_t timeout_ns)
+{
+	struct drm_nouveau_private *dev_priv = ch->dev->dev_private;
+	uint64_t us = timeout_ns;
+	long ret;
+
+	if (pscnv_fence_passed(pscnv_fence_read(ch), seq))
+		return 0;
+	if (!timeout_ns)
+		return -EBUSY;
+
+	do_div(us, 1000);
+	if (us > UINT_MAX)
+		us = UINT_MAX;
+	ret = wait_event_interruptible_timeout(dev_priv->fence_wq,
+			pscnv_fence_passed(pscnv_fence_read(ch), seq),
+			usecs_to_jiffies(us) + 1);
+	if (ret < 0)
+		return ret;
+	if (!ret)
+		return -ETIMEDOUT;
+	return 0;
+}
+
+struct pscnv_fence_file {
+	struct pscnv_chan *ch;
+	uint32_t seq;
+};
+
+static unsigned int
+pscnv_fence_file_poll(struct file *filp, poll_table *wait)
+{
+	struct pscnv_fence_file *ff = filp->private_data;
+	struct drm_nouveau_private *dev_priv = ff->ch->dev->dev_private;
+
+	poll_wait(filp, &dev_priv->fence_wq, wait);
+	if (pscnv_fence_passed(pscnv_fence_read(ff->ch), ff->seq))
+		return POLLIN | POLLRDNORM;
+	return 0;
+}
+
+static int
+pscnv_fence_file_release(struct inode *inode, struct file *filp)
+{
+	struct pscnv_fence_file *ff = filp->private_data;
+
+	pscnv_chan_unref(ff->ch);
+	kfree(ff);
+	return 0;
+}
+
+static const struct file_operations pscnv_fence_fops = {
+	.owner = THIS_MODULE,
+	.poll = pscnv_fence_file_poll,
+	.release = pscnv_fence_file_release,
+};
+
+int
+pscnv_fence_fd(struct pscnv_chan *ch, uint32_t seq)
+{
+	struct pscnv_fence_file *ff = kzalloc(sizeof *ff, GFP_KERNEL);
+	int fd;
+
+	if (!ff)
+		return -ENOMEM;
+	pscnv_chan_ref(ch);
+	ff->ch = ch;
+	ff->seq = seq;
+	fd = anon_inode_getfd("pscnv_fence", &pscnv_fence_fops, ff, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		pscnv_chan_unref(ch);
+		kfree(ff);
+	}
+	return fd;
+}
+
+#else
+
+/* No wait queues in the BSD glue yet, so just poll the word. */
+int
+pscnv_fence_wait(struct pscnv_chan *ch, uint32_t seq, uint64_t timeout_ns)
+{
+	uint64_t ms = (timeout_ns + 999999) / 1000000;
+
+	while (!pscnv_fence_passed(pscnv_fence_read(ch), seq)) {
+		if (!ms--)
+			return timeout_ns ? -ETIMEDOUT : -EBUSY;
+		msleep(1);
+	}
+	return 0;
+}
+
+int
+pscnv_fence_fd(struct pscnv_chan *ch, uint32_t seq)
+{
+	return -ENOSYS;
+}
+
+#endif
@@ -0,0 +1,46 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright 2010 PathScale Inc.  All rights reserved.
+ * Use is subject to license terms.
+ */
+
+#ifndef __PSCNV_FENCE_H__
+#define __PSCNV_FENCE_H__
+
+#include "pscnv_chan.h"
+
+/* Fence sequences wrap, compare them like PTIMER-style counters. */
+static inline int
+pscnv_fence_passed(uint32_t cur, uint32_t seq)
+{
+	return (int32_t)(cur - seq) >= 0;
+}
+
+extern int pscnv_fence_chan_init(struct pscnv_chan *ch);
+extern void pscnv_fence_chan_free(struct pscnv_chan *ch);
+extern uint32_t pscnv_fence_read(struct pscnv_chan *ch);
+extern void pscnv_fence_signal(struct drm_device *dev);
+extern int pscnv_fence_wait(struct pscnv_chan *ch, uint32_t seq, uint64_t timeout_ns);
+extern int pscnv_fence_fd(struct pscnv_chan *ch, uint32_t seq);
+
+#endif /* __PSCNV_FENCE_H__ */
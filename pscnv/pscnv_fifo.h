@@ -32,6 +32,12 @@ struct pscnv_fifo_engine {
 	int (*chan_init_dma) (struct pscnv_chan *ch, uint32_t pb_handle, uint32_t flags, uint32_t slimask, uint64_t pb_start);
 	int (*chan_init_ib) (struct pscnv_chan *ch, uint32_t pb_handle, uint32_t flags, uint32_t slimask, uint64_t ib_start, uint32_t ib_order);
 	void (*chan_kill) (struct pscnv_chan *ch);
+	int (*chan_sched) (struct pscnv_chan *ch, int priority, uint32_t timeslice);
+	/* nonzero if the channel has pushbuffer left to fetch */
+	int (*chan_busy) (struct pscnv_chan *ch);
+	/* optional, like pscnv_engine's: -EBUSY if PFIFO may still use the
+	 * channel's instance object at inst */
+	int (*chan_obj_free) (struct pscnv_chan *ch, uint32_t inst);
 };
 
 int nv50_fifo_init(struct drm_device *dev);
@@ -6,12 +6,20 @@
 #include "pscnv_chan.h"
 #include "pscnv_fifo.h"
 #include "pscnv_gem.h"
+#include "pscnv_fence.h"
 #include "nv50_chan.h"
 #include "nvc0_graph.h"
 #include "pscnv_kapi.h"
 
 #include "nvc0_pgraph.xml.h"
 
+#ifndef __linux__
+#include <sys/priv.h>
+#endif
+
+#define CREATE_TRACE_POINTS
+#include "pscnv_trace.h"
+
 #ifdef PSCNV_KAPI_GETPARAM_BUS_TYPE
 #define DEVICE_IS_AGP(dev) drm_device_is_agp(dev)
 #define DEVICE_IS_PCIE(dev) drm_device_is_pcie(dev)
@@ -20,7 +28,7 @@
 #define DEVICE_IS_PCIE(dev) pci_is_pcie(dev->pdev)
 #endif
 
-int pscnv_ioctl_getparam(struct drm_device *dev, void *data,
+static int __pscnv_ioctl_getparam(struct drm_device *dev, void *data,
 						struct drm_file *file_priv)
 {
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
@@ -100,7 +108,7 @@ fail:
 	return -EINVAL;
 }
 
-int pscnv_ioctl_gem_new(struct drm_device *dev, void *data,
+static int __pscnv_ioctl_gem_new(struct drm_device *dev, void *data,
 						struct drm_file *file_priv)
 {
 	struct drm_pscnv_gem_info *info = data;
@@ -135,7 +143,7 @@ int pscnv_ioctl_gem_new(struct drm_device *dev, void *data,
 	return ret;
 }
 
-int pscnv_ioctl_gem_info(struct drm_device *dev, void *data,
+static int __pscnv_ioctl_gem_info(struct drm_device *dev, void *data,
 						struct drm_file *file_priv)
 {
 	struct drm_pscnv_gem_info *info = data;
@@ -186,7 +194,7 @@ pscnv_get_vspace(struct drm_device *dev, struct drm_file *file_priv, int vid)
 	return 0;
 }
 
-int pscnv_ioctl_vspace_new(struct drm_device *dev, void *data,
+static int __pscnv_ioctl_vspace_new(struct drm_device *dev, void *data,
 						struct drm_file *file_priv)
 {
 	struct drm_pscnv_vspace_req *req = data;
@@ -205,7 +213,7 @@ int pscnv_ioctl_vspace_new(struct drm_device *dev, void *data,
 	return 0;
 }
 
-int pscnv_ioctl_vspace_free(struct drm_device *dev, void *data,
+static int __pscnv_ioctl_vspace_free(struct drm_device *dev, void *data,
 						struct drm_file *file_priv)
 {
 	struct drm_pscnv_vspace_req *req = data;
@@ -225,7 +233,7 @@ int pscnv_ioctl_vspace_free(struct drm_device *dev, void *data,
 	return 0;
 }
 
-int pscnv_ioctl_vspace_map(struct drm_device *dev, void *data,
+static int __pscnv_ioctl_vspace_map(struct drm_device *dev, void *data,
 						struct drm_file *file_priv)
 {
 	struct drm_pscnv_vspace_map *req = data;
@@ -249,16 +257,19 @@ int pscnv_ioctl_vspace_map(struct drm_device *dev, void *data,
 
 	bo = obj->driver_private;
 
+	/* the mapping takes over the lookup's reference */
 	ret = pscnv_vspace_map(vs, bo, req->start, req->end, req->back, &map);
 	if (!ret)
 		req->offset = map->start;
+	else
+		drm_gem_object_unreference_unlocked(obj);
 
 	pscnv_vspace_unref(vs);
 
 	return ret;
 }
 
-int pscnv_ioctl_vspace_unmap(struct drm_device *dev, void *data,
+static int __pscnv_ioctl_vspace_unmap(struct drm_device *dev, void *data,
 						struct drm_file *file_priv)
 {
 	struct drm_pscnv_vspace_unmap *req = data;
@@ -310,12 +321,13 @@ pscnv_get_chan(struct drm_device *dev, struct drm_file *file_priv, int cid)
 	return 0;
 }
 
-int pscnv_ioctl_chan_new(struct drm_device *dev, void *data,
+static int __pscnv_ioctl_chan_new(struct drm_device *dev, void *data,
 						struct drm_file *file_priv)
 {
 	struct drm_pscnv_chan_new *req = data;
 	struct pscnv_vspace *vs;
 	struct pscnv_chan *ch;
+	int ret;
 #ifndef __linux__
 	struct drm_gem_object *obj;
 #endif
@@ -331,6 +343,11 @@ int pscnv_ioctl_chan_new(struct drm_device *dev, void *data,
 		return -ENOMEM;
 	}
 	pscnv_vspace_unref(vs);
+	ret = pscnv_fence_chan_init(ch);
+	if (ret) {
+		pscnv_chan_unref(ch);
+		return ret;
+	}
 #ifndef __linux__
 	if (!(obj = pscnv_gem_wrap(dev, ch->bo))) {
 		pscnv_chan_unref(ch);
@@ -349,7 +366,7 @@ int pscnv_ioctl_chan_new(struct drm_device *dev, void *data,
 	return 0;
 }
 
-int pscnv_ioctl_chan_free(struct drm_device *dev, void *data,
+static int __pscnv_ioctl_chan_free(struct drm_device *dev, void *data,
 						struct drm_file *file_priv)
 {
 	struct drm_pscnv_chan_free *req = data;
@@ -368,7 +385,7 @@ int pscnv_ioctl_chan_free(struct drm_device *dev, void *data,
 	return 0;
 }
 
-int pscnv_ioctl_obj_vdma_new(struct drm_device *dev, void *data,
+static int __pscnv_ioctl_obj_vdma_new(struct drm_device *dev, void *data,
 						struct drm_file *file_priv) {
 	struct drm_pscnv_obj_vdma_new *req = data;
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
@@ -397,6 +414,31 @@ int pscnv_ioctl_obj_vdma_new(struct drm_device *dev, void *data,
 	}
 
 	ret = pscnv_ramht_insert (&ch->ramht, req->handle, inst >> 4);
+	if (ret)
+		nv50_chan_iobj_free(ch, inst);
+
+	pscnv_chan_unref(ch);
+
+	return ret;
+}
+
+static int __pscnv_ioctl_obj_free(struct drm_device *dev, void *data,
+						struct drm_file *file_priv) {
+	struct drm_pscnv_obj_free *req = data;
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	struct pscnv_chan *ch;
+	int ret;
+
+	NOUVEAU_CHECK_INITIALISED_WITH_RETURN;
+
+	if (dev_priv->card_type != NV_50)
+		return -ENOSYS;
+
+	ch = pscnv_get_chan(dev, file_priv, req->cid);
+	if (!ch)
+		return -ENOENT;
+
+	ret = nv50_chan_obj_free(ch, req->handle);
 
 	pscnv_chan_unref(ch);
 
@@ -417,7 +459,7 @@ void pscnv_chan_cleanup(struct drm_device *dev, struct drm_file *file_priv) {
 	}
 }
 
-int pscnv_ioctl_obj_eng_new(struct drm_device *dev, void *data,
+static int __pscnv_ioctl_obj_eng_new(struct drm_device *dev, void *data,
 						struct drm_file *file_priv) {
 	struct drm_pscnv_obj_eng_new *req = data;
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
@@ -460,7 +502,7 @@ found:
 	return ret;
 }
 
-int pscnv_ioctl_fifo_init(struct drm_device *dev, void *data,
+static int __pscnv_ioctl_fifo_init(struct drm_device *dev, void *data,
 						struct drm_file *file_priv) {
 	struct drm_pscnv_fifo_init *req = data;
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
@@ -483,7 +525,7 @@ int pscnv_ioctl_fifo_init(struct drm_device *dev, void *data,
 	return ret;
 }
 
-int pscnv_ioctl_fifo_init_ib(struct drm_device *dev, void *data,
+static int __pscnv_ioctl_fifo_init_ib(struct drm_device *dev, void *data,
 						struct drm_file *file_priv) {
 	struct drm_pscnv_fifo_init_ib *req = data;
 	struct drm_nouveau_private *dev_priv = dev->dev_private;
@@ -505,3 +547,362 @@ int pscnv_ioctl_fifo_init_ib(struct drm_device *dev, void *data,
 
 	return ret;
 }
+
+/* Raising a channel over the others takes what raising a process would. */
+static int pscnv_chan_sched_allowed(void) {
+#ifdef __linux__
+	return capable(CAP_SYS_NICE);
+#else
+	return !priv_check(curthread, PRIV_SCHED_SETPRIORITY);
+#endif
+}
+
+static int __pscnv_ioctl_chan_sched(struct drm_device *dev, void *data,
+						struct drm_file *file_priv) {
+	struct drm_pscnv_chan_sched *req = data;
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	struct pscnv_chan *ch;
+	int ret;
+
+	NOUVEAU_CHECK_INITIALISED_WITH_RETURN;
+
+	if (!dev_priv->fifo || !dev_priv->fifo->chan_sched)
+		return -ENODEV;
+
+	if (req->priority > PSCNV_CHAN_PRIO_MAX)
+		return -EINVAL;
+
+	if ((req->priority > PSCNV_CHAN_PRIO_NORMAL ||
+	     req->timeslice > PSCNV_CHAN_TIMESLICE_DEFAULT) &&
+	    !pscnv_chan_sched_allowed())
+		return -EPERM;
+	if (req->timeslice > PSCNV_CHAN_TIMESLICE_MAX)
+		req->timeslice = PSCNV_CHAN_TIMESLICE_MAX;
+
+	ch = pscnv_get_chan(dev, file_priv, req->cid);
+	if (!ch)
+		return -ENOENT;
+
+	ret = dev_priv->fifo->chan_sched(ch, req->priority, req->timeslice);
+
+	pscnv_chan_unref(ch);
+
+	return ret;
+}
+
+static int __pscnv_ioctl_fence_info(struct drm_device *dev, void *data,
+						struct drm_file *file_priv) {
+	struct drm_pscnv_fence_info *req = data;
+	struct pscnv_chan *ch;
+
+	NOUVEAU_CHECK_INITIALISED_WITH_RETURN;
+
+	ch = pscnv_get_chan(dev, file_priv, req->cid);
+	if (!ch)
+		return -ENOENT;
+
+	req->addr = ch->fence_map->start;
+	req->value = pscnv_fence_read(ch);
+
+	pscnv_chan_unref(ch);
+
+	return 0;
+}
+
+static int __pscnv_ioctl_fence_wait(struct drm_device *dev, void *data,
+						struct drm_file *file_priv) {
+	struct drm_pscnv_fence_wait *req = data;
+	struct pscnv_chan *ch;
+	int ret;
+
+	NOUVEAU_CHECK_INITIALISED_WITH_RETURN;
+
+	ch = pscnv_get_chan(dev, file_priv, req->cid);
+	if (!ch)
+		return -ENOENT;
+
+	ret = pscnv_fence_wait(ch, req->seq, req->timeout_ns);
+
+	pscnv_chan_unref(ch);
+
+	return ret;
+}
+
+static int __pscnv_ioctl_fence_fd(struct drm_device *dev, void *data,
+						struct drm_file *file_priv) {
+	struct drm_pscnv_fence_fd *req = data;
+	struct pscnv_chan *ch;
+	int ret;
+
+	NOUVEAU_CHECK_INITIALISED_WITH_RETURN;
+
+	ch = pscnv_get_chan(dev, file_priv, req->cid);
+	if (!ch)
+		return -ENOENT;
+
+	ret = pscnv_fence_fd(ch, req->seq);
+	if (ret >= 0) {
+		req->fd = ret;
+		ret = 0;
+	}
+
+	pscnv_chan_unref(ch);
+
+	return ret;
+}
+
+static int __pscnv_ioctl_perfmon(struct drm_device *dev, void *data,
+						struct drm_file *file_priv)
+{
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	struct nouveau_pm_counter *counter = &dev_priv->engine.pm.counter;
+	struct drm_pscnv_perfmon *req = data;
+	struct drm_gem_object *obj;
+	uint64_t size;
+	int ret;
+
+	NOUVEAU_CHECK_INITIALISED_WITH_RETURN;
+
+	if (!counter->configure)
+		return -ENODEV;
+
+	if (!req->period_us)
+		return counter->configure(dev, NULL, 0, NULL);
+
+	if (req->period_us < PSCNV_PERFMON_PERIOD_MIN ||
+	    req->ring_order < PSCNV_PERFMON_ORDER_MIN ||
+	    req->ring_order > PSCNV_PERFMON_ORDER_MAX)
+		return -EINVAL;
+
+	size = PSCNV_PERF_RING_SAMPLES +
+		(sizeof(struct drm_pscnv_perf_sample) << req->ring_order);
+	obj = pscnv_gem_new(dev, size, PSCNV_GEM_SYSRAM_SNOOP | PSCNV_GEM_MAPPABLE,
+			    0, 0xc0de7e11, 0);
+	if (!obj)
+		return -ENOMEM;
+
+	req->handle = 0;
+	ret = drm_gem_handle_create(file_priv, obj, &req->handle);
+	if (ret) {
+		drm_gem_object_unreference_unlocked(obj);
+		return ret;
+	}
+#ifdef __linux__
+	req->map_handle = (uint64_t)req->handle << 32;
+#else
+	req->map_handle = DRM_GEM_MAPPING_OFF(obj->map_list.key) |
+			   DRM_GEM_MAPPING_KEY;
+#endif
+
+	/* our reference goes to the counters, the handle has its own */
+	ret = counter->configure(dev, req->signals, req->period_us,
+				 obj->driver_private);
+	if (ret) {
+		drm_gem_handle_delete(file_priv, req->handle);
+		drm_gem_object_unreference_unlocked(obj);
+	}
+	return ret;
+}
+
+/*
+ * Timing. Every ioctl above goes through pscnv_ioctl_timed, which fires
+ * the entry and exit tracepoints and adds the time taken to the ioctl's
+ * histogram in dev_priv->ioctl_stats, shown by debugfs "ioctl".
+ */
+
+const char *const pscnv_ioctl_names[PSCNV_IOCTLS] = {
+	[DRM_PSCNV_GETPARAM] = "getparam",
+	[DRM_PSCNV_GEM_NEW] = "gem_new",
+	[DRM_PSCNV_GEM_INFO] = "gem_info",
+	[DRM_PSCNV_VSPACE_NEW] = "vspace_new",
+	[DRM_PSCNV_VSPACE_FREE] = "vspace_free",
+	[DRM_PSCNV_VSPACE_MAP] = "vspace_map",
+	[DRM_PSCNV_VSPACE_UNMAP] = "vspace_unmap",
+	[DRM_PSCNV_CHAN_NEW] = "chan_new",
+	[DRM_PSCNV_CHAN_FREE] = "chan_free",
+	[DRM_PSCNV_OBJ_VDMA_NEW] = "obj_vdma_new",
+	[DRM_PSCNV_FIFO_INIT] = "fifo_init",
+	[DRM_PSCNV_OBJ_ENG_NEW] = "obj_eng_new",
+	[DRM_PSCNV_FIFO_INIT_IB] = "fifo_init_ib",
+	[DRM_PSCNV_CHAN_SCHED] = "chan_sched",
+	[DRM_PSCNV_FENCE_INFO] = "fence_info",
+	[DRM_PSCNV_FENCE_WAIT] = "fence_wait",
+	[DRM_PSCNV_FENCE_FD] = "fence_fd",
+	[DRM_PSCNV_OBJ_FREE] = "obj_free",
+	[DRM_PSCNV_PERFMON] = "perfmon",
+};
+
+void
+pscnv_lat_add(struct pscnv_lat *lat, uint64_t ns)
+{
+	uint64_t us = ns >> 10;
+	int b = us >> (PSCNV_LAT_HIST - 2) ? PSCNV_LAT_HIST - 1 : fls(us);
+	lat->count++;
+	lat->time += ns;
+	if (ns > lat->max)
+		lat->max = ns;
+	lat->hist[b]++;
+}
+
+void
+pscnv_lock_waited(struct drm_device *dev, int lock, uint64_t ns)
+{
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	trace_pscnv_lock_wait(lock, ns);
+	spin_lock(&dev_priv->ioctl_stats.lock);
+	pscnv_lat_add(&dev_priv->ioctl_stats.lock_wait[lock], ns);
+	spin_unlock(&dev_priv->ioctl_stats.lock);
+}
+
+static void
+pscnv_ioctl_args_get(unsigned int nr, void *data, struct pscnv_ioctl_args *a)
+{
+	memset(a, 0, sizeof *a);
+	switch (nr) {
+	case DRM_PSCNV_GEM_NEW: {
+		struct drm_pscnv_gem_info *req = data;
+		a->size = req->size;
+		a->flags = req->flags;
+		break;
+	}
+	case DRM_PSCNV_GEM_INFO: {
+		struct drm_pscnv_gem_info *req = data;
+		a->handle = req->handle;
+		break;
+	}
+	case DRM_PSCNV_VSPACE_FREE: {
+		struct drm_pscnv_vspace_req *req = data;
+		a->vid = req->vid;
+		break;
+	}
+	case DRM_PSCNV_VSPACE_MAP: {
+		struct drm_pscnv_vspace_map *req = data;
+		a->vid = req->vid;
+		a->handle = req->handle;
+		a->flags = req->back;
+		a->offset = req->start;
+		a->size = req->end - req->start;
+		break;
+	}
+	case DRM_PSCNV_VSPACE_UNMAP: {
+		struct drm_pscnv_vspace_unmap *req = data;
+		a->vid = req->vid;
+		a->offset = req->offset;
+		break;
+	}
+	case DRM_PSCNV_CHAN_NEW: {
+		struct drm_pscnv_chan_new *req = data;
+		a->vid = req->vid;
+		break;
+	}
+	case DRM_PSCNV_OBJ_VDMA_NEW: {
+		struct drm_pscnv_obj_vdma_new *req = data;
+		a->cid = req->cid;
+		a->handle = req->handle;
+		a->oclass = req->oclass;
+		a->flags = req->flags;
+		a->offset = req->start;
+		a->size = req->size;
+		break;
+	}
+	case DRM_PSCNV_OBJ_ENG_NEW: {
+		struct drm_pscnv_obj_eng_new *req = data;
+		a->cid = req->cid;
+		a->handle = req->handle;
+		a->oclass = req->oclass;
+		a->flags = req->flags;
+		break;
+	}
+	case DRM_PSCNV_FIFO_INIT: {
+		struct drm_pscnv_fifo_init *req = data;
+		a->cid = req->cid;
+		a->handle = req->pb_handle;
+		a->flags = req->flags;
+		a->offset = req->pb_start;
+		break;
+	}
+	case DRM_PSCNV_FIFO_INIT_IB: {
+		struct drm_pscnv_fifo_init_ib *req = data;
+		a->cid = req->cid;
+		a->handle = req->pb_handle;
+		a->flags = req->flags;
+		a->offset = req->ib_start;
+		a->size = 8ull << req->ib_order;
+		break;
+	}
+	case DRM_PSCNV_OBJ_FREE: {
+		struct drm_pscnv_obj_free *req = data;
+		a->cid = req->cid;
+		a->handle = req->handle;
+		break;
+	}
+	case DRM_PSCNV_PERFMON: {
+		struct drm_pscnv_perfmon *req = data;
+		/* no better places for them */
+		a->size = req->ring_order;
+		a->flags = req->period_us;
+		break;
+	}
+	case DRM_PSCNV_CHAN_FREE:
+	case DRM_PSCNV_CHAN_SCHED:
+	case DRM_PSCNV_FENCE_INFO:
+	case DRM_PSCNV_FENCE_WAIT:
+	case DRM_PSCNV_FENCE_FD:
+		/* all start with the cid */
+		a->cid = *(uint32_t *)data;
+		break;
+	}
+}
+
+static int
+pscnv_ioctl_timed(struct drm_device *dev, unsigned int nr,
+		  int (*fn)(struct drm_device *, void *, struct drm_file *),
+		  void *data, struct drm_file *file_priv)
+{
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	struct pscnv_ioctl_args a;
+	uint64_t start, ns;
+	int ret;
+
+	pscnv_ioctl_args_get(nr, data, &a);
+	trace_pscnv_ioctl_enter(nr, &a);
+	start = pscnv_clock_ns();
+	ret = fn(dev, data, file_priv);
+	ns = pscnv_clock_ns() - start;
+	trace_pscnv_ioctl_exit(nr, ret, ns);
+
+	spin_lock(&dev_priv->ioctl_stats.lock);
+	pscnv_lat_add(&dev_priv->ioctl_stats.ioctl[nr], ns);
+	if (ret < 0)
+		dev_priv->ioctl_stats.errors[nr]++;
+	spin_unlock(&dev_priv->ioctl_stats.lock);
+	return ret;
+}
+
+#define PSCNV_IOCTL_TIMED(name, NR)					\
+int pscnv_ioctl_##name(struct drm_device *dev, void *data,		\
+		       struct drm_file *file_priv)			\
+{									\
+	return pscnv_ioctl_timed(dev, DRM_PSCNV_##NR,			\
+				 __pscnv_ioctl_##name, data, file_priv);	\
+}
+
+PSCNV_IOCTL_TIMED(getparam, GETPARAM)
+PSCNV_IOCTL_TIMED(gem_new, GEM_NEW)
+PSCNV_IOCTL_TIMED(gem_info, GEM_INFO)
+PSCNV_IOCTL_TIMED(vspace_new, VSPACE_NEW)
+PSCNV_IOCTL_TIMED(vspace_free, VSPACE_FREE)
+PSCNV_IOCTL_TIMED(vspace_map, VSPACE_MAP)
+PSCNV_IOCTL_TIMED(vspace_unmap, VSPACE_UNMAP)
+PSCNV_IOCTL_TIMED(chan_new, CHAN_NEW)
+PSCNV_IOCTL_TIMED(chan_free, CHAN_FREE)
+PSCNV_IOCTL_TIMED(obj_vdma_new, OBJ_VDMA_NEW)
+PSCNV_IOCTL_TIMED(fifo_init, FIFO_INIT)
+PSCNV_IOCTL_TIMED(obj_eng_new, OBJ_ENG_NEW)
+PSCNV_IOCTL_TIMED(fifo_init_ib, FIFO_INIT_IB)
+PSCNV_IOCTL_TIMED(chan_sched, CHAN_SCHED)
+PSCNV_IOCTL_TIMED(fence_info, FENCE_INFO)
+PSCNV_IOCTL_TIMED(fence_wait, FENCE_WAIT)
+PSCNV_IOCTL_TIMED(fence_fd, FENCE_FD)
+PSCNV_IOCTL_TIMED(obj_free, OBJ_FREE)
+PSCNV_IOCTL_TIMED(perfmon, PERFMON)
@@ -1,6 +1,17 @@
 #ifndef __PSCNV_IOCTL_H__
 #define __PSCNV_IOCTL_H__
 
+/* what the tracepoints show of an ioctl's arguments, 0 if it has none */
+struct pscnv_ioctl_args {
+	uint32_t vid;
+	uint32_t cid;
+	uint32_t handle;
+	uint32_t oclass;
+	uint32_t flags;
+	uint64_t size;
+	uint64_t offset;
+};
+
 extern int  pscnv_ioctl_getparam(struct drm_device *, void *data,
 				   struct drm_file *);
 int pscnv_ioctl_gem_new(struct drm_device *dev, void *data,
@@ -27,6 +38,18 @@ int pscnv_ioctl_fifo_init(struct drm_device *dev, void *data,
 						struct drm_file *file_priv);
 int pscnv_ioctl_fifo_init_ib(struct drm_device *dev, void *data,
 						struct drm_file *file_priv);
+int pscnv_ioctl_chan_sched(struct drm_device *dev, void *data,
+						struct drm_file *file_priv);
+int pscnv_ioctl_fence_info(struct drm_device *dev, void *data,
+						struct drm_file *file_priv);
+int pscnv_ioctl_fence_wait(struct drm_device *dev, void *data,
+						struct drm_file *file_priv);
+int pscnv_ioctl_fence_fd(struct drm_device *dev, void *data,
+						struct drm_file *file_priv);
+int pscnv_ioctl_obj_free(struct drm_device *dev, void *data,
+						struct drm_file *file_priv);
+int pscnv_ioctl_perfmon(struct drm_device *dev, void *data,
+						struct drm_file *file_priv);
 
 extern void pscnv_chan_cleanup(struct drm_device *dev, struct drm_file *file_priv);
 extern void pscnv_vspace_cleanup(struct drm_device *dev, struct drm_file *file_priv);
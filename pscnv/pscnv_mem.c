@@ -122,7 +122,7 @@ pscnv_mem_alloc(struct drm_device *dev,
 	res->gem = 0;
 
 	/* XXX: another mutex? */
-	mutex_lock(&dev_priv->vram_mutex);
+	pscnv_mutex_lock(dev, &dev_priv->vram_mutex, PSCNV_LOCK_VRAM);
 	res->serial = serial++;
 	mutex_unlock(&dev_priv->vram_mutex);
 
@@ -181,7 +181,7 @@ int
 pscnv_vram_free(struct pscnv_bo *bo)
 {
 	struct drm_nouveau_private *dev_priv = bo->dev->dev_private;
-	mutex_lock(&dev_priv->vram_mutex);
+	pscnv_mutex_lock(bo->dev, &dev_priv->vram_mutex, PSCNV_LOCK_VRAM);
 	pscnv_mm_free(bo->mmnode);
 	mutex_unlock(&dev_priv->vram_mutex);
 	return 0;
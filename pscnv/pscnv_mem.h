@@ -58,6 +58,9 @@ struct pscnv_bo {
 	dma_addr_t *dmapages;
 	/* CHAN only, pointer to a channel (FreeBSD doesn't allow overriding mmap) */
 	struct pscnv_chan *chan;
+	/* mapped into user vspaces by the kernel (fence page, engine
+	 * contexts and buffers); userspace can't unmap it */
+	int kernel_map;
 };
 #define PSCNV_GEM_NOUSER	0x10
 
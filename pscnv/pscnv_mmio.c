@@ -0,0 +1,225 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright 2010 PathScale Inc.  All rights reserved.
+ * Use is subject to license terms.
+ */
+
+#include "nouveau_drv.h"
+#include "pscnv_mmio.h"
+#ifdef __linux__
+#include <linux/sched.h>
+#include <linux/vmalloc.h>
+#endif
+
+#ifdef PSCNV_MMIO_PROFILE
+
+static struct pscnv_mmio_site *pscnv_mmio_sites;
+
+/*
+ * Sites can first be hit from interrupt context on any CPU, so this
+ * takes no lock: a site is claimed by whoever flips registered, then
+ * pushed on the list. Nothing ever comes off it, the sites are static.
+ */
+void
+pscnv_mmio_register(struct pscnv_mmio_site *site)
+{
+	struct pscnv_mmio_site *head;
+	if (!__sync_bool_compare_and_swap(&site->registered, 0, 1))
+		return;
+	do {
+		head = pscnv_mmio_sites;
+		site->next = head;
+	} while (!__sync_bool_compare_and_swap(&pscnv_mmio_sites, head, site));
+}
+
+struct pscnv_mmio_site *
+pscnv_mmio_first(void)
+{
+	return pscnv_mmio_sites;
+}
+
+void
+pscnv_mmio_reset(void)
+{
+	struct pscnv_mmio_site *site;
+	for (site = pscnv_mmio_sites; site; site = site->next)
+		memset(site->count, 0, sizeof site->count);
+}
+
+unsigned long
+pscnv_mmio_total(struct pscnv_mmio_site *site)
+{
+	return site->count[PSCNV_MMIO_RD] + site->count[PSCNV_MMIO_WR] +
+		site->count[PSCNV_MMIO_BAR3] + site->count[PSCNV_MMIO_POLL];
+}
+
+static const struct {
+	const char *match;
+	enum pscnv_mmio_subsys subsys;
+} pscnv_mmio_files[] = {
+	{ "_vm", PSCNV_MMIO_SUB_VM },
+	{ "vram", PSCNV_MMIO_SUB_VM },
+	{ "fifo", PSCNV_MMIO_SUB_FIFO },
+	{ "chan", PSCNV_MMIO_SUB_FIFO },
+	{ "fence", PSCNV_MMIO_SUB_FIFO },
+	{ "graph", PSCNV_MMIO_SUB_GRAPH },
+	{ "grctx", PSCNV_MMIO_SUB_GRAPH },
+	{ "copy", PSCNV_MMIO_SUB_GRAPH },
+	{ "crypt", PSCNV_MMIO_SUB_GRAPH },
+	{ "_pm", PSCNV_MMIO_SUB_PM },
+	{ "perf", PSCNV_MMIO_SUB_PM },
+	{ "volt", PSCNV_MMIO_SUB_PM },
+	{ "temp", PSCNV_MMIO_SUB_PM },
+	{ "calc", PSCNV_MMIO_SUB_PM },
+	{ "counter", PSCNV_MMIO_SUB_PM },
+	{ "display", PSCNV_MMIO_SUB_DISPLAY },
+	{ "crtc", PSCNV_MMIO_SUB_DISPLAY },
+	{ "cursor", PSCNV_MMIO_SUB_DISPLAY },
+	{ "dac", PSCNV_MMIO_SUB_DISPLAY },
+	{ "dfp", PSCNV_MMIO_SUB_DISPLAY },
+	{ "sor", PSCNV_MMIO_SUB_DISPLAY },
+	{ "tv", PSCNV_MMIO_SUB_DISPLAY },
+	{ "dp", PSCNV_MMIO_SUB_DISPLAY },
+	{ "hdmi", PSCNV_MMIO_SUB_DISPLAY },
+	{ "connector", PSCNV_MMIO_SUB_DISPLAY },
+	{ "i2c", PSCNV_MMIO_SUB_DISPLAY },
+	{ "iic", PSCNV_MMIO_SUB_DISPLAY },
+	{ "fbcon", PSCNV_MMIO_SUB_DISPLAY },
+	{ "hw", PSCNV_MMIO_SUB_DISPLAY },
+};
+
+const char *const pscnv_mmio_subsys_names[PSCNV_MMIO_SUBSYS] = {
+	[PSCNV_MMIO_SUB_VM] = "VM",
+	[PSCNV_MMIO_SUB_FIFO] = "FIFO",
+	[PSCNV_MMIO_SUB_GRAPH] = "graph",
+	[PSCNV_MMIO_SUB_PM] = "PM",
+	[PSCNV_MMIO_SUB_DISPLAY] = "display",
+	[PSCNV_MMIO_SUB_OTHER] = "other",
+};
+
+/* Goes by the source file name, the driver's files are named after
+ * what they do. */
+enum pscnv_mmio_subsys
+pscnv_mmio_subsys(struct pscnv_mmio_site *site)
+{
+	const char *name = strrchr(site->file, '/');
+	int i;
+	name = name ? name + 1 : site->file;
+	for (i = 0; i < ARRAY_SIZE(pscnv_mmio_files); i++)
+		if (strstr(name, pscnv_mmio_files[i].match))
+			return pscnv_mmio_files[i].subsys;
+	return PSCNV_MMIO_SUB_OTHER;
+}
+
+#endif
+
+#ifdef PSCNV_MMIO_TRACE
+
+struct pscnv_mmio_trace *
+pscnv_mmio_trace_new(int order)
+{
+	struct pscnv_mmio_trace *t;
+	if (order <= 0)
+		return NULL;
+	if (order > 24)
+		order = 24;
+	t = kzalloc(sizeof *t, GFP_KERNEL);
+	if (!t)
+		return NULL;
+	t->size = 1 << order;
+	t->rec = vzalloc(t->size * sizeof *t->rec);
+	if (!t->rec) {
+		kfree(t);
+		return NULL;
+	}
+	return t;
+}
+
+void
+pscnv_mmio_trace_free(struct pscnv_mmio_trace *t)
+{
+	if (!t)
+		return;
+	vfree(t->rec);
+	kfree(t);
+}
+
+/*
+ * Any context, any CPU: a record is claimed with an atomic add, once
+ * they're all taken the head is left alone so it can't wrap around.
+ */
+void
+pscnv_mmio_trace_rec(struct pscnv_mmio_trace *t, int op, uint32_t addr, uint32_t val)
+{
+	struct drm_pscnv_mmio_rec *r;
+	uint32_t i;
+#ifndef __linux__
+	struct timespec ts;
+#endif
+	if (t->head >= t->size) {
+		t->dropped++;
+		return;
+	}
+	i = __sync_fetch_and_add(&t->head, 1);
+	if (i >= t->size) {
+		t->dropped++;
+		return;
+	}
+	r = &t->rec[i];
+#ifdef __linux__
+	r->time = local_clock();
+	r->cpu = raw_smp_processor_id();
+#else
+	nanouptime(&ts);
+	r->time = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	r->cpu = curcpu;
+#endif
+	r->addr = addr;
+	r->val = val;
+	r->op = op;
+}
+
+/* Racy against accesses being traced at the same time, which may land
+ * in the new trace half written. */
+void
+pscnv_mmio_trace_reset(struct pscnv_mmio_trace *t)
+{
+	t->head = 0;
+	t->dropped = 0;
+}
+
+void
+pscnv_mmio_trace_head(struct pscnv_mmio_trace *t, uint32_t chipset,
+		      struct drm_pscnv_mmio_trace_head *head)
+{
+	uint32_t count = t->head;
+	memset(head, 0, sizeof *head);
+	head->magic = PSCNV_MMIO_TRACE_MAGIC;
+	head->version = PSCNV_MMIO_TRACE_VERSION;
+	head->chipset = chipset;
+	head->rec_size = sizeof(struct drm_pscnv_mmio_rec);
+	head->count = count < t->size ? count : t->size;
+	head->dropped = t->dropped;
+}
+
+#endif
@@ -0,0 +1,171 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright 2010 PathScale Inc.  All rights reserved.
+ * Use is subject to license terms.
+ */
+
+#ifndef __PSCNV_MMIO_H__
+#define __PSCNV_MMIO_H__
+
+#include "pscnv_drm.h"
+
+/*
+ * MMIO access profiling, built in with -DPSCNV_MMIO_PROFILE only.
+ *
+ * Every nv_rd32/nv_wr32/nv_rv32/... call site gets a static counter
+ * block, hooked on a global list the first time it's hit, counting BAR0
+ * reads and writes, PRAMIN accesses and window switches, BAR3 accesses
+ * and wait loop iterations. Accesses nv_rv32/nv_wv32 and the nv_wait
+ * family make on the caller's behalf are charged to the caller. The
+ * "mmio" debugfs file lists the busiest sites and totals per subsystem.
+ *
+ * Counters aren't atomic and can lose the odd increment when two CPUs
+ * hit the same site at once; they're for finding hot spots, not for
+ * exact accounting.
+ *
+ * Without PSCNV_MMIO_PROFILE, PSCNV_MMIO_SITE is NULL and counting does
+ * nothing, so the accessors compile to what they always were.
+ *
+ * Functions that aren't inline take the site only when profiling: they
+ * start their parameters with PSCNV_MMIO_SITE_PARAM, their macros pass
+ * PSCNV_MMIO_SITE_ARG, and they hand PSCNV_MMIO_CALLER on to the
+ * accessors. All three are empty or NULL otherwise.
+ */
+
+enum pscnv_mmio_kind {
+	PSCNV_MMIO_RD,		/* BAR0 reads */
+	PSCNV_MMIO_WR,		/* BAR0 writes */
+	PSCNV_MMIO_PRAMIN,	/* of those, through the PRAMIN window */
+	PSCNV_MMIO_WINDOW,	/* PRAMIN window moves */
+	PSCNV_MMIO_BAR3,	/* BAR3 reads and writes */
+	PSCNV_MMIO_POLL,	/* wait loop iterations */
+	PSCNV_MMIO_KINDS
+};
+
+struct pscnv_mmio_site {
+	const char *file;
+	const char *func;
+	int line;
+	int registered;
+	struct pscnv_mmio_site *next;
+	unsigned long count[PSCNV_MMIO_KINDS];
+};
+
+#ifdef PSCNV_MMIO_PROFILE
+
+enum pscnv_mmio_subsys {
+	PSCNV_MMIO_SUB_VM,
+	PSCNV_MMIO_SUB_FIFO,
+	PSCNV_MMIO_SUB_GRAPH,	/* and the other engines */
+	PSCNV_MMIO_SUB_PM,
+	PSCNV_MMIO_SUB_DISPLAY,
+	PSCNV_MMIO_SUB_OTHER,
+	PSCNV_MMIO_SUBSYS
+};
+
+extern const char *const pscnv_mmio_subsys_names[PSCNV_MMIO_SUBSYS];
+
+void pscnv_mmio_register(struct pscnv_mmio_site *site);
+struct pscnv_mmio_site *pscnv_mmio_first(void);
+void pscnv_mmio_reset(void);
+unsigned long pscnv_mmio_total(struct pscnv_mmio_site *site);
+enum pscnv_mmio_subsys pscnv_mmio_subsys(struct pscnv_mmio_site *site);
+
+#define PSCNV_MMIO_SITE ({						\
+	static struct pscnv_mmio_site __pscnv_mmio_site = {		\
+		.file = __FILE__, .func = __func__, .line = __LINE__,	\
+	};								\
+	&__pscnv_mmio_site;						\
+})
+
+static inline void
+pscnv_mmio_count(struct pscnv_mmio_site *site, enum pscnv_mmio_kind kind)
+{
+	if (!site->registered)
+		pscnv_mmio_register(site);
+	site->count[kind]++;
+}
+
+#define PSCNV_MMIO_SITE_PARAM	struct pscnv_mmio_site *site,
+#define PSCNV_MMIO_SITE_ARG	PSCNV_MMIO_SITE,
+#define PSCNV_MMIO_CALLER	site
+
+#else
+
+#define PSCNV_MMIO_SITE NULL
+#define pscnv_mmio_count(site, kind) do { } while (0)
+
+#define PSCNV_MMIO_SITE_PARAM
+#define PSCNV_MMIO_SITE_ARG
+#define PSCNV_MMIO_CALLER	NULL
+
+#endif
+
+/*
+ * MMIO tracing, built in with -DPSCNV_MMIO_TRACE only.
+ *
+ * Every register access goes into a per-device buffer of
+ * drm_pscnv_mmio_rec, 2^mmio_trace of them, allocated at load so card
+ * init is in it. Once it's full, further accesses are only counted as
+ * dropped, so what's kept is the start; writing to debugfs mmio_trace
+ * starts over, reading it gives the trace in the format of pscnv_drm.h.
+ * pscnv_mmio_mark brackets the init sequences test/mmio_replay knows.
+ */
+
+#ifdef PSCNV_MMIO_TRACE
+
+struct pscnv_mmio_trace {
+	struct drm_pscnv_mmio_rec *rec;
+	uint32_t size;
+	uint32_t head;		/* next free record */
+	uint64_t dropped;
+};
+
+extern int pscnv_mmio_trace_order;
+
+struct pscnv_mmio_trace *pscnv_mmio_trace_new(int order);
+void pscnv_mmio_trace_free(struct pscnv_mmio_trace *t);
+void pscnv_mmio_trace_rec(struct pscnv_mmio_trace *t, int op, uint32_t addr, uint32_t val);
+void pscnv_mmio_trace_reset(struct pscnv_mmio_trace *t);
+void pscnv_mmio_trace_head(struct pscnv_mmio_trace *t, uint32_t chipset,
+			   struct drm_pscnv_mmio_trace_head *head);
+
+#define pscnv_mmio_trace(dev_priv, op, addr, val) do {			\
+	if ((dev_priv)->mmio_trace)					\
+		pscnv_mmio_trace_rec((dev_priv)->mmio_trace,		\
+				     PSCNV_MMIO_TRACE_##op, addr, val);	\
+} while (0)
+
+#define pscnv_mmio_mark(dev, op, seq) do {				\
+	struct drm_nouveau_private *__dev_priv = (dev)->dev_private;	\
+	pscnv_mmio_trace(__dev_priv, op, 0, PSCNV_MMIO_SEQ_##seq);	\
+} while (0)
+
+#else
+
+#define pscnv_mmio_trace(dev_priv, op, addr, val) do { } while (0)
+#define pscnv_mmio_mark(dev, op, seq) do { } while (0)
+
+#endif
+
+#endif /* __PSCNV_MMIO_H__ */
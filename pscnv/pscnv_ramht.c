@@ -29,6 +29,32 @@
 #include "pscnv_ramht.h"
 #include "pscnv_vm.h"
 
+/* Sets up an empty RAMHT of 1 << bits slots at offset in bo, which must
+ * be mapped already. */
+int pscnv_ramht_init(struct pscnv_ramht *ramht, struct pscnv_bo *bo, uint32_t offset, int bits) {
+	struct drm_nouveau_private *dev_priv = bo->dev->dev_private;
+	int i;
+	ramht->shadow = kzalloc((1 << bits) * sizeof *ramht->shadow, GFP_KERNEL);
+	if (!ramht->shadow) {
+		NV_ERROR(bo->dev, "Couldn't allocate RAMHT shadow\n");
+		return -ENOMEM;
+	}
+	ramht->bo = bo;
+	ramht->offset = offset;
+	ramht->bits = bits;
+	for (i = 0; i < (8 << bits); i += 8) {
+		nv_wv32(bo, offset + i, 0);
+		nv_wv32(bo, offset + i + 4, 0);
+	}
+	dev_priv->vm->bar_flush(bo->dev);
+	return 0;
+}
+
+void pscnv_ramht_takedown(struct pscnv_ramht *ramht) {
+	kfree(ramht->shadow);
+	ramht->shadow = 0;
+}
+
 uint32_t pscnv_ramht_hash(struct pscnv_ramht *ramht, uint32_t handle) {
 	uint32_t hash = 0;
 	while (handle) {
@@ -38,56 +64,98 @@ uint32_t pscnv_ramht_hash(struct pscnv_ramht *ramht, uint32_t handle) {
 	return hash;
 }
 
+/* Walks the probe sequence of handle. Returns its slot, or -1 and the
+ * first reusable slot (or -1 if the table is full) in *freeslot. Must
+ * be called with the lock held. */
+static int pscnv_ramht_probe(struct pscnv_ramht *ramht, uint32_t handle, int *freeslot) {
+	int mask = (1 << ramht->bits) - 1;
+	int start = pscnv_ramht_hash(ramht, handle);
+	int slot = start;
+	struct pscnv_ramht_entry *e;
+	*freeslot = -1;
+	do {
+		e = &ramht->shadow[slot];
+		if (e->state == PSCNV_RAMHT_FREE) {
+			if (*freeslot == -1)
+				*freeslot = slot;
+			return -1;
+		}
+		if (e->state == PSCNV_RAMHT_TOMBSTONE) {
+			if (*freeslot == -1)
+				*freeslot = slot;
+		} else if (e->handle == handle) {
+			return slot;
+		}
+		slot = (slot + 1) & mask;
+	} while (slot != start);
+	return -1;
+}
+
 int pscnv_ramht_insert(struct pscnv_ramht *ramht, uint32_t handle, uint32_t context) {
-	/* XXX: check if the object exists already... */
 	struct drm_nouveau_private *dev_priv = ramht->bo->dev->dev_private;
-	uint32_t hash = pscnv_ramht_hash(ramht, handle);
-	uint32_t start = hash * 8;
-	uint32_t pos = start;
+	unsigned long flags;
+	int slot, freeslot;
 	if (pscnv_ramht_debug >= 2)
-		NV_INFO(ramht->bo->dev, "Handle %x hash %x\n", handle, hash);
-	spin_lock (&ramht->lock);
-	do {
-		if (!nv_rv32(ramht->bo, ramht->offset + pos + 4)) {
-			nv_wv32(ramht->bo, ramht->offset + pos, handle);
-			nv_wv32(ramht->bo, ramht->offset + pos + 4, context);
-			dev_priv->vm->bar_flush(ramht->bo->dev);
-			spin_unlock (&ramht->lock);
-			if (pscnv_ramht_debug >= 1)
-				NV_INFO(ramht->bo->dev, "Adding RAMHT entry for object %x at %x, context %x\n", handle, pos, context);
-			return 0;
-		}
-		pos += 8;
-		if (pos == 8 << ramht->bits)
-			pos = 0;
-	} while (pos != start);
-	spin_unlock (&ramht->lock);
-	NV_ERROR(ramht->bo->dev, "No RAMHT space for object %x\n", handle);
-	return -ENOMEM;
+		NV_INFO(ramht->bo->dev, "Handle %x hash %x\n", handle, pscnv_ramht_hash(ramht, handle));
+	spin_lock_irqsave (&ramht->lock, flags);
+	slot = pscnv_ramht_probe(ramht, handle, &freeslot);
+	if (slot != -1) {
+		spin_unlock_irqrestore (&ramht->lock, flags);
+		NV_ERROR(ramht->bo->dev, "RAMHT object %x already exists\n", handle);
+		return -EEXIST;
+	}
+	if (freeslot == -1) {
+		spin_unlock_irqrestore (&ramht->lock, flags);
+		NV_ERROR(ramht->bo->dev, "No RAMHT space for object %x\n", handle);
+		return -ENOMEM;
+	}
+	ramht->shadow[freeslot].handle = handle;
+	ramht->shadow[freeslot].context = context;
+	ramht->shadow[freeslot].state = PSCNV_RAMHT_USED;
+	nv_wv32(ramht->bo, ramht->offset + freeslot * 8, handle);
+	nv_wv32(ramht->bo, ramht->offset + freeslot * 8 + 4, context);
+	dev_priv->vm->bar_flush(ramht->bo->dev);
+	spin_unlock_irqrestore (&ramht->lock, flags);
+	if (pscnv_ramht_debug >= 1)
+		NV_INFO(ramht->bo->dev, "Adding RAMHT entry for object %x at %x, context %x\n", handle, freeslot * 8, context);
+	return 0;
+}
+
+/* The slot is cleared in VRAM like nouveau does, but stays a tombstone
+ * in the shadow so that probing for entries placed after it still
+ * works. Inserts reuse tombstones. A missing handle is -ENOENT, left
+ * to the caller to report. */
+int pscnv_ramht_remove(struct pscnv_ramht *ramht, uint32_t handle) {
+	struct drm_nouveau_private *dev_priv = ramht->bo->dev->dev_private;
+	unsigned long flags;
+	int slot, freeslot;
+	spin_lock_irqsave (&ramht->lock, flags);
+	slot = pscnv_ramht_probe(ramht, handle, &freeslot);
+	if (slot == -1) {
+		spin_unlock_irqrestore (&ramht->lock, flags);
+		return -ENOENT;
+	}
+	ramht->shadow[slot].state = PSCNV_RAMHT_TOMBSTONE;
+	nv_wv32(ramht->bo, ramht->offset + slot * 8, 0);
+	nv_wv32(ramht->bo, ramht->offset + slot * 8 + 4, 0);
+	dev_priv->vm->bar_flush(ramht->bo->dev);
+	spin_unlock_irqrestore (&ramht->lock, flags);
+	if (pscnv_ramht_debug >= 1)
+		NV_INFO(ramht->bo->dev, "Removing RAMHT entry for object %x at %x\n", handle, slot * 8);
+	return 0;
 }
 
+/* Returns the handle's context, or 0 if it isn't there. Misses are
+ * quiet, the caller knows whether one is an error. */
 uint32_t pscnv_ramht_find(struct pscnv_ramht *ramht, uint32_t handle) {
-	/* XXX: do this properly. */
-	uint32_t hash = pscnv_ramht_hash(ramht, handle);
-	uint32_t start = hash * 8;
-	uint32_t pos = start;
+	unsigned long flags;
+	int slot, freeslot;
 	uint32_t res;
 	if (pscnv_ramht_debug >= 2)
-		NV_INFO(ramht->bo->dev, "Handle %x hash %x\n", handle, hash);
-	spin_lock (&ramht->lock);
-	do {
-		if (!nv_rv32(ramht->bo, ramht->offset + pos + 4))
-			break;
-		if (nv_rv32(ramht->bo, ramht->offset + pos) == handle) {
-			res = nv_rv32(ramht->bo, ramht->offset + pos + 4);
-			spin_unlock (&ramht->lock);
-			return res;
-		} 
-		pos += 8;
-		if (pos == 8 << ramht->bits)
-			pos = 0;
-	} while (pos != start);
-	spin_unlock (&ramht->lock);
-	NV_ERROR(ramht->bo->dev, "RAMHT object %x not found\n", handle);
-	return 0;
+		NV_INFO(ramht->bo->dev, "Handle %x hash %x\n", handle, pscnv_ramht_hash(ramht, handle));
+	spin_lock_irqsave (&ramht->lock, flags);
+	slot = pscnv_ramht_probe(ramht, handle, &freeslot);
+	res = slot == -1 ? 0 : ramht->shadow[slot].context;
+	spin_unlock_irqrestore (&ramht->lock, flags);
+	return res;
 }
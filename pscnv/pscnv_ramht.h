@@ -27,15 +27,32 @@
 #ifndef __PSCNV_RAMHT_H__
 #define __PSCNV_RAMHT_H__
 
+/* host copy of one RAMHT slot */
+struct pscnv_ramht_entry {
+	uint32_t handle;
+	uint32_t context;
+	uint32_t state;
+};
+
+#define PSCNV_RAMHT_FREE	0
+#define PSCNV_RAMHT_USED	1
+#define PSCNV_RAMHT_TOMBSTONE	2
+
 struct pscnv_ramht {
 	struct pscnv_bo *bo;
-	spinlock_t lock;
+	spinlock_t lock;	/* irqsave, also taken under context_switch_lock */
 	uint32_t offset;
 	int bits;
+	/* 1 << bits slots, all lookups are done here. VRAM is only
+	 * ever written. */
+	struct pscnv_ramht_entry *shadow;
 };
 
+extern int pscnv_ramht_init(struct pscnv_ramht *, struct pscnv_bo *bo, uint32_t offset, int bits);
+extern void pscnv_ramht_takedown(struct pscnv_ramht *);
 extern uint32_t pscnv_ramht_hash(struct pscnv_ramht *, uint32_t handle);
 extern int pscnv_ramht_insert(struct pscnv_ramht *, uint32_t handle, uint32_t context);
+extern int pscnv_ramht_remove(struct pscnv_ramht *, uint32_t handle);
 extern uint32_t pscnv_ramht_find(struct pscnv_ramht *, uint32_t handle);
 
 #endif
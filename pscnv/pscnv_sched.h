@@ -0,0 +1,98 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright 2010 PathScale Inc.  All rights reserved.
+ * Use is subject to license terms.
+ */
+
+#ifndef __PSCNV_SCHED_H__
+#define __PSCNV_SCHED_H__
+
+/* Channel scheduling policy helpers. These only do arithmetic, so that
+ * test/sched_sim can build them on the host. */
+
+#include "pscnv_drm.h"
+
+/*
+ * Builds a weighted PFIFO playlist. prio[cid] is the priority of channel
+ * cid, or negative if it's not enabled on PFIFO. Each channel gets
+ * weight prio - lowest enabled prio + 1 and appears that many times,
+ * spread evenly over the playlist (smooth weighted round-robin), ties
+ * going to the higher priority and then the lower cid. When all enabled
+ * channels have the same priority, this gives the plain cid-ordered
+ * playlist. cur[] is nchans ints of scratch space.
+ *
+ * Returns the number of entries written to list, never more than max.
+ */
+static inline int
+pscnv_sched_build_playlist(const int *prio, int *cur, int nchans, int *list, int max)
+{
+	int pmin = PSCNV_CHAN_PRIO_MAX + 1;
+	int i, best, total = 0, n, pos;
+	for (i = 0; i < nchans; i++)
+		if (prio[i] >= 0 && prio[i] < pmin)
+			pmin = prio[i];
+	for (i = 0; i < nchans; i++) {
+		cur[i] = 0;
+		if (prio[i] >= 0)
+			total += prio[i] - pmin + 1;
+	}
+	n = total < max ? total : max;
+	for (pos = 0; pos < n; pos++) {
+		best = -1;
+		for (i = 0; i < nchans; i++) {
+			if (prio[i] < 0)
+				continue;
+			cur[i] += prio[i] - pmin + 1;
+			if (best == -1 || cur[i] > cur[best] ||
+			    (cur[i] == cur[best] && prio[i] > prio[best]))
+				best = i;
+		}
+		cur[best] -= total;
+		list[pos] = best;
+	}
+	return pos;
+}
+
+/*
+ * Encodes a timeslice in microseconds into the NVC0 RAMFC 0xf8 word:
+ * bit 28 enables it, bits 12-15 are the scale and bits 0-7 the timeout,
+ * the slice being timeout << scale PTIMER microseconds. 0 gives the
+ * default 1024us slice (PSCNV_CHAN_TIMESLICE_DEFAULT) that chan_init_ib
+ * has always used.
+ */
+static inline uint32_t
+pscnv_sched_timeslice_nvc0(uint32_t us)
+{
+	uint32_t scale = 0;
+	if (!us)
+		return 0x10003080;
+	while (us > 0xff && scale < 0xf) {
+		us = (us + 1) >> 1;
+		scale++;
+	}
+	if (us > 0xff)
+		us = 0xff;
+	return 0x10000000 | scale << 12 | us;
+}
+
+#endif /* __PSCNV_SCHED_H__ */
@@ -0,0 +1,127 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright 2010 PathScale Inc.  All rights reserved.
+ * Use is subject to license terms.
+ */
+
+/*
+ * Tracepoints, in events/pscnv under the tracing directory. Only Linux
+ * has them, elsewhere the trace_* calls compile to nothing.
+ *
+ * pscnv_ioctl_enter and pscnv_ioctl_exit bracket every pscnv ioctl, the
+ * latter with the return value and the time taken; pscnv_lock_wait fires
+ * whenever one of the lock classes of nouveau_drv.h had to be waited for.
+ */
+
+#ifndef __linux__
+
+#ifndef __PSCNV_TRACE_H__
+#define __PSCNV_TRACE_H__
+#define trace_pscnv_ioctl_enter(nr, a) do { } while (0)
+#define trace_pscnv_ioctl_exit(nr, ret, ns) do { } while (0)
+#define trace_pscnv_lock_wait(lock, ns) do { } while (0)
+#endif
+
+#else
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM pscnv
+
+#if !defined(__PSCNV_TRACE_H__) || defined(TRACE_HEADER_MULTI_READ)
+#define __PSCNV_TRACE_H__
+
+#include <linux/tracepoint.h>
+#include "pscnv_ioctl.h"
+
+TRACE_EVENT(pscnv_ioctl_enter,
+	TP_PROTO(unsigned int nr, const struct pscnv_ioctl_args *a),
+	TP_ARGS(nr, a),
+	TP_STRUCT__entry(
+		__field(unsigned int, nr)
+		__field(uint32_t, vid)
+		__field(uint32_t, cid)
+		__field(uint32_t, handle)
+		__field(uint32_t, oclass)
+		__field(uint32_t, flags)
+		__field(uint64_t, size)
+		__field(uint64_t, offset)
+	),
+	TP_fast_assign(
+		__entry->nr = nr;
+		__entry->vid = a->vid;
+		__entry->cid = a->cid;
+		__entry->handle = a->handle;
+		__entry->oclass = a->oclass;
+		__entry->flags = a->flags;
+		__entry->size = a->size;
+		__entry->offset = a->offset;
+	),
+	TP_printk("nr=0x%02x vid=%u cid=%u handle=0x%x oclass=0x%x flags=0x%x size=0x%llx offset=0x%llx",
+		  __entry->nr, __entry->vid, __entry->cid, __entry->handle,
+		  __entry->oclass, __entry->flags,
+		  (unsigned long long)__entry->size,
+		  (unsigned long long)__entry->offset)
+);
+
+TRACE_EVENT(pscnv_ioctl_exit,
+	TP_PROTO(unsigned int nr, int ret, uint64_t ns),
+	TP_ARGS(nr, ret, ns),
+	TP_STRUCT__entry(
+		__field(unsigned int, nr)
+		__field(int, ret)
+		__field(uint64_t, ns)
+	),
+	TP_fast_assign(
+		__entry->nr = nr;
+		__entry->ret = ret;
+		__entry->ns = ns;
+	),
+	TP_printk("nr=0x%02x ret=%d ns=%llu", __entry->nr, __entry->ret,
+		  (unsigned long long)__entry->ns)
+);
+
+TRACE_EVENT(pscnv_lock_wait,
+	TP_PROTO(int lock, uint64_t ns),
+	TP_ARGS(lock, ns),
+	TP_STRUCT__entry(
+		__field(int, lock)
+		__field(uint64_t, ns)
+	),
+	TP_fast_assign(
+		__entry->lock = lock;
+		__entry->ns = ns;
+	),
+	TP_printk("lock=%s ns=%llu",
+		  __entry->lock == PSCNV_LOCK_VRAM ? "vram" : "vspace",
+		  (unsigned long long)__entry->ns)
+);
+
+#endif
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE pscnv_trace
+#include <trace/define_trace.h>
+
+#endif
@@ -0,0 +1,160 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright 2010 PathScale Inc.  All rights reserved.
+ * Use is subject to license terms.
+ */
+
+#include "drm.h"
+#include "nouveau_drv.h"
+#include "nouveau_reg.h"
+#include "pscnv_trap.h"
+
+static void pscnv_trap_work(struct work_struct *work) {
+	struct pscnv_trap_ring *ring = container_of(work, struct pscnv_trap_ring, work);
+	struct drm_device *dev = ring->dev;
+	struct pscnv_trap *t;
+	unsigned long flags;
+	uint64_t dropped;
+
+	spin_lock_irqsave(&ring->lock, flags);
+	while (ring->tail != ring->head) {
+		t = &ring->ent[ring->tail];
+		spin_unlock_irqrestore(&ring->lock, flags);
+		/* the slot is ours until tail moves past it */
+		t->decoding = 1;
+		t->cursor = 0;
+		t->fn(dev, t, t->arg);
+		if (t->truncated)
+			NV_ERROR(dev, "trap snapshot truncated after %d registers\n", t->nregs);
+		spin_lock_irqsave(&ring->lock, flags);
+		ring->tail = (ring->tail + 1) % PSCNV_TRAP_RING;
+		ring->decoded++;
+	}
+	dropped = ring->dropped - ring->dropped_reported;
+	ring->dropped_reported = ring->dropped;
+	spin_unlock_irqrestore(&ring->lock, flags);
+	if (dropped)
+		NV_ERROR(dev, "%llu trap reports dropped, ring full\n", (unsigned long long)dropped);
+}
+
+int pscnv_trap_init(struct drm_device *dev) {
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	struct pscnv_trap_ring *ring = kzalloc(sizeof *ring, GFP_KERNEL);
+	if (!ring)
+		return -ENOMEM;
+	ring->dev = dev;
+	spin_lock_init(&ring->lock);
+	INIT_WORK(&ring->work, pscnv_trap_work);
+	dev_priv->trap = ring;
+	return 0;
+}
+
+/* IRQ must be uninstalled already. */
+void pscnv_trap_takedown(struct drm_device *dev) {
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	struct pscnv_trap_ring *ring = dev_priv->trap;
+	if (!ring)
+		return;
+	cancel_work_sync(&ring->work);
+	dev_priv->trap = 0;
+	kfree(ring);
+}
+
+/*
+ * Runs fn in the interrupt as described in pscnv_trap.h and queues it for
+ * decoding if it had anything to report. With the ring full the reports
+ * are lost, but fn still runs to ack the trap.
+ */
+void pscnv_trap_run(struct drm_device *dev, pscnv_trap_fn fn, uint32_t arg) {
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	struct pscnv_trap_ring *ring = dev_priv->trap;
+	struct pscnv_trap *t;
+	unsigned long flags;
+	int full, queue = 0;
+
+	spin_lock_irqsave(&ring->lock, flags);
+	full = (ring->head + 1) % PSCNV_TRAP_RING == ring->tail;
+	t = full ? &ring->spare : &ring->ent[ring->head];
+	t->fn = fn;
+	t->arg = arg;
+	t->decoding = 0;
+	t->truncated = 0;
+	t->nmsgs = 0;
+	t->nregs = 0;
+	fn(dev, t, arg);
+	if (t->nmsgs) {
+		if (full) {
+			ring->dropped++;
+		} else {
+			ring->head = (ring->head + 1) % PSCNV_TRAP_RING;
+			ring->queued++;
+			queue = 1;
+		}
+	}
+	spin_unlock_irqrestore(&ring->lock, flags);
+	if (queue)
+		queue_work(dev_priv->wq, &ring->work);
+}
+
+/*
+ * A stand-in for a TPROP trap: a few status registers, a handful of
+ * others and one message, so the storm costs what a real one would.
+ */
+static void pscnv_trap_synthetic(struct drm_device *dev, struct pscnv_trap *t, uint32_t arg) {
+	uint32_t status = TRAP_RD(dev, t, NV03_PMC_BOOT_0);
+	uint32_t first = TRAP_RD(dev, t, NV04_PTIMER_TIME_0);
+	uint32_t last = first;
+	int i;
+	for (i = 0; i < 7; i++)
+		last = TRAP_RD(dev, t, NV04_PTIMER_TIME_0);
+	TRAP_INFO(dev, t, "synthetic trap %d: %08x, %d ns\n", arg, status, last - first);
+}
+
+/*
+ * Software interrupt. Returns 1 if it was raised by a trap storm, which
+ * keeps raising it until the count runs out.
+ */
+int pscnv_trap_storm(struct drm_device *dev) {
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	struct pscnv_trap_ring *ring = dev_priv->trap;
+	if (!ring->storm)
+		return 0;
+	ring->storm--;
+	pscnv_trap_run(dev, pscnv_trap_synthetic, ring->storm);
+	if (ring->storm)
+		nv_wr32(dev, NV03_PMC_INTR_0, 0x80000000);
+	return 1;
+}
+
+/* Raises count synthetic traps back to back and restarts the IRQ statistics. */
+void pscnv_trap_storm_start(struct drm_device *dev, uint32_t count) {
+	struct drm_nouveau_private *dev_priv = dev->dev_private;
+	struct pscnv_trap_ring *ring = dev_priv->trap;
+	unsigned long flags;
+	spin_lock_irqsave(&dev_priv->context_switch_lock, flags);
+	memset(&dev_priv->irq_stats, 0, sizeof dev_priv->irq_stats);
+	ring->storm = count;
+	if (count)
+		nv_wr32(dev, NV03_PMC_INTR_0, 0x80000000);
+	spin_unlock_irqrestore(&dev_priv->context_switch_lock, flags);
+}
@@ -0,0 +1,106 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright 2010 PathScale Inc.  All rights reserved.
+ * Use is subject to license terms.
+ */
+
+#ifndef __PSCNV_TRAP_H__
+#define __PSCNV_TRAP_H__
+
+#include "nouveau_drv.h"
+
+/*
+ * Deferred trap decoding. Interrupt handlers with a lot to say run their
+ * decoder through pscnv_trap_run. In the interrupt, every register the
+ * decoder reads (and anything else it depends on that may change later)
+ * goes through TRAP_VAL and is recorded, writes are done, and messages
+ * are only counted. If there were any, the snapshot is queued and the
+ * decoder runs again from the workqueue: TRAP_VAL then hands back the
+ * recorded values in order, writes are skipped and messages printed.
+ *
+ * So a decoder must take the same path both times: message arguments
+ * mustn't read registers, and values written may read them directly
+ * since they're not evaluated on replay.
+ */
+
+#define PSCNV_TRAP_RING		16
+#define PSCNV_TRAP_REGS		384
+
+struct pscnv_trap;
+
+typedef void (*pscnv_trap_fn)(struct drm_device *dev, struct pscnv_trap *t, uint32_t arg);
+
+struct pscnv_trap {
+	pscnv_trap_fn fn;
+	uint32_t arg;
+	int decoding;
+	int truncated;
+	uint32_t nmsgs;
+	uint32_t nregs;
+	uint32_t cursor;
+	uint32_t val[PSCNV_TRAP_REGS];
+};
+
+struct pscnv_trap_ring {
+	struct drm_device *dev;
+	spinlock_t lock;
+	struct work_struct work;
+	uint32_t head, tail;
+	struct pscnv_trap ent[PSCNV_TRAP_RING];
+	struct pscnv_trap spare;	/* scratch when the ring is full */
+	uint64_t queued;
+	uint64_t decoded;
+	uint64_t dropped;
+	uint64_t dropped_reported;
+	/* synthetic traps still to raise, see pscnv_trap_storm_start */
+	uint32_t storm;
+};
+
+static inline uint32_t pscnv_trap_record(struct pscnv_trap *t, uint32_t val) {
+	if (t->nregs < PSCNV_TRAP_REGS)
+		t->val[t->nregs++] = val;
+	else
+		t->truncated = 1;
+	return val;
+}
+
+static inline uint32_t pscnv_trap_replay(struct pscnv_trap *t) {
+	return t->cursor < t->nregs ? t->val[t->cursor++] : 0;
+}
+
+#define TRAP_VAL(t, expr) ((t)->decoding ? pscnv_trap_replay(t) : pscnv_trap_record(t, (expr)))
+#define TRAP_RD(dev, t, reg) TRAP_VAL(t, nv_rd32(dev, reg))
+#define TRAP_WR(dev, t, reg, val) do { if (!(t)->decoding) nv_wr32(dev, reg, val); } while (0)
+#define TRAP_ERROR(dev, t, fmt, arg...) do { if ((t)->decoding) NV_ERROR(dev, fmt, ##arg); else (t)->nmsgs++; } while (0)
+#define TRAP_INFO(dev, t, fmt, arg...) do { if ((t)->decoding) NV_INFO(dev, fmt, ##arg); else (t)->nmsgs++; } while (0)
+
+int pscnv_trap_init(struct drm_device *dev);
+void pscnv_trap_takedown(struct drm_device *dev);
+void pscnv_trap_run(struct drm_device *dev, pscnv_trap_fn fn, uint32_t arg);
+
+/* called from nouveau_irq_handler, under context_switch_lock */
+int pscnv_trap_storm(struct drm_device *dev);
+
+void pscnv_trap_storm_start(struct drm_device *dev, uint32_t count);
+
+#endif
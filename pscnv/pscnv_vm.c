@@ -144,7 +144,7 @@ pscnv_vspace_map(struct pscnv_vspace *vs, struct pscnv_bo *bo,
 	struct pscnv_mm_node *node;
 	int ret;
 	struct drm_nouveau_private *dev_priv = vs->dev->dev_private;
-	mutex_lock(&vs->lock);
+	pscnv_mutex_lock(vs->dev, &vs->lock, PSCNV_LOCK_VSPACE);
 	ret = dev_priv->vm->place_map(vs, bo, start, end, back, &node);
 	if (ret) {
 		mutex_unlock(&vs->lock);
@@ -157,7 +157,10 @@ pscnv_vspace_map(struct pscnv_vspace *vs, struct pscnv_bo *bo,
 				node->start + node->size);
 	ret = dev_priv->vm->do_map(vs, bo, node->start);
 	if (ret) {
-		pscnv_vspace_unmap_node_unlocked(node);
+		/* the caller keeps its reference to bo on failure */
+		dev_priv->vm->do_unmap(vs, node->start, node->size);
+		pscnv_mm_free(node);
+		node = 0;
 	}
 	*res = node;
 	mutex_unlock(&vs->lock);
@@ -168,17 +171,28 @@ int
 pscnv_vspace_unmap_node(struct pscnv_mm_node *node) {
 	struct pscnv_vspace *vs = node->tag2;
 	int ret;
-	mutex_lock(&vs->lock);
+	pscnv_mutex_lock(vs->dev, &vs->lock, PSCNV_LOCK_VSPACE);
 	ret = pscnv_vspace_unmap_node_unlocked(node);
 	mutex_unlock(&vs->lock);
 	return ret;
 }
 
+/* Unmaps on behalf of userspace, which can't touch what the kernel mapped
+ * for its own use. */
 int
 pscnv_vspace_unmap(struct pscnv_vspace *vs, uint64_t start) {
+	struct pscnv_mm_node *node;
+	struct pscnv_bo *bo;
 	int ret;
-	mutex_lock(&vs->lock);
-	ret = pscnv_vspace_unmap_node_unlocked(pscnv_mm_find_node(vs->mm, start));
+	pscnv_mutex_lock(vs->dev, &vs->lock, PSCNV_LOCK_VSPACE);
+	node = pscnv_mm_find_node(vs->mm, start);
+	bo = node ? node->tag : 0;
+	if (!bo)
+		ret = -ENOENT;
+	else if (bo->kernel_map)
+		ret = -EPERM;
+	else
+		ret = pscnv_vspace_unmap_node_unlocked(node);
 	mutex_unlock(&vs->lock);
 	return ret;
 }
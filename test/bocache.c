@@ -0,0 +1,101 @@
+#include "libpscnv.h"
+#include "libpscnv_ib.h"
+#include "libpscnv_bocache.h"
+#include <xf86drm.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+#define N	8192
+#define LIVE	16
+
+static double now(void) {
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* a few buffers of varying size live at a time, as in a kernel launch loop */
+static uint64_t size_of(int i) {
+	return 0x1000 + (i * 0x9e3779b9u >> 12) % 0x40000;
+}
+
+int
+main()
+{
+	int fd;
+	uint32_t vid;
+	struct pscnv_bo_cache *cache;
+	struct pscnv_ib_bo *bo[LIVE] = { 0 };
+	uint32_t flags = PSCNV_GEM_SYSRAM_SNOOP | PSCNV_GEM_MAPPABLE;
+	double t;
+	int i;
+        fd = drmOpen("pscnv", 0);
+	if (fd == -1) {
+		perror("drmOpen");
+		return 1;
+	}
+	if (pscnv_vspace_new(fd, &vid)) {
+		perror("vspace_new");
+		return 1;
+	}
+
+	t = now();
+	for (i = 0; i < N; i++) {
+		if (bo[i % LIVE])
+			pscnv_ib_bo_free(bo[i % LIVE]);
+		if (pscnv_ib_bo_alloc(fd, vid, 0xb0, flags, 0, size_of(i), 0, &bo[i % LIVE])) {
+			printf("bo_alloc %d failed\n", i);
+			return 1;
+		}
+	}
+	for (i = 0; i < LIVE; i++) {
+		pscnv_ib_bo_free(bo[i]);
+		bo[i] = 0;
+	}
+	printf("uncached: %.2f us per alloc/free\n", (now() - t) * 1e6 / N);
+
+	if (pscnv_bo_cache_new(fd, vid, &cache)) {
+		printf("cache_new failed\n");
+		return 1;
+	}
+	t = now();
+	for (i = 0; i < N; i++) {
+		if (bo[i % LIVE])
+			pscnv_bo_cache_free(cache, bo[i % LIVE]);
+		if (pscnv_bo_cache_alloc(cache, 0xb0, flags, 0, size_of(i), 0, &bo[i % LIVE])) {
+			printf("cache_alloc %d failed\n", i);
+			return 1;
+		}
+		if (bo[i % LIVE]->size < size_of(i)) {
+			printf("cache_alloc %d: got %d bytes\n", i, bo[i % LIVE]->size);
+			return 1;
+		}
+		/* touch it, reused mappings must still work */
+		*(volatile uint32_t *)bo[i % LIVE]->map = i;
+	}
+	for (i = 0; i < LIVE; i++)
+		pscnv_bo_cache_free(cache, bo[i]);
+	printf("cached:   %.2f us per alloc/free, %llu hits, %llu misses, %llu ioctls saved, %llu bytes cached\n",
+		(now() - t) * 1e6 / N, (unsigned long long)cache->hits, (unsigned long long)cache->misses,
+		(unsigned long long)cache->ioctls_saved, (unsigned long long)cache->bytes);
+
+	if (!cache->hits) {
+		printf("no cache hits\n");
+		return 1;
+	}
+	pscnv_bo_cache_set_limits(cache, 1 << 20, cache->max_age_us);
+	if (cache->bytes > 1 << 20) {
+		printf("%llu bytes cached over a 1 MiB limit\n", (unsigned long long)cache->bytes);
+		return 1;
+	}
+	pscnv_bo_cache_trim(cache, 0);
+	if (cache->bytes) {
+		printf("%llu bytes left after trim\n", (unsigned long long)cache->bytes);
+		return 1;
+	}
+	pscnv_bo_cache_destroy(cache);
+	pscnv_vspace_free(fd, vid);
+
+	printf("Passed.\n");
+	return 0;
+}
@@ -0,0 +1,163 @@
+/*
+ * Checks libpscnv_compute without a card. The channel is plain memory as
+ * in pb_bench, and everything submitted goes through libpscnv_decode to
+ * a simulated object, which has to hold exactly the state the launch was
+ * set up with whenever LAUNCH comes by.
+ *
+ * Dispatches are shaped like mem_test's: the same kernel and segments,
+ * with a changing grid and parameters. The dwords and doorbells they take
+ * are compared with emitting the full state before each launch.
+ */
+
+#include "libpscnv_ib.h"
+#include "libpscnv_compute.h"
+#include "libpscnv_decode.h"
+#include "fake_chan.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PB_ORDER	20
+#define IB_ORDER	9
+#define LAUNCHES	10000
+#define SNAPS		64	/* more than a batch of launches */
+
+static uint32_t gpu[0x800/4], expect[0x800/4], snap[SNAPS][0x800/4];
+static int launches, idles, fails;
+
+static void method(void *priv, int subc, uint32_t obj, uint32_t oclass, uint32_t mthd, uint32_t data, int flags) {
+	if (mthd == 0x110)
+		idles++;
+	if (mthd < 0x100 || mthd >= 0x800)
+		return;
+	if (mthd == PSCNV_COMPUTE_LAUNCH) {
+		/* everything below USER_PARAM, and the params in use */
+		uint32_t *e = snap[launches % SNAPS];
+		if (memcmp(gpu, e, 0x600) || memcmp(gpu + 0x600/4, e + 0x600/4, (gpu[0x374/4] >> 8) * 4)) {
+			if (!fails)
+				printf("state mismatch at launch %d\n", launches);
+			fails++;
+		}
+		launches++;
+		return;
+	}
+	if (mthd != 0x2f8)
+		gpu[mthd / 4] = data;
+}
+
+static struct pscnv_decode dec;
+
+/* Executes every IB entry, like the real PFIFO would. */
+static void fake_pfifo(struct pscnv_ib_chan *ch) {
+	uint32_t get = ch->chmap[0x88/4];
+	uint32_t put = ch->chmap[0x8c/4];
+	uint64_t start, end;
+	while (get != put) {
+		if (fake_chan_entry(ch, get, &start, &end) ||
+		    pscnv_decode(&dec, fake_chan_data(ch, start), (end - start) / 4))
+			fails++;
+		fake_chan_consume(ch, &get, end);
+	}
+}
+
+static void set(struct pscnv_compute *cp, uint32_t mthd, uint32_t value) {
+	expect[mthd / 4] = value;
+	if (cp)
+		pscnv_compute_set(cp, mthd, value);
+}
+
+/* the state mem_test sets up, and the dwords it takes to emit */
+static int setup(struct pscnv_compute *cp, int i, int *ctas) {
+	uint32_t params[2];
+	int threads = i % 3 ? 128 : 256;
+	*ctas = 16 + i % 4;
+	set(cp, 0x210, 0);
+	set(cp, 0x214, 0x10000000);
+	set(cp, 0x2b4, threads);
+	set(cp, 0x2c0, 4);
+	set(cp, 0x3a4, 0x10000 | *ctas);
+	set(cp, 0x3a8, 0x40);
+	set(cp, 0x3ac, 0x10000 | threads);
+	set(cp, 0x3b0, 1);
+	set(cp, 0x3b4, i & 1 ? 0x50 : 0);
+	set(cp, 0x400, 0);
+	set(cp, 0x404, 0x10100000);
+	set(cp, 0x408, 0);
+	set(cp, 0x40c, 0xfffffff);
+	set(cp, 0x410, 1);
+	set(cp, 0x420, 0);
+	set(cp, 0x424, 0x10200000);
+	set(cp, 0x428, 0);
+	set(cp, 0x42c, 0xfffffff);
+	set(cp, 0x430, 1);
+	params[0] = 0x100000;
+	params[1] = 0x100000 / *ctas;
+	set(0, 0x374, 2 << 8);
+	set(0, 0x600, params[0]);
+	set(0, 0x604, params[1]);
+	if (cp && pscnv_compute_params(cp, params, 2))
+		fails++;
+	/* 0x210, 0x2b4, 0x2c0, 0x3a4 and both segments, param count,
+	 * params, CP_START_ID, latch and launch, as mem_test has them */
+	return 3 + 2 + 2 + 6 + 6 + 6 + 2 + 3 + 2 + 2 + 2;
+}
+
+int
+main()
+{
+	struct pscnv_ib_chan ch;
+	struct pscnv_compute *cp;
+	uint64_t naive = 0;
+	int i, ctas;
+
+	fake_chan_init(&ch, PB_ORDER, IB_ORDER, 0, 0);
+	pscnv_ib_set_batch(&ch, 32, 256 << 10, 0);
+	pscnv_decode_init(&dec, 0x50);
+	dec.method = method;
+	if (pscnv_compute_new(&ch, 0, 0x50c0, 0xdeadd00d, &cp))
+		return 1;
+	for (i = 0; i < LAUNCHES; i++) {
+		naive += setup(cp, i, &ctas);
+		/* someone else touches the object, once what's queued ran */
+		if (i == LAUNCHES / 2) {
+			pscnv_compute_flush(cp);
+			fake_pfifo(&ch);
+			gpu[0x3a8/4] = 0x80;
+			pscnv_compute_invalidate(cp);
+		}
+		/* wait for idle is a trigger, every write of it counts */
+		if (i % 100 == 0) {
+			pscnv_compute_set(cp, 0x110, 0);
+			pscnv_compute_set(cp, 0x110, 0);
+		}
+		memcpy(snap[i % SNAPS], expect, sizeof expect);
+		pscnv_compute_launch(cp);
+		if (i % 7 == 0)
+			fake_pfifo(&ch);
+	}
+	pscnv_compute_flush(cp);
+	fake_pfifo(&ch);
+
+	if (launches != LAUNCHES) {
+		printf("%d launches seen, expected %d\n", launches, LAUNCHES);
+		fails++;
+	}
+	if (idles != LAUNCHES / 100 * 2) {
+		printf("%d waits for idle seen, expected %d\n", idles, LAUNCHES / 100 * 2);
+		fails++;
+	}
+	printf("%d launches: %.1f dwords each, %.1f hand-emitted; %llu submissions, %d hand-emitted\n",
+		LAUNCHES, (double)cp->words / LAUNCHES, (double)naive / LAUNCHES,
+		(unsigned long long)cp->flushes, LAUNCHES);
+	printf("%llu sets matched the GPU's state, %llu doorbells\n",
+		(unsigned long long)cp->skipped, (unsigned long long)ch.nkicks);
+	if (cp->words * 2 > naive)
+		fails++;
+	pscnv_compute_free(cp);
+
+	if (fails) {
+		printf("Failed.\n");
+		return 1;
+	}
+	printf("Passed.\n");
+	return 0;
+}
@@ -0,0 +1,85 @@
+#ifndef FAKE_CHAN_H
+#define FAKE_CHAN_H
+/*
+ * A libpscnv_ib channel without a card, for the tests that run on the
+ * host. The control area is plain memory, the IB ring and pushbuffer
+ * are calloc'ed and pretend to sit at FAKE_CHAN_PB_BASE. The test plays
+ * PFIFO itself: it takes the entry at GET with fake_chan_entry, checks
+ * or executes its data, then moves GET past it with fake_chan_consume.
+ */
+
+#include "libpscnv_ib.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define FAKE_CHAN_PB_BASE	0x20000000
+#define FAKE_CHAN_TRACK_ADDR	0x30000000
+
+static volatile uint32_t fake_chmap[0x1000/4];
+
+/* With track, GET tracking releases land in its track_size bytes. The
+ * batch limits are left to the caller. */
+static inline void fake_chan_init(struct pscnv_ib_chan *ch, uint32_t pb_order, uint32_t ib_order,
+				  volatile uint32_t *track, uint32_t track_size) {
+	memset(ch, 0, sizeof *ch);
+	memset((void *)fake_chmap, 0, sizeof fake_chmap);
+	ch->chmap = fake_chmap;
+	ch->ib_order = ib_order;
+	ch->ib_mask = (1 << ib_order) - 1;
+	ch->ib_map = calloc(2 << ib_order, 4);
+	ch->pb_order = pb_order;
+	ch->pb_size = 1 << pb_order;
+	ch->pb_mask = ch->pb_size - 1;
+	ch->pb_map = calloc(ch->pb_size, 1);
+	ch->pb_base = FAKE_CHAN_PB_BASE;
+	if (track) {
+		memset((void *)track, 0, track_size);
+		ch->track_map = track;
+		ch->track_addr = FAKE_CHAN_TRACK_ADDR;
+		ch->track_ring = calloc(ch->ib_mask + 1, sizeof *ch->track_ring);
+	}
+}
+
+static inline void fake_chan_fini(struct pscnv_ib_chan *ch) {
+	free(ch->mp_ready);
+	free(ch->track_ring);
+	free(ch->ib_map);
+	free(ch->pb_map);
+}
+
+/* The pushbuffer range of the IB entry at get. Fails if it isn't all
+ * in the pushbuffer. */
+static inline int fake_chan_entry(struct pscnv_ib_chan *ch, uint32_t get, uint64_t *start, uint64_t *end) {
+	uint64_t w;
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	w = (uint64_t)ch->ib_map[get * 2 + 1] << 32 | ch->ib_map[get * 2];
+	*start = w & 0xffffffffffull;
+	*end = *start + (w >> 40);
+	return *start < ch->pb_base || *end > ch->pb_base + ch->pb_size;
+}
+
+static inline uint32_t *fake_chan_data(struct pscnv_ib_chan *ch, uint64_t addr) {
+	return &ch->pb_map[(addr - ch->pb_base) / 4];
+}
+
+/* Executes the GET tracking release that ends the entry. Fails if it
+ * isn't one, or doesn't land in the first track_size bytes of track. */
+static inline int fake_chan_release(struct pscnv_ib_chan *ch, uint64_t end, uint32_t track_size) {
+	uint32_t *rel = fake_chan_data(ch, end) - PSCNV_IB_TRACK_DWORDS;
+	uint64_t addr = (uint64_t)rel[1] << 32 | rel[2];
+	if (rel[0] != (4 << 18 | 0x10) || rel[4] != 2 ||
+	    addr < ch->track_addr || addr >= ch->track_addr + track_size)
+		return 1;
+	ch->track_map[(addr - ch->track_addr) / 4] = rel[3];
+	return 0;
+}
+
+/* Moves IB GET past the entry at *get, and pushbuffer GET to its end. */
+static inline void fake_chan_consume(struct pscnv_ib_chan *ch, uint32_t *get, uint64_t end) {
+	ch->chmap[0x58/4] = end;
+	ch->chmap[0x5c/4] = (end >> 32) | 0x80000000;
+	*get = (*get + 1) & ch->ib_mask;
+	ch->chmap[0x88/4] = *get;
+}
+
+#endif
@@ -0,0 +1,64 @@
+#include "libpscnv.h"
+#include "libpscnv_ib.h"
+#include <xf86drm.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <poll.h>
+
+int
+main()
+{
+	int fd;
+	int ret;
+	struct pscnv_ib_chan *ch;
+	struct pollfd pfd;
+	uint32_t seq;
+	int i;
+        fd = drmOpen("pscnv", 0);
+	if (fd == -1) {
+		perror("drmOpen");
+		return 1;
+	}
+
+	ret = pscnv_ib_chan_new(fd, 0, &ch, 0xdeadbeef, 0, 0);
+	if (ret) {
+		perror("chan_new");
+		return 1;
+	}
+
+	for (i = 0; i < 0x10000; i++) {
+		seq = pscnv_ib_fence_emit(ch);
+		ret = pscnv_ib_fence_wait(ch, seq, 1000000000);
+		if (ret) {
+			printf("fence %d: wait failed: %d\n", seq, ret);
+			return 1;
+		}
+	}
+
+	/* a sequence we never emit must time out */
+	ret = pscnv_ib_fence_wait(ch, seq + 1, 10000000);
+	if (!ret) {
+		printf("fence %d: didn't time out\n", seq + 1);
+		return 1;
+	}
+
+	ret = pscnv_fence_fd(fd, ch->cid, seq + 1, &pfd.fd);
+	if (ret) {
+		perror("fence_fd");
+		return 1;
+	}
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, 0) != 0) {
+		printf("fence fd ready too early\n");
+		return 1;
+	}
+	pscnv_ib_fence_emit(ch);
+	if (poll(&pfd, 1, 1000) != 1) {
+		printf("fence fd never became ready\n");
+		return 1;
+	}
+	close(pfd.fd);
+
+	printf("Passed.\n");
+	return 0;
+}
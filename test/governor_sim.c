@@ -0,0 +1,167 @@
+/*
+ * Host-side check of the "auto" reclocking profile's decisions, fed
+ * synthetic PGRAPH utilization traces. Doesn't need a card.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "nouveau_governor.h"
+
+static int fails;
+
+static void check(int cond, const char *what) {
+	if (!cond) {
+		printf("FAIL: %s\n", what);
+		fails++;
+	}
+}
+
+static const struct nouveau_gov_params params = {
+	.up = NOUVEAU_GOV_UP,
+	.down = NOUVEAU_GOV_DOWN,
+	.residency_ms = NOUVEAU_GOV_RESIDENCY,
+	.defer_ms = NOUVEAU_GOV_DEFER,
+};
+
+/* Feeds busy[] (ending with -1) every NOUVEAU_GOV_PERIOD ms from *now,
+ * doing every change asked for at once like nouveau_pm_trigger does when
+ * reclocking works. queued says whether channels have work pending. */
+static void run(struct nouveau_gov *g, uint32_t *now, const int *busy, int queued) {
+	int i, level;
+	for (i = 0; busy[i] >= 0; i++) {
+		*now += NOUVEAU_GOV_PERIOD;
+		level = nouveau_gov_sample(g, *now, busy[i], queued);
+		nouveau_gov_switched(g, *now, level);
+	}
+}
+
+/* n samples of the same load */
+static void steady(struct nouveau_gov *g, uint32_t *now, int busy, int n, int queued) {
+	int trace[64];
+	int i;
+	for (i = 0; i < n; i++)
+		trace[i] = busy;
+	trace[n] = -1;
+	run(g, now, trace, queued);
+}
+
+int main() {
+	struct nouveau_gov g;
+	uint32_t now = 1000;
+	uint32_t before;
+	uint64_t total;
+	int i, level;
+	static const int spiky[] = { 100, 0, 0, 0, 100, 0, 0, 0, 100, 0, 0, 0, -1 };
+	static const int middle[] = { 50, 60, 40, 70, 45, 55, 65, 35, 50, 60, -1 };
+
+	/* out of the boot level, the first sample takes us to the top */
+	nouveau_gov_init(&g, &params, 4, -1, now);
+	steady(&g, &now, 0, 1, 0);
+	check(g.cur == 3 && g.reclocks == 1, "leaving boot");
+
+	/* idle: one level down per residency period, no faster */
+	steady(&g, &now, 0, 4, 0);
+	check(g.cur == 3, "residency before stepping down");
+	steady(&g, &now, 0, 1, 0);
+	check(g.cur == 2, "first step down");
+	steady(&g, &now, 0, 4, 0);
+	check(g.cur == 2, "residency between steps");
+	steady(&g, &now, 0, 20, 0);
+	check(g.cur == 0 && g.reclocks == 4, "bottom");
+	steady(&g, &now, 0, 20, 0);
+	check(g.cur == 0 && g.reclocks == 4, "stays at the bottom");
+
+	/* load in the hysteresis band never moves us, from either side */
+	before = g.reclocks;
+	for (i = 0; i < 5; i++)
+		run(&g, &now, middle, 0);
+	check(g.cur == 0 && g.reclocks == before, "band from below");
+
+	/* sustained load: straight to the top, not one level at a time */
+	steady(&g, &now, 100, 10, 0);
+	check(g.cur == 3 && g.reclocks == before + 1, "up to the top");
+	before = g.reclocks;
+	for (i = 0; i < 5; i++)
+		run(&g, &now, middle, 0);
+	check(g.cur == 3 && g.reclocks == before, "band from above");
+
+	/* a single busy sample isn't enough to go up */
+	steady(&g, &now, 0, 50, 0);
+	check(g.cur == 0, "idle again");
+	before = g.reclocks;
+	steady(&g, &now, 100, 1, 0);
+	check(g.cur == 0 && g.reclocks == before, "one spike");
+	steady(&g, &now, 0, 10, 0);
+
+	/* short bursts averaging 25% don't cause flapping */
+	before = g.reclocks;
+	for (i = 0; i < 10; i++)
+		run(&g, &now, spiky, 0);
+	check(g.reclocks == before, "no flapping on bursts");
+
+	/* while channels have work queued, a change waits... */
+	steady(&g, &now, 100, 10, 0);
+	check(g.cur == 3, "back up");
+	steady(&g, &now, 0, 10, 1);
+	check(g.cur == 3, "deferred while queued");
+	/* ...until they drain */
+	steady(&g, &now, 0, 1, 0);
+	check(g.cur == 2, "done once drained");
+
+	/* ...or for defer_ms at most, counted from the end of residency */
+	steady(&g, &now, 0, 5, 0);
+	check(g.cur == 1, "down again");
+	before = g.reclocks;
+	for (i = 1; i * NOUVEAU_GOV_PERIOD < NOUVEAU_GOV_RESIDENCY + NOUVEAU_GOV_DEFER; i++) {
+		now += NOUVEAU_GOV_PERIOD;
+		level = nouveau_gov_sample(&g, now, 0, 1);
+		check(level == g.cur, "deferred up to defer_ms");
+	}
+	now += NOUVEAU_GOV_PERIOD;
+	level = nouveau_gov_sample(&g, now, 0, 1);
+	check(level == 0, "not deferred past defer_ms");
+	nouveau_gov_switched(&g, now, level);
+	check(g.reclocks == before + 1, "counted");
+
+	/* a failed reclock leaves us where we were, uncounted */
+	steady(&g, &now, 100, 10, 0);
+	before = g.reclocks;
+	check(g.cur == 3, "top");
+	for (i = 0; i < 10; i++) {
+		now += NOUVEAU_GOV_PERIOD;
+		nouveau_gov_sample(&g, now, 0, 0);
+		nouveau_gov_switched(&g, now, g.cur);
+	}
+	check(g.cur == 3 && g.reclocks == before, "failed reclock");
+
+	/* time in state adds up to the time sampled */
+	nouveau_gov_init(&g, &params, 3, 0, 0);
+	now = 0;
+	steady(&g, &now, 100, 20, 0);
+	steady(&g, &now, 0, 40, 0);
+	total = 0;
+	for (i = 0; i < NOUVEAU_GOV_LEVELS; i++)
+		total += g.time_ms[i];
+	check(total == 60 * NOUVEAU_GOV_PERIOD, "time in state total");
+	check(g.time_ms[0] > 0 && g.time_ms[1] >= NOUVEAU_GOV_RESIDENCY &&
+	      g.time_ms[2] >= 10 * NOUVEAU_GOV_PERIOD, "time in state split");
+
+	/* ms wraparound doesn't stop it */
+	nouveau_gov_init(&g, &params, 2, 1, 0xffffff00);
+	now = 0xffffff00;
+	steady(&g, &now, 0, 10, 0);
+	check(g.cur == 0, "wraparound");
+
+	/* only one level: nothing to do */
+	nouveau_gov_init(&g, &params, 1, 0, 0);
+	now = 0;
+	steady(&g, &now, 100, 10, 0);
+	steady(&g, &now, 0, 10, 0);
+	check(g.cur == 0 && g.reclocks == 0, "single level");
+
+	if (fails)
+		return 1;
+	printf("Passed.\n");
+	return 0;
+}
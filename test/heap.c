@@ -0,0 +1,92 @@
+#include "libpscnv.h"
+#include "libpscnv_ib.h"
+#include "libpscnv_heap.h"
+#include <xf86drm.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#define N	4096
+
+static double now(void) {
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int cmp_gpu(const void *a, const void *b) {
+	const struct pscnv_heap_block *x = a, *y = b;
+	return x->gpu < y->gpu ? -1 : x->gpu > y->gpu;
+}
+
+int
+main()
+{
+	int fd;
+	uint32_t vid;
+	struct pscnv_heap *heap;
+	static struct pscnv_heap_block blk[N], sorted[N];
+	static struct pscnv_ib_bo *bo[N];
+	double t;
+	int i;
+        fd = drmOpen("pscnv", 0);
+	if (fd == -1) {
+		perror("drmOpen");
+		return 1;
+	}
+	if (pscnv_vspace_new(fd, &vid)) {
+		perror("vspace_new");
+		return 1;
+	}
+
+	t = now();
+	for (i = 0; i < N; i++)
+		if (pscnv_ib_bo_alloc(fd, vid, 0xb0, PSCNV_GEM_SYSRAM_SNOOP | PSCNV_GEM_MAPPABLE, 0, 0x1000, 0, &bo[i])) {
+			printf("bo_alloc %d failed\n", i);
+			return 1;
+		}
+	for (i = 0; i < N; i++)
+		pscnv_ib_bo_free(bo[i]);
+	printf("pscnv_ib_bo_alloc/free: %.2f us each\n", (now() - t) * 1e6 / N);
+
+	if (pscnv_heap_new(fd, vid, PSCNV_GEM_SYSRAM_SNOOP | PSCNV_GEM_MAPPABLE, &heap)) {
+		printf("heap_new failed\n");
+		return 1;
+	}
+	t = now();
+	for (i = 0; i < N; i++)
+		if (pscnv_heap_alloc(heap, 64 << (i % 7), &blk[i])) {
+			printf("heap_alloc %d failed\n", i);
+			return 1;
+		}
+	for (i = 0; i < N; i++)
+		*(uint32_t *)blk[i].map = i;
+	memcpy(sorted, blk, sizeof blk);
+	qsort(sorted, N, sizeof *sorted, cmp_gpu);
+	for (i = 1; i < N; i++)
+		if (sorted[i-1].gpu + sorted[i-1].size > sorted[i].gpu) {
+			printf("blocks at %llx and %llx overlap\n",
+				(unsigned long long)sorted[i-1].gpu, (unsigned long long)sorted[i].gpu);
+			return 1;
+		}
+	for (i = 0; i < N; i++) {
+		if (*(uint32_t *)blk[i].map != i) {
+			printf("block %d clobbered\n", i);
+			return 1;
+		}
+		pscnv_heap_free(heap, &blk[i]);
+	}
+	printf("pscnv_heap_alloc/free: %.2f us each, %llu slabs allocated\n", (now() - t) * 1e6 / N,
+		(unsigned long long)heap->slab_allocs);
+
+	pscnv_heap_trim(heap);
+	if (heap->nslabs) {
+		printf("%d slabs left after trim\n", heap->nslabs);
+		return 1;
+	}
+	pscnv_heap_destroy(heap);
+	pscnv_vspace_free(fd, vid);
+
+	printf("Passed.\n");
+	return 0;
+}
@@ -0,0 +1,117 @@
+#include "libpscnv.h"
+#include "libpscnv_ib.h"
+#include "libpscnv_memcpy.h"
+#include <xf86drm.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#define MAXSIZE	(64 << 20)
+#define REPS	(256 << 20)	/* bytes moved per measurement */
+
+static double now(void) {
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+int
+main()
+{
+	int fd;
+	uint32_t vid;
+	struct pscnv_copy *cp;
+	struct pscnv_ib_bo *vram, *pinned;
+	uint32_t *src, *dst;
+	uint64_t size, chipset;
+	uint32_t seq;
+	double t[4];
+	int i, n, reps, ret = 0;
+        fd = drmOpen("pscnv", 0);
+	if (fd == -1) {
+		perror("drmOpen");
+		return 1;
+	}
+	if (pscnv_getparam(fd, PSCNV_GETPARAM_CHIPSET_ID, &chipset)) {
+		printf("getparam failed\n");
+		return 1;
+	}
+	if (chipset < 0xc0) {
+		printf("NV50 channels have no fences, skipped.\n");
+		return 0;
+	}
+	if (pscnv_vspace_new(fd, &vid)) {
+		perror("vspace_new");
+		return 1;
+	}
+	if (pscnv_copy_new(fd, vid, 0, &cp)) {
+		printf("copy_new failed\n");
+		return 1;
+	}
+	if (pscnv_ib_bo_alloc(fd, vid, 0xb1, PSCNV_GEM_VRAM_SMALL, 0, 2 * MAXSIZE, 0, &vram) ||
+	    pscnv_ib_bo_alloc(fd, vid, 0xb2, PSCNV_GEM_SYSRAM_SNOOP | PSCNV_GEM_MAPPABLE, 0, MAXSIZE, 0, &pinned)) {
+		printf("bo_alloc failed\n");
+		return 1;
+	}
+	src = malloc(MAXSIZE);
+	dst = malloc(MAXSIZE);
+	for (i = 0; i < MAXSIZE / 4; i++)
+		src[i] = i * 0x9e3779b9;
+	printf("engine class %04x\n", cp->oclass);
+
+	/* correctness: host -> vram -> vram -> host */
+	if (pscnv_memcpy_htod_async(cp, vram->vm_base, src, MAXSIZE, 0) ||
+	    pscnv_memcpy_dtod_async(cp, vram->vm_base + MAXSIZE, vram->vm_base, MAXSIZE, 0) ||
+	    pscnv_memcpy_dtoh_async(cp, dst, vram->vm_base + MAXSIZE, MAXSIZE, 0) ||
+	    memcmp(src, dst, MAXSIZE)) {
+		printf("data mismatch after round trip\n");
+		return 1;
+	}
+	/* an odd size and offset */
+	memset(dst, 0, MAXSIZE);
+	if (pscnv_memcpy_dtod_async(cp, pinned->vm_base + 4, vram->vm_base + 12, 0x12344, &seq) ||
+	    pscnv_copy_wait(cp, seq, 1000000000) ||
+	    memcmp((char *)pinned->map + 4, (char *)src + 12, 0x12344)) {
+		printf("unaligned copy mismatch\n");
+		return 1;
+	}
+
+	printf("%10s %10s %10s %10s %14s  (MB/s)\n", "size", "htod", "dtoh", "dtod", "dtoh pinned");
+	for (size = 0x1000; size <= MAXSIZE; size <<= 2) {
+		reps = REPS / size;
+		if (reps > 1024)
+			reps = 1024;
+		for (n = 0; n < 4; n++) {
+			t[n] = now();
+			for (i = 0; i < reps; i++) {
+				switch (n) {
+				case 0:
+					ret = pscnv_memcpy_htod_async(cp, vram->vm_base, src, size, &seq);
+					break;
+				case 1:
+					ret = pscnv_memcpy_dtoh_async(cp, dst, vram->vm_base, size, &seq);
+					break;
+				case 2:
+					ret = pscnv_memcpy_dtod_async(cp, vram->vm_base + MAXSIZE, vram->vm_base, size, &seq);
+					break;
+				case 3:
+					ret = pscnv_memcpy_dtod_async(cp, pinned->vm_base, vram->vm_base, size, &seq);
+					break;
+				}
+			}
+			if (ret || pscnv_copy_wait(cp, seq, 10000000000ull)) {
+				printf("copy failed\n");
+				return 1;
+			}
+			t[n] = size * reps / (now() - t[n]) / 1e6;
+		}
+		printf("%10llu %10.0f %10.0f %10.0f %14.0f\n", (unsigned long long)size, t[0], t[1], t[2], t[3]);
+	}
+
+	pscnv_copy_free(cp);
+	pscnv_ib_bo_free(vram);
+	pscnv_ib_bo_free(pinned);
+	pscnv_vspace_free(fd, vid);
+	printf("Passed.\n");
+	return 0;
+}
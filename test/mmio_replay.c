@@ -0,0 +1,354 @@
+/*
+ * Replays an MMIO trace, as read from debugfs mmio_trace on a kernel
+ * built with PSCNV_MMIO_TRACE (see pscnv_drm.h), into a register file
+ * model. No card needed.
+ *
+ *   mmio_replay trace		per init sequence: time, accesses, polls
+ *				and reads the model couldn't predict
+ *   mmio_replay -c old new	the same side by side, and where the
+ *				written values first diverge
+ *   mmio_replay -s seq trace	the register file as it stood at the
+ *				end of sequence seq (card, fifo, ...)
+ *
+ * The model is just the last value seen at every address: writes set it
+ * and reads are checked against it, then taken over. A read it gets
+ * wrong is one of status, timers, or anything else the hardware changes
+ * by itself; reading the same register over and over counts as polling.
+ */
+
+#include <stdint.h>
+#include "pscnv_drm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BAR3	0x100000000ull	/* BAR3 offsets in the model's keys */
+
+static const char *const seq_names[PSCNV_MMIO_SEQS] = {
+	[PSCNV_MMIO_SEQ_CARD_INIT] = "card",
+	[PSCNV_MMIO_SEQ_FIFO_INIT] = "fifo",
+	[PSCNV_MMIO_SEQ_GRAPH_INIT] = "graph",
+	[PSCNV_MMIO_SEQ_COPY_INIT] = "copy",
+	[PSCNV_MMIO_SEQ_DISPLAY_INIT] = "display",
+};
+
+struct reg {
+	uint64_t key;		/* address + 1, 0 if free */
+	uint32_t val;
+};
+
+struct model {
+	struct reg *tab;
+	uint32_t size;
+	uint32_t used;
+};
+
+struct seq {
+	int seen;
+	int active;
+	uint64_t begin, time;
+	uint64_t reads, writes, bar3, windows, polls, unpredicted;
+	/* written values, for -c */
+	struct drm_pscnv_mmio_rec *wr;
+	uint64_t nwr;
+};
+
+struct trace {
+	struct drm_pscnv_mmio_trace_head head;
+	struct drm_pscnv_mmio_rec *rec;
+	struct seq seqs[PSCNV_MMIO_SEQS];
+	struct model model;
+	uint64_t reads, writes, bar3, windows, polls, unpredicted;
+};
+
+static struct reg *model_find(struct model *m, uint64_t addr) {
+	uint64_t key = addr + 1;
+	uint32_t i = (key * 0x9e3779b97f4a7c15ull) >> 40 & (m->size - 1);
+	while (m->tab[i].key && m->tab[i].key != key)
+		i = (i + 1) & (m->size - 1);
+	return &m->tab[i];
+}
+
+static void model_set(struct model *m, uint64_t addr, uint32_t val) {
+	struct reg *r = model_find(m, addr);
+	if (!r->key) {
+		if (++m->used * 2 > m->size) {
+			struct reg *old = m->tab;
+			uint32_t i, osize = m->size;
+			m->size *= 2;
+			m->tab = calloc(m->size, sizeof *m->tab);
+			m->used = 0;
+			for (i = 0; i < osize; i++)
+				if (old[i].key)
+					model_set(m, old[i].key - 1, old[i].val);
+			free(old);
+			model_set(m, addr, val);
+			return;
+		}
+		r->key = addr + 1;
+	}
+	r->val = val;
+}
+
+/* 1 if the model knows addr, value in *val */
+static int model_get(struct model *m, uint64_t addr, uint32_t *val) {
+	struct reg *r = model_find(m, addr);
+	*val = r->val;
+	return r->key != 0;
+}
+
+/* byte accesses go to their lane of the 32-bit register */
+static void access8(struct model *m, uint32_t addr, uint32_t val, int rd, int *predicted) {
+	uint32_t old = 0, shift = (addr & 3) * 8;
+	int known = model_get(m, addr & ~3, &old);
+	if (rd)
+		*predicted = known && (old >> shift & 0xff) == (val & 0xff);
+	model_set(m, addr & ~3, (old & ~(0xffu << shift)) | (val & 0xff) << shift);
+}
+
+static int load(struct trace *t, const char *path) {
+	FILE *fp = fopen(path, "rb");
+	memset(t, 0, sizeof *t);
+	if (!fp) {
+		perror(path);
+		return 1;
+	}
+	if (fread(&t->head, sizeof t->head, 1, fp) != 1 ||
+	    t->head.magic != PSCNV_MMIO_TRACE_MAGIC ||
+	    t->head.version != PSCNV_MMIO_TRACE_VERSION ||
+	    t->head.rec_size != sizeof *t->rec) {
+		fprintf(stderr, "%s: not an MMIO trace\n", path);
+		fclose(fp);
+		return 1;
+	}
+	t->rec = malloc(t->head.count * sizeof *t->rec + 1);
+	if (fread(t->rec, sizeof *t->rec, t->head.count, fp) != t->head.count) {
+		fprintf(stderr, "%s: truncated\n", path);
+		fclose(fp);
+		return 1;
+	}
+	fclose(fp);
+	t->model.size = 1 << 12;
+	t->model.tab = calloc(t->model.size, sizeof *t->model.tab);
+	return 0;
+}
+
+static void dump_model(struct model *m);
+
+/*
+ * Feeds the trace through the model. With stop_seq >= 0 the register
+ * file is printed when that sequence ends.
+ */
+static void replay(struct trace *t, int stop_seq) {
+	struct drm_pscnv_mmio_rec *r, *prev = 0;
+	uint64_t i, s;
+	for (i = 0; i < t->head.count; i++) {
+		int rd = 0, wr = 0, bar3 = 0, window = 0, poll = 0, predicted = 1;
+		uint32_t old;
+		r = &t->rec[i];
+		switch (r->op) {
+		case PSCNV_MMIO_TRACE_BEGIN:
+		case PSCNV_MMIO_TRACE_END:
+			if (r->val >= PSCNV_MMIO_SEQS)
+				continue;
+			if (r->op == PSCNV_MMIO_TRACE_BEGIN) {
+				t->seqs[r->val].seen = 1;
+				t->seqs[r->val].active = 1;
+				t->seqs[r->val].begin = r->time;
+			} else if (t->seqs[r->val].active) {
+				t->seqs[r->val].active = 0;
+				t->seqs[r->val].time += r->time - t->seqs[r->val].begin;
+				if (stop_seq == r->val)
+					dump_model(&t->model);
+			}
+			continue;
+		case PSCNV_MMIO_TRACE_RD32:
+			rd = 1;
+			predicted = model_get(&t->model, r->addr, &old) && old == r->val;
+			model_set(&t->model, r->addr, r->val);
+			break;
+		case PSCNV_MMIO_TRACE_WR32:
+			wr = 1;
+			window = r->addr == 0x1700;
+			model_set(&t->model, r->addr, r->val);
+			break;
+		case PSCNV_MMIO_TRACE_RD08:
+		case PSCNV_MMIO_TRACE_WR08:
+			rd = r->op == PSCNV_MMIO_TRACE_RD08;
+			wr = !rd;
+			access8(&t->model, r->addr, r->val, rd, &predicted);
+			break;
+		case PSCNV_MMIO_TRACE_BAR3_RD:
+			rd = bar3 = 1;
+			predicted = model_get(&t->model, BAR3 + r->addr, &old) && old == r->val;
+			model_set(&t->model, BAR3 + r->addr, r->val);
+			break;
+		case PSCNV_MMIO_TRACE_BAR3_WR:
+			wr = bar3 = 1;
+			model_set(&t->model, BAR3 + r->addr, r->val);
+			break;
+		default:
+			continue;
+		}
+		poll = rd && prev && prev->op == r->op && prev->addr == r->addr;
+		prev = r;
+		t->reads += rd;
+		t->writes += wr;
+		t->bar3 += bar3;
+		t->windows += window;
+		t->polls += poll;
+		t->unpredicted += !predicted;
+		for (s = 0; s < PSCNV_MMIO_SEQS; s++) {
+			struct seq *q = &t->seqs[s];
+			if (!q->active)
+				continue;
+			q->reads += rd;
+			q->writes += wr;
+			q->bar3 += bar3;
+			q->windows += window;
+			q->polls += poll;
+			q->unpredicted += !predicted;
+			if (wr) {
+				if (!(q->nwr & (q->nwr - 1)))
+					q->wr = realloc(q->wr, (q->nwr ? q->nwr * 2 : 1) * sizeof *q->wr);
+				q->wr[q->nwr++] = *r;
+			}
+		}
+	}
+	/* never ended, the trace filled up or init failed */
+	for (s = 0; s < PSCNV_MMIO_SEQS; s++)
+		if (t->seqs[s].active && t->head.count)
+			t->seqs[s].time += t->rec[t->head.count - 1].time - t->seqs[s].begin;
+}
+
+static int cmp_reg(const void *a, const void *b) {
+	const struct reg *x = a, *y = b;
+	return x->key < y->key ? -1 : x->key > y->key;
+}
+
+static void dump_model(struct model *m) {
+	struct reg *regs = malloc(m->used * sizeof *regs + 1);
+	uint32_t i, n = 0;
+	for (i = 0; i < m->size; i++)
+		if (m->tab[i].key)
+			regs[n++] = m->tab[i];
+	qsort(regs, n, sizeof *regs, cmp_reg);
+	for (i = 0; i < n; i++) {
+		uint64_t addr = regs[i].key - 1;
+		if (addr >= BAR3)
+			printf("bar3+%08llx: %08x\n", (unsigned long long)(addr - BAR3), regs[i].val);
+		else
+			printf("%08llx: %08x\n", (unsigned long long)addr, regs[i].val);
+	}
+	free(regs);
+}
+
+static void print_seq(const char *name, uint64_t time, uint64_t reads, uint64_t writes,
+		uint64_t bar3, uint64_t windows, uint64_t polls, uint64_t unpredicted) {
+	printf("%-8s %10.3f %9llu %9llu %8llu %8llu %8llu %8llu\n", name, time / 1e6,
+		(unsigned long long)reads, (unsigned long long)writes,
+		(unsigned long long)bar3, (unsigned long long)windows,
+		(unsigned long long)polls, (unsigned long long)unpredicted);
+}
+
+static void print_header(void) {
+	printf("%-8s %10s %9s %9s %8s %8s %8s %8s\n", "seq", "ms", "reads", "writes",
+		"bar3", "windows", "polls", "unpred");
+}
+
+static void report(struct trace *t) {
+	int s;
+	printf("chipset %02x, %llu records, %llu dropped\n", t->head.chipset,
+		(unsigned long long)t->head.count, (unsigned long long)t->head.dropped);
+	print_header();
+	for (s = 0; s < PSCNV_MMIO_SEQS; s++) {
+		struct seq *q = &t->seqs[s];
+		if (q->seen)
+			print_seq(seq_names[s], q->time, q->reads, q->writes, q->bar3,
+				q->windows, q->polls, q->unpredicted);
+	}
+	print_seq("total", t->head.count ? t->rec[t->head.count - 1].time - t->rec[0].time : 0,
+		t->reads, t->writes, t->bar3, t->windows, t->polls, t->unpredicted);
+}
+
+/* For bisecting: what changed between two runs of the same init. */
+static void compare(struct trace *a, struct trace *b) {
+	int s;
+	uint64_t i;
+	printf("%-8s %10s %10s %9s %9s %9s %9s\n", "seq", "ms old", "ms new",
+		"rd old", "rd new", "wr old", "wr new");
+	for (s = 0; s < PSCNV_MMIO_SEQS; s++) {
+		struct seq *x = &a->seqs[s], *y = &b->seqs[s];
+		if (!x->seen && !y->seen)
+			continue;
+		printf("%-8s %10.3f %10.3f %9llu %9llu %9llu %9llu\n", seq_names[s],
+			x->time / 1e6, y->time / 1e6,
+			(unsigned long long)x->reads, (unsigned long long)y->reads,
+			(unsigned long long)x->writes, (unsigned long long)y->writes);
+	}
+	for (s = 0; s < PSCNV_MMIO_SEQS; s++) {
+		struct seq *x = &a->seqs[s], *y = &b->seqs[s];
+		for (i = 0; i < x->nwr && i < y->nwr; i++)
+			if (x->wr[i].op != y->wr[i].op || x->wr[i].addr != y->wr[i].addr ||
+			    x->wr[i].val != y->wr[i].val)
+				break;
+		if (i == x->nwr && i == y->nwr)
+			continue;
+		printf("%s: writes diverge at %llu:", seq_names[s], (unsigned long long)i);
+		if (i < x->nwr)
+			printf(" old %08x <- %08x", x->wr[i].addr, x->wr[i].val);
+		if (i < y->nwr)
+			printf(" new %08x <- %08x", y->wr[i].addr, y->wr[i].val);
+		printf("\n");
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	static struct trace a, b;
+	const char *stop = 0;
+	int opt, cmp = 0, s, stop_seq = -1;
+
+	while ((opt = getopt(argc, argv, "cs:")) != -1) {
+		switch (opt) {
+		case 'c':
+			cmp = 1;
+			break;
+		case 's':
+			stop = optarg;
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind + 1 + cmp != argc)
+		goto usage;
+	if (stop) {
+		for (s = 0; s < PSCNV_MMIO_SEQS; s++)
+			if (!strcmp(stop, seq_names[s]))
+				stop_seq = s;
+		if (stop_seq < 0)
+			goto usage;
+	}
+	if (load(&a, argv[optind]))
+		return 1;
+	replay(&a, stop_seq);
+	if (stop)
+		return 0;
+	if (!cmp) {
+		report(&a);
+		return 0;
+	}
+	if (load(&b, argv[optind + 1]))
+		return 1;
+	replay(&b, -1);
+	compare(&a, &b);
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: %s [-s card|fifo|graph|copy|display] trace\n"
+			"       %s -c old new\n", argv[0], argv[0]);
+	return 1;
+}
@@ -0,0 +1,160 @@
+/*
+ * Multi-producer submission scaling, without a card: 1 to 32 threads
+ * submit small dispatches to one channel, either each through its own
+ * pushbuffer segment or all through the channel under a global mutex.
+ * A fake PFIFO thread consumes the IB ring, executes the GET tracking
+ * releases and checks that every thread's submissions arrive in order.
+ */
+
+#include "libpscnv.h"
+#include "libpscnv_ib.h"
+#include "fake_chan.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#define PB_ORDER	22
+#define IB_ORDER	9
+#define SEG_SIZE	(64 << 10)
+#define MAXTHREADS	32
+#define TOTAL		(1 << 20)	/* submissions per run */
+#define SMALL		16	/* dwords per dispatch */
+
+static volatile uint32_t track[0x1000/4];
+static struct pscnv_ib_chan ch;
+static pthread_mutex_t ch_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile int done;
+static uint32_t seen[MAXTHREADS];
+static int fails;
+
+static void *fake_pfifo(void *arg) {
+	uint32_t get = ch.chmap[0x88/4];
+	for (;;) {
+		uint32_t put = ch.chmap[0x8c/4];
+		uint64_t start, end;
+		if (get == put) {
+			if (done)
+				break;
+			sched_yield();
+			continue;
+		}
+		if (fake_chan_entry(&ch, get, &start, &end) || end - start < (SMALL + 1 + PSCNV_IB_TRACK_DWORDS) * 4) {
+			fails++;
+		} else {
+			uint32_t *p = fake_chan_data(&ch, start);
+			/* each dispatch is thread id, then its counter */
+			uint32_t tid = p[1], cnt = p[2];
+			if (tid >= MAXTHREADS || cnt != seen[tid]++)
+				fails++;
+			if (fake_chan_release(&ch, end, sizeof track))
+				fails++;
+		}
+		fake_chan_consume(&ch, &get, end);
+	}
+	return 0;
+}
+
+struct producer {
+	pthread_t thr;
+	uint32_t tid;
+	uint32_t count;
+	int segmented;
+	uint64_t nstalls;
+};
+
+static void dispatch(struct pscnv_ib_chan *c, uint32_t tid, uint32_t cnt) {
+	uint32_t data[SMALL];
+	int i;
+	data[0] = tid;
+	data[1] = cnt;
+	for (i = 2; i < SMALL; i++)
+		data[i] = i;
+	BEGIN_RING50(c, 0, 0x1000, SMALL);
+	OUT_RINGp(c, data, SMALL);
+	FIRE_RING(c);
+}
+
+static void *produce(void *arg) {
+	struct producer *p = arg;
+	struct pscnv_ib_chan *seg;
+	uint32_t i;
+	if (p->segmented) {
+		if (pscnv_ib_seg_new(&ch, SEG_SIZE, &seg)) {
+			__atomic_add_fetch(&fails, 1, __ATOMIC_RELAXED);
+			return 0;
+		}
+		for (i = 0; i < p->count; i++)
+			dispatch(seg, p->tid, i);
+		p->nstalls = seg->nstalls;
+		pscnv_ib_seg_free(seg);
+	} else {
+		for (i = 0; i < p->count; i++) {
+			pthread_mutex_lock(&ch_lock);
+			dispatch(&ch, p->tid, i);
+			pthread_mutex_unlock(&ch_lock);
+		}
+	}
+	return 0;
+}
+
+static double now(void) {
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void run(int nthreads, int segmented) {
+	struct producer p[MAXTHREADS];
+	pthread_t pfifo;
+	uint64_t nstalls = 0;
+	double t;
+	int i;
+
+	fake_chan_init(&ch, PB_ORDER, IB_ORDER, track, sizeof track);
+	pscnv_ib_set_batch(&ch, 32, 256 << 10, 0);
+	memset(seen, 0, sizeof seen);
+	if (segmented && pscnv_ib_mp_init(&ch)) {
+		fails++;
+		return;
+	}
+	done = 0;
+	pthread_create(&pfifo, 0, fake_pfifo, 0);
+	t = now();
+	for (i = 0; i < nthreads; i++) {
+		p[i].tid = i;
+		p[i].count = TOTAL / nthreads;
+		p[i].segmented = segmented;
+		p[i].nstalls = 0;
+		pthread_create(&p[i].thr, 0, produce, &p[i]);
+	}
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(p[i].thr, 0);
+		nstalls += p[i].nstalls;
+	}
+	done = 1;
+	pthread_join(pfifo, 0);
+	t = now() - t;
+	for (i = 0; i < nthreads; i++)
+		if (seen[i] != p[i].count)
+			fails++;
+	printf("%2d threads, %-9s %8.0f submissions/s", nthreads, segmented ? "segments" : "mutex", TOTAL / t);
+	if (segmented)
+		printf(", %llu ring-full waits", (unsigned long long)nstalls);
+	printf("\n");
+	fake_chan_fini(&ch);
+}
+
+int main() {
+	int n;
+	for (n = 1; n <= MAXTHREADS; n *= 2) {
+		run(n, 0);
+		run(n, 1);
+	}
+	if (fails) {
+		printf("FAIL: %d bad or out of order submissions\n", fails);
+		return 1;
+	}
+	printf("Passed.\n");
+	return 0;
+}
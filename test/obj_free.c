@@ -0,0 +1,138 @@
+/*
+ * OBJ_FREE on an NV50 channel: objects can't go while the channel still
+ * has work that may use them, the pushbuffer's DMA object can't go at
+ * all, and freed instance memory and handles get reused.
+ */
+
+#include <errno.h>
+#include <xf86drm.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "libpscnv.h"
+
+#define SEM	0xff0	/* semaphore word, at the end of the pushbuffer BO */
+
+static int fails;
+
+static void check(int cond, const char *what, int ret) {
+	if (!cond) {
+		printf("FAIL: %s (%d)\n", what, ret);
+		fails++;
+	}
+}
+
+static uint64_t now_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int
+main()
+{
+	int fd, ret, i;
+	uint64_t chipset, map_handle, ch_map_handle, offset, start;
+	uint32_t handle, vid, cid;
+	uint32_t *pb_map;
+	volatile uint32_t *chmap;
+
+	fd = drmOpen("pscnv", 0);
+	if (fd == -1) {
+		perror("drmOpen");
+		return 1;
+	}
+	if (pscnv_getparam(fd, PSCNV_GETPARAM_CHIPSET_ID, &chipset)) {
+		printf("getparam failed\n");
+		return 1;
+	}
+	if (chipset < 0x50 || chipset >= 0xc0) {
+		printf("OBJ_FREE is NV50 only, skipped.\n");
+		return 0;
+	}
+
+	ret = pscnv_gem_new(fd, 0xf1f0c0de, PSCNV_GEM_SYSRAM_SNOOP, 0, 0x1000, 0, &handle, &map_handle);
+	if (ret) {
+		printf("new: failed ret = %d\n", ret);
+		return 1;
+	}
+	pb_map = mmap(0, 0x1000, PROT_READ | PROT_WRITE, MAP_SHARED, fd, map_handle);
+	if ((void *)pb_map == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+	if ((ret = pscnv_vspace_new(fd, &vid)) ||
+	    (ret = pscnv_chan_new(fd, vid, &cid, &ch_map_handle)) ||
+	    (ret = pscnv_vspace_map(fd, vid, handle, 0x1000, 1ull << 32, 1, 0, &offset)) ||
+	    (ret = pscnv_obj_vdma_new(fd, cid, 0xbeef, 0x3d, 0, offset, 0x1000)) ||
+	    (ret = pscnv_obj_vdma_new(fd, cid, 0xdead, 0x3d, 0, offset, 0x1000)) ||
+	    (ret = pscnv_fifo_init(fd, cid, 0xbeef, 0, 1, offset))) {
+		printf("channel setup failed ret = %d\n", ret);
+		return 1;
+	}
+	chmap = mmap(0, 0x2000, PROT_READ | PROT_WRITE, MAP_SHARED, fd, ch_map_handle);
+	if ((void *)chmap == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+
+	ret = pscnv_obj_free(fd, cid, 0xbeef);
+	check(ret == -EBUSY, "freeing the pushbuffer's DMA object", ret);
+	ret = pscnv_obj_free(fd, cid, 0x1234);
+	check(ret == -ENOENT, "freeing a handle that isn't there", ret);
+
+	/* 20000 objects of 16 bytes don't fit in the channel VO at once */
+	for (i = 0; i < 20000; i++) {
+		ret = pscnv_obj_vdma_new(fd, cid, 0xf00, 0x3d, 0, offset, 0x1000);
+		if (ret) {
+			check(0, "reusing freed instance memory", ret);
+			break;
+		}
+		ret = pscnv_obj_free(fd, cid, 0xf00);
+		if (ret) {
+			check(0, "freeing an idle object", ret);
+			break;
+		}
+	}
+
+	/* park the channel on a semaphore acquire through 0xdead */
+	pb_map[SEM / 4] = 0;
+	pb_map[0] = 0x40060;
+	pb_map[1] = 0xdead;
+	pb_map[2] = 0x40064;
+	pb_map[3] = SEM;
+	pb_map[4] = 0x40068;
+	pb_map[5] = 1;
+	pb_map[6] = 0x40050;
+	pb_map[7] = 0xcafebabe;
+	__sync_synchronize();
+	chmap[0x40/4] = offset + 8 * 4;
+
+	start = now_ms();
+	while (now_ms() - start < 100)
+		;
+	check(chmap[0x48/4] != 0xcafebabe, "semaphore acquire blocking", 0);
+	ret = pscnv_obj_free(fd, cid, 0xdead);
+	check(ret == -EBUSY, "freeing an object of a blocked channel", ret);
+
+	/* let it go, then the object becomes free to go too */
+	pb_map[SEM / 4] = 1;
+	__sync_synchronize();
+	start = now_ms();
+	while (chmap[0x48/4] != 0xcafebabe && now_ms() - start < 1000)
+		;
+	check(chmap[0x48/4] == 0xcafebabe, "semaphore released", 0);
+	do
+		ret = pscnv_obj_free(fd, cid, 0xdead);
+	while (ret == -EBUSY && now_ms() - start < 2000);
+	check(ret == 0, "freeing an object once the channel is idle", ret);
+	ret = pscnv_obj_vdma_new(fd, cid, 0xdead, 0x3d, 0, offset, 0x1000);
+	check(ret == 0, "reusing a freed handle", ret);
+
+	close(fd);
+	if (fails)
+		return 1;
+	printf("Passed.\n");
+	return 0;
+}
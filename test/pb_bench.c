@@ -0,0 +1,150 @@
+/*
+ * Pushbuffer emission throughput, without a card: the channel's control
+ * area is plain memory and after every submission fake_pfifo() consumes
+ * all IB entries, moving GET along, so only the CPU side is measured.
+ *
+ * Compares the old per-dword checked OUT_RING with RING_SPACE + OUT_RINGu
+ * and OUT_RINGp for large method data uploads, and counts doorbell
+ * writes for many small submissions with FIRE_RING vs QUEUE_RING.
+ * Tracked runs also have fake_pfifo() execute the GET tracking release
+ * at the end of each entry, and count how often GET still comes from
+ * MMIO.
+ */
+
+#include "libpscnv.h"
+#include "libpscnv_ib.h"
+#include "fake_chan.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#define PB_ORDER	20
+#define IB_ORDER	9
+#define CHUNK		2047	/* max method count in a NV50 header */
+#define TOTAL		(256 << 20)
+#define SMALL		16	/* dwords per small dispatch */
+
+static volatile uint32_t track[4];
+static int fails;
+
+static void fake_pfifo(struct pscnv_ib_chan *ch) {
+	uint32_t get = ch->chmap[0x88/4];
+	uint32_t put = ch->chmap[0x8c/4];
+	uint64_t start, end;
+	while (get != put) {
+		if (fake_chan_entry(ch, get, &start, &end))
+			fails++;
+		else if (ch->track_map && fake_chan_release(ch, end, sizeof track))
+			fails++;
+		fake_chan_consume(ch, &get, end);
+	}
+}
+
+/* what OUT_RING used to be, for comparison */
+static inline void old_fire_ring(struct pscnv_ib_chan *ch) {
+	if (ch->pb_pos != ch->pb_put) {
+		if (ch->pb_pos > ch->pb_put) {
+			pscnv_ib_push(ch, ch->pb_base + ch->pb_put, ch->pb_pos - ch->pb_put, 0);
+		} else {
+			pscnv_ib_push(ch, ch->pb_base + ch->pb_put, ch->pb_size - ch->pb_put, 0);
+			if (ch->pb_pos)
+				pscnv_ib_push(ch, ch->pb_base, ch->pb_pos, 0);
+		}
+		ch->pb_put = ch->pb_pos;
+	}
+}
+
+static inline void old_out_ring(struct pscnv_ib_chan *ch, uint32_t word) {
+	while (((ch->pb_pos + 4) & ch->pb_mask) == ch->pb_get) {
+		uint32_t old = ch->pb_get;
+		old_fire_ring(ch);
+		pscnv_ib_update_get(ch);
+		if (old == ch->pb_get)
+			sched_yield();
+	}
+	ch->pb_map[ch->pb_pos/4] = word;
+	ch->pb_pos += 4;
+	ch->pb_pos &= ch->pb_mask;
+}
+
+static double now(void) {
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void run(const char *name, int mode, int tracked, const uint32_t *data) {
+	struct pscnv_ib_chan ch;
+	uint64_t left;
+	double t;
+	int i, n;
+
+	fake_chan_init(&ch, PB_ORDER, IB_ORDER, tracked ? track : 0, sizeof track);
+	pscnv_ib_set_batch(&ch, 32, 256 << 10, 0);
+	t = now();
+	for (left = TOTAL / 4; left; left -= n) {
+		n = left > CHUNK ? CHUNK : left;
+		if (mode >= 3)
+			n = left > SMALL ? SMALL : left;
+		switch (mode) {
+		case 0:
+			old_out_ring(&ch, 0x40000000 | 0x1000 | n << 18);
+			for (i = 0; i < n; i++)
+				old_out_ring(&ch, data[i]);
+			old_fire_ring(&ch);
+			break;
+		case 1:
+			BEGIN_RING50_NI(&ch, 0, 0x1000, n);
+			for (i = 0; i < n; i++)
+				OUT_RINGu(&ch, data[i]);
+			FIRE_RING(&ch);
+			break;
+		case 2:
+			BEGIN_RING50_NI(&ch, 0, 0x1000, n);
+			OUT_RINGp(&ch, data, n);
+			FIRE_RING(&ch);
+			break;
+		case 3:
+			BEGIN_RING50(&ch, 0, 0x1000, n);
+			OUT_RINGp(&ch, data, n);
+			FIRE_RING(&ch);
+			break;
+		case 4:
+			BEGIN_RING50(&ch, 0, 0x1000, n);
+			OUT_RINGp(&ch, data, n);
+			QUEUE_RING(&ch);
+			break;
+		}
+		fake_pfifo(&ch);
+	}
+	FIRE_RING(&ch);
+	t = now() - t;
+	if (mode == 0)
+		printf("%-32s %8.1f MB/s\n", name, TOTAL / t / 1e6);
+	else
+		printf("%-32s %8.1f MB/s, %llu IB entries, %llu doorbell writes, %llu MMIO GET reads, %llu stalls\n",
+				name, TOTAL / t / 1e6,
+				(unsigned long long)ch.nentries, (unsigned long long)ch.nkicks,
+				(unsigned long long)ch.nmmio_gets, (unsigned long long)ch.nstalls);
+	fake_chan_fini(&ch);
+}
+
+int main() {
+	uint32_t data[CHUNK];
+	int i;
+	for (i = 0; i < CHUNK; i++)
+		data[i] = i * 0x9e3779b9;
+	run("OUT_RING per dword (old)", 0, 0, data);
+	run("RING_SPACE + OUT_RINGu", 1, 0, data);
+	run("RING_SPACE + OUT_RINGp", 2, 0, data);
+	run("RING_SPACE + OUT_RINGp, tracked", 2, 1, data);
+	run("small, FIRE_RING each", 3, 0, data);
+	run("small, QUEUE_RING each", 4, 0, data);
+	run("small, QUEUE_RING, tracked", 4, 1, data);
+	if (fails) {
+		printf("FAIL: %d bad IB entries\n", fails);
+		return 1;
+	}
+	printf("Passed.\n");
+	return 0;
+}
@@ -0,0 +1,195 @@
+/*
+ * Checks libpscnv_decode on hand-built NV50 and NVC0 streams. Runs on
+ * the host, no card needed.
+ */
+
+#include "libpscnv_decode.h"
+#include <stdio.h>
+#include <string.h>
+
+static uint32_t pb[256];
+static int n;
+
+static void begin50(int subc, int mthd, int len, int ni) {
+	pb[n++] = (ni ? 0x40000000 : 0) | mthd | subc << 13 | len << 18;
+}
+
+static void beginc0(int type, int subc, int mthd, int len) {
+	pb[n++] = type << 29 | len << 16 | subc << 13 | mthd >> 2;
+}
+
+static void out(uint32_t w) {
+	pb[n++] = w;
+}
+
+struct write {
+	uint32_t oclass, mthd, data;
+	int flags;
+} writes[256];
+static int nwrites;
+
+static void record(void *priv, int subc, uint32_t obj, uint32_t oclass, uint32_t mthd, uint32_t data, int flags) {
+	writes[nwrites].oclass = oclass;
+	writes[nwrites].mthd = mthd;
+	writes[nwrites].data = data;
+	writes[nwrites].flags = flags;
+	nwrites++;
+}
+
+static uint32_t lookup(void *priv, uint32_t handle) {
+	return handle == 0xbeef50c0 ? 0x50c0 : 0;
+}
+
+static int check(int i, uint32_t oclass, uint32_t mthd, uint32_t data, int flags) {
+	if (i >= nwrites || writes[i].oclass != oclass || writes[i].mthd != mthd ||
+	    writes[i].data != data || writes[i].flags != flags) {
+		printf("write %d: got %04x %04x %08x %d, expected %04x %04x %08x %d\n", i,
+			writes[i].oclass, writes[i].mthd, writes[i].data, writes[i].flags,
+			oclass, mthd, data, flags);
+		return 1;
+	}
+	return 0;
+}
+
+int
+main()
+{
+	struct pscnv_decode d;
+	struct pscnv_pb_stats st;
+	int i, fail = 0;
+
+	/* NV50: bind by handle, incrementing and non-incrementing */
+	n = nwrites = 0;
+	begin50(1, 0, 1, 0);
+	out(0xbeef50c0);
+	begin50(1, 0x3a4, 2, 0);
+	out(1);
+	out(2);
+	begin50(1, 0x600, 2, 1);
+	out(3);
+	out(4);
+	pscnv_decode_init(&d, 0x50);
+	d.lookup = lookup;
+	d.method = record;
+	fail |= pscnv_decode(&d, pb, n);
+	fail |= check(0, 0, 0, 0xbeef50c0, PSCNV_DECODE_FIRST);
+	fail |= check(1, 0x50c0, 0x3a4, 1, PSCNV_DECODE_FIRST);
+	fail |= check(2, 0x50c0, 0x3a8, 2, 0);
+	fail |= check(3, 0x50c0, 0x600, 3, PSCNV_DECODE_FIRST | PSCNV_DECODE_NI);
+	fail |= check(4, 0x50c0, 0x600, 4, PSCNV_DECODE_NI);
+	fail |= nwrites != 5 || d.nheaders != 3 || d.nwords != n;
+	/* NVC0 headers aren't valid on NV50 */
+	beginc0(4, 0, 0x10, 1);
+	fail |= !pscnv_decode(&d, pb + n - 1, 1) || d.nbad != 1;
+
+	/* the same stream a word at a time */
+	n--;
+	nwrites = 0;
+	pscnv_decode_init(&d, 0x50);
+	d.lookup = lookup;
+	d.method = record;
+	for (i = 0; i < n; i++)
+		fail |= pscnv_decode(&d, pb + i, 1);
+	fail |= check(0, 0, 0, 0xbeef50c0, PSCNV_DECODE_FIRST);
+	fail |= check(1, 0x50c0, 0x3a4, 1, PSCNV_DECODE_FIRST);
+	fail |= check(2, 0x50c0, 0x3a8, 2, 0);
+	fail |= check(3, 0x50c0, 0x600, 3, PSCNV_DECODE_FIRST | PSCNV_DECODE_NI);
+	fail |= check(4, 0x50c0, 0x600, 4, PSCNV_DECODE_NI);
+	fail |= nwrites != 5 || d.nheaders != 3 || d.nwords != n;
+
+	/* NV50 jumps: decoding goes on after a call only */
+	n = nwrites = 0;
+	begin50(1, 0x3a4, 1, 0);
+	out(1);
+	out(0x12340002);	/* call */
+	begin50(1, 0x3a8, 1, 0);
+	out(2);
+	out(0x20000000 | 0x5000);	/* old jump */
+	begin50(1, 0x3ac, 1, 0);
+	out(3);
+	fail |= pscnv_decode(&d, pb, n);
+	out(0x00020000);	/* return */
+	out(0x12340001);	/* jump */
+	fail |= pscnv_decode(&d, pb + n - 2, 1) || pscnv_decode(&d, pb + n - 1, 1);
+	fail |= check(0, 0x50c0, 0x3a4, 1, PSCNV_DECODE_FIRST);
+	fail |= check(1, 0x50c0, 0x3a8, 2, PSCNV_DECODE_FIRST);
+	fail |= nwrites != 2 || d.njumps != 4 || d.nbad;
+
+	/* NVC0: every header type */
+	n = nwrites = 0;
+	beginc0(4, 2, 0, 0x90c0 & 0x1fff);	/* too big for an immediate */
+	beginc0(1, 2, 0, 1);
+	out(0x90c0);
+	beginc0(1, 2, 0x2b4, 2);
+	out(5);
+	out(6);
+	beginc0(3, 2, 0x400, 2);
+	out(7);
+	out(8);
+	beginc0(5, 2, 0x380, 3);
+	out(9);
+	out(10);
+	out(11);
+	beginc0(4, 2, 0x368, 12);
+	begin50(2, 0x388, 1, 0);	/* old formats still work */
+	out(13);
+	pscnv_decode_init(&d, 0xc0);
+	d.method = record;
+	fail |= pscnv_decode(&d, pb, n);
+	fail |= check(0, 0, 0, 0x10c0, PSCNV_DECODE_FIRST | PSCNV_DECODE_IMM);
+	fail |= check(1, 0, 0, 0x90c0, PSCNV_DECODE_FIRST);
+	fail |= check(2, 0x90c0, 0x2b4, 5, PSCNV_DECODE_FIRST);
+	fail |= check(3, 0x90c0, 0x2b8, 6, 0);
+	fail |= check(4, 0x90c0, 0x400, 7, PSCNV_DECODE_FIRST | PSCNV_DECODE_NI);
+	fail |= check(5, 0x90c0, 0x400, 8, PSCNV_DECODE_NI);
+	fail |= check(6, 0x90c0, 0x380, 9, PSCNV_DECODE_FIRST);
+	fail |= check(7, 0x90c0, 0x384, 10, 0);
+	fail |= check(8, 0x90c0, 0x384, 11, 0);
+	fail |= check(9, 0x90c0, 0x368, 12, PSCNV_DECODE_FIRST | PSCNV_DECODE_IMM);
+	fail |= check(10, 0x90c0, 0x388, 13, PSCNV_DECODE_FIRST);
+	fail |= nwrites != 11 || d.nheaders != 7 || d.nwords != n;
+
+	/* stats: the same 3 state writes and a launch, 4 times over, with
+	 * a data port and a semaphore in between */
+	n = 0;
+	beginc0(1, 0, 0, 1);
+	out(0x90c0);
+	for (i = 0; i < 4; i++) {
+		beginc0(1, 0, 0x2b4, 3);
+		out(1);
+		out(2);
+		out(i == 2 ? 4 : 3);
+		beginc0(3, 0, 0x1000, 2);
+		out(i);
+		out(i);
+		beginc0(1, 0, 0x368, 1);
+		out(0);
+		beginc0(1, 0, 0x10, 4);
+		out(0);
+		out(0x1000);
+		out(i);
+		out(2);
+	}
+	if (pscnv_pb_stats_init(&st, 0xc0))
+		return 1;
+	fail |= pscnv_pb_stats_feed(&st, pb, n);
+	/* 0x2b4 and 0x2b8 repeat 3 times each, 0x2bc only on the 2nd pass.
+	 * The data port counts as state on its first write only. */
+	if (st.launches != 4 || st.redundant != 7 || st.launch_state != 13 ||
+	    st.launch_redundant != 7 || st.launch_state_max != 4 || st.launch_words != n - 5) {
+		printf("stats: %llu launches, %llu redundant, %llu state, %llu redundant state, max %llu, %llu words\n",
+			(unsigned long long)st.launches, (unsigned long long)st.redundant,
+			(unsigned long long)st.launch_state, (unsigned long long)st.launch_redundant,
+			(unsigned long long)st.launch_state_max, (unsigned long long)st.launch_words);
+		fail = 1;
+	}
+	pscnv_pb_stats_print(&st, stdout, 8);
+	pscnv_pb_stats_fini(&st);
+
+	if (fail) {
+		printf("Failed.\n");
+		return 1;
+	}
+	printf("Passed.\n");
+	return 0;
+}
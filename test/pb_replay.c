@@ -0,0 +1,367 @@
+/*
+ * Reads a trace written with PSCNV_TRACE=file (see libpscnv_trace.h).
+ *
+ *   pb_replay -d trace	decode only, no card needed: method writes,
+ *			redundant ones and launch state per channel
+ *   pb_replay -r chipset file	the same for a raw pushbuffer dump
+ *   pb_replay [-t] trace	resubmit it, -t keeps the recorded pacing
+ *
+ * Replay recreates BOs at their recorded addresses, in a fresh vspace per
+ * recorded one, and relocates IB entries into its own channels'
+ * pushbuffers. BO contents aren't in the trace, so anything that reads
+ * data it didn't write itself will see zeros.
+ */
+
+#include "libpscnv.h"
+#include "libpscnv_ib.h"
+#include "libpscnv_trace.h"
+#include "libpscnv_decode.h"
+#include <xf86drm.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/time.h>
+
+#define MAXCHANS	128
+#define MAXVSPACES	128
+#define MAXBOS		65536
+#define MAXOBJS		1024
+#define TOP		40
+
+struct chan {
+	uint32_t cid;
+	uint32_t chipset;
+	struct pscnv_trace_chan rec;
+	struct pscnv_pb_stats stats;
+	/* replay */
+	struct pscnv_ib_chan *ch;
+	uint64_t last_base;
+	int last_in_pb;
+};
+
+static struct chan chans[MAXCHANS];
+static int nchans;
+static struct pscnv_trace_obj objs[MAXOBJS];
+static int nobjs;
+
+static uint64_t nrecs[8], ib_bytes, nodata;
+
+static struct chan *find_chan(uint32_t cid) {
+	int i;
+	for (i = 0; i < nchans; i++)
+		if (chans[i].cid == cid)
+			return &chans[i];
+	return 0;
+}
+
+/* NV50 binds object handles */
+static uint32_t lookup_obj(void *priv, uint32_t handle) {
+	struct chan *c = priv;
+	int i;
+	for (i = 0; i < nobjs; i++)
+		if (objs[i].cid == c->cid && objs[i].handle == handle)
+			return objs[i].oclass;
+	return 0;
+}
+
+static void report(void) {
+	int i;
+	printf("%llu channels, %llu BOs created, %llu freed, %llu objects, %llu IB entries (%llu without data), %llu pushbuffer bytes\n",
+		(unsigned long long)nrecs[PSCNV_TRACE_CHAN], (unsigned long long)nrecs[PSCNV_TRACE_BO_NEW],
+		(unsigned long long)nrecs[PSCNV_TRACE_BO_FREE], (unsigned long long)nrecs[PSCNV_TRACE_OBJ],
+		(unsigned long long)nrecs[PSCNV_TRACE_IB], (unsigned long long)nodata, (unsigned long long)ib_bytes);
+	for (i = 0; i < nchans; i++) {
+		printf("\nchannel %d, chipset %02x:\n", chans[i].cid, chans[i].chipset);
+		pscnv_pb_stats_print(&chans[i].stats, stdout, TOP);
+	}
+}
+
+/* A raw pushbuffer: method words and nothing else, in host order. */
+static int decode_raw(const char *path, uint32_t chipset) {
+	struct pscnv_pb_stats st;
+	uint32_t w[4096];
+	size_t n;
+	FILE *fp = fopen(path, "rb");
+	if (!fp) {
+		perror(path);
+		return 1;
+	}
+	if (pscnv_pb_stats_init(&st, chipset)) {
+		fclose(fp);
+		return 1;
+	}
+	while ((n = fread(w, 4, 4096, fp)))
+		if (pscnv_pb_stats_feed(&st, w, n))
+			break;
+	fclose(fp);
+	pscnv_pb_stats_print(&st, stdout, TOP);
+	pscnv_pb_stats_fini(&st);
+	return 0;
+}
+
+/* replay state */
+static int fd = -1;
+static uint32_t vspaces[MAXVSPACES][2];	/* recorded, ours */
+static int nvspaces;
+static struct {
+	uint32_t vid;
+	uint64_t vm_base;
+	uint32_t handle;
+} bos[MAXBOS];
+static int nbos;
+
+static uint32_t map_vid(uint32_t vid) {
+	int i;
+	for (i = 0; i < nvspaces; i++)
+		if (vspaces[i][0] == vid)
+			return vspaces[i][1];
+	if (nvspaces == MAXVSPACES || pscnv_vspace_new(fd, &vspaces[nvspaces][1])) {
+		fprintf(stderr, "vspace_new failed\n");
+		exit(1);
+	}
+	vspaces[nvspaces][0] = vid;
+	return vspaces[nvspaces++][1];
+}
+
+static int chan_bo(uint32_t cookie) {
+	/* IB, pushbuffer and GET tracking BOs of a libpscnv_ib channel */
+	return cookie == 0xf1f01b || cookie == 0xf1f0 || cookie == 0xf1f07ac;
+}
+
+static void replay_bo_new(const struct pscnv_trace_bo *tb) {
+	uint64_t map_handle, off;
+	uint32_t vid;
+	if (chan_bo(tb->cookie) || !tb->vid)
+		return;
+	vid = map_vid(tb->vid);
+	if (nbos == MAXBOS)
+		return;
+	if (pscnv_gem_new(fd, tb->cookie, tb->flags & ~PSCNV_GEM_MAPPABLE, tb->tile_flags, tb->size, 0, &bos[nbos].handle, &map_handle) ||
+	    pscnv_vspace_map(fd, vid, bos[nbos].handle, tb->vm_base, tb->vm_base + tb->size, 0, 0, &off)) {
+		fprintf(stderr, "can't recreate BO at %llx\n", (unsigned long long)tb->vm_base);
+		return;
+	}
+	if (off != tb->vm_base)
+		fprintf(stderr, "BO at %llx landed at %llx\n", (unsigned long long)tb->vm_base, (unsigned long long)off);
+	bos[nbos].vid = vid;
+	bos[nbos].vm_base = off;
+	nbos++;
+}
+
+static void replay_bo_free(const struct pscnv_trace_bo *tb) {
+	uint32_t vid;
+	int i;
+	if (!tb->vid)
+		return;
+	vid = map_vid(tb->vid);
+	for (i = 0; i < nbos; i++)
+		if (bos[i].vid == vid && bos[i].vm_base == tb->vm_base) {
+			pscnv_vspace_unmap(fd, vid, bos[i].vm_base);
+			pscnv_gem_close(fd, bos[i].handle);
+			bos[i] = bos[--nbos];
+			return;
+		}
+}
+
+static void replay_chan(struct chan *c) {
+	if (pscnv_ib_chan_new(fd, map_vid(c->rec.vid), &c->ch, c->rec.pb_dma, c->rec.pb_order, c->rec.ib_order)) {
+		fprintf(stderr, "chan_new failed\n");
+		exit(1);
+	}
+	/* GET comes from MMIO: the recorded tracking releases are patched
+	 * to land in our track BO, but they carry the old sequences. */
+	c->ch->track_map = 0;
+	c->last_base = 0;
+	c->last_in_pb = 0;
+}
+
+/* Waits until the GPU has fetched everything submitted so far. GET only
+ * says where the pushbuffer fetch is if the last entry was in it. */
+static void drain(struct chan *c) {
+	struct pscnv_ib_chan *ch = c->ch;
+	pscnv_ib_kick(ch);
+	for (;;) {
+		pscnv_ib_update_get(ch);
+		if (ch->ib_get == ch->ib_put && (!c->last_in_pb || ch->pb_get == c->last_base))
+			break;
+		sched_yield();
+	}
+}
+
+static void replay_ib(struct chan *c, const struct pscnv_trace_ib *ti, const uint32_t *data) {
+	struct pscnv_ib_chan *ch = c->ch;
+	uint64_t off, base = ti->base;
+	uint32_t *dst;
+	if (!ch)
+		return;
+	if (ti->nodata || base < c->rec.pb_base || base + ti->len > c->rec.pb_base + (1ull << ch->pb_order)) {
+		/* not in the channel's pushbuffer, resubmit as is */
+		pscnv_ib_push(ch, base, ti->len, ti->flags);
+		c->last_in_pb = 0;
+		return;
+	}
+	off = base - c->rec.pb_base;
+	/* offsets only go back when the recorded ring wrapped (or with
+	 * several producers), make sure the GPU is done with it then */
+	if (off < c->last_base)
+		drain(c);
+	dst = ch->pb_map + off / 4;
+	memcpy(dst, data, ti->len);
+	/* the GET tracking release at the end */
+	if (c->rec.track_base && ch->track && ti->len >= PSCNV_IB_TRACK_DWORDS * 4) {
+		uint32_t *rel = dst + ti->len / 4 - PSCNV_IB_TRACK_DWORDS;
+		uint64_t addr = (uint64_t)rel[1] << 32 | rel[2];
+		if (rel[0] == (4 << 18 | 0x10) && addr >= c->rec.track_base && addr < c->rec.track_base + 0x1000) {
+			addr += ch->track->vm_base - c->rec.track_base;
+			rel[1] = addr >> 32;
+			rel[2] = addr;
+		}
+	}
+	pscnv_ib_push(ch, ch->pb_base + off, ti->len, ti->flags);
+	/* kicks aren't recorded, so every entry gets one */
+	pscnv_ib_kick(ch);
+	c->last_base = off + ti->len;
+	c->last_in_pb = 1;
+}
+
+static double now(void) {
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+int
+main(int argc, char **argv)
+{
+	struct pscnv_trace_hdr hdr;
+	struct pscnv_trace_rec rec;
+	struct chan *c;
+	FILE *fp;
+	char *buf = 0;
+	uint32_t bufsize = 0;
+	uint64_t first_us = 0;
+	double start;
+	int opt, decode_only = 0, paced = 0, i;
+	long raw = -1;
+
+	while ((opt = getopt(argc, argv, "dtr:")) != -1) {
+		if (opt == 'd')
+			decode_only = 1;
+		else if (opt == 't')
+			paced = 1;
+		else if (opt == 'r')
+			raw = strtol(optarg, 0, 16);
+		else
+			goto usage;
+	}
+	if (optind != argc - 1)
+		goto usage;
+	if (raw != -1)
+		return decode_raw(argv[optind], raw);
+	fp = fopen(argv[optind], "rb");
+	if (!fp) {
+		perror(argv[optind]);
+		return 1;
+	}
+	if (fread(&hdr, sizeof hdr, 1, fp) != 1 || memcmp(hdr.magic, PSCNV_TRACE_MAGIC, 8) ||
+	    hdr.version != PSCNV_TRACE_VERSION) {
+		fprintf(stderr, "not a pscnv trace\n");
+		return 1;
+	}
+	if (!decode_only) {
+		fd = drmOpen("pscnv", 0);
+		if (fd == -1) {
+			perror("drmOpen");
+			return 1;
+		}
+	}
+
+	start = now();
+	while (fread(&rec, sizeof rec, 1, fp) == 1) {
+		if (rec.len > bufsize) {
+			bufsize = rec.len;
+			buf = realloc(buf, bufsize);
+			if (!buf)
+				return 1;
+		}
+		if (fread(buf, rec.len, 1, fp) != 1 && rec.len) {
+			fprintf(stderr, "truncated trace\n");
+			break;
+		}
+		if (rec.type < 8)
+			nrecs[rec.type]++;
+		if (!first_us)
+			first_us = rec.time_us;
+		if (paced && !decode_only) {
+			double due = start + (rec.time_us - first_us) / 1e6;
+			if (now() < due)
+				usleep((due - now()) * 1e6);
+		}
+		switch (rec.type) {
+		case PSCNV_TRACE_CHAN: {
+			struct pscnv_trace_chan *tc = (void *)buf;
+			if (nchans == MAXCHANS)
+				break;
+			c = &chans[nchans++];
+			memset(c, 0, sizeof *c);
+			c->cid = tc->cid;
+			c->chipset = tc->chipset;
+			c->rec = *tc;
+			if (pscnv_pb_stats_init(&c->stats, c->chipset))
+				return 1;
+			c->stats.dec.lookup = lookup_obj;
+			c->stats.dec.lookup_priv = c;
+			if (!decode_only)
+				replay_chan(c);
+			break;
+		}
+		case PSCNV_TRACE_BO_NEW:
+			if (!decode_only)
+				replay_bo_new((void *)buf);
+			break;
+		case PSCNV_TRACE_BO_FREE:
+			if (!decode_only)
+				replay_bo_free((void *)buf);
+			break;
+		case PSCNV_TRACE_OBJ: {
+			struct pscnv_trace_obj *to = (void *)buf;
+			if (nobjs < MAXOBJS)
+				objs[nobjs++] = *to;
+			c = find_chan(to->cid);
+			if (!decode_only && c && c->ch)
+				pscnv_obj_eng_new(fd, c->ch->cid, to->handle, to->oclass, to->flags);
+			break;
+		}
+		case PSCNV_TRACE_IB: {
+			struct pscnv_trace_ib *ti = (void *)buf;
+			c = find_chan(ti->cid);
+			if (!c)
+				break;
+			if (ti->nodata)
+				nodata++;
+			else
+				pscnv_pb_stats_feed(&c->stats, (uint32_t *)(ti + 1), ti->len / 4);
+			ib_bytes += ti->len;
+			if (!decode_only)
+				replay_ib(c, ti, (uint32_t *)(ti + 1));
+			break;
+		}
+		}
+	}
+	fclose(fp);
+
+	if (!decode_only) {
+		for (i = 0; i < nchans; i++)
+			if (chans[i].ch)
+				drain(&chans[i]);
+		printf("replayed in %.3f s\n", now() - start);
+	}
+	report();
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: %s [-d | -t] trace\n       %s -r chipset pushbuffer\n", argv[0], argv[0]);
+	return 1;
+}
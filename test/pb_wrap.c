@@ -0,0 +1,113 @@
+/*
+ * Pushbuffer wraparound against a GPU that lags behind, without a card:
+ * a fake PFIFO thread takes its time over every IB entry before moving
+ * GET past it, and checks that the data it points to is still what was
+ * written for it. RING_SPACE must never reuse pushbuffer space GET
+ * hasn't left yet, in particular when restarting at the beginning of
+ * the ring while GET is still reading the previous lap.
+ */
+
+#include "libpscnv.h"
+#include "libpscnv_ib.h"
+#include "fake_chan.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PB_ORDER	13
+#define IB_ORDER	6
+#define SUBMITS		200000
+#define MAXN		700	/* dwords per submission, over a third of the ring */
+
+static volatile uint32_t track[4];
+static struct pscnv_ib_chan ch;
+static volatile int done;
+static int fails, overwrites;
+
+static uint32_t rnd(uint32_t *seed) {
+	*seed = *seed * 1103515245 + 12345;
+	return *seed >> 8;
+}
+
+static void *fake_pfifo(void *arg) {
+	uint32_t get = ch.chmap[0x88/4], seq = 0, seed = 1;
+	volatile int spin;
+	for (;;) {
+		uint32_t put = ch.chmap[0x8c/4];
+		uint64_t start, end;
+		uint32_t *p;
+		int i, n, delay;
+		if (get == put) {
+			if (done)
+				break;
+			sched_yield();
+			continue;
+		}
+		seq++;
+		if (fake_chan_entry(&ch, get, &start, &end)) {
+			fails++;
+			break;
+		}
+		/* the producer gets to run while we're reading */
+		delay = rnd(&seed) % 2000;
+		for (spin = 0; spin < delay; spin++)
+			;
+		if (rnd(&seed) % 16 == 0)
+			sched_yield();
+		p = fake_chan_data(&ch, start);
+		n = (p[0] >> 18) & 0x7ff;
+		if ((p[0] & ~(0x7ff << 18)) != (0x40000000 | 0x1000) ||
+		    (n + 1 + (ch.track_map ? PSCNV_IB_TRACK_DWORDS : 0)) * 4 != end - start) {
+			if (!overwrites++)
+				printf("entry %u at %llu overwritten, header %08x\n", seq,
+				       (unsigned long long)(start - ch.pb_base), p[0]);
+		} else {
+			for (i = 0; i < n; i++)
+				if (p[1 + i] != (seq << 12 | (i & 0xfff)))
+					break;
+			if (i < n && !overwrites++)
+				printf("entry %u at %llu overwritten, word %d\n", seq,
+				       (unsigned long long)(start - ch.pb_base), i);
+			if (ch.track_map && fake_chan_release(&ch, end, sizeof track))
+				fails++;
+		}
+		fake_chan_consume(&ch, &get, end);
+	}
+	return 0;
+}
+
+static void run(int tracked) {
+	pthread_t thr;
+	uint32_t seq, seed = 2;
+	int i, n;
+
+	fake_chan_init(&ch, PB_ORDER, IB_ORDER, tracked ? track : 0, sizeof track);
+	pscnv_ib_set_batch(&ch, 1, 0, 0);
+	done = 0;
+	overwrites = 0;
+	pthread_create(&thr, 0, fake_pfifo, 0);
+	for (seq = 1; seq <= SUBMITS; seq++) {
+		n = 1 + rnd(&seed) % MAXN;
+		BEGIN_RING50_NI(&ch, 0, 0x1000, n);
+		for (i = 0; i < n; i++)
+			OUT_RINGu(&ch, seq << 12 | (i & 0xfff));
+		FIRE_RING(&ch);
+	}
+	done = 1;
+	pthread_join(thr, 0);
+	printf("%s: %d submissions, %llu stalls, %d overwritten\n",
+	       tracked ? "tracked" : "MMIO GET", SUBMITS,
+	       (unsigned long long)ch.nstalls, overwrites);
+	if (overwrites)
+		fails++;
+	fake_chan_fini(&ch);
+}
+
+int main() {
+	run(0);
+	run(1);
+	if (fails)
+		return 1;
+	printf("Passed.\n");
+	return 0;
+}
@@ -0,0 +1,101 @@
+/*
+ * Samples performance counters through the perfmon ioctl and prints, for
+ * each sample, how busy every signal asked for was.
+ *
+ *	perfmon [-p period_us] [-n samples] set.counter=signal...
+ *
+ * e.g. "perfmon -p 1000 1.0=0xc8" samples PGRAPH_IDLE on NV50 every ms.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <xf86drm.h>
+#include "libpscnv.h"
+#include "pscnv_drm.h"
+
+#define RING_ORDER 10
+
+int
+main(int argc, char **argv)
+{
+	uint8_t signals[8][4];
+	uint32_t period = 10000, handle, seq = 0, head;
+	uint64_t map_handle, last = 0;
+	struct drm_pscnv_perf_ring *ring;
+	struct drm_pscnv_perf_sample s;
+	int fd, n = 100, c, i, j, set, ctr, sig;
+	size_t size;
+
+	memset(signals, 0, sizeof signals);
+	while ((c = getopt(argc, argv, "p:n:")) != -1) {
+		switch (c) {
+		case 'p':
+			period = strtoul(optarg, 0, 0);
+			break;
+		case 'n':
+			n = strtoul(optarg, 0, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-p period_us] [-n samples] set.counter=signal...\n", argv[0]);
+			return 1;
+		}
+	}
+	for (i = optind; i < argc; i++) {
+		if (sscanf(argv[i], "%d.%d=%i", &set, &ctr, &sig) != 3 ||
+		    set < 0 || set > 7 || ctr < 0 || ctr > 3 || sig < 0 || sig > 0xff) {
+			fprintf(stderr, "bad signal %s\n", argv[i]);
+			return 1;
+		}
+		signals[set][ctr] = sig;
+	}
+
+	fd = drmOpen("pscnv", 0);
+	if (fd == -1) {
+		perror("drmOpen");
+		return 1;
+	}
+	if (pscnv_perfmon(fd, signals, period, RING_ORDER, &handle, &map_handle)) {
+		perror("perfmon");
+		return 1;
+	}
+	size = PSCNV_PERF_RING_SAMPLES + (sizeof s << RING_ORDER);
+	ring = mmap(0, size, PROT_READ, MAP_SHARED, fd, map_handle);
+	if (ring == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+	printf("ring of %u samples, period %u us\n", ring->size, ring->period_us);
+
+	while (seq < n) {
+		head = *(volatile uint32_t *)&ring->head;
+		if (seq == head) {
+			usleep(period / 2);
+			continue;
+		}
+		if (head - seq > ring->size) {
+			printf("lost %u samples\n", head - seq - ring->size);
+			seq = head - ring->size;
+		}
+		memcpy(&s, (char *)ring + PSCNV_PERF_RING_SAMPLES + (seq & (ring->size - 1)) * sizeof s, sizeof s);
+		__sync_synchronize();
+		if (*(volatile uint32_t *)&ring->head - seq > ring->size)
+			continue;	/* overwritten while we copied it */
+		printf("%8.3f ms", last ? (s.time - last) / 1e6 : 0.0);
+		for (i = 0; i < 8; i++)
+			for (j = 0; j < 4; j++)
+				if (signals[i][j])
+					printf("  %d.%d %5.1f%%", i, j, s.cycles[i] ? 100.0 * s.count[i][j] / s.cycles[i] : 0.0);
+		printf("\n");
+		last = s.time;
+		seq++;
+	}
+
+	pscnv_perfmon(fd, NULL, 0, 0, NULL, NULL);
+	munmap(ring, size);
+	pscnv_gem_close(fd, handle);
+	return 0;
+}
@@ -0,0 +1,444 @@
+/*
+ * Host-side check of the PLL M/N/P search in nouveau_pll.h against the
+ * exhaustive one it replaced, over the whole clock range of each set of
+ * limits, with and without the cache, and how long each takes a clock.
+ * Doesn't need a card.
+ *
+ * Besides the built-in limits below, takes files in the form of the
+ * pll_lims debugfs file, so the limits of real VBIOSes can be checked:
+ *
+ *	cat /sys/kernel/debug/dri/0/pll_lims > nv50.lims
+ *	./pll_sim nv50.lims
+ *
+ * -s sets the number of clocks tried per set of limits.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <time.h>
+#include "nouveau_pll.h"
+
+static int fails;
+
+static void check(int cond, const char *what) {
+	if (!cond) {
+		printf("FAIL: %s\n", what);
+		fails++;
+	}
+}
+
+/* getMNP_single as it was in nouveau_calc.c, taking the chip version
+ * and whether the pre-NV50 M limits apply instead of the device */
+static int
+ref_single(struct pll_lims *pll_lim, int clk, int cv, int clamp,
+	   struct nouveau_pll_vals *bestpv)
+{
+	int minvco = pll_lim->vco1.minfreq, maxvco = pll_lim->vco1.maxfreq;
+	int minM = pll_lim->vco1.min_m, maxM = pll_lim->vco1.max_m;
+	int minN = pll_lim->vco1.min_n, maxN = pll_lim->vco1.max_n;
+	int minU = pll_lim->vco1.min_inputfreq;
+	int maxU = pll_lim->vco1.max_inputfreq;
+	int minP = pll_lim->max_p ? pll_lim->min_p : 0;
+	int maxP = pll_lim->max_p ? pll_lim->max_p : pll_lim->max_usable_log2p;
+	int crystal = pll_lim->refclk;
+	int M, N, thisP, P;
+	int clkP, calcclk;
+	int delta, bestdelta = INT_MAX;
+	int bestclk = 0;
+
+	if (clamp) {
+		if (cv < 0x17 || cv == 0x1a || cv == 0x20) {
+			if (clk > 250000)
+				maxM = 6;
+			if (clk > 340000)
+				maxM = 2;
+		} else if (cv < 0x40) {
+			if (clk > 150000)
+				maxM = 6;
+			if (clk > 200000)
+				maxM = 4;
+			if (clk > 340000)
+				maxM = 2;
+		}
+	}
+
+	P = pll_lim->max_p ? maxP : (1 << maxP);
+	if ((clk * P) < minvco) {
+		minvco = clk * maxP;
+		maxvco = minvco * 2;
+	}
+
+	if (clk + clk/200 > maxvco)	/* +0.5% */
+		maxvco = clk + clk/200;
+
+	for (thisP = minP; thisP <= maxP; thisP++) {
+		P = pll_lim->max_p ? thisP : (1 << thisP);
+		clkP = clk * P;
+
+		if (clkP < minvco)
+			continue;
+		if (clkP > maxvco)
+			return bestclk;
+
+		for (M = minM; M <= maxM; M++) {
+			if (crystal/M < minU)
+				return bestclk;
+			if (crystal/M > maxU)
+				continue;
+
+			N = (clkP * M + crystal/2) / crystal;
+
+			if (N < minN)
+				continue;
+			if (N > maxN)
+				break;
+
+			calcclk = ((N * crystal + P/2) / P + M/2) / M;
+			delta = abs(calcclk - clk);
+			if (delta < bestdelta) {
+				bestdelta = delta;
+				bestclk = calcclk;
+				bestpv->N1 = N;
+				bestpv->M1 = M;
+				bestpv->log2P = thisP;
+				if (delta == 0)
+					return bestclk;
+			}
+		}
+	}
+
+	return bestclk;
+}
+
+/* getMNP_double as it was in nouveau_calc.c */
+static int
+ref_double(struct pll_lims *pll_lim, int clk, int chip_version,
+	   struct nouveau_pll_vals *bestpv)
+{
+	int minvco1 = pll_lim->vco1.minfreq, maxvco1 = pll_lim->vco1.maxfreq;
+	int minvco2 = pll_lim->vco2.minfreq, maxvco2 = pll_lim->vco2.maxfreq;
+	int minU1 = pll_lim->vco1.min_inputfreq, minU2 = pll_lim->vco2.min_inputfreq;
+	int maxU1 = pll_lim->vco1.max_inputfreq, maxU2 = pll_lim->vco2.max_inputfreq;
+	int minM1 = pll_lim->vco1.min_m, maxM1 = pll_lim->vco1.max_m;
+	int minN1 = pll_lim->vco1.min_n, maxN1 = pll_lim->vco1.max_n;
+	int minM2 = pll_lim->vco2.min_m, maxM2 = pll_lim->vco2.max_m;
+	int minN2 = pll_lim->vco2.min_n, maxN2 = pll_lim->vco2.max_n;
+	int maxlog2P = pll_lim->max_usable_log2p;
+	int crystal = pll_lim->refclk;
+	int fixedgain2 = (minM2 == maxM2 && minN2 == maxN2);
+	int M1, N1, M2, N2, log2P;
+	int clkP, calcclk1, calcclk2, calcclkout;
+	int delta, bestdelta = INT_MAX;
+	int bestclk = 0;
+
+	int vco2 = (maxvco2 - maxvco2/200) / 2;
+	for (log2P = 0; clk && log2P < maxlog2P && clk <= (vco2 >> log2P); log2P++)
+		;
+	clkP = clk << log2P;
+
+	if (maxvco2 < clk + clk/200)	/* +0.5% */
+		maxvco2 = clk + clk/200;
+
+	for (M1 = minM1; M1 <= maxM1; M1++) {
+		if (crystal/M1 < minU1)
+			return bestclk;
+		if (crystal/M1 > maxU1)
+			continue;
+
+		for (N1 = minN1; N1 <= maxN1; N1++) {
+			calcclk1 = crystal * N1 / M1;
+			if (calcclk1 < minvco1)
+				continue;
+			if (calcclk1 > maxvco1)
+				break;
+
+			for (M2 = minM2; M2 <= maxM2; M2++) {
+				if (calcclk1/M2 < minU2)
+					break;
+				if (calcclk1/M2 > maxU2)
+					continue;
+
+				N2 = (clkP * M2 + calcclk1/2) / calcclk1;
+				if (N2 < minN2)
+					continue;
+				if (N2 > maxN2)
+					break;
+
+				if (!fixedgain2) {
+					if (chip_version < 0x60)
+						if (N2/M2 < 4 || N2/M2 > 10)
+							continue;
+
+					calcclk2 = calcclk1 * N2 / M2;
+					if (calcclk2 < minvco2)
+						break;
+					if (calcclk2 > maxvco2)
+						continue;
+				} else
+					calcclk2 = calcclk1;
+
+				calcclkout = calcclk2 >> log2P;
+				delta = abs(calcclkout - clk);
+				if (delta < bestdelta) {
+					bestdelta = delta;
+					bestclk = calcclkout;
+					bestpv->N1 = N1;
+					bestpv->M1 = M1;
+					bestpv->N2 = N2;
+					bestpv->M2 = M2;
+					bestpv->log2P = log2P;
+					if (delta == 0)
+						return bestclk;
+				}
+			}
+		}
+	}
+
+	return bestclk;
+}
+
+static int
+ref_calc(struct pll_lims *lim, int clk, int cv, int clamp,
+	 struct nouveau_pll_vals *pv)
+{
+	if (!lim->vco2.maxfreq)
+		return ref_single(lim, clk, cv, clamp, pv);
+	return ref_double(lim, clk, cv, pv);
+}
+
+struct lims {
+	const char *name;
+	int cv;
+	int clamp;
+	struct pll_lims lim;
+};
+
+#define VCO(minf, maxf, minu, maxu, minm, maxm, minn, maxn) \
+	{ minf, maxf, minu, maxu, minm, maxm, minn, maxn }
+
+/*
+ * Limits made up to look like what get_pll_limits builds from each kind of
+ * table, not dumps of real VBIOSes; give those on the command line.
+ */
+static struct lims builtin[] = {
+	/* no limits table: the BMP VCO range and strap defaults */
+	{ "nv05 no table", 0x05, 1, { 0, VCO(128000, 256000, 0, INT_MAX, 7, 13, 1, 255),
+	  VCO(0, 0, 0, 0, 0, 0, 0, 0), 4, 4, 0, 0, 0, 13500 } },
+	{ "nv11 no table", 0x11, 1, { 0, VCO(128000, 256000, 0, INT_MAX, 1, 14, 1, 255),
+	  VCO(0, 0, 0, 0, 0, 0, 0, 0), 4, 4, 0, 0, 0, 14318 } },
+	{ "nv18 no table", 0x18, 1, { 0, VCO(128000, 350000, 0, INT_MAX, 1, 14, 1, 255),
+	  VCO(0, 0, 0, 0, 0, 0, 0, 0), 5, 5, 0, 0, 0, 27000 } },
+	/* 0x10 table, two stage */
+	{ "nv31 0x10", 0x31, 1, { 0, VCO(100000, 400000, 1000, INT_MAX, 1, 13, 1, 255),
+	  VCO(400000, 1000000, 5000, INT_MAX, 1, 4, 4, 40), 7, 6, 0, 0, 0, 13500 } },
+	{ "nv30 0x10", 0x30, 1, { 0, VCO(100000, 350000, 1000, INT_MAX, 1, 13, 1, 255),
+	  VCO(350000, 1000000, 5000, INT_MAX, 1, 4, 4, 31), 7, 6, 0, 0, 0, 27000 } },
+	/* 0x20 table, one and two stage */
+	{ "nv43 0x21 single", 0x43, 1, { 0, VCO(400000, 1000000, 3000, 25000, 1, 14, 1, 255),
+	  VCO(0, 0, 0, 0, 0, 0, 0, 0), 6, 6, 0, 0, 0, 27000 } },
+	{ "nv44 0x21 double", 0x44, 1, { 0, VCO(400000, 1000000, 5000, 25000, 1, 13, 4, 90),
+	  VCO(400000, 1400000, 50000, 300000, 1, 4, 4, 40), 6, 6, 0, 0, 0, 27000 } },
+	{ "nv49 0x21 fixed 2nd", 0x49, 1, { 0, VCO(400000, 1000000, 5000, 25000, 1, 13, 4, 90),
+	  VCO(100000, 1400000, 50000, 500000, 1, 1, 1, 1), 6, 6, 0, 0, 0, 27000 } },
+	/* 0x30 table */
+	{ "nv50 0x30 core", 0x50, 0, { 0, VCO(100000, 500000, 5000, 50000, 1, 14, 4, 250),
+	  VCO(500000, 1400000, 50000, 500000, 1, 10, 4, 80), 7, 7, 0, 0, 0, 27000 } },
+	{ "nv86 0x30 vpll", 0x86, 0, { 0, VCO(100000, 400000, 4000, 40000, 1, 20, 1, 255),
+	  VCO(400000, 1000000, 40000, 400000, 1, 4, 1, 40), 6, 6, 0, 0, 0, 27000 } },
+	{ "nv92 0x30 unk", 0x92, 0, { 0, VCO(200000, 800000, 10000, 100000, 1, 6, 2, 120),
+	  VCO(800000, 1800000, 100000, 800000, 1, 8, 4, 64), 7, 7, 0, 0, 0, 100000 } },
+	/* 0x40 table, linear P */
+	{ "nva3 0x40 core", 0xa3, 0, { 0, VCO(1000000, 2000000, 13500, 108000, 1, 4, 10, 150),
+	  VCO(0, 0, 0, 0, 0, 0, 0, 0), 0, 0, 0, 1, 63, 27000 } },
+	{ "nva5 0x40 vpll", 0xa5, 0, { 0, VCO(400000, 1200000, 5000, 50000, 1, 20, 8, 255),
+	  VCO(0, 0, 0, 0, 0, 0, 0, 0), 0, 0, 0, 1, 63, 100000 } },
+};
+
+static uint32_t seed = 1;
+
+static int rnd(int lo, int hi) {
+	seed = seed * 1103515245 + 12345;
+	return lo + (int)((seed >> 8) % (uint32_t)(hi - lo + 1));
+}
+
+/* Odd limits, to try the bounds with more than sane tables do. */
+static void make_random(struct lims *l, int i) {
+	struct pll_lims *lim = &l->lim;
+	int m, n;
+
+	memset(lim, 0, sizeof *lim);
+	l->name = "random";
+	l->cv = rnd(0x05, 0xc0);
+	l->clamp = l->cv < 0x50;
+	lim->refclk = rnd(0, 3) ? 27000 : rnd(10000, 100000);
+	lim->vco1.minfreq = rnd(0, 4) ? rnd(10000, 500000) : 0;
+	lim->vco1.maxfreq = lim->vco1.minfreq + rnd(10000, 1500000);
+	lim->vco1.min_inputfreq = rnd(0, 2) ? rnd(0, 20000) : 0;
+	lim->vco1.max_inputfreq = rnd(0, 2) ? rnd(5000, 120000) : INT_MAX;
+	m = rnd(1, 4);
+	n = rnd(1, 20);
+	lim->vco1.min_m = m;
+	lim->vco1.max_m = rnd(m, i & 1 ? 16 : 40);
+	lim->vco1.min_n = n;
+	lim->vco1.max_n = rnd(n, 255);
+	if (i % 3 == 0) {
+		/* linear P */
+		lim->min_p = rnd(1, 3);
+		lim->max_p = rnd(lim->min_p, 63);
+	} else if (i % 3 == 1) {
+		lim->max_log2p = lim->max_usable_log2p = rnd(0, 7);
+	} else {
+		lim->max_log2p = lim->max_usable_log2p = rnd(0, 7);
+		lim->vco2.minfreq = rnd(0, 4) ? rnd(10000, 800000) : 0;
+		lim->vco2.maxfreq = lim->vco2.minfreq + rnd(10000, 1500000);
+		lim->vco2.min_inputfreq = rnd(0, 2) ? rnd(0, 100000) : 0;
+		lim->vco2.max_inputfreq = rnd(0, 2) ? rnd(20000, 800000) : INT_MAX;
+		m = rnd(1, 3);
+		n = rnd(1, 8);
+		if (rnd(0, 5)) {
+			lim->vco2.min_m = m;
+			lim->vco2.max_m = rnd(m, 12);
+			lim->vco2.min_n = n;
+			lim->vco2.max_n = rnd(n, 100);
+		} else {
+			lim->vco2.min_m = lim->vco2.max_m = m;
+			lim->vco2.min_n = lim->vco2.max_n = n;
+		}
+	}
+}
+
+static int read_lims(const char *file, struct lims *l, int max) {
+	FILE *f = fopen(file, "r");
+	char line[512];
+	int n = 0, type, clamp, v[22];
+	unsigned cv, reg;
+
+	if (!f) {
+		perror(file);
+		exit(1);
+	}
+	while (n < max && fgets(line, sizeof line, f)) {
+		if (line[0] == '#')
+			continue;
+		if (sscanf(line, "%x %x %d %x %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d",
+			   &type, &cv, &clamp, &reg, &v[0], &v[1], &v[2], &v[3], &v[4], &v[5],
+			   &v[6], &v[7], &v[8], &v[9], &v[10], &v[11], &v[12], &v[13], &v[14],
+			   &v[15], &v[16], &v[17], &v[18], &v[19], &v[20], &v[21]) != 26) {
+			fprintf(stderr, "%s: can't parse %s", file, line);
+			continue;
+		}
+		memset(&l[n], 0, sizeof l[n]);
+		l[n].name = file;
+		l[n].cv = cv;
+		l[n].clamp = clamp;
+		l[n].lim.reg = reg;
+		l[n].lim.vco1 = (typeof(l[n].lim.vco1))VCO(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7]);
+		l[n].lim.vco2 = (typeof(l[n].lim.vco2))VCO(v[8], v[9], v[10], v[11], v[12], v[13], v[14], v[15]);
+		l[n].lim.max_log2p = v[16];
+		l[n].lim.max_usable_log2p = v[17];
+		l[n].lim.log2p_bias = v[18];
+		l[n].lim.min_p = v[19];
+		l[n].lim.max_p = v[20];
+		l[n].lim.refclk = v[21];
+		n++;
+	}
+	fclose(f);
+	return n;
+}
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint64_t t_ref, t_fast, t_hit, solves;
+
+/* Every clock from 0 to a bit past the top of the VCOs. */
+static void sweep(struct lims *l, int steps) {
+	struct nouveau_pll_cache *cache = calloc(1, sizeof *cache);
+	struct nouveau_pll_vals pv_ref, pv_fast, pv_miss, pv_hit, res;
+	int top = l->lim.vco1.maxfreq > l->lim.vco2.maxfreq ?
+		l->lim.vco1.maxfreq : l->lim.vco2.maxfreq;
+	int step, clk, out_ref, out_fast, out_miss, out_hit;
+	uint64_t t0, t1, t2, t3;
+	char what[128];
+	int bad = 0;
+
+	top += top / 50;
+	step = top / steps > 0 ? top / steps : 1;
+	for (clk = 0; clk <= top && bad < 5; clk += step) {
+		memset(&pv_ref, 0xa5, sizeof pv_ref);
+		pv_fast = pv_miss = pv_hit = pv_ref;
+
+		t0 = now_ns();
+		out_ref = ref_calc(&l->lim, clk, l->cv, l->clamp, &pv_ref);
+		t1 = now_ns();
+		out_fast = nouveau_pll_search(&l->lim, clk, l->cv, l->clamp, &res);
+		nouveau_pll_apply(&l->lim, &pv_fast, &res);
+		t2 = now_ns();
+		out_miss = nouveau_pll_calc(cache, &l->lim, clk, l->cv, l->clamp, &pv_miss);
+		t3 = now_ns();
+		out_hit = nouveau_pll_calc(cache, &l->lim, clk, l->cv, l->clamp, &pv_hit);
+		t_hit += now_ns() - t3;
+		t_ref += t1 - t0;
+		t_fast += t2 - t1;
+		solves++;
+
+		if (out_fast != out_ref || memcmp(&pv_fast, &pv_ref, sizeof pv_ref) ||
+		    out_miss != out_ref || memcmp(&pv_miss, &pv_ref, sizeof pv_ref) ||
+		    out_hit != out_ref || memcmp(&pv_hit, &pv_ref, sizeof pv_ref)) {
+			snprintf(what, sizeof what,
+				 "%s cv %02x, %d kHz: %d M1 %d N1 %d M2 %d N2 %d P %d, expected %d M1 %d N1 %d M2 %d N2 %d P %d",
+				 l->name, l->cv, clk, out_fast, pv_fast.M1, pv_fast.N1,
+				 pv_fast.M2, pv_fast.N2, pv_fast.log2P, out_ref, pv_ref.M1,
+				 pv_ref.N1, pv_ref.M2, pv_ref.N2, pv_ref.log2P);
+			check(0, what);
+			bad++;
+		}
+	}
+	check(cache->hits == cache->misses, "every second lookup hits");
+	free(cache);
+}
+
+int main(int argc, char **argv) {
+	static struct lims l[256];
+	int steps = 20000, n = 0, i, opt;
+
+	while ((opt = getopt(argc, argv, "s:")) != -1) {
+		switch (opt) {
+		case 's':
+			steps = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-s steps] [pll_lims file...]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (steps < 1)
+		steps = 1;
+
+	for (i = 0; i < sizeof builtin / sizeof *builtin; i++)
+		sweep(&builtin[i], steps);
+	for (i = 0; i < 300; i++) {
+		make_random(&l[0], i);
+		sweep(&l[0], steps / 20 ? steps / 20 : 1);
+	}
+	for (i = optind; i < argc; i++)
+		n += read_lims(argv[i], l + n, 256 - n);
+	for (i = 0; i < n; i++)
+		sweep(&l[i], steps);
+
+	printf("%llu clocks: exhaustive %llu ns, bounded %llu ns, cached %llu ns a clock\n",
+	       (unsigned long long)solves, (unsigned long long)(t_ref / solves),
+	       (unsigned long long)(t_fast / solves), (unsigned long long)(t_hit / solves));
+
+	if (fails)
+		return 1;
+	printf("Passed.\n");
+	return 0;
+}
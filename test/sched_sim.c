@@ -0,0 +1,84 @@
+/*
+ * Host-side check of the weighted PFIFO playlist and timeslice encoding
+ * used by DRM_PSCNV_CHAN_SCHED. Doesn't need a card.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "pscnv_sched.h"
+
+static int fails;
+
+static void check(int cond, const char *what) {
+	if (!cond) {
+		printf("FAIL: %s\n", what);
+		fails++;
+	}
+}
+
+static int count(const int *list, int n, int cid) {
+	int i, res = 0;
+	for (i = 0; i < n; i++)
+		if (list[i] == cid)
+			res++;
+	return res;
+}
+
+int main() {
+	int prio[128];
+	int cur[128];
+	int list[512];
+	int i, n;
+
+	/* all channels at default priority: plain cid order, as before */
+	for (i = 0; i < 128; i++)
+		prio[i] = -1;
+	prio[3] = prio[7] = prio[9] = PSCNV_CHAN_PRIO_NORMAL;
+	n = pscnv_sched_build_playlist(prio, cur, 128, list, 512);
+	check(n == 3 && list[0] == 3 && list[1] == 7 && list[2] == 9, "equal priorities");
+
+	/* one realtime job among normal ones: it comes first and appears
+	 * once more per priority step above the lowest one present. */
+	prio[7] = PSCNV_CHAN_PRIO_REALTIME;
+	n = pscnv_sched_build_playlist(prio, cur, 128, list, 512);
+	check(n == 5, "realtime entry count");
+	check(list[0] == 7, "realtime first");
+	check(count(list, n, 7) == 3, "realtime weight");
+	check(count(list, n, 3) == 1 && count(list, n, 9) == 1, "normal weight");
+	for (i = 1; i < n; i++)
+		check(list[i] != list[i-1], "no back-to-back duplicates");
+
+	/* full mix: weights 4, 3, 1, spread over the playlist */
+	prio[3] = PSCNV_CHAN_PRIO_LOW;
+	prio[9] = PSCNV_CHAN_PRIO_HIGH;
+	n = pscnv_sched_build_playlist(prio, cur, 128, list, 512);
+	{
+		static const int expect[] = { 7, 9, 7, 9, 3, 7, 9, 7 };
+		check(n == 8 && !memcmp(list, expect, sizeof expect), "mixed priorities");
+	}
+
+	/* worst case still fits a NVC0 playlist */
+	for (i = 0; i < 128; i++)
+		prio[i] = (i >= 1 && i <= 126) ? (i & 1 ? PSCNV_CHAN_PRIO_REALTIME : PSCNV_CHAN_PRIO_LOW) : -1;
+	n = pscnv_sched_build_playlist(prio, cur, 128, list, 512);
+	check(n == 63 * 4 + 63, "worst case size");
+	n = pscnv_sched_build_playlist(prio, cur, 128, list, 16);
+	check(n == 16, "truncation");
+
+	/* nothing enabled */
+	for (i = 0; i < 128; i++)
+		prio[i] = -1;
+	check(pscnv_sched_build_playlist(prio, cur, 128, list, 512) == 0, "empty");
+
+	/* timeslice encoding */
+	check(pscnv_sched_timeslice_nvc0(0) == 0x10003080, "default timeslice");
+	check(pscnv_sched_timeslice_nvc0(1024) == 0x10003080, "1024us");
+	check(pscnv_sched_timeslice_nvc0(100) == 0x10000064, "100us");
+	check(pscnv_sched_timeslice_nvc0(1u << 30) == 0x1000f0ff, "clamped");
+
+	if (fails)
+		return 1;
+	printf("Passed.\n");
+	return 0;
+}